@@ -1,5 +1,6 @@
 #include "counter.h"
 #include "logger.h"
+#include "metrics.h"
 
 Counter::Counter(QObject *parent) : QObject(parent), counterChanged(false)
 {
@@ -15,13 +16,8 @@ Counter *Counter::instance()
 void Counter::countValue(const QString &key, int val)
 {
     if(key.isEmpty()) return;
-    if(!counterKV.contains(key))
-    {
-        QMutexLocker lock(&hashMutex);
-        counterKV[key] = QSharedPointer<CountStat>::create();
-    }
-    counterKV[key]->num++;
-    counterKV[key]->value += val;
+    Metrics::instance()->add("kikoplay_counter_samples_total", 1, {key});
+    Metrics::instance()->add("kikoplay_counter_value_sum", val, {key});
     counterChanged = true;
 }
 
@@ -29,19 +25,17 @@ void Counter::logCounter(const QString &key)
 {
     static QString msg("%1: %2, num: %3  total: %4");
     QStringList allKeys;
-    if(!key.isEmpty() && counterKV.contains(key))
-    {
-        allKeys.append(key);
-    }
-    else
+    for(const QStringList &labelValues : Metrics::instance()->series("kikoplay_counter_samples_total"))
     {
-        allKeys = counterKV.keys();
-        std::sort(allKeys.begin(), allKeys.end());
+        if(key.isEmpty() || labelValues.first() == key) allKeys.append(labelValues.first());
     }
+    std::sort(allKeys.begin(), allKeys.end());
     QStringList allMsg{QString("All Counter(%1):").arg(allKeys.size())};
     for(const QString &key : allKeys)
     {
-        double val = counterKV[key]->value, num = counterKV[key]->num;
+        double val = Metrics::instance()->value("kikoplay_counter_value_sum", {key});
+        double num = Metrics::instance()->value("kikoplay_counter_samples_total", {key});
+        if(num == 0) continue;
         QString log = msg.arg(key, -20).arg(val / num, 8, 'f', 2).arg((qint64)num, 6).arg((qint64)val, 6);
         allMsg.append(log);
     }
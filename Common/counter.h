@@ -3,11 +3,12 @@
 
 #include <QObject>
 #include <atomic>
-#include <QHash>
-#include <QTimer>
-#include <QMutex>
-#include <QSharedPointer>
+#include <QBasicTimer>
 
+/*
+ * Debug counters: number and sum of the values counted per key, logged every 10s when they change.
+ * Values are kept by Metrics, so counting is lock-free and the counters are exported with the other metrics.
+ */
 class Counter : public QObject
 {
     Q_OBJECT
@@ -21,14 +22,7 @@ public:
 protected:
     void timerEvent(QTimerEvent* event);
 private:
-    struct CountStat
-    {
-        std::atomic<qint64> num;
-        std::atomic<qint64> value;
-    };
-    QHash<QString, QSharedPointer<CountStat>> counterKV;
     std::atomic<bool> counterChanged;
-    QMutex hashMutex;
     QBasicTimer flushTimer;
 };
 
@@ -1,43 +1,69 @@
 #include "htmlparsersax.h"
+#include <cstring>
+
+namespace
+{
+    inline bool isSpaceChar(char c)
+    {
+        return c==' ' || c=='\n' || c=='\t' || c=='\r' || c=='\f';
+    }
+    inline bool isNameChar(char c)
+    {
+        return (c>='a' && c<='z') || (c>='A' && c<='Z') || (c>='0' && c<='9') || c=='-' || c=='_' || c==':';
+    }
+}
 
 void HTMLParserSax::parseNode()
 {
     begin++;
+    resetNode();
     if(begin==end)return;
     if(*begin=='!')
     {
         parseComment();
-		nodeName.clear();
-		propertyMap.clear();
         return;
     }
     QByteArray::const_iterator iter=begin;
-    nodeName.clear();
     isStart=!(*iter=='/');
     if(!isStart)iter++;
-    while (iter!=end && QChar(*iter).isLetterOrNumber()) nodeName+=*iter++;
-    propertyMap.clear();
+    QByteArray::const_iterator nameBegin=iter;
+    while (iter!=end && isNameChar(*iter)) iter++;
+    nodeName=span(nameBegin, iter);
     while(iter!=end && *iter!='>')
     {
-        while(iter!=end && QChar(*iter).isSpace())iter++;
+        while(iter!=end && isSpaceChar(*iter))iter++;
+        if(iter==end || *iter=='>') break;
         if(*iter=='/')
         {
-            while(iter!=end && *iter!='>')iter++;
-            break;
+            iter++;
+            if(iter!=end && *iter=='>') selfClosing=true;
+            continue;
         }
-        else if(*iter!='>')
+        QByteArray::const_iterator propertyBegin=iter;
+        while (iter!=end && *iter!='=' && *iter!='>' && *iter!='/' && !isSpaceChar(*iter)) iter++;
+        Attribute attr;
+        attr.name=span(propertyBegin, iter);
+        while(iter!=end && isSpaceChar(*iter))iter++;
+        if(iter!=end && *iter=='=')
         {
-            QByteArray propertyName,propertyVal;
-            while (iter!=end && *iter!='=' && *iter!='>') propertyName+=*iter++;
-            if(iter!=end && *iter!='>')
+            iter++;
+            while(iter!=end && isSpaceChar(*iter))iter++;
+            if(iter!=end && (*iter=='"' || *iter=='\''))
             {
-                iter++;
-                QChar q(*iter++);
-                while (iter!=end && *iter!=q) propertyVal+=*iter++;
-                propertyMap.insert(propertyName,propertyVal);
+                const char q=*iter++;
+                QByteArray::const_iterator valBegin=iter;
+                while (iter!=end && *iter!=q) iter++;
+                attr.value=span(valBegin, iter);
                 if(iter!=end) iter++;
             }
+            else
+            {
+                QByteArray::const_iterator valBegin=iter;
+                while (iter!=end && *iter!='>' && !isSpaceChar(*iter)) iter++;
+                attr.value=span(valBegin, iter);
+            }
         }
+        if(attr.name.len>0) attributes.push_back(attr);
     }
     if(iter!=end && *iter=='>')iter++;
     begin=iter;
@@ -45,6 +71,13 @@ void HTMLParserSax::parseNode()
 
 void HTMLParserSax::parseComment()
 {
+    if(end-begin<3 || begin[1]!='-' || begin[2]!='-')
+    {
+        // <!DOCTYPE ...>, <![CDATA[...]]>
+        while(begin!=end && *begin!='>')begin++;
+        if(begin!=end)begin++;
+        return;
+    }
     int commentState=0;
     while(begin!=end)
     {
@@ -68,14 +101,19 @@ void HTMLParserSax::parseComment()
 
 void HTMLParserSax::skip()
 {
-    while(begin!=end)
-    {
-        if(*begin!='<')begin++;
-        else return;
-    }
+    const char *next = static_cast<const char *>(memchr(begin, '<', end-begin));
+    begin = next? next : end;
 }
 
-HTMLParserSax::HTMLParserSax(const QByteArray &content):cHtml(content), isStart(false)
+void HTMLParserSax::resetNode()
+{
+    nodeName=Span();
+    attributes.clear();
+    isStart=false;
+    selfClosing=false;
+}
+
+HTMLParserSax::HTMLParserSax(const QByteArray &content):cHtml(content), nodeBegin(0), isStart(false), selfClosing(false)
 {
     begin=cHtml.cbegin();
     end=cHtml.cend();
@@ -93,62 +131,72 @@ void HTMLParserSax::seekTo(int pos)
 {
     pos = qBound<int>(0, pos, cHtml.size());
     begin=cHtml.cbegin()+pos;
-    nodeName="";
-    isStart=false;
-    propertyMap.clear();
+    nodeBegin=pos;
+    resetNode();
 }
 
 void HTMLParserSax::readNext()
 {
     if(begin==end)return;
-    if(QChar(*begin).isSpace())
-        while(begin!=end && QChar(*begin).isSpace())begin++;
-    if(*begin=='<')
+    while(begin!=end && isSpaceChar(*begin))begin++;
+    nodeBegin=curPos();
+    if(begin!=end && *begin=='<')
     {
         parseNode();
     }
     else
     {
         skip();
-        isStart=false;
-        nodeName.clear();
-        propertyMap.clear();
+        resetNode();
     }
 }
 
 const QByteArray HTMLParserSax::readContentText()
 {
-    int contentState=0;
-    QByteArray text;
+    QByteArray::const_iterator textBegin=begin;
     while(begin!=end)
     {
-        if(*begin=='<')
-        {
-            if(contentState==0)contentState=1;
-        }
-        else if(*begin=='/' && contentState==1)
-        {
-            begin-=1;
-            break;
-        }
-        else
-        {
-            if(contentState==1)
-                text+='<';
-            text+=*begin;
-        }
+        skip();
+        if(begin==end) break;
+        if(begin+1!=end && begin[1]=='/') break;
         begin++;
     }
-    return text;
+    return QByteArray::fromRawData(textBegin, begin-textBegin);
 }
 
-const QByteArray HTMLParserSax::readContentUntil(const QString &node, bool isStart)
+const QByteArray HTMLParserSax::readContentUntil(const QByteArray &node, bool isStart)
 {
     int startPos = curPos();
     while(begin!=end)
     {
         readNext();
-        if(nodeName==node && this->isStart==isStart) break;
+        if(this->isStart==isStart && view(nodeName)==node) break;
+    }
+    return QByteArray::fromRawData(cHtml.constData()+startPos, curPos()-startPos);
+}
+
+void HTMLParserSax::skipRawText(const QByteArray &node)
+{
+    while(begin!=end)
+    {
+        skip();
+        if(end-begin > node.size()+2 && begin[1]=='/' && equalsIgnoreCase(node, begin+2, node.size()) &&
+           !isNameChar(begin[node.size()+2]))
+            return;
+        if(begin!=end) begin++;
     }
-    return cHtml.mid(startPos,curPos()-startPos);
+}
+
+const QByteArray HTMLParserSax::currentNodeProperty(const QByteArray &name) const
+{
+    for(const Attribute &attr : attributes)
+    {
+        if(view(attr.name)==name) return view(attr.value);
+    }
+    return QByteArray();
+}
+
+bool HTMLParserSax::equalsIgnoreCase(const QByteArray &a, const char *b, int len)
+{
+    return a.size()==len && qstrnicmp(a.constData(), b, len)==0;
 }
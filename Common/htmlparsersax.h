@@ -1,32 +1,61 @@
 #ifndef HTMLPARSERSAX_H
 #define HTMLPARSERSAX_H
 #include <QtCore>
+#include <vector>
 
+/*
+ * Tokens returned by the parser are views into the parsed buffer (QByteArray::fromRawData),
+ * they stay valid until addData is called or the parser is destroyed.
+ */
 class HTMLParserSax
 {
-    QByteArray cHtml;
-    QByteArray::const_iterator begin,end;
-
-    QByteArray nodeName;
-    QMap<QByteArray,QByteArray> propertyMap;
-    bool isStart;
-    void parseNode();
-    void parseComment();
-    void skip();
 public:
+    struct Span
+    {
+        int pos = 0;
+        int len = 0;
+    };
+    struct Attribute
+    {
+        Span name, value;
+    };
+
     HTMLParserSax(const QByteArray &content);
     void addData(const QByteArray &content);
     void seekTo(int pos);
     void readNext();
-    inline bool atEnd(){return begin==end;}
-    inline int curPos(){return begin-cHtml.cbegin();}
+    inline bool atEnd() const {return begin==end;}
+    inline int curPos() const {return begin-cHtml.cbegin();}
+    inline int nodePos() const {return nodeBegin;}
     const QByteArray readContentText();
-    const QByteArray readContentUntil(const QString &node,bool isStart);
+    const QByteArray readContentUntil(const QByteArray &node,bool isStart);
+    // move to the end tag of a raw text element(script, style, ...) without tokenizing its content
+    void skipRawText(const QByteArray &node);
 
-    inline bool isStartNode(){return isStart;}
-    inline const QByteArray &currentNode(){return nodeName;}
-    inline const QByteArray currentNodeProperty(const QByteArray &name){return propertyMap.value(name);}
+    inline bool isStartNode() const {return isStart;}
+    inline bool isSelfClosingNode() const {return selfClosing;}
+    inline const QByteArray currentNode() const {return view(nodeName);}
+    inline const Span &currentNodeSpan() const {return nodeName;}
+    const QByteArray currentNodeProperty(const QByteArray &name) const;
+    inline const std::vector<Attribute> &currentAttributes() const {return attributes;}
 
+    inline const QByteArray &content() const {return cHtml;}
+    inline const QByteArray view(const Span &span) const {return QByteArray::fromRawData(cHtml.constData()+span.pos, span.len);}
+    static bool equalsIgnoreCase(const QByteArray &a, const char *b, int len);
+
+private:
+    QByteArray cHtml;
+    QByteArray::const_iterator begin,end;
+
+    int nodeBegin;
+    Span nodeName;
+    std::vector<Attribute> attributes;
+    bool isStart, selfClosing;
+    void parseNode();
+    void parseComment();
+    void skip();
+    void resetNode();
+    inline Span span(QByteArray::const_iterator from, QByteArray::const_iterator to) const {return {int(from-cHtml.cbegin()), int(to-from)};}
 };
 
 #endif // HTMLPARSERSAX_H
@@ -0,0 +1,401 @@
+#include "htmlselector.h"
+#include <cstring>
+
+namespace
+{
+    const char *const voidElements[] = {"area", "base", "br", "col", "embed", "hr", "img", "input", "link", "meta", "param", "source", "track", "wbr", nullptr};
+    const char *const rawTextElements[] = {"script", "style", "textarea", "title", nullptr};
+    // elements whose end tag may be omitted: opening one closes an open sibling
+    const char *const siblingClosed[][2] = {{"li", "li"}, {"p", "p"}, {"option", "option"}, {"tr", "tr"},
+                                            {"td", "td"}, {"td", "th"}, {"th", "td"}, {"th", "th"},
+                                            {"dt", "dt"}, {"dt", "dd"}, {"dd", "dt"}, {"dd", "dd"}, {nullptr, nullptr}};
+
+    inline bool isSpaceChar(char c)
+    {
+        return c==' ' || c=='\n' || c=='\t' || c=='\r' || c=='\f';
+    }
+    inline bool isIdentChar(char c)
+    {
+        return (c>='a' && c<='z') || (c>='A' && c<='Z') || (c>='0' && c<='9') || c=='-' || c=='_' || (c & 0x80);
+    }
+    bool equals(const QByteArray &name, const char *s)
+    {
+        return HTMLParserSax::equalsIgnoreCase(name, s, qstrlen(s));
+    }
+    bool inList(const QByteArray &name, const char *const list[])
+    {
+        for(int i = 0; list[i]; ++i)
+        {
+            if(equals(name, list[i])) return true;
+        }
+        return false;
+    }
+    bool closesOpenElement(const QByteArray &opening, const QByteArray &open)
+    {
+        for(int i = 0; siblingClosed[i][0]; ++i)
+        {
+            if(equals(opening, siblingClosed[i][0]) && equals(open, siblingClosed[i][1])) return true;
+        }
+        return false;
+    }
+    bool containsToken(const QByteArray &list, const QByteArray &token)
+    {
+        const char *p = list.constData(), *end = p + list.size();
+        while(p < end)
+        {
+            while(p < end && isSpaceChar(*p)) ++p;
+            const char *tokenBegin = p;
+            while(p < end && !isSpaceChar(*p)) ++p;
+            if(p - tokenBegin == token.size() && memcmp(tokenBegin, token.constData(), token.size()) == 0) return true;
+        }
+        return false;
+    }
+    QByteArray decodeEntities(const QByteArray &text)
+    {
+        if(!text.contains('&')) return text;
+        static const QHash<QByteArray, QByteArray> entities{
+            {"amp", "&"}, {"lt", "<"}, {"gt", ">"}, {"quot", "\""}, {"apos", "'"}, {"nbsp", " "}
+        };
+        QByteArray decoded;
+        decoded.reserve(text.size());
+        int i = 0;
+        while(i < text.size())
+        {
+            const int amp = text.indexOf('&', i);
+            const int semicolon = amp < 0? -1 : text.indexOf(';', amp);
+            if(semicolon < 0 || semicolon - amp > 10)
+            {
+                decoded.append(text.constData() + i, (amp < 0? text.size() : amp + 1) - i);
+                i = amp < 0? text.size() : amp + 1;
+                continue;
+            }
+            decoded.append(text.constData() + i, amp - i);
+            const QByteArray entity(text.mid(amp + 1, semicolon - amp - 1));
+            if(entity.startsWith('#'))
+            {
+                bool ok = false;
+                const uint code = entity.startsWith("#x") || entity.startsWith("#X")? entity.mid(2).toUInt(&ok, 16) : entity.mid(1).toUInt(&ok);
+                if(ok) decoded.append(QString::fromUcs4(&code, 1).toUtf8());
+                else decoded.append(text.constData() + amp, semicolon - amp + 1);
+            }
+            else if(entities.contains(entity))
+            {
+                decoded.append(entities.value(entity));
+            }
+            else
+            {
+                decoded.append(text.constData() + amp, semicolon - amp + 1);
+            }
+            i = semicolon + 1;
+        }
+        return decoded;
+    }
+}
+
+HTMLSelector::HTMLSelector(const QByteArray &selector)
+{
+    parse(selector);
+}
+
+QVector<HTMLSelector::Match> HTMLSelector::select(const QByteArray &html, int limit) const
+{
+    QVector<Match> matches;
+    if(!isValid() || limit == 0) return matches;
+    HTMLParserSax parser(html);
+    Context context{parser, {}, {}};
+    int openMatches = 0;
+    auto closeTop = [&](int innerEnd, int outerEnd){
+        const OpenElement &element = context.stack.back();
+        if(element.matchIndex >= 0)
+        {
+            matches[element.matchIndex].innerEnd = innerEnd;
+            matches[element.matchIndex].outerEnd = outerEnd;
+            --openMatches;
+        }
+        context.attrPool.resize(element.attrBegin);
+        context.stack.pop_back();
+    };
+    while(!parser.atEnd())
+    {
+        if(limit > 0 && matches.size() >= limit && openMatches == 0) break;
+        parser.readNext();
+        const QByteArray name(parser.currentNode());
+        if(name.isEmpty()) continue;
+        if(parser.isStartNode())
+        {
+            if(!context.stack.empty() && closesOpenElement(name, parser.view(context.stack.back().name)))
+            {
+                closeTop(parser.nodePos(), parser.nodePos());
+            }
+            const auto &attributes = parser.currentAttributes();
+            context.stack.push_back({parser.currentNodeSpan(), int(context.attrPool.size()), int(attributes.size()), -1});
+            context.attrPool.insert(context.attrPool.end(), attributes.begin(), attributes.end());
+            if(limit < 0 || matches.size() < limit)
+            {
+                const int top = int(context.stack.size()) - 1;
+                for(const Complex &complex : group)
+                {
+                    if(!matchComplex(context, top, complex, complex.size() - 1)) continue;
+                    Match match;
+                    match.name = parser.currentNodeSpan();
+                    match.attributes.reserve(int(attributes.size()));
+                    for(const auto &attr : attributes) match.attributes.append(attr);
+                    match.outerBegin = parser.nodePos();
+                    match.innerBegin = parser.curPos();
+                    context.stack.back().matchIndex = matches.size();
+                    matches.append(match);
+                    ++openMatches;
+                    break;
+                }
+            }
+            if(parser.isSelfClosingNode() || inList(name, voidElements))
+            {
+                closeTop(parser.curPos(), parser.curPos());
+            }
+            else if(inList(name, rawTextElements))
+            {
+                parser.skipRawText(name);
+            }
+        }
+        else
+        {
+            int index = int(context.stack.size()) - 1;
+            while(index >= 0 && !HTMLParserSax::equalsIgnoreCase(name, html.constData() + context.stack[index].name.pos, context.stack[index].name.len)) --index;
+            if(index < 0) continue;  // stray end tag
+            while(int(context.stack.size()) > index + 1) closeTop(parser.nodePos(), parser.nodePos());
+            closeTop(parser.nodePos(), parser.curPos());
+        }
+    }
+    while(!context.stack.empty()) closeTop(html.size(), html.size());
+    if(limit > 0 && matches.size() > limit) matches.resize(limit);
+    return matches;
+}
+
+QByteArray HTMLSelector::innerText(const QByteArray &html, int begin, int end)
+{
+    QByteArray text;
+    end = qMin(end, html.size());
+    HTMLParserSax parser(html);
+    parser.seekTo(begin);
+    while(!parser.atEnd() && parser.curPos() < end)
+    {
+        const int from = parser.curPos();
+        parser.readNext();
+        if(parser.nodePos() < end && html[parser.nodePos()] == '<')
+        {
+            if(parser.nodePos() > from) text.append(' ');
+            if(parser.isStartNode() && inList(parser.currentNode(), rawTextElements) && !equals(parser.currentNode(), "title") && !equals(parser.currentNode(), "textarea"))
+            {
+                parser.skipRawText(parser.currentNode());
+            }
+        }
+        else
+        {
+            text.append(html.constData() + from, qMin(parser.curPos(), end) - from);
+        }
+    }
+    return decodeEntities(text).simplified();
+}
+
+void HTMLSelector::parse(const QByteArray &selector)
+{
+    const char *p = selector.constData(), *end = p + selector.size();
+    auto skipSpace = [&](){
+        bool skipped = false;
+        while(p < end && isSpaceChar(*p)) { ++p; skipped = true; }
+        return skipped;
+    };
+    auto readIdent = [&](){
+        const char *identBegin = p;
+        while(p < end && isIdentChar(*p)) ++p;
+        return QByteArray(identBegin, p - identBegin);
+    };
+    auto error = [&](const QString &info){
+        errInfo = QString("%1 at %2").arg(info).arg(p - selector.constData());
+        group.clear();
+    };
+    skipSpace();
+    Complex complex;
+    char combinator = ' ';
+    while(true)
+    {
+        Compound compound;
+        compound.combinator = combinator;
+        bool empty = true;
+        if(p < end && *p == '*')
+        {
+            ++p;
+            empty = false;
+        }
+        else if(p < end && isIdentChar(*p))
+        {
+            compound.tag = readIdent().toLower();
+            empty = false;
+        }
+        while(p < end)
+        {
+            if(*p == '#' || *p == '.')
+            {
+                const char type = *p++;
+                const QByteArray ident(readIdent());
+                if(ident.isEmpty()) return error(QString("expect name after '%1'").arg(type));
+                (type == '#'? compound.ids : compound.classes).append(ident);
+            }
+            else if(*p == '[')
+            {
+                ++p;
+                skipSpace();
+                AttrCond cond;
+                cond.name = readIdent().toLower();
+                if(cond.name.isEmpty()) return error("expect attribute name");
+                skipSpace();
+                if(p < end && *p != ']')
+                {
+                    if(*p == '=') cond.op = '=';
+                    else if(strchr("~^$*|", *p) && p + 1 < end && p[1] == '=') cond.op = *p++;
+                    else return error(QString("unexpected '%1'").arg(*p));
+                    ++p;
+                    skipSpace();
+                    if(p < end && (*p == '"' || *p == '\''))
+                    {
+                        const char q = *p++;
+                        const char *valBegin = p;
+                        while(p < end && *p != q) ++p;
+                        if(p == end) return error("unterminated string");
+                        cond.value = QByteArray(valBegin, p - valBegin);
+                        ++p;
+                    }
+                    else
+                    {
+                        cond.value = readIdent();
+                    }
+                    skipSpace();
+                }
+                if(p == end || *p != ']') return error("expect ']'");
+                ++p;
+                compound.attrs.append(cond);
+            }
+            else if(*p == ':')
+            {
+                return error("pseudo-class is not supported");
+            }
+            else
+            {
+                break;
+            }
+            empty = false;
+        }
+        if(empty) return error(p < end? QString("unexpected '%1'").arg(*p) : QString("unexpected end"));
+        complex.append(compound);
+
+        const bool hasSpace = skipSpace();
+        if(p == end || *p == ',')
+        {
+            group.append(complex);
+            complex.clear();
+            combinator = ' ';
+            if(p == end) break;
+            ++p;
+            skipSpace();
+        }
+        else if(*p == '>')
+        {
+            combinator = '>';
+            ++p;
+            skipSpace();
+        }
+        else if(*p == '+' || *p == '~')
+        {
+            return error(QString("combinator '%1' is not supported").arg(*p));
+        }
+        else if(hasSpace)
+        {
+            combinator = ' ';
+        }
+        else
+        {
+            return error(QString("unexpected '%1'").arg(*p));
+        }
+    }
+}
+
+bool HTMLSelector::matchCompound(const Context &context, int stackIndex, const Compound &compound) const
+{
+    const OpenElement &element = context.stack[stackIndex];
+    if(!compound.tag.isEmpty() && !HTMLParserSax::equalsIgnoreCase(compound.tag, context.parser.content().constData() + element.name.pos, element.name.len))
+    {
+        return false;
+    }
+    QByteArray value;
+    for(const QByteArray &id : compound.ids)
+    {
+        if(!attribute(context, element, "id", value) || value != id) return false;
+    }
+    if(!compound.classes.isEmpty())
+    {
+        if(!attribute(context, element, "class", value)) return false;
+        for(const QByteArray &cls : compound.classes)
+        {
+            if(!containsToken(value, cls)) return false;
+        }
+    }
+    for(const AttrCond &cond : compound.attrs)
+    {
+        if(!attribute(context, element, cond.name, value)) return false;
+        bool matched = true;
+        switch (cond.op)
+        {
+        case '=':
+            matched = value == cond.value;
+            break;
+        case '~':
+            matched = containsToken(value, cond.value);
+            break;
+        case '^':
+            matched = !cond.value.isEmpty() && value.startsWith(cond.value);
+            break;
+        case '$':
+            matched = !cond.value.isEmpty() && value.endsWith(cond.value);
+            break;
+        case '*':
+            matched = !cond.value.isEmpty() && value.contains(cond.value);
+            break;
+        case '|':
+            matched = value == cond.value || (value.startsWith(cond.value) && value.size() > cond.value.size() && value[cond.value.size()] == '-');
+            break;
+        default:
+            break;
+        }
+        if(!matched) return false;
+    }
+    return true;
+}
+
+bool HTMLSelector::matchComplex(const Context &context, int stackIndex, const Complex &complex, int partIndex) const
+{
+    if(!matchCompound(context, stackIndex, complex[partIndex])) return false;
+    if(partIndex == 0) return true;
+    if(complex[partIndex].combinator == '>')
+    {
+        return stackIndex > 0 && matchComplex(context, stackIndex - 1, complex, partIndex - 1);
+    }
+    for(int i = stackIndex - 1; i >= 0; --i)
+    {
+        if(matchComplex(context, i, complex, partIndex - 1)) return true;
+    }
+    return false;
+}
+
+bool HTMLSelector::attribute(const Context &context, const OpenElement &element, const QByteArray &name, QByteArray &value) const
+{
+    for(int i = element.attrBegin; i < element.attrBegin + element.attrCount; ++i)
+    {
+        const HTMLParserSax::Attribute &attr = context.attrPool[i];
+        if(HTMLParserSax::equalsIgnoreCase(name, context.parser.content().constData() + attr.name.pos, attr.name.len))
+        {
+            value = context.parser.view(attr.value);
+            return true;
+        }
+    }
+    return false;
+}
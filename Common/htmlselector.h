@@ -0,0 +1,64 @@
+#ifndef HTMLSELECTOR_H
+#define HTMLSELECTOR_H
+#include "htmlparsersax.h"
+
+/*
+ * CSS selector matched in a single HTMLParserSax pass.
+ * Supported: type, *, #id, .class, [attr], [attr=|~=|^=|$=|*=||=value], descendant and child(>) combinators, selector groups(,)
+ */
+class HTMLSelector
+{
+public:
+    struct Match
+    {
+        HTMLParserSax::Span name;
+        QVector<HTMLParserSax::Attribute> attributes;
+        int outerBegin = 0, innerBegin = 0, innerEnd = 0, outerEnd = 0;
+    };
+
+    explicit HTMLSelector(const QByteArray &selector);
+    inline bool isValid() const {return errInfo.isEmpty();}
+    inline const QString &errorInfo() const {return errInfo;}
+
+    // positions in Match refer to html, limit < 0: no limit
+    QVector<Match> select(const QByteArray &html, int limit = -1) const;
+    static QByteArray innerText(const QByteArray &html, int begin, int end);
+
+private:
+    struct AttrCond
+    {
+        QByteArray name, value;
+        char op = 0;  // 0: exists, '=', '~', '^', '$', '*', '|'
+    };
+    struct Compound
+    {
+        QByteArray tag;  // empty: any
+        QVector<QByteArray> ids, classes;
+        QVector<AttrCond> attrs;
+        char combinator = ' ';  // relation with the previous compound: ' ' descendant, '>' child
+    };
+    using Complex = QVector<Compound>;
+
+    struct OpenElement
+    {
+        HTMLParserSax::Span name;
+        int attrBegin, attrCount;
+        int matchIndex;
+    };
+    struct Context
+    {
+        const HTMLParserSax &parser;
+        std::vector<OpenElement> stack;
+        std::vector<HTMLParserSax::Attribute> attrPool;
+    };
+
+    QVector<Complex> group;
+    QString errInfo;
+
+    void parse(const QByteArray &selector);
+    bool matchCompound(const Context &context, int stackIndex, const Compound &compound) const;
+    bool matchComplex(const Context &context, int stackIndex, const Complex &complex, int partIndex) const;
+    bool attribute(const Context &context, const OpenElement &element, const QByteArray &name, QByteArray &value) const;
+};
+
+#endif // HTMLSELECTOR_H
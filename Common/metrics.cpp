@@ -0,0 +1,260 @@
+#include "metrics.h"
+#include <QMutexLocker>
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+    // upper bounds of the histogram buckets, seconds
+    const double bucketBounds[] = {0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 10};
+    const char *bucketNames[] = {"0.001", "0.0025", "0.005", "0.01", "0.025", "0.05", "0.1", "0.25", "0.5", "1", "2.5", "10", "+Inf"};
+}
+
+Metrics::Shard::Shard()
+{
+    for(std::atomic<qint64> &slot : slots) slot.store(0, std::memory_order_relaxed);
+}
+
+Metrics::ShardHolder::~ShardHolder()
+{
+    if(shard) Metrics::instance()->releaseShard(shard);
+}
+
+Metrics::Metrics() : slotCount(0)
+{
+    describe("kikoplay_http_requests_total", CounterMetric, "Requests served by the LAN server", {"route", "status"});
+    describe("kikoplay_http_request_duration_seconds", HistogramMetric, "Time to serve a request, until the request handler returns", {"route"});
+    describe("kikoplay_http_sent_bytes_total", CounterMetric, "Bytes sent to a client", {"client"});
+    describe("kikoplay_http_connections", GaugeMetric, "Open connections");
+    describe("kikoplay_http_rejected_total", CounterMetric, "Connections and requests rejected because a limit was reached", {"reason"});
+    describe("kikoplay_http_io_threads", GaugeMetric, "I/O threads of the LAN server");
+    describe("kikoplay_http_busy_workers", GaugeMetric, "Worker threads serving a request");
+    describe("kikoplay_http_pending_requests", GaugeMetric, "Requests queued or being served");
+    describe("kikoplay_dlna_actions_total", CounterMetric, "UPnP actions of the DLNA media server", {"action", "status"});
+    describe("kikoplay_response_cache_requests_total", CounterMetric, "Lookups in the response cache of the LAN server", {"cache", "result"});
+    describe("kikoplay_script_call_duration_seconds", HistogramMetric, "Time of calls into script functions", {"script", "function"});
+    describe("kikoplay_thread_task_queue_depth", GaugeMetric, "Tasks posted to a thread and not started yet", {"thread"});
+    describe("kikoplay_counter_samples_total", CounterMetric, "Samples of the debug counters", {"key"});
+    describe("kikoplay_counter_value_sum", GaugeMetric, "Sum of the debug counter values", {"key"});
+}
+
+Metrics *Metrics::instance()
+{
+    // never destroyed, shards of threads are returned until the process exits
+    static Metrics *metrics = new Metrics;
+    return metrics;
+}
+
+void Metrics::add(const QString &name, qint64 value, const QStringList &labelValues)
+{
+    const int index = slot(name, GaugeMetric, labelValues);
+    if(index < 0) return;
+    std::atomic<qint64> &cur = localShard()->slots[index];
+    // only the owning thread writes the shard
+    cur.store(cur.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+void Metrics::observe(const QString &name, double seconds, const QStringList &labelValues)
+{
+    const int index = slot(name, HistogramMetric, labelValues);
+    if(index < 0) return;
+    const int bucket = std::lower_bound(std::begin(bucketBounds), std::end(bucketBounds), seconds) - std::begin(bucketBounds);
+    Shard *shard = localShard();
+    std::atomic<qint64> &count = shard->slots[index + bucket], &sumUs = shard->slots[index + bucketCount];
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    sumUs.store(sumUs.load(std::memory_order_relaxed) + qint64(seconds * 1000000), std::memory_order_relaxed);
+}
+
+qint64 Metrics::value(const QString &name, const QStringList &labelValues) const
+{
+    QMutexLocker locker(&lock);
+    const int index = findSlot(name, labelValues);
+    if(index < 0) return 0;
+    if(families.constFind(name)->type != HistogramMetric) return total(index);
+    qint64 count = 0;
+    for(int i = 0; i < bucketCount; ++i) count += total(index + i);
+    return count;
+}
+
+qint64 Metrics::sum(const QString &name, const QStringList &labelValues) const
+{
+    QMutexLocker locker(&lock);
+    const int index = findSlot(name, labelValues);
+    if(index < 0) return 0;
+    return families.constFind(name)->type == HistogramMetric? total(index + bucketCount) : total(index);
+}
+
+QVector<QStringList> Metrics::series(const QString &name) const
+{
+    QMutexLocker locker(&lock);
+    return families.value(name).labelValues;
+}
+
+QByteArray Metrics::exposition() const
+{
+    QMutexLocker locker(&lock);
+    QStringList names = families.keys();
+    std::sort(names.begin(), names.end());
+    QByteArray text;
+    text.reserve(64 * 1024);
+    for(const QString &name : names)
+    {
+        const Family &family = *families.constFind(name);
+        if(family.series.isEmpty()) continue;
+        static const char *typeNames[] = {"counter", "gauge", "histogram"};
+        const QByteArray metricName = name.toUtf8();
+        text += "# HELP " + metricName + ' ' + family.help.toUtf8() + '\n';
+        text += "# TYPE " + metricName + ' ' + typeNames[family.type] + '\n';
+        for(const QStringList &values : family.labelValues)
+        {
+            const int index = family.series.value(values.join(QChar(0x1f)));
+            if(family.type != HistogramMetric)
+            {
+                text += metricName + labelText(family.labelNames, values) + ' ' + QByteArray::number(total(index)) + '\n';
+                continue;
+            }
+            // buckets are stored separately, exported cumulative
+            qint64 count = 0;
+            for(int i = 0; i < bucketCount; ++i)
+            {
+                count += total(index + i);
+                text += metricName + "_bucket" + labelText(family.labelNames, values, bucketNames[i]) + ' ' + QByteArray::number(count) + '\n';
+            }
+            const QByteArray labels = labelText(family.labelNames, values);
+            text += metricName + "_sum" + labels + ' ' + QByteArray::number(total(index + bucketCount) / 1000000.0, 'f', 6) + '\n';
+            text += metricName + "_count" + labels + ' ' + QByteArray::number(count) + '\n';
+        }
+    }
+    return text;
+}
+
+void Metrics::describe(const QString &name, Type type, const QString &help, const QStringList &labelNames)
+{
+    QMutexLocker locker(&lock);
+    Family &family = families[name];
+    family.type = type;
+    family.help = help;
+    family.labelNames = labelNames;
+    if(labelNames.isEmpty())
+    {
+        // a single series, exported even if nothing has been recorded yet
+        family.series.insert(QString(), slotCount);
+        family.labelValues.append(QStringList());
+        slotCount += type == HistogramMetric? bucketCount + 1 : 1;
+    }
+}
+
+int Metrics::slot(const QString &name, Type type, const QStringList &labelValues)
+{
+    // series never move, so each thread remembers the slots it has used
+    thread_local QHash<QString, int> slotCache;
+    const QString key = seriesKey(name, labelValues);
+    auto cached = slotCache.constFind(key);
+    if(cached != slotCache.cend()) return cached.value();
+
+    QMutexLocker locker(&lock);
+    int index = -1;
+    bool ownSeries = false;
+    auto family = families.find(name);
+    const bool matched = family != families.end() && family->labelNames.size() == labelValues.size() &&
+            (type == HistogramMetric) == (family->type == HistogramMetric);
+    if(matched)
+    {
+        QStringList values(labelValues);
+        QString id = values.join(QChar(0x1f));
+        index = family->series.value(id, -1);
+        ownSeries = index >= 0;
+        if(index < 0 && family->series.size() >= maxSeriesPerFamily)
+        {
+            for(QString &value : values) value = QStringLiteral("other");
+            id = values.join(QChar(0x1f));
+            index = family->series.value(id, -1);
+        }
+        const int width = family->type == HistogramMetric? bucketCount + 1 : 1;
+        if(index < 0 && slotCount + width <= maxSlots)
+        {
+            index = slotCount;
+            slotCount += width;
+            family->series.insert(id, index);
+            family->labelValues.append(values);
+            ownSeries = values == labelValues;
+        }
+    }
+    // label sets folded into "other" or dropped have no bound, only series (at most maxSlots) are cached
+    if(ownSeries) slotCache.insert(key, index);
+    return index;
+}
+
+int Metrics::findSlot(const QString &name, const QStringList &labelValues) const
+{
+    auto family = families.constFind(name);
+    if(family == families.cend()) return -1;
+    return family->series.value(labelValues.join(QChar(0x1f)), -1);
+}
+
+Metrics::Shard *Metrics::localShard()
+{
+    thread_local ShardHolder holder;
+    if(!holder.shard)
+    {
+        QMutexLocker locker(&lock);
+        if(!freeShards.isEmpty())
+        {
+            holder.shard = freeShards.takeLast();
+        }
+        else
+        {
+            holder.shard = new Shard;
+            shards.append(holder.shard);
+        }
+    }
+    return holder.shard;
+}
+
+qint64 Metrics::total(int slot) const
+{
+    qint64 val = 0;
+    for(const Shard *shard : shards)
+    {
+        val += shard->slots[slot].load(std::memory_order_relaxed);
+    }
+    return val;
+}
+
+void Metrics::releaseShard(Shard *shard)
+{
+    // the values stay in the shard and keep counting for the next thread
+    QMutexLocker locker(&lock);
+    freeShards.append(shard);
+}
+
+QString Metrics::seriesKey(const QString &name, const QStringList &labelValues)
+{
+    QString key(name);
+    for(const QString &value : labelValues)
+    {
+        key.append(QChar(0x1f));
+        key.append(value);
+    }
+    return key;
+}
+
+QByteArray Metrics::labelText(const QStringList &names, const QStringList &values, const QString &le)
+{
+    if(names.isEmpty() && le.isEmpty()) return QByteArray();
+    QByteArray text("{");
+    for(int i = 0; i < names.size(); ++i)
+    {
+        QByteArray value = values[i].toUtf8();
+        value.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+        if(i > 0) text += ',';
+        text += names[i].toUtf8() + "=\"" + value + '"';
+    }
+    if(!le.isEmpty())
+    {
+        if(!names.isEmpty()) text += ',';
+        text += "le=\"" + le.toUtf8() + '"';
+    }
+    text += '}';
+    return text;
+}
@@ -0,0 +1,80 @@
+#ifndef METRICS_H
+#define METRICS_H
+#include <QHash>
+#include <QMutex>
+#include <QStringList>
+#include <QVector>
+#include <atomic>
+
+/*
+ * Process-wide counters, gauges and latency histograms, exported in the Prometheus text format (/metrics of the LAN server).
+ * Every thread writes to its own shard of slots without locks or shared cache lines, a scrape sums the shards.
+ * Series are keyed by the label values of a family; a family keeps at most maxSeriesPerFamily series,
+ * further label sets are counted as "other".
+ * Families are declared in the constructor, values of unknown families are dropped.
+ */
+class Metrics
+{
+public:
+    enum Type
+    {
+        CounterMetric, GaugeMetric, HistogramMetric
+    };
+
+    static Metrics *instance();
+
+    // counter: value >= 0, gauge: delta
+    void add(const QString &name, qint64 value = 1, const QStringList &labelValues = QStringList());
+    void observe(const QString &name, double seconds, const QStringList &labelValues = QStringList());
+
+    // counter/gauge value, histogram count
+    qint64 value(const QString &name, const QStringList &labelValues = QStringList()) const;
+    qint64 sum(const QString &name, const QStringList &labelValues = QStringList()) const;
+    QVector<QStringList> series(const QString &name) const;
+
+    QByteArray exposition() const;
+
+private:
+    Metrics();
+    Q_DISABLE_COPY(Metrics)
+
+    static const int maxSlots = 4096;
+    static const int maxSeriesPerFamily = 128;
+    static const int bucketCount = 13;  // 12 bounds and +Inf, followed by the sum in microseconds
+
+    struct Shard
+    {
+        std::atomic<qint64> slots[maxSlots];
+        Shard();
+    };
+    struct Family
+    {
+        Type type;
+        QString help;
+        QStringList labelNames;
+        QHash<QString, int> series;  // joined label values -> first slot
+        QVector<QStringList> labelValues;
+    };
+    struct ShardHolder
+    {
+        Shard *shard = nullptr;
+        ~ShardHolder();
+    };
+
+    mutable QMutex lock;
+    QHash<QString, Family> families;
+    QVector<Shard *> shards, freeShards;
+    int slotCount;
+
+    void describe(const QString &name, Type type, const QString &help, const QStringList &labelNames = QStringList());
+    int slot(const QString &name, Type type, const QStringList &labelValues);
+    int findSlot(const QString &name, const QStringList &labelValues) const;
+    Shard *localShard();
+    qint64 total(int slot) const;
+    void releaseShard(Shard *shard);
+
+    static QString seriesKey(const QString &name, const QStringList &labelValues);
+    static QByteArray labelText(const QStringList &names, const QStringList &values, const QString &le = QString());
+};
+
+#endif // METRICS_H
@@ -245,13 +245,14 @@ int Network::gzipCompress(const QByteArray &input, QByteArray &output)
     ret = deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
                             MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY);
     if (ret != Z_OK) return ret;
-	static QVector<unsigned char> inBuf(chunkSize), outBuf(chunkSize);
+    // called by the workers of the LAN server in parallel
+    thread_local QVector<unsigned char> inBuf(chunkSize), outBuf(chunkSize);
     QDataStream inStream(input);
     int flush;
     while(!inStream.atEnd())
     {
         stream.avail_in=inStream.readRawData((char *)inBuf.data(),chunkSize);
-        flush = stream.avail_in<chunkSize ? Z_FINISH : Z_NO_FLUSH;
+        flush = inStream.atEnd() ? Z_FINISH : Z_NO_FLUSH;
         stream.next_in = inBuf.data();
         do
         {
@@ -280,7 +281,7 @@ int Network::gzipDecompress(const QByteArray &input, QByteArray &output)
     stream.next_in = Z_NULL;
     ret = inflateInit2(&stream, MAX_WBITS + 16);
     if (ret != Z_OK) return ret;
-	static QVector<unsigned char> inBuf(chunkSize), outBuf(chunkSize);
+    thread_local QVector<unsigned char> inBuf(chunkSize), outBuf(chunkSize);
     static char dummy_head[2] = {
             0x8 + 0x7 * 0x10,
             (((0x8 + 0x7 * 0x10) * 0x100 + 30) / 31 * 31) & 0xFF,
@@ -333,7 +334,7 @@ int Network::decompress(const QByteArray &input, QByteArray &output)
     stream.next_in = Z_NULL;
     ret = inflateInit(&stream);
     if (ret != Z_OK) return ret;
-	static QVector<unsigned char> inBuf(chunkSize), outBuf(chunkSize);
+    thread_local QVector<unsigned char> inBuf(chunkSize), outBuf(chunkSize);
     QDataStream inStream(input);
     while(!inStream.atEnd())
     {
@@ -1,6 +1,7 @@
 #ifndef THREADTASK_H
 #define THREADTASK_H
 #include <QtCore>
+#include "metrics.h"
 class ThreadTask
 {
 public:
@@ -18,16 +19,20 @@ public:
 		QObject obj;
 		obj.moveToThread(taskThread);
         QVariant result;
+        const QString threadName = taskThread->objectName();
+        Metrics::instance()->add("kikoplay_thread_task_queue_depth", 1, {threadName});
         if (blocking)
         {
-            QMetaObject::invokeMethod(&obj,[task, &result](){
+            QMetaObject::invokeMethod(&obj,[task, &result, threadName](){
+                Metrics::instance()->add("kikoplay_thread_task_queue_depth", -1, {threadName});
                 result = task();
             }, Qt::BlockingQueuedConnection);
         }
         else
         {
             QEventLoop eventLoop;
-            QMetaObject::invokeMethod(&obj,[task, &result, &eventLoop](){
+            QMetaObject::invokeMethod(&obj,[task, &result, &eventLoop, threadName](){
+                Metrics::instance()->add("kikoplay_thread_task_queue_depth", -1, {threadName});
                 result = task();
                 QMetaObject::invokeMethod(&eventLoop, "quit", Qt::QueuedConnection);
             }, Qt::QueuedConnection);
@@ -45,7 +50,10 @@ public:
         }
         QObject *obj=new QObject();
         obj->moveToThread(taskThread);
-        QMetaObject::invokeMethod(obj,[task,obj](){
+        const QString threadName = taskThread->objectName();
+        Metrics::instance()->add("kikoplay_thread_task_queue_depth", 1, {threadName});
+        QMetaObject::invokeMethod(obj,[task,obj,threadName](){
+           Metrics::instance()->add("kikoplay_thread_task_queue_depth", -1, {threadName});
            task();
            obj->deleteLater();
         });
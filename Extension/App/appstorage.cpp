@@ -1,74 +1,304 @@
 #include "appstorage.h"
 #include "Common/logger.h"
-#include <QFile>
+#include <QSaveFile>
 #include <QDataStream>
 #include <QCoreApplication>
 #include <QEvent>
+#include <QTimerEvent>
+#include <QtEndian>
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+    enum RecordOp : quint8
+    {
+        OP_SET = 0,
+        OP_REMOVE = 1
+    };
+}
 
 namespace Extension
 {
 
-AppStorage::AppStorage(const QString &path, QObject *parent) : QObject(parent), counter(0), storagePath(path)
+AppStorage::AppStorage(const QString &path, QObject *parent) : QObject(parent), storagePath(path), mapped(nullptr),
+    streamVersion(QDataStream::Qt_DefaultCompiledVersion), fileSize(headerSize), liveBytes(headerSize),
+    flushScheduled(false), unsynced(false), compactPending(false)
 {
-    QFile storageFile(storagePath);
-    if (storageFile.exists())
-    {
-        bool ret = storageFile.open(QIODevice::ReadOnly);
-        if(!ret)
-        {
-            Logger::logger()->log(Logger::Extension, QString("[storage]open failed: %1").arg(storagePath));
-        }
-        else
-        {
-            QDataStream fs(&storageFile);
-            fs >> storageHash;
-        }
-    }
+    load();
 }
 
 AppStorage::~AppStorage()
 {
     flush();
+    sync();
 }
 
 void AppStorage::set(const QString &key, const QVariant &val)
 {
+    QByteArray record;
     if (!val.isValid())
     {
-        storageHash.remove(key);
+        auto iter = storageHash.find(key);
+        if (iter == storageHash.end()) return;
+        liveBytes -= iter->recordSize;
+        storageHash.erase(iter);
+        record = encodeRecord(key, nullptr);
     }
     else
     {
-        storageHash[key] = val;
+        Entry &entry = storageHash[key];
+        if (entry.recordSize > 0 && entry.offset < 0 && entry.value == val) return;
+        record = encodeRecord(key, &val);
+        liveBytes += record.size() - entry.recordSize;
+        entry.value = val;
+        entry.offset = -1;
+        entry.recordSize = record.size();
     }
-    if (++counter > 0)
+    pendingLog.append(record);
+    fileSize += record.size();
+    if (!flushScheduled)
     {
+        flushScheduled = true;
         QCoreApplication::postEvent(this, new QEvent(QEvent::UpdateRequest));
     }
-
 }
 
 QVariant AppStorage::get(const QString &key)
 {
-    return storageHash.value(key, QVariant());
+    auto iter = storageHash.find(key);
+    if (iter == storageHash.end()) return QVariant();
+    materialize(*iter);
+    return iter->value;
 }
 
-void AppStorage::flush()
+void AppStorage::load()
+{
+    mapFile.setFileName(storagePath);
+    if (!mapFile.exists()) return;
+    if (!mapFile.open(QIODevice::ReadOnly))
+    {
+        Logger::logger()->log(Logger::Extension, QString("[storage]open failed: %1").arg(storagePath));
+        return;
+    }
+    const qint64 size = mapFile.size();
+    const QByteArray head(mapFile.peek(sizeof(quint32)));
+    bool needCompact = false;
+    if (head.size() == sizeof(quint32) && qFromBigEndian<quint32>(head.constData()) == logMagic)
+    {
+        if (size >= mapThreshold) mapped = mapFile.map(0, size);
+        if (mapped)
+        {
+            needCompact = !loadLog(reinterpret_cast<const char *>(mapped), size, true);
+        }
+        else
+        {
+            const QByteArray content(mapFile.readAll());
+            mapFile.close();
+            needCompact = !loadLog(content.constData(), content.size(), false);
+        }
+        if (needCompact)
+        {
+            Logger::logger()->log(Logger::Extension, QString("[storage]drop broken tail: %1").arg(storagePath));
+        }
+    }
+    else
+    {
+        // storage written by older versions: a single serialized QHash
+        loadLegacy();
+        mapFile.close();
+        needCompact = true;
+    }
+    if (needCompact)
+    {
+        compactPending = true;
+        compact();
+    }
+}
+
+bool AppStorage::loadLog(const char *data, qint64 size, bool lazy)
 {
-    if (counter > 0)
+    // a file cut within the header has nothing to keep
+    if (size < headerSize) return false;
+    quint32 magic = 0, version = 0, dsVersion = 0;
+    QDataStream hs(QByteArray::fromRawData(data, headerSize));
+    hs >> magic >> version >> dsVersion;
+    if (hs.status() != QDataStream::Ok) return false;
+    streamVersion = dsVersion;
+    qint64 pos = headerSize;
+    while (pos + recordHeaderSize <= size)
     {
-        QFile storageFile(storagePath);
-        bool ret = storageFile.open(QIODevice::WriteOnly);
-        if (!ret)
+        const quint32 payloadSize = qFromBigEndian<quint32>(data + pos);
+        const quint16 checksum = qFromBigEndian<quint16>(data + pos + 4);
+        if (pos + recordHeaderSize + payloadSize > size) break;
+        const char *payload = data + pos + recordHeaderSize;
+        if (qChecksum(payload, payloadSize) != checksum) break;
+
+        QDataStream ds(QByteArray::fromRawData(payload, payloadSize));
+        ds.setVersion(streamVersion);
+        quint8 op = OP_SET;
+        QString key;
+        ds >> op >> key;
+        if (ds.status() != QDataStream::Ok) break;
+        const int recordSize = recordHeaderSize + payloadSize;
+        if (op == OP_REMOVE)
+        {
+            auto iter = storageHash.find(key);
+            if (iter != storageHash.end())
+            {
+                liveBytes -= iter->recordSize;
+                storageHash.erase(iter);
+            }
+        }
+        else
         {
-            Logger::logger()->log(Logger::Extension, QString("[storage]flush failed: %1").arg(storagePath));
-            return;
+            Entry &entry = storageHash[key];
+            liveBytes += recordSize - entry.recordSize;
+            entry.recordSize = recordSize;
+            if (lazy)
+            {
+                const qint64 valuePos = ds.device()->pos();
+                entry.value = QVariant();
+                entry.offset = pos + recordHeaderSize + valuePos;
+                entry.length = payloadSize - valuePos;
+            }
+            else
+            {
+                ds >> entry.value;
+                entry.offset = -1;
+            }
         }
-        QDataStream fs(&storageFile);
-        fs << storageHash;
-        storageFile.flush();
-        counter = 0;
+        pos += recordSize;
+    }
+    fileSize = pos;
+    return pos == size;
+}
+
+bool AppStorage::loadLegacy()
+{
+    QHash<QString, QVariant> legacyHash;
+    QDataStream fs(&mapFile);
+    fs >> legacyHash;
+    for (auto iter = legacyHash.cbegin(); iter != legacyHash.cend(); ++iter)
+    {
+        storageHash[iter.key()].value = iter.value();
+    }
+    return fs.status() == QDataStream::Ok;
+}
+
+QByteArray AppStorage::encodeRecord(const QString &key, const QVariant *val) const
+{
+    QByteArray record(recordHeaderSize, 0);
+    QDataStream ds(&record, QIODevice::WriteOnly);
+    ds.setVersion(streamVersion);
+    ds.device()->seek(recordHeaderSize);
+    ds << quint8(val ? OP_SET : OP_REMOVE) << key;
+    if (val) ds << *val;
+    const int payloadSize = record.size() - recordHeaderSize;
+    qToBigEndian<quint32>(payloadSize, record.data());
+    qToBigEndian<quint16>(qChecksum(record.constData() + recordHeaderSize, payloadSize), record.data() + 4);
+    return record;
+}
+
+void AppStorage::materialize(Entry &entry)
+{
+    if (entry.offset < 0 || !mapped) return;
+    QDataStream ds(QByteArray::fromRawData(reinterpret_cast<const char *>(mapped) + entry.offset, entry.length));
+    ds.setVersion(streamVersion);
+    ds >> entry.value;
+    entry.offset = -1;
+}
+
+void AppStorage::flush()
+{
+    flushScheduled = false;
+    if (pendingLog.isEmpty()) return;
+    if (compactPending || (fileSize >= compactThreshold && fileSize > liveBytes * 2))
+    {
+        // live entries already hold the pending changes, they are kept for the next try if compacting fails
+        if (compact()) pendingLog.clear();
+        return;
+    }
+    if (!logFile.isOpen() && !openLog())
+    {
+        Logger::logger()->log(Logger::Extension, QString("[storage]flush failed: %1").arg(storagePath));
+        return;
+    }
+    if (logFile.write(pendingLog) != pendingLog.size())
+    {
+        Logger::logger()->log(Logger::Extension, QString("[storage]flush failed: %1, %2").arg(storagePath, logFile.errorString()));
+    }
+    logFile.flush();
+    pendingLog.clear();
+    unsynced = true;
+    if (!syncTimer.isActive()) syncTimer.start(syncInterval, this);
+}
+
+void AppStorage::sync()
+{
+    syncTimer.stop();
+    if (!unsynced || !logFile.isOpen()) return;
+    logFile.flush();
+#ifdef Q_OS_WIN
+    _commit(logFile.handle());
+#else
+    fsync(logFile.handle());
+#endif
+    unsynced = false;
+}
+
+bool AppStorage::compact()
+{
+    for (Entry &entry : storageHash)
+    {
+        materialize(entry);
+    }
+    // the log is replaced by rename, nothing may keep it open
+    mapFile.close();
+    mapped = nullptr;
+    logFile.close();
+    syncTimer.stop();
+    unsynced = false;
+
+    QSaveFile saveFile(storagePath);
+    if (!saveFile.open(QIODevice::WriteOnly))
+    {
+        Logger::logger()->log(Logger::Extension, QString("[storage]compact failed: %1").arg(storagePath));
+        return false;
+    }
+    QDataStream hs(&saveFile);
+    hs << logMagic << logVersion << quint32(streamVersion);
+    qint64 size = headerSize;
+    for (auto iter = storageHash.begin(); iter != storageHash.end(); ++iter)
+    {
+        const QByteArray record(encodeRecord(iter.key(), &iter->value));
+        saveFile.write(record);
+        iter->recordSize = record.size();
+        size += record.size();
     }
+    if (!saveFile.commit())
+    {
+        Logger::logger()->log(Logger::Extension, QString("[storage]compact failed: %1, %2").arg(storagePath, saveFile.errorString()));
+        return false;
+    }
+    fileSize = liveBytes = size;
+    compactPending = false;
+    return true;
+}
+
+bool AppStorage::openLog()
+{
+    logFile.setFileName(storagePath);
+    if (!logFile.open(QIODevice::WriteOnly | QIODevice::Append)) return false;
+    if (logFile.size() == 0)
+    {
+        QDataStream hs(&logFile);
+        hs << logMagic << logVersion << quint32(streamVersion);
+    }
+    return true;
 }
 
 bool AppStorage::event(QEvent *event)
@@ -78,6 +308,11 @@ bool AppStorage::event(QEvent *event)
         flush();
         return true;
     }
+    if (event->type() == QEvent::Timer && static_cast<QTimerEvent *>(event)->timerId() == syncTimer.timerId())
+    {
+        sync();
+        return true;
+    }
     return QObject::event(event);
 }
 
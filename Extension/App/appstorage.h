@@ -2,11 +2,20 @@
 #define APPSTORAGE_H
 #include <QHash>
 #include <QVariant>
+#include <QFile>
+#include <QBasicTimer>
 #include "Extension/Common/ext_common.h"
 
 namespace Extension
 {
-
+/*
+ * Append-only key-value log:
+ *   header: magic, format version, QDataStream version
+ *   record: payload size(quint32), checksum(quint16), payload(op, key[, value])
+ * Writes of one event-loop turn are appended together, fsync is deferred by syncInterval.
+ * The log is rewritten when it grows to twice the size of the live records.
+ * Large logs are mapped and values are decoded on first access.
+ */
 class AppStorage : public QObject
 {
     Q_OBJECT
@@ -18,11 +27,40 @@ public:
     QVariant get(const QString &key);
 
 private:
-    QHash<QString, QVariant> storageHash;
-    int counter;
+    struct Entry
+    {
+        QVariant value;
+        qint64 offset = -1;  // >= 0: value is still in the mapped log
+        int length = 0;
+        int recordSize = 0;
+    };
+    QHash<QString, Entry> storageHash;
     QString storagePath;
 
+    QFile logFile, mapFile;
+    const uchar *mapped;
+    int streamVersion;
+    QByteArray pendingLog;
+    qint64 fileSize, liveBytes;
+    bool flushScheduled, unsynced, compactPending;
+    QBasicTimer syncTimer;
+
+    static const quint32 logMagic = 0x4b534c47;
+    static const quint32 logVersion = 1;
+    static const int headerSize = 12, recordHeaderSize = 6;
+    static const int syncInterval = 1000;  // ms
+    static const qint64 mapThreshold = 256 * 1024;
+    static const qint64 compactThreshold = 256 * 1024;
+
+    void load();
+    bool loadLog(const char *data, qint64 size, bool lazy);
+    bool loadLegacy();
+    QByteArray encodeRecord(const QString &key, const QVariant *val) const;
+    void materialize(Entry &entry);
     void flush();
+    void sync();
+    bool compact();
+    bool openLog();
 
     // QObject interface
 public:
@@ -6,6 +6,7 @@
 #include <QMainWindow>
 #include <QFontDatabase>
 #include <QElapsedTimer>
+#include <QSettings>
 #include "Extension/Common/ext_common.h"
 #include "Extension/Modules/lua_apputil.h"
 #include "Extension/Modules/lua_regex.h"
@@ -83,7 +84,8 @@ bool KApp::start(LaunchScene scene)
     QElapsedTimer timer;
     timer.start();
 
-    L = luaL_newstate();
+    allocator.setLimit(GlobalObjects::appSetting->value("Extension/AppMemoryLimit", 512).toLongLong() * 1024 * 1024);
+    L = allocator.newState();
     if (!L) return false;
 
     //  setup lua env -------------
@@ -178,6 +180,8 @@ void KApp::stop()
     {
         lua_close(L);
         L = nullptr;
+        Logger::logger()->log(Logger::Extension, QString("[%1]memory peak: %2 bytes").arg(id()).arg(allocator.stat().peak));
+        allocator.release();
     }
     if (appThread)
     {
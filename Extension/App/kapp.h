@@ -1,6 +1,7 @@
 #ifndef KAPP_H
 #define KAPP_H
 #include "Extension/App/AppWidgets/appwidget.h"
+#include "Extension/Common/luaallocator.h"
 #include <QVector>
 #include <QHash>
 #include <QThread>
@@ -52,6 +53,7 @@ public:
     qint64 time() const { return appInfo.value("time").toLongLong(); }
     qint64 getLatestFileModifyTime() const;
     bool isLoaded() const { return loaded; }
+    LuaAllocator::Stat memoryStat() const { return allocator.stat(); }
     AppWidget *window() const { return mainWindow; }
 
     void addRes(const QString &key, AppRes *res);
@@ -82,6 +84,7 @@ private:
 
     bool loaded;
     QThread *appThread;
+    LuaAllocator allocator;
     lua_State *L;
     AppWidget *mainWindow;
     QVector<AppRes *> appResources;
@@ -0,0 +1,152 @@
+#include "luaallocator.h"
+#include <QtGlobal>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+namespace Extension
+{
+
+LuaAllocator::LuaAllocator(qint64 limitBytes) : arenaCur(nullptr), arenaEnd(nullptr),
+    limit(limitBytes), currentBytes(0), peakBytes(0), allocatedBytes(0)
+{
+    std::fill(freeLists, freeLists + sizeClassCount, nullptr);
+}
+
+LuaAllocator::~LuaAllocator()
+{
+    release();
+}
+
+lua_State *LuaAllocator::newState()
+{
+    lua_State *L = lua_newstate(alloc, this);
+    if (L) lua_atpanic(L, panic);
+    return L;
+}
+
+void LuaAllocator::release()
+{
+    for (char *arena : arenas)
+    {
+        free(arena);
+    }
+    arenas.clear();
+    arenaCur = arenaEnd = nullptr;
+    std::fill(freeLists, freeLists + sizeClassCount, nullptr);
+    currentBytes.store(0, std::memory_order_relaxed);
+}
+
+LuaAllocator::Stat LuaAllocator::stat() const
+{
+    Stat s;
+    s.current = currentBytes.load(std::memory_order_relaxed);
+    s.peak = peakBytes.load(std::memory_order_relaxed);
+    s.allocated = allocatedBytes.load(std::memory_order_relaxed);
+    s.limit = limit.load(std::memory_order_relaxed);
+    return s;
+}
+
+void *LuaAllocator::alloc(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+    LuaAllocator *allocator = static_cast<LuaAllocator *>(ud);
+    // when ptr is null, osize is the type of the new object instead of a size
+    const size_t oldSize = ptr ? osize : 0;
+    if (nsize == 0)
+    {
+        if (ptr) allocator->freeBlock(ptr, oldSize);
+        allocator->addUsage(oldSize, 0);
+        return nullptr;
+    }
+    if (nsize > oldSize)
+    {
+        const qint64 limit = allocator->limit.load(std::memory_order_relaxed);
+        if (limit > 0 && allocator->currentBytes.load(std::memory_order_relaxed) + qint64(nsize - oldSize) > limit)
+        {
+            return nullptr;
+        }
+    }
+    void *nptr = nullptr;
+    if (!ptr)
+    {
+        nptr = allocator->allocBlock(nsize);
+    }
+    else if (oldSize > maxPooledSize && nsize > maxPooledSize)
+    {
+        nptr = realloc(ptr, nsize);
+    }
+    else if (oldSize <= maxPooledSize && nsize <= maxPooledSize && sizeClass(oldSize) == sizeClass(nsize))
+    {
+        nptr = ptr;
+    }
+    else
+    {
+        nptr = allocator->allocBlock(nsize);
+        if (nptr)
+        {
+            memcpy(nptr, ptr, qMin(oldSize, nsize));
+            allocator->freeBlock(ptr, oldSize);
+        }
+    }
+    if (nptr) allocator->addUsage(oldSize, nsize);
+    return nptr;
+}
+
+void *LuaAllocator::allocBlock(size_t size)
+{
+    if (size > maxPooledSize) return malloc(size);
+    const int cls = sizeClass(size);
+    if (freeLists[cls])
+    {
+        void *block = freeLists[cls];
+        freeLists[cls] = *static_cast<void **>(block);
+        return block;
+    }
+    const size_t blockSize = (cls + 1) * sizeClassStep;
+    if (!arenaCur || arenaCur + blockSize > arenaEnd)
+    {
+        char *arena = static_cast<char *>(malloc(arenaSize));
+        if (!arena) return nullptr;
+        arenas.append(arena);
+        arenaCur = arena;
+        arenaEnd = arena + arenaSize;
+    }
+    void *block = arenaCur;
+    arenaCur += blockSize;
+    return block;
+}
+
+void LuaAllocator::freeBlock(void *ptr, size_t size)
+{
+    if (size > maxPooledSize)
+    {
+        free(ptr);
+        return;
+    }
+    const int cls = sizeClass(size);
+    *static_cast<void **>(ptr) = freeLists[cls];
+    freeLists[cls] = ptr;
+}
+
+void LuaAllocator::addUsage(size_t oldSize, size_t newSize)
+{
+    // only the thread running the state writes, relaxed load/store is enough for readers
+    const qint64 current = currentBytes.load(std::memory_order_relaxed) + qint64(newSize) - qint64(oldSize);
+    currentBytes.store(current, std::memory_order_relaxed);
+    if (newSize > oldSize)
+    {
+        allocatedBytes.store(allocatedBytes.load(std::memory_order_relaxed) + qint64(newSize - oldSize), std::memory_order_relaxed);
+    }
+    if (current > peakBytes.load(std::memory_order_relaxed))
+    {
+        peakBytes.store(current, std::memory_order_relaxed);
+    }
+}
+
+int LuaAllocator::panic(lua_State *L)
+{
+    qCritical("PANIC: unprotected error in call to Lua API (%s)", lua_tostring(L, -1));
+    return 0;
+}
+
+}
@@ -0,0 +1,62 @@
+#ifndef LUAALLOCATOR_H
+#define LUAALLOCATOR_H
+#include <QVector>
+#include <QtGlobal>
+#include <atomic>
+#include "Extension/Lua/lua.hpp"
+
+namespace Extension
+{
+/*
+ * lua_Alloc bound to one lua_State.
+ * Small blocks come from per-size-class free lists carved out of 64KB arenas,
+ * larger blocks go to malloc. Growth beyond the limit fails, and Lua turns the
+ * failure into a "not enough memory" error in the running script.
+ */
+class LuaAllocator
+{
+public:
+    struct Stat
+    {
+        qint64 current = 0;
+        qint64 peak = 0;
+        qint64 allocated = 0;  // cumulative
+        qint64 limit = 0;
+    };
+
+    explicit LuaAllocator(qint64 limitBytes = 0);
+    LuaAllocator(const LuaAllocator &) = delete;
+    LuaAllocator &operator=(const LuaAllocator &) = delete;
+    ~LuaAllocator();
+
+    lua_State *newState();
+    // return all arenas to the system, only valid after the state is closed
+    void release();
+
+    void setLimit(qint64 limitBytes) { limit.store(limitBytes, std::memory_order_relaxed); }  // 0: unlimited
+    qint64 allocated() const { return allocatedBytes.load(std::memory_order_relaxed); }
+    Stat stat() const;
+
+    static void *alloc(void *ud, void *ptr, size_t osize, size_t nsize);
+
+private:
+    static constexpr size_t sizeClassStep = 16;
+    static constexpr int sizeClassCount = 16;  // pooled blocks: 16 ~ 256 bytes
+    static constexpr size_t maxPooledSize = sizeClassStep * sizeClassCount;
+    static constexpr size_t arenaSize = 64 * 1024;
+
+    void *freeLists[sizeClassCount];
+    QVector<char *> arenas;
+    char *arenaCur, *arenaEnd;
+
+    std::atomic<qint64> limit, currentBytes, peakBytes, allocatedBytes;
+
+    void *allocBlock(size_t size);
+    void freeBlock(void *ptr, size_t size);
+    void addUsage(size_t oldSize, size_t newSize);
+    static int sizeClass(size_t size) { return int((size - 1) / sizeClassStep); }
+    static int panic(lua_State *L);
+};
+
+}
+#endif // LUAALLOCATOR_H
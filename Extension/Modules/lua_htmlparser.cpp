@@ -1,5 +1,66 @@
 #include "lua_htmlparser.h"
 #include "Common/htmlparsersax.h"
+#include "Common/htmlselector.h"
+
+namespace
+{
+struct SelectResult
+{
+    const QByteArray *html;
+    QVector<HTMLSelector::Match> matches;
+    QVector<QByteArray> texts;
+    QByteArray error;
+    int limit;
+};
+
+int pushSelectResult(lua_State *L)
+{
+    // only reads result, nothing here owns memory a lua error could leak
+    const SelectResult &result = *static_cast<const SelectResult *>(lua_touserdata(L, 1));
+    if(!result.error.isEmpty())
+    {
+        lua_pushlstring(L, result.error.constData(), result.error.size());
+        return 1;
+    }
+    const QByteArray &html = *result.html;
+    const QVector<HTMLSelector::Match> &matches = result.matches;
+    const int limit = result.limit;
+    if(limit == 1 && matches.isEmpty())
+    {
+        lua_pushnil(L);
+        return 1;
+    }
+    auto pushRange = [&](const char *field, int begin, int end){
+        lua_pushlstring(L, html.constData() + begin, end - begin);
+        lua_setfield(L, -2, field);
+    };
+    if(limit != 1) lua_createtable(L, matches.size(), 0);
+    for(int i = 0; i < matches.size(); ++i)
+    {
+        // {name=, attr={}, pos=, html=, inner=, text=}
+        const HTMLSelector::Match &match = matches[i];
+        lua_createtable(L, 0, 6);
+        pushRange("name", match.name.pos, match.name.pos + match.name.len);
+        lua_createtable(L, 0, match.attributes.size());
+        for(const auto &attr : match.attributes)
+        {
+            lua_pushlstring(L, html.constData() + attr.name.pos, attr.name.len);
+            lua_pushlstring(L, html.constData() + attr.value.pos, attr.value.len);
+            lua_rawset(L, -3);
+        }
+        lua_setfield(L, -2, "attr");
+        lua_pushinteger(L, match.outerBegin);
+        lua_setfield(L, -2, "pos");
+        pushRange("html", match.outerBegin, match.outerEnd);
+        pushRange("inner", match.innerBegin, match.innerEnd);
+        const QByteArray &text = result.texts[i];
+        lua_pushlstring(L, text.constData(), text.size());
+        lua_setfield(L, -2, "text");
+        if(limit != 1) lua_rawseti(L, -2, i + 1);
+    }
+    return 1;
+}
+}
 
 namespace Extension
 {
@@ -23,6 +84,8 @@ void HtmlParser::setup()
         {"start", hpIsStartNode},
         {"curnode", hpCurrentNode},
         {"curproperty", hpCurrentNodeProperty},
+        {"select", hpSelect},
+        {"selectall", hpSelectAll},
         {"__gc", htmlParserGC},
         {nullptr, nullptr}
     };
@@ -36,12 +99,18 @@ int HtmlParser::htmlparser(lua_State *L)
     size_t length = 0;
     if(n > 0 && lua_type(L, 1)==LUA_TSTRING)
     {
-        data = lua_tolstring(L, -1, &length);
+        data = lua_tolstring(L, 1, &length);
     }
     HTMLParserSax **parser = (HTMLParserSax **)lua_newuserdata(L, sizeof(HTMLParserSax *));
     luaL_getmetatable(L, "meta.kiko.htmlparser");
     lua_setmetatable(L, -2);  // reader meta
-    *parser = new HTMLParserSax(QByteArray(data, length)); //reader
+    if(data)
+    {
+        // the parser reads the lua string in place, keep it alive as long as the parser
+        lua_pushvalue(L, 1);
+        lua_setuservalue(L, -2);
+    }
+    *parser = new HTMLParserSax(QByteArray::fromRawData(data, length)); //reader
     return 1;
 }
 
@@ -103,7 +172,7 @@ int HtmlParser::hpCurPos(lua_State *L)
 int HtmlParser::hpReadContentText(lua_State *L)
 {
     HTMLParserSax *parser = checkHTMLParser(L);
-    QByteArray content(parser->readContentText());
+    const QByteArray content(parser->readContentText());
     lua_pushlstring(L, content.constData(), content.size());
     return 1;
 }
@@ -117,9 +186,10 @@ int HtmlParser::hpReadContentUntil(lua_State *L)
         lua_pushnil(L);
         return 1;
     }
-    QByteArray nodeName(lua_tostring(L, 2));
+    size_t len = 0;
+    const char *nodeName = lua_tolstring(L, 2, &len);
     bool isStart = lua_toboolean(L, 3);
-    QByteArray content(parser->readContentUntil(nodeName, isStart));
+    const QByteArray content(parser->readContentUntil(QByteArray::fromRawData(nodeName, len), isStart));
     lua_pushlstring(L, content.constData(), content.size());
     return 1;
 }
@@ -134,7 +204,8 @@ int HtmlParser::hpIsStartNode(lua_State *L)
 int HtmlParser::hpCurrentNode(lua_State *L)
 {
     HTMLParserSax *parser = checkHTMLParser(L);
-    lua_pushstring(L, parser->currentNode().constData());
+    const QByteArray nodeName(parser->currentNode());
+    lua_pushlstring(L, nodeName.constData(), nodeName.size());
     return 1;
 }
 
@@ -147,8 +218,48 @@ int HtmlParser::hpCurrentNodeProperty(lua_State *L)
         lua_pushnil(L);
         return 1;
     }
-    QByteArray nodeName(lua_tostring(L, 2));
-    lua_pushstring(L, parser->currentNodeProperty(nodeName).constData());
+    size_t len = 0;
+    const char *name = lua_tolstring(L, 2, &len);
+    const QByteArray property(parser->currentNodeProperty(QByteArray::fromRawData(name, len)));
+    lua_pushlstring(L, property.constData(), property.size());
+    return 1;
+}
+
+int HtmlParser::hpSelect(lua_State *L)
+{
+    return select(L, 1);
+}
+
+int HtmlParser::hpSelectAll(lua_State *L)
+{
+    return select(L, -1);
+}
+
+int HtmlParser::select(lua_State *L, int limit)
+{
+    HTMLParserSax *parser = checkHTMLParser(L);
+    size_t len = 0;
+    const char *css = luaL_checklstring(L, 2, &len);
+    bool failed = false;
+    {
+        // lua errors (e.g. LUA_ERRMEM) longjmp over C++ destructors, so the result table is built
+        // in a protected call and the error is raised once the C++ objects of this scope are gone
+        SelectResult result;
+        result.html = &parser->content();
+        result.limit = limit;
+        const HTMLSelector selector(QByteArray::fromRawData(css, len));
+        if(!selector.isValid())
+            result.error = QString("invalid selector: %1").arg(selector.errorInfo()).toUtf8();
+        else
+            result.matches = selector.select(*result.html, limit);
+        result.texts.reserve(result.matches.size());
+        for(const HTMLSelector::Match &match : result.matches)
+            result.texts.append(HTMLSelector::innerText(*result.html, match.innerBegin, match.innerEnd));
+        lua_pushcfunction(L, pushSelectResult);
+        lua_pushlightuserdata(L, &result);
+        failed = lua_pcall(L, 1, 1, 0) != LUA_OK || !result.error.isEmpty();
+    }
+    if(failed) return lua_error(L);
     return 1;
 }
 
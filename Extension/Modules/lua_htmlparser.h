@@ -23,6 +23,9 @@ private:
     static int hpIsStartNode(lua_State *L);
     static int hpCurrentNode(lua_State *L);
     static int hpCurrentNodeProperty(lua_State *L);
+    static int hpSelect(lua_State *L);
+    static int hpSelectAll(lua_State *L);
+    static int select(lua_State *L, int limit);
     static int htmlParserGC (lua_State *L);
 };
 }
@@ -15,6 +15,7 @@ void LibraryInterface::setup()
         {"gettag", gettag},
         {"addanime", addanime},
         {"addtag", addtag},
+        {"search", search},
         {nullptr, nullptr}
     };
     registerFuncs({"kiko", "library"}, funcs);
@@ -150,5 +151,17 @@ int LibraryInterface::addtag(lua_State *L)
     return 1;
 }
 
+int LibraryInterface::search(lua_State *L)
+{
+    // search(text, limit): anime names, best match first
+    const int params = lua_gettop(L);
+    if (params < 1 || params > 2 || lua_type(L, 1) != LUA_TSTRING) return 0;
+    const QString text = lua_tostring(L, 1);
+    const int limit = params > 1 && lua_isinteger(L, 2)? int(lua_tointeger(L, 2)) : 100;
+    if (!AnimeWorker::instance()->hasSearchIndex()) return 0;
+    pushValue(L, AnimeWorker::instance()->searchAnimes(text, qMax(limit, 1)));
+    return 1;
+}
+
 
 }
@@ -15,6 +15,7 @@ private:
     static int gettag(lua_State *L);
     static int addanime(lua_State *L);
     static int addtag(lua_State *L);
+    static int search(lua_State *L);
 };
 
 }
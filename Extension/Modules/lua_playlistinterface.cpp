@@ -2,6 +2,18 @@
 #include "Extension/Common/ext_common.h"
 #include "globalobjects.h"
 #include "Play/Playlist/playlist.h"
+#include <QSemaphore>
+#include <QSharedPointer>
+
+namespace
+{
+    // released when the last copy of the addFolder callback is gone: after it has run, or when the scan is dropped at exit
+    struct FolderAddedGuard
+    {
+        QSharedPointer<QSemaphore> semaphore;
+        ~FolderAddedGuard() { semaphore->release(); }
+    };
+}
 
 namespace Extension
 {
@@ -69,6 +81,9 @@ int PlayListInterface::add(lua_State *L)
             bool isWebDAVCollection = itemInfo.value("webdav_collection").toBool();
             const QString webDAVUser = itemInfo.value("webdav_user").toString();
             const QString webDAVPassword = itemInfo.value("webdav_password").toString();
+            // the folder is scanned in the background, add returns once its items are in the playlist
+            QSharedPointer<QSemaphore> folderAdded(new QSemaphore);
+            bool waitFolder = false;
             QMetaObject::invokeMethod(GlobalObjects::playlist, [&](){
                 if (!path.isEmpty())
                 {
@@ -83,7 +98,9 @@ int PlayListInterface::add(lua_State *L)
                     }
                     else
                     {
-                        GlobalObjects::playlist->addFolder(path, parent, title);
+                        waitFolder = true;
+                        QSharedPointer<FolderAddedGuard> guard(new FolderAddedGuard{folderAdded});
+                        GlobalObjects::playlist->addFolder(path, parent, title, [guard](int){});
                     }
                 }
                 else
@@ -96,6 +113,7 @@ int PlayListInterface::add(lua_State *L)
                     }
                 }
             }, Qt::BlockingQueuedConnection);
+            if (waitFolder) folderAdded->acquire();
             lua_pushboolean(L, true);
             return 1;
         }
@@ -1,4 +1,5 @@
 #include "playgroundscript.h"
+#include "scriptprofiler.h"
 
 PlaygroundScript::PlaygroundScript() : ScriptBase()
 {
@@ -14,7 +15,10 @@ PlaygroundScript::PlaygroundScript() : ScriptBase()
 
 void PlaygroundScript::run(const QString &scriptContent)
 {
+    const qint64 allocatedBefore = allocator.allocated();
+    if(profiler) profiler->beginCall();
     ScriptState state = loadScriptStr(scriptContent);
+    if(profiler) profiler->endCall("<playground>", allocator.allocated() - allocatedBefore);
     if(!state)
     {
         printCallBack(state.info);
@@ -7,10 +7,14 @@
 #include "Extension/Modules/lua_stringutil.h"
 #include "Extension/Modules/lua_dir.h"
 #include "Extension/Common/ext_common.h"
+#include "scriptcache.h"
+#include "scriptprofiler.h"
 #include <QFile>
 #include <QDir>
 #include <QVariant>
+#include <QElapsedTimer>
 #include "Common/logger.h"
+#include "Common/metrics.h"
 #include "globalobjects.h"
 
 #define LOG_INFO(info, scriptId) Logger::logger()->log(Logger::Script, QString("[%1]%2").arg(scriptId, info))
@@ -18,10 +22,10 @@
 namespace
 {
 }
-ScriptBase::ScriptBase() : L(nullptr), settingsUpdated(false),hasSetOptionFunc(false),sType(ScriptType::UNKNOWN_STYPE)
+ScriptBase::ScriptBase() : L(nullptr), loadMode(LoadMode::DIRECT), chunkLoaded(false), settingsUpdated(false),hasSetOptionFunc(false),sType(ScriptType::UNKNOWN_STYPE)
 {
     settingPath = GlobalObjects::dataPath + "extension/script_data/";
-    L = luaL_newstate();
+    L = allocator.newState();
     if(L)
     {
         luaL_openlibs(L);
@@ -44,6 +48,7 @@ ScriptBase::~ScriptBase()
     if(L)
     {
         QMutexLocker locker(&scriptLock);
+        profiler.reset();
         lua_close(L);
         L = nullptr;
     }
@@ -78,7 +83,7 @@ ScriptState ScriptBase::setOption(int index, const QString &value, bool callLua)
     scriptSettings[index].value = value;
     settingsUpdated = true;
     QString errInfo;
-    if(callLua)
+    if(callLua && chunkLoaded)
     {
         setTable(luaSettingsTable, scriptSettings[index].key, value);
         if(hasSetOptionFunc)
@@ -96,7 +101,7 @@ ScriptState ScriptBase::setOption(const QString &key, const QString &value, bool
         {
             item.value = value;
             settingsUpdated = true;
-            if(callLua)
+            if(callLua && chunkLoaded)
             {
                 setTable(luaSettingsTable, key, value);
                 if(hasSetOptionFunc)
@@ -135,12 +140,21 @@ ScriptState ScriptBase::scriptMenuClick(const QString &mid)
 ScriptState ScriptBase::loadScript(const QString &path)
 {
     if(!L) return "Script Error: Wrong Lua State";
-    QFile luaFile(path);
-    luaFile.open(QFile::ReadOnly);
-    if(!luaFile.isOpen()) return "Open Script File Failed";
-    QString luaScript(luaFile.readAll());
-    QString errInfo = loadScriptStr(luaScript);
-    if(!errInfo.isEmpty()) return errInfo;
+    luaPath = path;
+    chunkLoaded = false;
+    manifest.clear();
+    QString errInfo;
+    if(ScriptCache::loadManifest(path, manifest))
+    {
+        // unchanged script, globals are served from the manifest until first call
+        loadMode = LoadMode::REPLAY;
+    }
+    else
+    {
+        loadMode = LoadMode::RECORD;
+        errInfo = loadChunk(path);
+        if(!errInfo.isEmpty()) return errInfo;
+    }
     errInfo = loadMeta(path);
     if(!errInfo.isEmpty()) return errInfo;
     loadSettings(path);
@@ -149,6 +163,16 @@ ScriptState ScriptBase::loadScript(const QString &path)
     return errInfo;
 }
 
+void ScriptBase::finishLoad(bool succeed)
+{
+    if(loadMode == LoadMode::RECORD && succeed)
+    {
+        ScriptCache::saveManifest(luaPath, manifest);
+    }
+    loadMode = LoadMode::DIRECT;
+    manifest.clear();
+}
+
 QVariantList ScriptBase::call(const char *fname, const QVariantList &params, int nRet, QString &errInfo)
 {
     if(!L)
@@ -157,6 +181,8 @@ QVariantList ScriptBase::call(const char *fname, const QVariantList &params, int
         LOG_ERROR(errInfo, "Lua");
         return QVariantList();
     }
+    errInfo = ensureLoaded();
+    if(!errInfo.isEmpty()) return QVariantList();
     if(lua_getglobal(L, fname) != LUA_TFUNCTION)
     {
         errInfo = QString("%1 is not founded").arg(fname);
@@ -167,10 +193,22 @@ QVariantList ScriptBase::call(const char *fname, const QVariantList &params, int
     {
         pushValue(L, p);
     }
-    if(lua_pcall(L, params.size(), nRet, 0))
+    const qint64 allocatedBefore = allocator.allocated();
+    if(profiler) profiler->beginCall();
+    QElapsedTimer callTimer;
+    callTimer.start();
+    const int ret = lua_pcall(L, params.size(), nRet, 0);
+    Metrics::instance()->observe("kikoplay_script_call_duration_seconds", callTimer.nsecsElapsed() / 1e9, {id(), fname});
+    if(profiler) profiler->endCall(fname, allocator.allocated() - allocatedBefore);
+    if(ret)
     {
         errInfo=QString(lua_tostring(L, -1));
         lua_pop(L,1);
+        if(ret == LUA_ERRMEM)
+        {
+            const auto memStat = allocator.stat();
+            errInfo += QString(" (memory: %1/%2 bytes)").arg(memStat.current).arg(memStat.limit);
+        }
         LOG_ERROR(errInfo, id());
         return QVariantList();
     }
@@ -184,18 +222,59 @@ QVariantList ScriptBase::call(const char *fname, const QVariantList &params, int
     return rets;
 }
 
+bool ScriptBase::setProfilerEnabled(bool on)
+{
+    if(!L) return false;
+    MutexLocker locker(scriptLock);
+    if(!locker.tryLock()) return false;
+    if(!on) profiler.reset();
+    else if(profiler) profiler->reset();
+    else profiler.reset(new ScriptProfiler(L));
+    return true;
+}
+
+QJsonObject ScriptBase::profileData()
+{
+    QJsonObject data(profiler? profiler->toJson() : QJsonObject());
+    data.insert("id", id());
+    const auto memStat = allocator.stat();
+    data.insert("memory", QJsonObject{
+        {"current", memStat.current},
+        {"peak", memStat.peak},
+        {"allocated", memStat.allocated},
+        {"limit", memStat.limit}
+    });
+    return data;
+}
+
+QByteArray ScriptBase::profileFoldedStacks()
+{
+    return profiler? profiler->toFoldedStacks() : QByteArray();
+}
+
+QString ScriptBase::profileSummary()
+{
+    const auto memStat = allocator.stat();
+    QString summary(QString("memory: current %1 bytes, peak %2 bytes, allocated %3 bytes").arg(memStat.current).arg(memStat.peak).arg(memStat.allocated));
+    if(profiler) summary += "\n" + profiler->summary();
+    return summary;
+}
+
 QVariant ScriptBase::get(const char *name)
 {
     if(!L) return QVariant();
+    if(loadMode == LoadMode::REPLAY) return manifest.value(QString("v:%1").arg(name));
+    if(!ensureLoaded().isEmpty()) return QVariant();
     lua_getglobal(L, name);
     QVariant val = getValue(L);
     lua_pop(L, 1);
+    if(loadMode == LoadMode::RECORD) manifest.insert(QString("v:%1").arg(name), val);
     return val;
 }
 
 void ScriptBase::set(const char *name, const QVariant &val)
 {
-    if(!L) return;
+    if(!L || !ensureLoaded().isEmpty()) return;
     pushValue(L, val);
     lua_setglobal(L, name);
 }
@@ -219,8 +298,11 @@ ScriptState ScriptBase::setTable(const char *tname, const QVariant &key, const Q
 bool ScriptBase::checkType(const char *name, int type)
 {
     if(!L) return false;
+    if(loadMode == LoadMode::REPLAY) return manifest.value(QString("t:%1").arg(name), LUA_TNIL).toInt() == type;
+    if(!ensureLoaded().isEmpty()) return false;
     int ct = lua_getglobal(L, name);
     lua_pop(L, 1);
+    if(loadMode == LoadMode::RECORD) manifest.insert(QString("t:%1").arg(name), ct);
     return ct == type;
 }
 
@@ -353,14 +435,7 @@ void ScriptBase::loadSettings(const QString &scriptPath)
         }
     }
 
-    lua_newtable(L);
-    for(const auto &item: scriptSettings)
-    {
-        lua_pushstring(L, item.key.toStdString().c_str());
-        lua_pushstring(L, item.value.toStdString().c_str());
-        lua_settable(L, -3);
-    }
-    lua_setglobal(L, luaSettingsTable);
+    if(chunkLoaded) pushSettingsTable();
 }
 
 void ScriptBase::loadSearchSettings(const QString &scriptPath)
@@ -466,9 +541,48 @@ void ScriptBase::registerFuncs(const char *tname, const luaL_Reg *funcs)
     lua_setglobal(L, tname);
 }
 
+QString ScriptBase::loadChunk(const QString &scriptPath)
+{
+    QString errInfo = ScriptCache::loadChunk(L, scriptPath);
+    if(errInfo.isEmpty() && lua_pcall(L,0,0,0))
+    {
+        errInfo = QString(lua_tostring(L, -1));
+        lua_pop(L,1);
+    }
+    if(!errInfo.isEmpty()) return "Script Error: " + errInfo;
+    chunkLoaded = true;
+    return errInfo;
+}
+
+QString ScriptBase::ensureLoaded()
+{
+    if(chunkLoaded) return QString();
+    QString errInfo = loadChunk(luaPath);
+    if(!errInfo.isEmpty())
+    {
+        LOG_ERROR(errInfo, id());
+        return errInfo;
+    }
+    pushSettingsTable();
+    return errInfo;
+}
+
+void ScriptBase::pushSettingsTable()
+{
+    lua_newtable(L);
+    for(const auto &item: scriptSettings)
+    {
+        lua_pushstring(L, item.key.toStdString().c_str());
+        lua_pushstring(L, item.value.toStdString().c_str());
+        lua_settable(L, -3);
+    }
+    lua_setglobal(L, luaSettingsTable);
+}
+
 ScriptState ScriptBase::loadScriptStr(const QString &content)
 {
     QString errInfo;
+    chunkLoaded = true;
     if(luaL_loadstring(L, content.toStdString().c_str()) || lua_pcall(L,0,0,0))
     {
         errInfo="Script Error: "+ QString(lua_tostring(L, -1));
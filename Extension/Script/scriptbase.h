@@ -3,7 +3,11 @@
 #include <QObject>
 #include <QHash>
 #include <QMutex>
+#include <QVariant>
+#include <QScopedPointer>
+#include <QJsonObject>
 #include "Extension/Lua/lua.hpp"
+#include "Extension/Common/luaallocator.h"
 class MutexLocker
 {
     QMutex &m;
@@ -33,6 +37,7 @@ struct ScriptState
 };
 Q_DECLARE_METATYPE(ScriptState)
 
+class ScriptProfiler;
 enum ScriptType
 {
     DANMU, LIBRARY, RESOURCE, BGM_CALENDAR, UNKNOWN_STYPE, PLAYGROUND
@@ -85,6 +90,16 @@ public:
     ScriptState scriptMenuClick(const QString &mid);
 
     virtual ScriptState loadScript(const QString &path);
+    // called by ScriptManager after loadScript, persists the manifest of a freshly executed script
+    void finishLoad(bool succeed);
+
+    Extension::LuaAllocator::Stat memoryStat() const {return allocator.stat();}
+    void setMemoryLimit(qint64 bytes) {allocator.setLimit(bytes);}
+    bool setProfilerEnabled(bool on);
+    bool profilerEnabled() const {return !profiler.isNull();}
+    QJsonObject profileData();
+    QByteArray profileFoldedStacks();
+    QString profileSummary();
 
 protected:
     const char *luaSettingsTable = "settings";
@@ -94,8 +109,18 @@ protected:
     const char *scriptMenuTable = "scriptmenus";
     const char *scriptMenuFunc = "scriptmenuclick";
 
+    Extension::LuaAllocator allocator;
     lua_State *L;
     QMutex scriptLock;
+    enum class LoadMode
+    {
+        DIRECT, RECORD, REPLAY
+    };
+    LoadMode loadMode;
+    bool chunkLoaded;
+    QVariantMap manifest;  // v:<global> -> value, t:<global> -> lua type
+    QString luaPath;
+    QScopedPointer<ScriptProfiler> profiler;
     QHash<QString, QString> scriptMeta;
     QVector<ScriptSettingItem> scriptSettings;
     QVector<SearchSettingItem> searchSettingItems;
@@ -110,6 +135,10 @@ protected:
     ScriptState setTable(const char *tname, const QVariant &key, const QVariant &val);
     bool checkType(const char *name, int type);
 
+    QString loadChunk(const QString &scriptPath);
+    QString ensureLoaded();
+    void pushSettingsTable();
+
     QString loadMeta(const QString &scriptPath);
     void loadSettings(const QString &scriptPath);
     void loadSearchSettings(const QString &scriptPath);
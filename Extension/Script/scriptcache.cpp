@@ -0,0 +1,111 @@
+#include "scriptcache.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QCryptographicHash>
+#include "globalobjects.h"
+
+namespace
+{
+    int chunkWriter(lua_State *, const void *p, size_t sz, void *ud)
+    {
+        static_cast<QByteArray *>(ud)->append(static_cast<const char *>(p), sz);
+        return 0;
+    }
+}
+
+QString ScriptCache::loadChunk(lua_State *L, const QString &scriptPath)
+{
+    const QByteArray chunkName("@" + QFileInfo(scriptPath).fileName().toUtf8());
+    QByteArray bytecode(readCache(scriptPath, chunkSuffix));
+    if(!bytecode.isEmpty())
+    {
+        if(luaL_loadbufferx(L, bytecode.constData(), bytecode.size(), chunkName.constData(), "b") == LUA_OK) return "";
+        lua_pop(L, 1);  // incompatible bytecode, compile from source again
+    }
+    QFile luaFile(scriptPath);
+    if(!luaFile.open(QFile::ReadOnly)) return "Open Script File Failed";
+    const QByteArray source(luaFile.readAll());
+    if(luaL_loadbufferx(L, source.constData(), source.size(), chunkName.constData(), "t") != LUA_OK)
+    {
+        QString errInfo(lua_tostring(L, -1));
+        lua_pop(L, 1);
+        return errInfo;
+    }
+    bytecode.clear();
+    if(lua_dump(L, chunkWriter, &bytecode, 0) == 0)
+    {
+        writeCache(scriptPath, chunkSuffix, bytecode);
+    }
+    return "";
+}
+
+bool ScriptCache::loadManifest(const QString &scriptPath, QVariantMap &manifest)
+{
+    const QByteArray data(readCache(scriptPath, manifestSuffix));
+    if(data.isEmpty()) return false;
+    QDataStream ds(data);
+    ds >> manifest;
+    return ds.status() == QDataStream::Ok && !manifest.isEmpty();
+}
+
+void ScriptCache::saveManifest(const QString &scriptPath, const QVariantMap &manifest)
+{
+    QByteArray data;
+    QDataStream ds(&data, QIODevice::WriteOnly);
+    ds << manifest;
+    writeCache(scriptPath, manifestSuffix, data);
+}
+
+void ScriptCache::removeCache(const QString &scriptPath)
+{
+    QFile::remove(cacheFile(scriptPath, chunkSuffix));
+    QFile::remove(cacheFile(scriptPath, manifestSuffix));
+}
+
+QString ScriptCache::cacheFile(const QString &scriptPath, const char *suffix, bool create)
+{
+    const QString cachePath(GlobalObjects::dataPath + "extension/script_cache/");
+    if(create)
+    {
+        QDir dir;
+        if(!dir.exists(cachePath)) dir.mkpath(cachePath);
+    }
+    const QByteArray pathHash(QCryptographicHash::hash(QFileInfo(scriptPath).absoluteFilePath().toUtf8(), QCryptographicHash::Md5).toHex());
+    return cachePath + QString(pathHash) + suffix;
+}
+
+QByteArray ScriptCache::cacheKey(const QFileInfo &fileInfo)
+{
+    QByteArray key(fileInfo.absoluteFilePath().toUtf8());
+    key.append('|').append(QByteArray::number(fileInfo.fileTime(QFile::FileModificationTime).toMSecsSinceEpoch()));
+    key.append('|').append(QByteArray::number(fileInfo.size()));
+    key.append('|').append(LUA_RELEASE);
+    key.append('|').append(GlobalObjects::kikoVersion);
+    return key;
+}
+
+QByteArray ScriptCache::readCache(const QString &scriptPath, const char *suffix)
+{
+    QFile cache(cacheFile(scriptPath, suffix));
+    if(!cache.open(QFile::ReadOnly)) return QByteArray();
+    QDataStream ds(&cache);
+    quint32 magic = 0;
+    QByteArray key, data;
+    ds >> magic >> key >> data;
+    if(ds.status() != QDataStream::Ok || magic != cacheMagic) return QByteArray();
+    if(key != cacheKey(QFileInfo(scriptPath))) return QByteArray();
+    return data;
+}
+
+void ScriptCache::writeCache(const QString &scriptPath, const char *suffix, const QByteArray &data)
+{
+    QSaveFile cache(cacheFile(scriptPath, suffix, true));
+    if(!cache.open(QFile::WriteOnly)) return;
+    QDataStream ds(&cache);
+    ds << cacheMagic << cacheKey(QFileInfo(scriptPath)) << data;
+    cache.commit();
+}
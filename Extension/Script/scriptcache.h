@@ -0,0 +1,28 @@
+#ifndef SCRIPTCACHE_H
+#define SCRIPTCACHE_H
+#include <QString>
+#include <QVariant>
+#include "Extension/Lua/lua.hpp"
+class QFileInfo;
+class ScriptCache
+{
+public:
+    // push compiled chunk of the script to the stack, precompiled bytecode is used when path+mtime+Lua version match
+    static QString loadChunk(lua_State *L, const QString &scriptPath);
+    // manifest: snapshot of globals queried while loading the script, replayed instead of executing the script
+    static bool loadManifest(const QString &scriptPath, QVariantMap &manifest);
+    static void saveManifest(const QString &scriptPath, const QVariantMap &manifest);
+    static void removeCache(const QString &scriptPath);
+
+private:
+    static constexpr const char *chunkSuffix = ".luac";
+    static constexpr const char *manifestSuffix = ".meta";
+    static constexpr const quint32 cacheMagic = 0x4b534331;  // KSC1
+
+    static QString cacheFile(const QString &scriptPath, const char *suffix, bool create = false);
+    static QByteArray cacheKey(const QFileInfo &fileInfo);
+    static QByteArray readCache(const QString &scriptPath, const char *suffix);
+    static void writeCache(const QString &scriptPath, const char *suffix, const QByteArray &data);
+};
+
+#endif // SCRIPTCACHE_H
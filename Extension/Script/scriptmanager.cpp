@@ -2,96 +2,145 @@
 #include <QCoreApplication>
 #include <QDir>
 #include <QDateTime>
+#include <QtConcurrent>
+#include <QSettings>
 #include "danmuscript.h"
 #include "libraryscript.h"
 #include "resourcescript.h"
 #include "bgmcalendarscript.h"
+#include "scriptcache.h"
 #include "Common/logger.h"
+#include "globalobjects.h"
 
-ScriptManager::ScriptManager(QObject *parent) : QObject(parent)
+ScriptManager::ScriptManager(QObject *parent) : QObject(parent), profilerOn(false)
 {
+    scriptMemoryLimit = GlobalObjects::appSetting->value("Script/MemoryLimit", 256).toLongLong() * 1024 * 1024;
     qRegisterMetaType<ScriptType>("ScriptType");
     qRegisterMetaType<ScriptState>("ScriptState");
     qRegisterMetaType<ScriptManager::ScriptChangeState>("ScriptChangeState");
-    refreshScripts(ScriptType::DANMU);
-    refreshScripts(ScriptType::LIBRARY);
-    refreshScripts(ScriptType::RESOURCE);
-    refreshScripts(ScriptType::BGM_CALENDAR);
+    refreshScripts(QVector<ScriptType>{ScriptType::DANMU, ScriptType::LIBRARY, ScriptType::RESOURCE, ScriptType::BGM_CALENDAR});
 }
 
 void ScriptManager::refreshScripts(ScriptType type)
 {
-    if(type == ScriptType::UNKNOWN_STYPE) return;
-    QString scriptPath(getScriptPath());
-    scriptPath += subDirs[type];
+    refreshScripts(QVector<ScriptType>{type});
+}
 
-    QHash<QString, QSharedPointer<ScriptBase>> curScripts;
-    for(auto &s : scriptLists[type])
+void ScriptManager::refreshScripts(const QVector<ScriptType> &types)
+{
+    struct LoadTask
     {
-        curScripts.insert(s->getValue("path"), s);
-    }
-    QSet<QString> existPaths;
-    QDir folder(scriptPath);
-    bool changed = false;
-    for (QFileInfo fileInfo : folder.entryInfoList())
+        ScriptType type;
+        QString path;
+        QSharedPointer<ScriptBase> script;
+        ScriptState state;
+    };
+    QVector<LoadTask> tasks;
+    bool changed[ScriptType::UNKNOWN_STYPE] = {false};
+    for(ScriptType type : types)
     {
-        if (fileInfo.isFile() && fileInfo.suffix().toLower()=="lua")
+        if(type == ScriptType::UNKNOWN_STYPE) continue;
+        QString scriptPath(getScriptPath());
+        scriptPath += subDirs[type];
+
+        QHash<QString, QSharedPointer<ScriptBase>> curScripts;
+        for(auto &s : scriptLists[type])
         {
-            QString path(fileInfo.absoluteFilePath());
-            qint64 modifyTime = fileInfo.fileTime(QFile::FileModificationTime).toSecsSinceEpoch();
-            bool add = !curScripts.contains(path);
-            existPaths.insert(path);
-            if(!add)
+            curScripts.insert(s->getValue("path"), s);
+        }
+        QSet<QString> existPaths;
+        QDir folder(scriptPath);
+        for (QFileInfo fileInfo : folder.entryInfoList())
+        {
+            if (fileInfo.isFile() && fileInfo.suffix().toLower()=="lua")
             {
-                if(curScripts[path]->getValue("time").toLongLong() < modifyTime)
+                QString path(fileInfo.absoluteFilePath());
+                qint64 modifyTime = fileInfo.fileTime(QFile::FileModificationTime).toSecsSinceEpoch();
+                bool add = !curScripts.contains(path);
+                existPaths.insert(path);
+                if(!add)
                 {
-                    QString id = curScripts[path]->id();
-                    scriptLists[type].removeAll(curScripts[path]);
-                    curScripts.remove(path);
-                    id2scriptHash.remove(id);
-                    add = true;
-                    changed = true;
+                    if(curScripts[path]->getValue("time").toLongLong() < modifyTime)
+                    {
+                        QString id = curScripts[path]->id();
+                        scriptLists[type].removeAll(curScripts[path]);
+                        curScripts.remove(path);
+                        id2scriptHash.remove(id);
+                        add = true;
+                        changed[type] = true;
+                    }
                 }
-            }
-            if(add)
-            {
-                QSharedPointer<ScriptBase> cs;
-                if(type == ScriptType::DANMU) cs.reset(new DanmuScript);
-                else if(type == ScriptType::LIBRARY) cs.reset(new LibraryScript);
-                else if(type == ScriptType::RESOURCE) cs.reset(new ResourceScript);
-                else if(type == ScriptType::BGM_CALENDAR) cs.reset(new BgmCalendarScript);
-                if(cs)
+                if(add)
                 {
-                    ScriptState state = cs->loadScript(path);
-                    if(state)
-                    {
-                        scriptLists[type].append(cs);
-                        id2scriptHash[cs->id()] = cs;
-                        changed = true;
-					}
-					else
-					{
-                        Logger::logger()->log(Logger::Script, QString("[ERROR][%1]%2").arg(path, state.info));
-					}
+                    tasks.append({type, path, nullptr, ScriptState()});
                 }
-
+            }
+        }
+        auto &scripts = scriptLists[type];
+        for(auto iter=scripts.begin(); iter!=scripts.end();)
+        {
+            if(!existPaths.contains((*iter)->getValue("path")))
+            {
+                QString id((*iter)->id());
+                id2scriptHash.remove(id);
+                iter = scripts.erase(iter);
+                changed[type] = true;
+            } else {
+                ++iter;
             }
         }
     }
-    auto &scripts = scriptLists[type];
-    for(auto iter=scripts.begin(); iter!=scripts.end();)
+    // every script owns an independent lua state, so new scripts can be loaded concurrently
+    const qint64 memoryLimit = scriptMemoryLimit;
+    QtConcurrent::blockingMap(tasks, [memoryLimit](LoadTask &task){
+        task.script = createScript(task.type);
+        if(!task.script) return;
+        task.script->setMemoryLimit(memoryLimit);
+        task.state = task.script->loadScript(task.path);
+    });
+    for(auto &task : tasks)
     {
-        if(!existPaths.contains((*iter)->getValue("path")))
+        if(!task.script) continue;
+        if(task.state)
         {
-            QString id((*iter)->id());
-            id2scriptHash.remove(id);
-            iter = scripts.erase(iter);
-            changed = true;
-        } else {
-            ++iter;
+            task.script->finishLoad(true);
+            if(profilerOn) task.script->setProfilerEnabled(true);
+            scriptLists[task.type].append(task.script);
+            id2scriptHash[task.script->id()] = task.script;
+            changed[task.type] = true;
+        }
+        else
+        {
+            task.script->finishLoad(false);
+            Logger::logger()->log(Logger::Script, QString("[ERROR][%1]%2").arg(task.path, task.state.info));
         }
     }
-    if(changed) emit scriptChanged(type);
+    for(ScriptType type : types)
+    {
+        if(type != ScriptType::UNKNOWN_STYPE && changed[type]) emit scriptChanged(type);
+    }
+}
+
+void ScriptManager::setProfilerEnabled(bool on)
+{
+    profilerOn = on;
+    for(auto &scripts : scriptLists)
+    {
+        for(auto &s : scripts)
+        {
+            s->setProfilerEnabled(on);
+        }
+    }
+}
+
+QSharedPointer<ScriptBase> ScriptManager::createScript(ScriptType type)
+{
+    QSharedPointer<ScriptBase> cs;
+    if(type == ScriptType::DANMU) cs.reset(new DanmuScript);
+    else if(type == ScriptType::LIBRARY) cs.reset(new LibraryScript);
+    else if(type == ScriptType::RESOURCE) cs.reset(new ResourceScript);
+    else if(type == ScriptType::BGM_CALENDAR) cs.reset(new BgmCalendarScript);
+    return cs;
 }
 
 void ScriptManager::deleteScript(const QString &id)
@@ -112,6 +161,7 @@ void ScriptManager::deleteScript(const QString &id)
     {
         QFileInfo fi(path);
         fi.dir().remove(fi.fileName());
+        ScriptCache::removeCache(path);
         int suffixPos = path.lastIndexOf('.');
         QFileInfo settingFile(path.mid(0,suffixPos)+".json");
         if(settingFile.exists()) settingFile.dir().remove(settingFile.fileName());
@@ -3,6 +3,7 @@
 #include <QList>
 #include <QHash>
 #include <QSet>
+#include <QVector>
 #include <QObject>
 #include <QSharedPointer>
 #include "scriptbase.h"
@@ -25,14 +26,21 @@ public:
     void deleteScript(const QString &id);
     const QList<QSharedPointer<ScriptBase>> &scripts(ScriptType type)  {return scriptLists[type]; }
     QSharedPointer<ScriptBase> getScript(const QString &id) {return id2scriptHash.value(id);}
+    void setProfilerEnabled(bool on);
+    bool profilerEnabled() const {return profilerOn;}
+    qint64 memoryLimit() const {return scriptMemoryLimit;}
 
 signals:
     void scriptChanged(ScriptType type);
 private:
     QList<QSharedPointer<ScriptBase>> scriptLists[ScriptType::UNKNOWN_STYPE];
     QHash<QString, QSharedPointer<ScriptBase>> id2scriptHash;
+    bool profilerOn;
+    qint64 scriptMemoryLimit;
     const char *subDirs[ScriptType::UNKNOWN_STYPE] = {"/danmu/", "/library/", "/resource/", "/bgm_calendar/"};
     QString getScriptPath();
+    void refreshScripts(const QVector<ScriptType> &types);
+    static QSharedPointer<ScriptBase> createScript(ScriptType type);
 };
 
 #endif // SCRIPTMANAGER_H
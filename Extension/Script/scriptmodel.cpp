@@ -1,5 +1,6 @@
 #include "scriptmodel.h"
 #include "globalobjects.h"
+#include "Download/util.h"
 #define ScriptTypeRole Qt::UserRole+1
 
 ScriptModel::ScriptModel(QObject *parent) : QAbstractItemModel(parent)
@@ -29,6 +30,13 @@ QVariant ScriptModel::data(const QModelIndex &index, int role) const
             return script.version;
         case Columns::DESC:
             return script.desc;
+        case Columns::MEMORY:
+        {
+            auto s = GlobalObjects::scriptManager->getScript(script.id);
+            if(!s) break;
+            const auto memStat = s->memoryStat();
+            return QString("%1 / %2").arg(formatSize(false, memStat.current), formatSize(false, memStat.peak));
+        }
         default:
             break;
         }
@@ -58,7 +66,7 @@ QVariant ScriptModel::data(const QModelIndex &index, int role) const
 
 QVariant ScriptModel::headerData(int section, Qt::Orientation orientation, int role) const
 {
-    static QStringList headers({tr("Type"), tr("Id"),tr("Name"),tr("Version"),tr("Description")});
+    static QStringList headers({tr("Type"), tr("Id"),tr("Name"),tr("Version"),tr("Description"),tr("Memory(Current/Peak)")});
     if (role == Qt::DisplayRole&&orientation == Qt::Horizontal)
     {
         if(section<headers.size()) return headers.at(section);
@@ -17,6 +17,7 @@ public:
         NAME,
         VERSION,
         DESC,
+        MEMORY,
         NONE
     };
     QStringList scriptTypes{tr("Danmu"), tr("Library"),tr("Resources"), tr("BgmCalendar")};
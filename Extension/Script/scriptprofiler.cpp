@@ -0,0 +1,291 @@
+#include "scriptprofiler.h"
+#include <QJsonArray>
+#include <QStringList>
+#include <algorithm>
+
+namespace
+{
+    static char profilerKey;
+    constexpr const int maxStackDepth = 64;
+
+    QString toMs(qint64 ns)
+    {
+        return QString::number(ns / 1000000.0, 'f', 2);
+    }
+
+    template<typename T, typename F>
+    QList<QPair<QString, qint64>> topItems(const QHash<QString, T> &items, F weight, int n)
+    {
+        QList<QPair<QString, qint64>> tops;
+        for(auto iter = items.cbegin(); iter != items.cend(); ++iter)
+        {
+            tops.append({iter.key(), weight(iter.value())});
+        }
+        std::sort(tops.begin(), tops.end(), [](const QPair<QString, qint64> &a, const QPair<QString, qint64> &b){
+            return a.second > b.second;
+        });
+        if(tops.size() > n) tops.erase(tops.begin() + n, tops.end());
+        return tops;
+    }
+}
+
+const QVector<qint64> ScriptProfiler::latencyBuckets{1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000};
+
+ScriptProfiler::ScriptProfiler(lua_State *state) : L(state), callStartNs(0), lastEventNs(0), luaNs(0), nativeNs(0)
+{
+    timer.start();
+    collectNativeNames();
+    lua_pushlightuserdata(L, this);
+    lua_rawsetp(L, LUA_REGISTRYINDEX, &profilerKey);
+    lua_sethook(L, hook, LUA_MASKCALL | LUA_MASKRET | LUA_MASKCOUNT, sampleInterval);
+}
+
+ScriptProfiler::~ScriptProfiler()
+{
+    lua_sethook(L, nullptr, 0, 0);
+    lua_pushnil(L);
+    lua_rawsetp(L, LUA_REGISTRYINDEX, &profilerKey);
+}
+
+void ScriptProfiler::beginCall()
+{
+    QMutexLocker locker(&statLock);
+    callStartNs = lastEventNs = timer.nsecsElapsed();
+    pendingNative.clear();
+}
+
+void ScriptProfiler::endCall(const QString &fname, qint64 allocatedBytes)
+{
+    QMutexLocker locker(&statLock);
+    const qint64 now = timer.nsecsElapsed();
+    luaNs += now - lastEventNs;
+    const qint64 duration = now - callStartNs;
+    CallStat &stat = callStats[fname];
+    if(stat.histogram.isEmpty()) stat.histogram.resize(latencyBuckets.size() + 1);
+    ++stat.count;
+    stat.totalNs += duration;
+    stat.maxNs = qMax(stat.maxNs, duration);
+    stat.allocated += allocatedBytes;
+    int bucket = 0;
+    while(bucket < latencyBuckets.size() && duration > latencyBuckets[bucket] * 1000000) ++bucket;
+    ++stat.histogram[bucket];
+    // unfinished C calls are left by errors thrown across them
+    pendingNative.clear();
+}
+
+void ScriptProfiler::reset()
+{
+    QMutexLocker locker(&statLock);
+    luaNs = nativeNs = 0;
+    callStats.clear();
+    nativeStats.clear();
+    foldedStacks.clear();
+    pendingNative.clear();
+    collectNativeNames();
+}
+
+QJsonObject ScriptProfiler::toJson() const
+{
+    QMutexLocker locker(&statLock);
+    QJsonObject calls;
+    for(auto iter = callStats.cbegin(); iter != callStats.cend(); ++iter)
+    {
+        const CallStat &stat = iter.value();
+        QJsonArray histogram;
+        for(int i = 0; i < stat.histogram.size(); ++i)
+        {
+            histogram.append(QJsonObject{
+                {"le", i < latencyBuckets.size()? QString::number(latencyBuckets[i]) : QString("+Inf")},
+                {"count", stat.histogram[i]}
+            });
+        }
+        calls.insert(iter.key(), QJsonObject{
+            {"count", stat.count},
+            {"total_ms", stat.totalNs / 1000000.0},
+            {"avg_ms", stat.count > 0? stat.totalNs / 1000000.0 / stat.count : 0},
+            {"max_ms", stat.maxNs / 1000000.0},
+            {"allocated", stat.allocated},
+            {"histogram", histogram}
+        });
+    }
+    QJsonObject natives;
+    for(auto iter = nativeStats.cbegin(); iter != nativeStats.cend(); ++iter)
+    {
+        natives.insert(iter.key(), QJsonObject{
+            {"count", iter.value().count},
+            {"total_ms", iter.value().totalNs / 1000000.0}
+        });
+    }
+    return QJsonObject{
+        {"lua_ms", luaNs / 1000000.0},
+        {"native_ms", nativeNs / 1000000.0},
+        {"calls", calls},
+        {"native", natives}
+    };
+}
+
+QByteArray ScriptProfiler::toFoldedStacks() const
+{
+    QMutexLocker locker(&statLock);
+    QStringList stacks(foldedStacks.keys());
+    std::sort(stacks.begin(), stacks.end());
+    QByteArray folded;
+    for(const QString &stack : stacks)
+    {
+        const qint64 us = foldedStacks.value(stack) / 1000;
+        if(us <= 0) continue;
+        folded.append(stack.toUtf8()).append(' ').append(QByteArray::number(us)).append('\n');
+    }
+    return folded;
+}
+
+QString ScriptProfiler::summary() const
+{
+    QMutexLocker locker(&statLock);
+    QStringList lines;
+    lines.append(QString("lua: %1 ms, native: %2 ms").arg(toMs(luaNs), toMs(nativeNs)));
+    for(auto iter = callStats.cbegin(); iter != callStats.cend(); ++iter)
+    {
+        const CallStat &stat = iter.value();
+        lines.append(QString("call %1: %2 times, avg %3 ms, max %4 ms, allocated %5 bytes")
+                     .arg(iter.key()).arg(stat.count).arg(toMs(stat.count > 0? stat.totalNs / stat.count : 0), toMs(stat.maxNs)).arg(stat.allocated));
+    }
+    const auto topNatives = topItems(nativeStats, [](const NativeStat &s){ return s.totalNs; }, 10);
+    for(const auto &p : topNatives)
+    {
+        lines.append(QString("native %1: %2 times, %3 ms").arg(p.first).arg(nativeStats[p.first].count).arg(toMs(p.second)));
+    }
+    const auto topStacks = topItems(foldedStacks, [](qint64 ns){ return ns; }, 10);
+    for(const auto &p : topStacks)
+    {
+        lines.append(QString("%1 ms\t%2").arg(toMs(p.second), p.first));
+    }
+    return lines.join('\n');
+}
+
+void ScriptProfiler::collectNativeNames()
+{
+    nativeNames.clear();
+    if(lua_getglobal(L, "kiko") == LUA_TTABLE)
+    {
+        collectNativeNames(lua_gettop(L), "kiko", ".");
+    }
+    lua_pop(L, 1);
+    // member functions of native objects live in meta.kiko.xx metatables
+    lua_pushnil(L);
+    while(lua_next(L, LUA_REGISTRYINDEX))
+    {
+        if(lua_type(L, -2) == LUA_TSTRING && lua_type(L, -1) == LUA_TTABLE)
+        {
+            const QString metaName(lua_tostring(L, -2));
+            if(metaName.startsWith("meta.kiko."))
+            {
+                collectNativeNames(lua_gettop(L), metaName.mid(5), ":");
+            }
+        }
+        lua_pop(L, 1);
+    }
+}
+
+void ScriptProfiler::collectNativeNames(int tableIndex, const QString &prefix, const QString &sep)
+{
+    lua_pushnil(L);
+    while(lua_next(L, tableIndex))
+    {
+        if(lua_type(L, -2) == LUA_TSTRING)
+        {
+            const QString name(prefix + sep + lua_tostring(L, -2));
+            if(lua_iscfunction(L, -1))
+            {
+                nativeNames.insert(reinterpret_cast<quintptr>(lua_tocfunction(L, -1)), name);
+            }
+            else if(lua_type(L, -1) == LUA_TTABLE && prefix == "kiko")
+            {
+                collectNativeNames(lua_gettop(L), name, ".");
+            }
+        }
+        lua_pop(L, 1);
+    }
+}
+
+QString ScriptProfiler::frameName(lua_State *state, lua_Debug *ar)
+{
+    if(ar->what[0] == 'C')
+    {
+        const QString name(nativeNames.value(reinterpret_cast<quintptr>(lua_tocfunction(state, -1))));
+        if(!name.isEmpty()) return name;
+        return QString("[C]%1").arg(ar->name? ar->name : "?");
+    }
+    if(ar->what[0] == 'm')
+    {
+        return QString("main (%1)").arg(ar->short_src);
+    }
+    return QString("%1 (%2:%3)").arg(ar->name? ar->name : "?", ar->short_src).arg(ar->linedefined);
+}
+
+void ScriptProfiler::addStack(lua_State *state, int level, qint64 ns)
+{
+    QStringList frames;
+    lua_Debug ar;
+    for(int i = level; i < level + maxStackDepth && lua_getstack(state, i, &ar); ++i)
+    {
+        lua_getinfo(state, "Snf", &ar);
+        frames.prepend(frameName(state, &ar));
+        lua_pop(state, 1);
+    }
+    if(frames.isEmpty()) return;
+    foldedStacks[frames.join(';')] += ns;
+}
+
+void ScriptProfiler::hook(lua_State *state, lua_Debug *ar)
+{
+    lua_rawgetp(state, LUA_REGISTRYINDEX, &profilerKey);
+    ScriptProfiler *profiler = static_cast<ScriptProfiler *>(lua_touserdata(state, -1));
+    lua_pop(state, 1);
+    if(!profiler) return;
+    QMutexLocker locker(&profiler->statLock);
+    const qint64 now = profiler->timer.nsecsElapsed();
+    const qint64 elapsed = now - profiler->lastEventNs;
+    switch (ar->event)
+    {
+    case LUA_HOOKCOUNT:
+    {
+        profiler->luaNs += elapsed;
+        profiler->addStack(state, 0, elapsed);
+        break;
+    }
+    case LUA_HOOKCALL:
+    {
+        lua_getinfo(state, "S", ar);
+        if(ar->what[0] != 'C') return;
+        // time before entering the C function belongs to the caller
+        profiler->luaNs += elapsed;
+        profiler->addStack(state, 1, elapsed);
+        profiler->pendingNative[state].append(now);
+        break;
+    }
+    case LUA_HOOKRET:
+    {
+        lua_getinfo(state, "Sf", ar);
+        const bool isNative = ar->what[0] == 'C';
+        const QString name(isNative? profiler->nativeNames.value(reinterpret_cast<quintptr>(lua_tocfunction(state, -1))) : QString());
+        lua_pop(state, 1);
+        auto &pending = profiler->pendingNative[state];
+        if(!isNative || pending.isEmpty()) return;
+        const qint64 duration = now - pending.takeLast();
+        if(!name.isEmpty())
+        {
+            NativeStat &stat = profiler->nativeStats[name];
+            ++stat.count;
+            stat.totalNs += duration;
+        }
+        profiler->nativeNs += elapsed;
+        profiler->addStack(state, 0, elapsed);
+        break;
+    }
+    default:
+        return;
+    }
+    // exclude the time spent in the hook itself
+    profiler->lastEventNs = profiler->timer.nsecsElapsed();
+}
@@ -0,0 +1,61 @@
+#ifndef SCRIPTPROFILER_H
+#define SCRIPTPROFILER_H
+#include <QHash>
+#include <QVector>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include "Extension/Lua/lua.hpp"
+
+class ScriptProfiler
+{
+public:
+    explicit ScriptProfiler(lua_State *state);
+    ScriptProfiler(const ScriptProfiler &) = delete;
+    ~ScriptProfiler();
+
+    static constexpr const int sampleInterval = 1000;  // vm instructions between two samples
+    static const QVector<qint64> latencyBuckets;  // upper bounds of call latency histogram, ms
+
+    void beginCall();
+    void endCall(const QString &fname, qint64 allocatedBytes);
+    void reset();
+
+    QJsonObject toJson() const;
+    QByteArray toFoldedStacks() const;  // flamegraph-compatible, weight: us
+    QString summary() const;
+
+private:
+    struct CallStat
+    {
+        qint64 count = 0;
+        qint64 totalNs = 0;
+        qint64 maxNs = 0;
+        qint64 allocated = 0;
+        QVector<qint64> histogram;
+    };
+    struct NativeStat
+    {
+        qint64 count = 0;
+        qint64 totalNs = 0;
+    };
+
+    lua_State *L;
+    QElapsedTimer timer;
+    qint64 callStartNs, lastEventNs;
+    qint64 luaNs, nativeNs;
+    mutable QMutex statLock;
+    QHash<QString, CallStat> callStats;
+    QHash<QString, NativeStat> nativeStats;
+    QHash<QString, qint64> foldedStacks;
+    QHash<lua_State *, QVector<qint64>> pendingNative;  // start time of running C functions
+    QHash<quintptr, QString> nativeNames;  // C function -> kiko.xx
+
+    void collectNativeNames();
+    void collectNativeNames(int tableIndex, const QString &prefix, const QString &sep);
+    QString frameName(lua_State *state, lua_Debug *ar);
+    void addStack(lua_State *state, int level, qint64 ns);
+    static void hook(lua_State *state, lua_Debug *ar);
+};
+
+#endif // SCRIPTPROFILER_H
@@ -43,9 +43,11 @@ SOURCES += \
     Common/eventbus.cpp \
     Common/flowlayout.cpp \
     Common/htmlparsersax.cpp \
+    Common/htmlselector.cpp \
     Common/kstats.cpp \
     Common/kupdater.cpp \
     Common/logger.cpp \
+    Common/metrics.cpp \
     Common/network.cpp \
     Common/notifier.cpp \
     Download/aria2jsonrpc.cpp \
@@ -81,6 +83,7 @@ SOURCES += \
     Extension/App/appstorage.cpp \
     Extension/App/kapp.cpp \
     Extension/Common/ext_common.cpp \
+    Extension/Common/luaallocator.cpp \
     Extension/Common/luatablemodel.cpp \
     Extension/Modules/lua_appcommondialog.cpp \
     Extension/Modules/lua_appevent.cpp \
@@ -111,8 +114,10 @@ SOURCES += \
     Extension/Script/playgroundscript.cpp \
     Extension/Script/resourcescript.cpp \
     Extension/Script/scriptbase.cpp \
+    Extension/Script/scriptcache.cpp \
     Extension/Script/scriptmanager.cpp \
     Extension/Script/scriptmodel.cpp \
+    Extension/Script/scriptprofiler.cpp \
     Extension/Script/scriptsettingmodel.cpp \
     Download/util.cpp \
     Play/Playlist/webdav/qwebdav.cpp \
@@ -123,16 +128,19 @@ SOURCES += \
     UI/widgets/windowtip.cpp \
     globalobjects.cpp \
     LANServer/apihandler.cpp \
+    LANServer/captureservice.cpp \
     LANServer/dlna/dlnamediacontroller.cpp \
+    LANServer/dlna/dlnamediaindex.cpp \
     LANServer/dlna/dlnamediaitem.cpp \
     LANServer/dlna/dlnamediaserver.cpp \
+    LANServer/dlna/dlnasearchcriteria.cpp \
     LANServer/dlna/upnp.cpp \
     LANServer/dlna/upnpctrlpoint.cpp \
     LANServer/dlna/upnpdevice.cpp \
     LANServer/dlna/upnpservice.cpp \
     LANServer/filehandler.cpp \
-    LANServer/httpserver/httpconnectionhandler.cpp \
-    LANServer/httpserver/httpconnectionhandlerpool.cpp \
+    LANServer/httpserver/httpconnection.cpp \
+    LANServer/httpserver/httpconnectionmanager.cpp \
     LANServer/httpserver/httpcookie.cpp \
     LANServer/httpserver/httpglobal.cpp \
     LANServer/httpserver/httplistener.cpp \
@@ -143,7 +151,10 @@ SOURCES += \
     LANServer/httpserver/httpsessionstore.cpp \
     LANServer/httpserver/staticfilecontroller.cpp \
     LANServer/lanserver.cpp \
+    LANServer/pushservice.cpp \
+    LANServer/responsecache.cpp \
     LANServer/router.cpp \
+    LANServer/staticassetcache.cpp \
     main.cpp \
     MediaLibrary/animefilterproxymodel.cpp \
     MediaLibrary/animeinfo.cpp \
@@ -155,6 +166,7 @@ SOURCES += \
     MediaLibrary/capturelistmodel.cpp \
     MediaLibrary/episodeitem.cpp \
     MediaLibrary/episodesmodel.cpp \
+    MediaLibrary/imagestore.cpp \
     MediaLibrary/labelitemdelegate.cpp \
     MediaLibrary/labelmodel.cpp \
     MediaLibrary/tagnode.cpp \
@@ -175,9 +187,14 @@ SOURCES += \
     Play/Danmu/Render/danmurender.cpp \
     Play/Danmu/Render/livedanmuitemdelegate.cpp \
     Play/Danmu/Render/livedanmulistmodel.cpp \
+    Play/Playlist/folderscanner.cpp \
+    Play/Playlist/folderwatcher.cpp \
     Play/Playlist/playlist.cpp \
     Play/Playlist/playlistitem.cpp \
     Play/Playlist/playlistprivate.cpp \
+    Play/Playlist/playlistsnapshot.cpp \
+    Play/Playlist/playliststore.cpp \
+    Play/Video/mpvframedecoder.cpp \
     Play/Video/mpvplayer.cpp \
     Play/Video/mpvpreview.cpp \
     Play/Video/simpleplayer.cpp \
@@ -254,10 +271,12 @@ HEADERS += \
     Common/eventbus.h \
     Common/flowlayout.h \
     Common/htmlparsersax.h \
+    Common/htmlselector.h \
     Common/kstats.h \
     Common/kupdater.h \
     Common/logger.h \
     Common/lrucache.h \
+    Common/metrics.h \
     Common/network.h \
     Common/notifier.h \
     Common/threadtask.h \
@@ -297,6 +316,7 @@ HEADERS += \
     Extension/App/appstorage.h \
     Extension/App/kapp.h \
     Extension/Common/ext_common.h \
+    Extension/Common/luaallocator.h \
     Extension/Common/luatablemodel.h \
     Extension/Modules/lua_appcommondialog.h \
     Extension/Modules/lua_appevent.h \
@@ -327,8 +347,10 @@ HEADERS += \
     Extension/Script/playgroundscript.h \
     Extension/Script/resourcescript.h \
     Extension/Script/scriptbase.h \
+    Extension/Script/scriptcache.h \
     Extension/Script/scriptmanager.h \
     Extension/Script/scriptmodel.h \
+    Extension/Script/scriptprofiler.h \
     Extension/Script/scriptsettingmodel.h \
     Download/util.h \
     Play/Playlist/webdav/qwebdav.h \
@@ -339,16 +361,19 @@ HEADERS += \
     UI/widgets/windowtip.h \
     globalobjects.h \
     LANServer/apihandler.h \
+    LANServer/captureservice.h \
     LANServer/dlna/dlnamediacontroller.h \
+    LANServer/dlna/dlnamediaindex.h \
     LANServer/dlna/dlnamediaitem.h \
     LANServer/dlna/dlnamediaserver.h \
+    LANServer/dlna/dlnasearchcriteria.h \
     LANServer/dlna/upnp.h \
     LANServer/dlna/upnpctrlpoint.h \
     LANServer/dlna/upnpdevice.h \
     LANServer/dlna/upnpservice.h \
     LANServer/filehandler.h \
-    LANServer/httpserver/httpconnectionhandler.h \
-    LANServer/httpserver/httpconnectionhandlerpool.h \
+    LANServer/httpserver/httpconnection.h \
+    LANServer/httpserver/httpconnectionmanager.h \
     LANServer/httpserver/httpcookie.h \
     LANServer/httpserver/httpglobal.h \
     LANServer/httpserver/httplistener.h \
@@ -359,7 +384,10 @@ HEADERS += \
     LANServer/httpserver/httpsessionstore.h \
     LANServer/httpserver/staticfilecontroller.h \
     LANServer/lanserver.h \
+    LANServer/pushservice.h \
+    LANServer/responsecache.h \
     LANServer/router.h \
+    LANServer/staticassetcache.h \
     MediaLibrary/animefilterproxymodel.h \
     MediaLibrary/animeinfo.h \
     MediaLibrary/animeitemdelegate.h \
@@ -370,6 +398,7 @@ HEADERS += \
     MediaLibrary/capturelistmodel.h \
     MediaLibrary/episodeitem.h \
     MediaLibrary/episodesmodel.h \
+    MediaLibrary/imagestore.h \
     MediaLibrary/labelitemdelegate.h \
     MediaLibrary/labelmodel.h \
     MediaLibrary/tagnode.h \
@@ -392,9 +421,14 @@ HEADERS += \
     Play/Danmu/Render/danmurender.h \
     Play/Danmu/Render/livedanmuitemdelegate.h \
     Play/Danmu/Render/livedanmulistmodel.h \
+    Play/Playlist/folderscanner.h \
+    Play/Playlist/folderwatcher.h \
     Play/Playlist/playlist.h \
     Play/Playlist/playlistitem.h \
     Play/Playlist/playlistprivate.h \
+    Play/Playlist/playlistsnapshot.h \
+    Play/Playlist/playliststore.h \
+    Play/Video/mpvframedecoder.h \
     Play/Video/mpvplayer.h \
     Play/Video/mpvpreview.h \
     Play/Video/simpleplayer.h \
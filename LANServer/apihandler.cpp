@@ -14,6 +14,7 @@
 #include "MediaLibrary/animeworker.h"
 #include "Play/Video/mpvplayer.h"
 #include "Play/playcontext.h"
+#include <limits>
 
 namespace
 {
@@ -47,9 +48,24 @@ void APIHandler::service(stefanfrings::HttpRequest &request, stefanfrings::HttpR
         response.setStatus(stefanfrings::HttpResponse::BadRequest);
         return;
     }
-    path = path.mid(5);
-    using Func = void(APIHandler::*)(stefanfrings::HttpRequest &, stefanfrings::HttpResponse &);
-    static QMap<QString, Func> routeTable = {
+    auto api = routeTable().value(path.mid(5), nullptr);
+    if(!api)
+    {
+        response.setStatus(stefanfrings::HttpResponse::BadRequest);
+        return;
+    }
+    (this->*api)(request, response);
+}
+
+QString APIHandler::routeName(const QByteArray &path)
+{
+    const QString route(path.mid(5));
+    return routeTable().contains(route)? "api/" + route : "api/unknown";
+}
+
+const QMap<QString, APIHandler::Func> &APIHandler::routeTable()
+{
+    static const QMap<QString, Func> routeTable = {
         {"playlist", &APIHandler::apiPlaylist},
         {"playstate", &APIHandler::apiPlaystate},
         {"updateTime", &APIHandler::apiUpdateTime},
@@ -57,33 +73,25 @@ void APIHandler::service(stefanfrings::HttpRequest &request, stefanfrings::HttpR
         {"updateDelay", &APIHandler::apiUpdateDelay},
         {"updateTimeline", &APIHandler::apiUpdateTimeline},
         {"screenshot", &APIHandler::apiScreenshot},
+        {"screenshot/status", &APIHandler::apiScreenshotStatus},
         {"danmu/v3/", &APIHandler::apiDanmu},
         {"danmu/full/", &APIHandler::apiDanmuFull},
+        {"danmu/window", &APIHandler::apiDanmuWindow},
         {"danmu/local/", &APIHandler::apiLocalDanmu},
         {"danmu/launch", &APIHandler::apiLaunch}
     };
-    auto api = routeTable.value(path, nullptr);
-    if(!api)
-    {
-        response.setStatus(stefanfrings::HttpResponse::BadRequest);
-        return;
-    }
-    (this->*api)(request, response);
+    return routeTable;
 }
 
 void APIHandler::apiPlaylist(stefanfrings::HttpRequest &request, stefanfrings::HttpResponse &response)
 {
-    QMetaObject::invokeMethod(GlobalObjects::playlist,[=](){
-        GlobalObjects::playlist->dumpJsonPlaylist(playlistDoc);
-    },Qt::BlockingQueuedConnection);
-    Logger::logger()->log(Logger::LANServer, QString("[%1]Playlist").arg(request.getPeerAddress().toString()));
+    QSharedPointer<const PlayListSnapshot> snapshot = GlobalObjects::playlist->snapshot();
+    ResponseCache::Entry entry;
+    const bool hit = responseCache.get("playlist", snapshot->version, entry);
+    Logger::logger()->log(Logger::LANServer, QString("[%1]Playlist%2").arg(request.getPeerAddress().toString(), hit?"(Cached)":""));
 
-    QByteArray data = playlistDoc.toJson();
-    QByteArray compressedBytes;
-    Network::gzipCompress(data,compressedBytes);
-    response.setHeader("Content-Type", "application/json");
-    response.setHeader("Content-Encoding", "gzip");
-    response.write(compressedBytes, true);
+    if(!hit) entry = responseCache.put("playlist", snapshot->version, QJsonDocument(snapshot->toJson()).toJson());
+    ResponseCache::write(request, response, entry);
 }
 
 void APIHandler::apiPlaystate(stefanfrings::HttpRequest &request, stefanfrings::HttpResponse &response)
@@ -177,7 +185,22 @@ void APIHandler::apiDanmu(stefanfrings::HttpRequest &request, stefanfrings::Http
         }
         else
         {
-            danmuArray=pool->exportJson();
+            // the version is taken before exporting, a change during the export makes the entry stale at once
+            const QString key("danmu/" + pool->id());
+            const quint64 version = responseCache.poolVersion(pool);
+            ResponseCache::Entry entry;
+            if(!responseCache.get(key, version, entry))
+            {
+                QJsonObject resposeObj
+                {
+                    {"code", 0},
+                    {"data", pool->exportJson()},
+                    {"update", false}
+                };
+                entry = responseCache.put(key, version, QJsonDocument(resposeObj).toJson());
+            }
+            ResponseCache::write(request, response, entry);
+            return;
         }
     }
     QJsonObject resposeObj
@@ -218,6 +241,14 @@ void APIHandler::apiDanmuFull(stefanfrings::HttpRequest &request, stefanfrings::
         }
         else
         {
+            const QString key("danmufull/" + pool->id());
+            const quint64 version = responseCache.poolVersion(pool);
+            ResponseCache::Entry entry;
+            if(responseCache.get(key, version, entry))
+            {
+                ResponseCache::write(request, response, entry);
+                return;
+            }
             resposeObj=pool->exportFullJson();
             resposeObj.insert("update", false);
             if(pool->sources().size()>0)
@@ -236,6 +267,9 @@ void APIHandler::apiDanmuFull(stefanfrings::HttpRequest &request, stefanfrings::
                 if(supportedScripts.size()>0)
                     resposeObj.insert("launchScripts", supportedScripts);
             }
+            entry = responseCache.put(key, version, QJsonDocument(resposeObj).toJson());
+            ResponseCache::write(request, response, entry);
+            return;
         }
     }
     QByteArray data = QJsonDocument(resposeObj).toJson();
@@ -246,6 +280,135 @@ void APIHandler::apiDanmuFull(stefanfrings::HttpRequest &request, stefanfrings::
     response.write(compressedBytes, true);
 }
 
+void APIHandler::apiDanmuWindow(stefanfrings::HttpRequest &request, stefanfrings::HttpResponse &response)
+{
+    // comments with from <= time < to, at most limit items per page
+    // cursor: "<time>_<skip>", the time of the next comment and the number of comments with this time already passed
+    // block=false keeps blocked comments, merge=<ms> merges equal comments within the interval
+    // format: json(default), ndjson, binary
+    Pool *pool = GlobalObjects::danmuManager->getPool(request.getParameter("id"));
+    if(!pool)
+    {
+        response.setStatus(stefanfrings::HttpResponse::NotFound);
+        return;
+    }
+    bool ok = false;
+    int from = request.getParameter("from").toInt(&ok);
+    if(!ok || from < 0) from = 0;
+    int to = request.getParameter("to").toInt(&ok);
+    if(!ok) to = std::numeric_limits<int>::max();
+    int limit = request.getParameter("limit").toInt(&ok);
+    limit = ok? qBound(1, limit, maxWindowLimit) : defaultWindowLimit;
+    const bool applyBlock = request.getParameter("block").toLower() != "false";
+    const int mergeInterval = qBound(0, request.getParameter("merge").toInt(), 60000);
+    const QByteArray format = request.getParameter("format").toLower();
+
+    QSharedPointer<const ResponseCache::CommentList> timeline = responseCache.timeline(pool);
+    auto timeLess = [](const QSharedPointer<DanmuComment> &danmu, int time){ return danmu->time < time; };
+    auto pos = std::lower_bound(timeline->cbegin(), timeline->cend(), from, timeLess);
+    const QList<QByteArray> cursor = request.getParameter("cursor").split('_');
+    if(cursor.size() == 2 && cursor[0].toInt() >= from)
+    {
+        const int cursorTime = cursor[0].toInt();
+        pos = std::lower_bound(timeline->cbegin(), timeline->cend(), cursorTime, timeLess);
+        for(int skip = cursor[1].toInt(); skip > 0 && pos != timeline->cend() && (*pos)->time == cursorTime; --skip) ++pos;
+    }
+
+    struct WindowItem
+    {
+        const DanmuComment *danmu;
+        int count;
+    };
+    QVector<WindowItem> items;
+    QHash<QString, int> mergeTarget;
+    for(; pos != timeline->cend() && (*pos)->time < to; ++pos)
+    {
+        const DanmuComment *danmu = pos->data();
+        if(applyBlock && danmu->blockBy != -1) continue;
+        if(mergeInterval > 0)
+        {
+            const QString mergeKey(QString::number(danmu->type) + danmu->text);
+            auto iter = mergeTarget.find(mergeKey);
+            if(iter != mergeTarget.end() && danmu->time - items[*iter].danmu->time <= mergeInterval)
+            {
+                ++items[*iter].count;
+                continue;
+            }
+            if(items.size() >= limit) break;
+            mergeTarget[mergeKey] = items.size();
+        }
+        else if(items.size() >= limit)
+        {
+            break;
+        }
+        items.append({danmu, 1});
+    }
+    QJsonValue next;
+    if(pos != timeline->cend() && (*pos)->time < to)
+    {
+        const int nextTime = (*pos)->time;
+        const int skip = pos - std::lower_bound(timeline->cbegin(), pos, nextTime, timeLess);
+        next = QString("%1_%2").arg(nextTime).arg(skip);
+    }
+    Logger::logger()->log(Logger::LANServer,
+                          QString("[%1]Danmu(Window) %2, [%3, %4), %5 items").arg(request.getPeerAddress().toString(),
+                          pool->epTitle(), QString::number(from), to == std::numeric_limits<int>::max()? "-" : QString::number(to),
+                          QString::number(items.size())));
+
+    QByteArray data;
+    if(format == "binary")
+    {
+        QDataStream ds(&data, QIODevice::WriteOnly);
+        ds << quint32(0x4b444d57) << quint16(1) << qint32(items.size()) << next.toString().toUtf8();
+        for(const WindowItem &item : items)
+        {
+            ds << qint32(item.danmu->time) << quint8(item.danmu->type) << quint32(item.danmu->color)
+               << quint16(qMin(item.count, 0xffff)) << item.danmu->sender.toUtf8() << item.danmu->text.toUtf8();
+        }
+        response.setHeader("Content-Type", "application/octet-stream");
+    }
+    else
+    {
+        QJsonArray danmuArray;
+        for(const WindowItem &item : items)
+        {
+            QJsonArray danmu({item.danmu->time/1000.0, item.danmu->type, item.danmu->color, item.danmu->sender, item.danmu->text});
+            if(mergeInterval > 0) danmu.append(item.count);
+            danmuArray.append(danmu);
+        }
+        QJsonObject pageObj
+        {
+            {"code", 0},
+            {"from", from},
+            {"next", next}
+        };
+        if(to != std::numeric_limits<int>::max()) pageObj.insert("to", to);
+        if(format == "ndjson")
+        {
+            // first line: page info, then a line for each comment
+            pageObj.insert("count", danmuArray.size());
+            data = QJsonDocument(pageObj).toJson(QJsonDocument::Compact);
+            data.append('\n');
+            for(const QJsonValue &danmu : danmuArray)
+            {
+                data.append(QJsonDocument(danmu.toArray()).toJson(QJsonDocument::Compact));
+                data.append('\n');
+            }
+            response.setHeader("Content-Type", "application/x-ndjson");
+        }
+        else
+        {
+            pageObj.insert("data", danmuArray);
+            data = QJsonDocument(pageObj).toJson(QJsonDocument::Compact);
+            response.setHeader("Content-Type", "application/json");
+        }
+    }
+    QByteArray compressedBytes;
+    Network::gzipCompress(data,compressedBytes);
+    response.setHeader("Content-Encoding", "gzip");
+    response.write(compressedBytes, true);
+}
+
 void APIHandler::apiLocalDanmu(stefanfrings::HttpRequest &request, stefanfrings::HttpResponse &response)
 {
     QString mediaId = request.getParameter("mediaId");
@@ -346,105 +509,67 @@ void APIHandler::apiSubtitle(stefanfrings::HttpRequest &request, stefanfrings::H
 
 void APIHandler::apiScreenshot(stefanfrings::HttpRequest &request, stefanfrings::HttpResponse &response)
 {
-    Q_UNUSED(response)
     QJsonDocument document;
-    if(readJson(request.getBody(), document))
+    if(!readJson(request.getBody(), document))
     {
-        QVariantMap data = document.object().toVariantMap();
-        QString animeName=data.value("animeName").toString();
-        double pos = data.value("pos").toDouble();  //s
-        QString mediaId = data.value("mediaId").toString();
-        QString mediaPath = GlobalObjects::playlist->getPathByHash(mediaId);
-        QFileInfo fi(mediaPath);
-        if(fi.exists() && !animeName.isEmpty())
-        {
-            QTemporaryFile tmpImg("XXXXXX.jpg");
-            if(tmpImg.open())
-            {
-                int cmin=pos/60;
-                int cls=pos-cmin*60;
-                QString posStr(QString("%1:%2").arg(cmin,2,10,QChar('0')).arg(cls,2,10,QChar('0')));
-
-                QString ffmpegPath = GlobalObjects::appSetting->value("Play/FFmpeg", "ffmpeg").toString();
-                QStringList arguments;
-                arguments << "-ss" << QString::number(pos);
-                arguments << "-i" << mediaPath;
-                arguments << "-vframes" << "1";
-                arguments << "-y";
-                arguments << tmpImg.fileName();
-
-                QProcess ffmpegProcess;
-                bool success = true;
-                QString errorInfo;
-                QObject::connect(&ffmpegProcess, &QProcess::errorOccurred, this, [&errorInfo, &success](QProcess::ProcessError error){
-                    if(error == QProcess::FailedToStart)
-                    {
-                        errorInfo = tr("Start FFmpeg Failed");
-                    }
-                   success = false;
-                });
-                QObject::connect(&ffmpegProcess, (void (QProcess:: *)(int, QProcess::ExitStatus))&QProcess::finished, this,
-                                 [&errorInfo, &success](int exitCode, QProcess::ExitStatus exitStatus){
-                   success = (exitStatus == QProcess::NormalExit && exitCode == 0);
-                   if(!success)
-                   {
-                       errorInfo = tr("Generate Failed, FFmpeg exit code: %1").arg(exitCode);
-                   }
-                });
-                QObject::connect(&ffmpegProcess, &QProcess::readyReadStandardOutput, this, [&](){
-                   qInfo()<<ffmpegProcess.readAllStandardOutput();
-                });
-                QObject::connect(&ffmpegProcess, &QProcess::readyReadStandardError, this, [&]() {
-                    QString content(ffmpegProcess.readAllStandardError());
-                    qInfo() << content.replace("\\n", "\n");
-                });
+        response.setStatus(stefanfrings::HttpResponse::BadRequest);
+        return;
+    }
+    QVariantMap data = document.object().toVariantMap();
+    CaptureService::CaptureRequest captureRequest;
+    captureRequest.animeName = data.value("animeName").toString();
+    captureRequest.pos = data.value("pos").toDouble();  //s
+    captureRequest.mediaPath = GlobalObjects::playlist->getPathByHash(data.value("mediaId").toString());
+    captureRequest.peer = request.getPeerAddress().toString();
+    QFileInfo fi(captureRequest.mediaPath);
+    if(!fi.exists() || captureRequest.animeName.isEmpty())
+    {
+        response.setStatus(stefanfrings::HttpResponse::BadRequest);
+        return;
+    }
+    captureRequest.info = data.value("info").toString();
+    if(data.contains("duration")) //snippet task
+    {
+        captureRequest.duration = qBound<int>(1, data.value("duration", 1).toInt(), 15);
+        captureRequest.retainAudio = data.value("retainAudio", true).toBool();
+        if(captureRequest.info.isEmpty())
+            captureRequest.info = QString("%1,%2s - %3").arg(duration2Str(captureRequest.pos), QString::number(captureRequest.duration), fi.fileName());
+    }
+    else if(captureRequest.info.isEmpty())
+    {
+        captureRequest.info = QString("%1 - %2").arg(duration2Str(captureRequest.pos), fi.fileName());
+    }
+    const QString id = captureService.submit(captureRequest);
+    if(id.isEmpty())
+    {
+        Logger::logger()->log(Logger::LANServer, QString("[%1]Screenshot, %2, capture queue is full").arg(captureRequest.peer, fi.filePath()));
+        response.setStatus(stefanfrings::HttpResponse::ServiceUnavailable);
+        response.setHeader("Retry-After", "5");
+        return;
+    }
+    QJsonObject resObj;
+    resObj.insert("id", id);
+    resObj.insert("state", CaptureService::stateName(CaptureService::Queued));
+    response.setHeader("Content-Type", "application/json");
+    response.write(QJsonDocument(resObj).toJson(QJsonDocument::Compact), true);
+}
 
-				ffmpegProcess.start(ffmpegPath, arguments);
-				ffmpegProcess.waitForFinished(-1);
-                if(success)
-                {
-                    QImage captureImage(tmpImg.fileName());
-                    if(data.contains("duration")) //snippet task
-                    {
-                        qint64 timeId = QDateTime::currentDateTime().toMSecsSinceEpoch();
-                        QString snippetPath(GlobalObjects::appSetting->value("Play/SnippetPath", GlobalObjects::dataPath + "/snippet").toString());
-                        QDir dir;
-                        if(!dir.exists(snippetPath)) dir.mkpath(snippetPath);
-                        QString fileName(QString("%1/%2.%3").arg(snippetPath, QString::number(timeId), fi.suffix()));
-                        QString duration = QString::number(qBound<int>(1, data.value("duration", 1).toInt(), 15));
-                        QStringList arguments;
-                        arguments << "-ss" << QString::number(pos);
-                        arguments << "-i" << mediaPath;
-                        arguments << "-t" << duration;
-                        if(!data.value("retainAudio", true).toBool())
-                            arguments << "-an";
-                        arguments << "-y";
-                        arguments << fileName;
-                        ffmpegProcess.start(ffmpegPath, arguments);
-                        ffmpegProcess.waitForFinished(-1);
-                        if(success)
-                        {
-                            Logger::logger()->log(Logger::LANServer, QString("[%1]Snippet,[%2]%3").arg(request.getPeerAddress().toString(),posStr, fi.filePath()));
-                            QString info = data.value("info").toString();
-                            if(info.isEmpty())  info = QString("%1,%2s - %3").arg(duration2Str(pos), duration, fi.fileName());
-                            AnimeWorker::instance()->saveSnippet(animeName, info, timeId, captureImage);
-                        }
-                    }
-                    else
-                    {
-                        Logger::logger()->log(Logger::LANServer, QString("[%1]Screenshot,[%2]%3").arg(request.getPeerAddress().toString(),posStr, fi.filePath()));
-                        QString info = data.value("info").toString();
-                        if(info.isEmpty())  info = QString("%1 - %2").arg(duration2Str(pos), fi.fileName());
-                        AnimeWorker::instance()->saveCapture(animeName, info, captureImage);
-                    }
-                }
-                else
-                {
-                    Logger::logger()->log(Logger::LANServer, QString("[%1]Screenshot, [%2]%3, %4").arg(request.getPeerAddress().toString(),posStr, fi.filePath(), errorInfo));
-                }
-            }
-        }
+void APIHandler::apiScreenshotStatus(stefanfrings::HttpRequest &request, stefanfrings::HttpResponse &response)
+{
+    const QString id = request.getParameter("id");
+    CaptureService::JobStatus status;
+    if(!captureService.status(id, status))
+    {
+        response.setStatus(stefanfrings::HttpResponse::NotFound);
+        return;
     }
+    QJsonObject resObj;
+    resObj.insert("id", id);
+    resObj.insert("state", CaptureService::stateName(status.state));
+    if(!status.errorInfo.isEmpty()) resObj.insert("error", status.errorInfo);
+    response.setHeader("Content-Type", "application/json");
+    response.setHeader("Cache-Control", "no-store");
+    response.write(QJsonDocument(resObj).toJson(QJsonDocument::Compact), true);
 }
 
 void APIHandler::apiLaunch(stefanfrings::HttpRequest &request, stefanfrings::HttpResponse &response)
@@ -5,6 +5,9 @@
 #include <QString>
 #include <QJsonDocument>
 #include <QHash>
+#include <QMap>
+#include "responsecache.h"
+#include "captureservice.h"
 
 class APIHandler : public stefanfrings::HttpRequestHandler
 {
@@ -13,20 +16,29 @@ class APIHandler : public stefanfrings::HttpRequestHandler
 public:
     APIHandler(QObject* parent = nullptr);
     void service(stefanfrings::HttpRequest& request, stefanfrings::HttpResponse& response);
+    // route label of the metrics, path: /api/...
+    static QString routeName(const QByteArray &path);
 private:
+    using Func = void(APIHandler::*)(stefanfrings::HttpRequest &, stefanfrings::HttpResponse &);
+    static const QMap<QString, Func> &routeTable();
+
     void apiPlaylist(stefanfrings::HttpRequest& request, stefanfrings::HttpResponse& response);
     void apiPlaystate(stefanfrings::HttpRequest& request, stefanfrings::HttpResponse& response);
     void apiUpdateTime(stefanfrings::HttpRequest& request, stefanfrings::HttpResponse& response);
     void apiDanmu(stefanfrings::HttpRequest& request, stefanfrings::HttpResponse& response);
     void apiDanmuFull(stefanfrings::HttpRequest& request, stefanfrings::HttpResponse& response);
+    void apiDanmuWindow(stefanfrings::HttpRequest& request, stefanfrings::HttpResponse& response);
     void apiLocalDanmu(stefanfrings::HttpRequest& request, stefanfrings::HttpResponse& response);
     void apiUpdateDelay(stefanfrings::HttpRequest& request, stefanfrings::HttpResponse& response);
     void apiUpdateTimeline(stefanfrings::HttpRequest& request, stefanfrings::HttpResponse& response);
     void apiSubtitle(stefanfrings::HttpRequest& request, stefanfrings::HttpResponse& response);
     void apiScreenshot(stefanfrings::HttpRequest& request, stefanfrings::HttpResponse& response);
+    void apiScreenshotStatus(stefanfrings::HttpRequest& request, stefanfrings::HttpResponse& response);
     void apiLaunch(stefanfrings::HttpRequest& request, stefanfrings::HttpResponse& response);
 private:
-    QJsonDocument playlistDoc;
+    static const int defaultWindowLimit = 1000, maxWindowLimit = 5000;
+    ResponseCache responseCache;
+    CaptureService captureService;
     bool readJson(const QByteArray &bytes, QJsonDocument &doc);
 };
 
@@ -0,0 +1,191 @@
+#include "captureservice.h"
+#include "globalobjects.h"
+#include "Common/logger.h"
+#include "MediaLibrary/animeworker.h"
+#include "Play/Video/mpvframedecoder.h"
+#include <QtConcurrent>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QProcess>
+#include <QSettings>
+#include <QUuid>
+#include <stdexcept>
+
+CaptureService::CaptureService() : pendingJobs(0)
+{
+    pool.setMaxThreadCount(maxWorkers);
+}
+
+CaptureService::~CaptureService()
+{
+    pool.clear();
+    pool.waitForDone();
+    qDeleteAll(idleDecoders);
+}
+
+QString CaptureService::submit(const CaptureRequest &request)
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QString id;
+    {
+        QMutexLocker locker(&lock);
+        if(pendingJobs >= maxPendingJobs) return QString();
+        removeExpiredJobs(now);
+        id = QUuid::createUuid().toString(QUuid::WithoutBraces);
+        JobStatus status;
+        status.updateTime = now;
+        jobs.insert(id, status);
+        ++pendingJobs;
+    }
+    QtConcurrent::run(&pool, [this, id, request](){
+        run(id, request);
+    });
+    return id;
+}
+
+bool CaptureService::status(const QString &id, JobStatus &status)
+{
+    QMutexLocker locker(&lock);
+    auto iter = jobs.find(id);
+    if(iter == jobs.end()) return false;
+    status = *iter;
+    return true;
+}
+
+QString CaptureService::stateName(JobState state)
+{
+    static const char *names[] = {"queued", "running", "finished", "failed"};
+    return names[state];
+}
+
+void CaptureService::run(const QString &id, const CaptureRequest &request)
+{
+    setState(id, Running);
+    const int pos = request.pos;
+    const QString posStr(QString("%1:%2").arg(pos/60, 2, 10, QChar('0')).arg(pos%60, 2, 10, QChar('0')));
+    const QFileInfo fi(request.mediaPath);
+    QImage captureImage;
+    QString errorInfo;
+    bool success = captureFrame(request, captureImage, errorInfo);
+    if(success && request.duration > 0)  // snippet task
+    {
+        qint64 timeId = QDateTime::currentDateTime().toMSecsSinceEpoch();
+        QString snippetPath(GlobalObjects::appSetting->value("Play/SnippetPath", GlobalObjects::dataPath + "/snippet").toString());
+        QDir dir;
+        if(!dir.exists(snippetPath)) dir.mkpath(snippetPath);
+        QString fileName(QString("%1/%2.%3").arg(snippetPath, QString::number(timeId), fi.suffix()));
+        success = cutSnippet(request, fileName, errorInfo);
+        if(success)
+        {
+            Logger::logger()->log(Logger::LANServer, QString("[%1]Snippet,[%2]%3").arg(request.peer, posStr, fi.filePath()));
+            AnimeWorker::instance()->saveSnippet(request.animeName, request.info, timeId, captureImage);
+        }
+    }
+    else if(success)
+    {
+        Logger::logger()->log(Logger::LANServer, QString("[%1]Screenshot,[%2]%3").arg(request.peer, posStr, fi.filePath()));
+        AnimeWorker::instance()->saveCapture(request.animeName, request.info, captureImage);
+    }
+    if(!success)
+    {
+        Logger::logger()->log(Logger::LANServer, QString("[%1]Screenshot, [%2]%3, %4").arg(request.peer, posStr, fi.filePath(), errorInfo));
+    }
+    setState(id, success? Finished : Failed, errorInfo);
+}
+
+bool CaptureService::captureFrame(const CaptureRequest &request, QImage &image, QString &errorInfo)
+{
+    // at most maxWorkers decoders exist, one per pool thread
+    MPVFrameDecoder *decoder = nullptr;
+    {
+        QMutexLocker locker(&lock);
+        if(!idleDecoders.isEmpty()) decoder = idleDecoders.takeLast();
+    }
+    if(!decoder)
+    {
+        try
+        {
+            decoder = new MPVFrameDecoder;
+        }
+        catch(const std::runtime_error &e)
+        {
+            errorInfo = e.what();
+            return false;
+        }
+    }
+    bool success = decoder->capture(request.mediaPath, request.pos, image, errorInfo);
+    QMutexLocker locker(&lock);
+    idleDecoders.append(decoder);
+    return success;
+}
+
+bool CaptureService::cutSnippet(const CaptureRequest &request, const QString &fileName, QString &errorInfo)
+{
+    const int snippetTimeout = 120 * 1000;
+    QString ffmpegPath = GlobalObjects::appSetting->value("Play/FFmpeg", "ffmpeg").toString();
+    QStringList arguments;
+    arguments << "-ss" << QString::number(request.pos);
+    arguments << "-i" << request.mediaPath;
+    arguments << "-t" << QString::number(request.duration);
+    if(!request.retainAudio)
+        arguments << "-an";
+    arguments << "-y";
+    arguments << fileName;
+
+    QProcess ffmpegProcess;
+    ffmpegProcess.setProcessChannelMode(QProcess::MergedChannels);
+    ffmpegProcess.start(ffmpegPath, arguments);
+    if(!ffmpegProcess.waitForStarted())
+    {
+        errorInfo = QObject::tr("Start FFmpeg Failed");
+        return false;
+    }
+    if(!ffmpegProcess.waitForFinished(snippetTimeout))
+    {
+        ffmpegProcess.kill();
+        ffmpegProcess.waitForFinished();
+        errorInfo = QObject::tr("Generate Failed, FFmpeg timeout");
+        return false;
+    }
+    qInfo() << ffmpegProcess.readAll();
+    if(ffmpegProcess.exitStatus() != QProcess::NormalExit || ffmpegProcess.exitCode() != 0)
+    {
+        errorInfo = QObject::tr("Generate Failed, FFmpeg exit code: %1").arg(ffmpegProcess.exitCode());
+        return false;
+    }
+    return true;
+}
+
+void CaptureService::setState(const QString &id, JobState state, const QString &errorInfo)
+{
+    QMutexLocker locker(&lock);
+    JobStatus &status = jobs[id];
+    status.state = state;
+    status.errorInfo = errorInfo;
+    status.updateTime = QDateTime::currentMSecsSinceEpoch();
+    if(state == Finished || state == Failed) --pendingJobs;
+}
+
+void CaptureService::removeExpiredJobs(qint64 now)
+{
+    auto isDone = [](const JobStatus &status){
+        return status.state == Finished || status.state == Failed;
+    };
+    for(auto iter = jobs.begin(); iter != jobs.end();)
+    {
+        if(isDone(*iter) && now - iter->updateTime > keepTime) iter = jobs.erase(iter);
+        else ++iter;
+    }
+    // pending jobs are never dropped, there are at most maxPendingJobs of them
+    while(jobs.size() >= maxKeptJobs + maxPendingJobs)
+    {
+        auto oldest = jobs.end();
+        for(auto iter = jobs.begin(); iter != jobs.end(); ++iter)
+        {
+            if(isDone(*iter) && (oldest == jobs.end() || iter->updateTime < oldest->updateTime)) oldest = iter;
+        }
+        jobs.erase(oldest);
+    }
+}
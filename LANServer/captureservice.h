@@ -0,0 +1,68 @@
+#ifndef CAPTURESERVICE_H
+#define CAPTURESERVICE_H
+
+#include <QHash>
+#include <QMutex>
+#include <QThreadPool>
+#include <QVector>
+class MPVFrameDecoder;
+/*
+ * Screenshot and snippet jobs of the LAN api (/api/screenshot).
+ * Jobs are queued and run by a small pool of threads, the request returns the job id at once
+ * and clients poll /api/screenshot/status?id=<id>.
+ * Frames are decoded by reused headless mpv instances (MPVFrameDecoder), snippets are still cut by ffmpeg.
+ * At most maxPendingJobs are queued or running, further submissions are refused.
+ * Thread-safe, used by the workers of the http server.
+ */
+class CaptureService
+{
+public:
+    enum JobState
+    {
+        Queued, Running, Finished, Failed
+    };
+    struct CaptureRequest
+    {
+        QString mediaPath;
+        QString animeName;
+        QString info;
+        QString peer;
+        double pos = 0;  // s
+        int duration = 0;  // s, 0 for a screenshot
+        bool retainAudio = true;
+    };
+    struct JobStatus
+    {
+        JobState state = Queued;
+        QString errorInfo;
+        qint64 updateTime = 0;
+    };
+
+    CaptureService();
+    ~CaptureService();
+
+    // returns an empty id if the queue is full
+    QString submit(const CaptureRequest &request);
+    bool status(const QString &id, JobStatus &status);
+    static QString stateName(JobState state);
+
+private:
+    static const int maxWorkers = 2;
+    static const int maxPendingJobs = 8;
+    static const int maxKeptJobs = 64;
+    static const int keepTime = 10 * 60 * 1000;  // ms
+
+    QThreadPool pool;
+    QMutex lock;
+    QHash<QString, JobStatus> jobs;
+    int pendingJobs;
+    QVector<MPVFrameDecoder *> idleDecoders;
+
+    void run(const QString &id, const CaptureRequest &request);
+    bool captureFrame(const CaptureRequest &request, QImage &image, QString &errorInfo);
+    bool cutSnippet(const CaptureRequest &request, const QString &fileName, QString &errorInfo);
+    void setState(const QString &id, JobState state, const QString &errorInfo = QString());
+    void removeExpiredJobs(qint64 now);
+};
+
+#endif // CAPTURESERVICE_H
@@ -0,0 +1,170 @@
+#include "dlnamediaindex.h"
+#include "dlnamediaitem.h"
+#include "dlnasearchcriteria.h"
+#include "globalobjects.h"
+#include "Play/Playlist/playlist.h"
+#include <QtConcurrent>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QFileInfo>
+
+DLNAMediaIndex::DLNAMediaIndex() : indexedVersion(0), generation(0), lastRefresh(0), refreshing(false), refreshPending(false)
+{
+    // one refresh at a time, stat calls on a slow mount should not pile up
+    refreshPool.setMaxThreadCount(1);
+}
+
+DLNAMediaIndex::~DLNAMediaIndex()
+{
+    refreshPool.waitForDone();
+}
+
+QSharedPointer<const PlayListSnapshot> DLNAMediaIndex::snapshot()
+{
+    QSharedPointer<const PlayListSnapshot> current = GlobalObjects::playlist->snapshot();
+    QMutexLocker locker(&lock);
+    bool needRefresh = false;
+    if(current->version != indexedVersion)
+    {
+        indexedVersion = current->version;
+        fragments.clear();
+        ++generation;
+        needRefresh = true;
+    }
+    else if(QDateTime::currentMSecsSinceEpoch() - lastRefresh > refreshInterval)
+    {
+        needRefresh = !refreshing;
+    }
+    if(needRefresh)
+    {
+        if(refreshing)
+        {
+            refreshPending = true;
+        }
+        else
+        {
+            refreshing = true;
+            QtConcurrent::run(&refreshPool, [this](){
+                refresh();
+            });
+        }
+    }
+    return current;
+}
+
+QByteArray DLNAMediaIndex::didlFragment(const PlayListSnapshot &snapshot, const PlayListSnapshot::Node *node, const QString &baseUrl, quint32 mask)
+{
+    const QString key = QString("%1|%2|%3").arg(node->id, QString::number(mask, 16), baseUrl);
+    // fragments only belong to the latest snapshot
+    bool cacheable;
+    quint64 fragmentGeneration;
+    {
+        QMutexLocker locker(&lock);
+        cacheable = snapshot.version == indexedVersion;
+        auto iter = fragments.constFind(key);
+        if(cacheable && iter != fragments.cend()) return iter.value();
+        fragmentGeneration = generation;
+    }
+    DLNAMediaItem mediaItem;
+    mediaItem.title = node->title;
+    mediaItem.objID = node->id;
+    mediaItem.parentID = node->parent < 0? "-1" : snapshot.nodes[node->parent].id;
+    mediaItem.type = node->isCollection? DLNAMediaItem::Container : DLNAMediaItem::Item;
+    mediaItem.childSize = node->children.size();
+    if(mediaItem.type == DLNAMediaItem::Item)
+    {
+        const MediaInfo info = mediaInfo(node->path);
+        const QString pathHash = node->pathHash.isEmpty()? QString(QCryptographicHash::hash(node->path.toUtf8(), QCryptographicHash::Md5).toHex()) : node->pathHash;
+        mediaItem.fileSize = info.fileSize;
+        mediaItem.setResource(node->path, pathHash, info.mimeType, baseUrl);
+    }
+    const QByteArray fragment = mediaItem.toDidl(mask);
+    QMutexLocker locker(&lock);
+    // a refresh in the meantime may have changed the file info
+    if(cacheable && fragmentGeneration == generation)
+    {
+        if(fragments.size() >= maxFragments) fragments.clear();
+        fragments.insert(key, fragment);
+    }
+    return fragment;
+}
+
+QVector<const PlayListSnapshot::Node *> DLNAMediaIndex::search(const PlayListSnapshot &snapshot, const PlayListSnapshot::Node *container, const DLNASearchCriteria &criteria)
+{
+    QVector<const PlayListSnapshot::Node *> result;
+    QVector<int> stack(container->children.crbegin(), container->children.crend());
+    while(!stack.isEmpty())
+    {
+        const PlayListSnapshot::Node *node = &snapshot.nodes[stack.takeLast()];
+        if(criteria.match(node->title, upnpClass(node))) result.append(node);
+        for(auto iter = node->children.crbegin(); iter != node->children.crend(); ++iter)
+        {
+            stack.append(*iter);
+        }
+    }
+    return result;
+}
+
+QString DLNAMediaIndex::upnpClass(const PlayListSnapshot::Node *node)
+{
+    return node->isCollection? "object.container.playlistContainer" : "object.item.videoItem";
+}
+
+void DLNAMediaIndex::refresh()
+{
+    bool again = true;
+    while(again)
+    {
+        QSharedPointer<const PlayListSnapshot> current = GlobalObjects::playlist->snapshot();
+        QHash<QString, MediaInfo> known;
+        {
+            QMutexLocker locker(&lock);
+            known = media;
+        }
+        const qint64 now = QDateTime::currentMSecsSinceEpoch();
+        QHash<QString, MediaInfo> updated;
+        updated.reserve(known.size());
+        bool changed = false;
+        for(const PlayListSnapshot::Node &node : current->nodes)
+        {
+            if(node.isCollection || node.type != PlayListItem::LOCAL_FILE || updated.contains(node.path)) continue;
+            auto iter = known.constFind(node.path);
+            if(iter != known.cend() && now - iter->checkTime < refreshInterval)
+            {
+                updated.insert(node.path, iter.value());
+                continue;
+            }
+            MediaInfo info;
+            const QFileInfo fileInfo(node.path);
+            info.fileSize = fileInfo.exists()? fileInfo.size() : -1;
+            info.mimeType = database.mimeTypeForFile(node.path, QMimeDatabase::MatchExtension).name();
+            info.checkTime = now;
+            if(iter == known.cend() || iter->fileSize != info.fileSize || iter->mimeType != info.mimeType) changed = true;
+            updated.insert(node.path, info);
+        }
+        QMutexLocker locker(&lock);
+        media.swap(updated);
+        if(changed)
+        {
+            fragments.clear();
+            ++generation;
+        }
+        lastRefresh = now;
+        again = refreshPending;
+        refreshPending = false;
+        refreshing = again;
+    }
+}
+
+DLNAMediaIndex::MediaInfo DLNAMediaIndex::mediaInfo(const QString &path)
+{
+    {
+        QMutexLocker locker(&lock);
+        auto iter = media.constFind(path);
+        if(iter != media.cend()) return iter.value();
+    }
+    // not checked yet, the extension is enough for the mime type
+    MediaInfo info;
+    info.mimeType = database.mimeTypeForFile(path, QMimeDatabase::MatchExtension).name();
+    return info;
+}
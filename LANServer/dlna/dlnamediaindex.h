@@ -0,0 +1,57 @@
+#ifndef DLNAMEDIAINDEX_H
+#define DLNAMEDIAINDEX_H
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QMimeDatabase>
+#include "Play/Playlist/playlistsnapshot.h"
+class DLNASearchCriteria;
+
+/*
+ * Index of the playlist for the DLNA media server.
+ * File sizes and mime types of the media are refreshed in the background, so a browse request never waits for
+ * the disk (items not checked yet are listed without size). The index follows the playlist snapshot:
+ * a new snapshot version starts a refresh and drops the DIDL fragments cached for the objects.
+ * Thread-safe, used by the workers of the http server.
+ */
+class DLNAMediaIndex
+{
+public:
+    struct MediaInfo
+    {
+        qint64 fileSize = -1;
+        QString mimeType;
+        qint64 checkTime = 0;
+    };
+
+    DLNAMediaIndex();
+    ~DLNAMediaIndex();
+
+    // current snapshot of the playlist, object ids of DLNA are the node ids
+    QSharedPointer<const PlayListSnapshot> snapshot();
+    // <item>/<container> element of the node, baseUrl: http://<local address>:<port>
+    QByteArray didlFragment(const PlayListSnapshot &snapshot, const PlayListSnapshot::Node *node, const QString &baseUrl, quint32 mask);
+    // matching nodes in the subtree of container, in playlist order
+    QVector<const PlayListSnapshot::Node *> search(const PlayListSnapshot &snapshot, const PlayListSnapshot::Node *container, const DLNASearchCriteria &criteria);
+
+    static QString upnpClass(const PlayListSnapshot::Node *node);
+
+private:
+    static const int refreshInterval = 5 * 60 * 1000;  // ms
+    static const int maxFragments = 8192;
+
+    QMutex lock;
+    QThreadPool refreshPool;
+    QMimeDatabase database;
+    QHash<QString, MediaInfo> media;
+    QHash<QString, QByteArray> fragments;
+    quint64 indexedVersion, generation;
+    qint64 lastRefresh;
+    bool refreshing, refreshPending;
+
+    void refresh();
+    MediaInfo mediaInfo(const QString &path);
+};
+
+#endif // DLNAMEDIAINDEX_H
@@ -1,7 +1,5 @@
 #include "dlnamediaitem.h"
 #include <QXmlStreamWriter>
-#include <QMimeDatabase>
-#include <QCryptographicHash>
 
 namespace
 {
@@ -83,46 +81,45 @@ static QHash<QString, quint32> filterMask = {
     {"*",                        0xFFFFFFFF}
 };
 }
-void DLNAMediaItem::toDidl(QXmlStreamWriter &writer, quint32 mask) const
+QByteArray DLNAMediaItem::toDidl(quint32 mask) const
 {
+    QByteArray buffer;
+    QXmlStreamWriter writer(&buffer);
     writer.writeStartElement(type == Container? "container" : "item");
     writer.writeAttribute("id", objID);
     writer.writeAttribute("parentID", parentID);
     writer.writeAttribute("restricted", "1");
     if(type == Container)
     {
-        if(mask & MASK_SEARCHABLE) writer.writeAttribute("searchable", "0");
-        if(mask & MASK_CHILDCOUNT) writer.writeAttribute("childCount", QString(childSize));
+        if(mask & MASK_SEARCHABLE) writer.writeAttribute("searchable", "1");
+        if(mask & MASK_CHILDCOUNT) writer.writeAttribute("childCount", QString::number(childSize));
     }
-    writer.writeTextElement("http://purl.org/dc/elements/1.1/", "title", title);
-    if(mask & MASK_CREATOR) writer.writeTextElement("http://purl.org/dc/elements/1.1/", "creator", "Unknown");
-    if(mask & MASK_DATE) writer.writeTextElement("http://purl.org/dc/elements/1.1/", "date", "");
-    if(mask & MASK_GENRE) writer.writeTextElement("urn:schemas-upnp-org:metadata-1-0/upnp/", "genre", "Unknown");
+    writer.writeTextElement("dc:title", title);
+    if(mask & MASK_CREATOR) writer.writeTextElement("dc:creator", "Unknown");
+    if(mask & MASK_DATE) writer.writeTextElement("dc:date", "");
+    if(mask & MASK_GENRE) writer.writeTextElement("upnp:genre", "Unknown");
 
     if(type == Item)
     {
         if(mask & MASK_RES)
         {
             writer.writeStartElement("res");
-            if(mask & MASK_RES_SIZE) writer.writeAttribute("size", QString::number(fileSize));
+            if((mask & MASK_RES_SIZE) && fileSize >= 0) writer.writeAttribute("size", QString::number(fileSize));
             writer.writeAttribute("protocolInfo", protocolInfo);
             writer.writeCharacters(url);
             writer.writeEndElement();
         }
     }
-    writer.writeTextElement("urn:schemas-upnp-org:metadata-1-0/upnp/", "class",
-                            type == Item ? "object.item.videoItem" : "object.container.playlistContainer");
+    writer.writeTextElement("upnp:class", type == Item ? "object.item.videoItem" : "object.container.playlistContainer");
     writer.writeEndElement();
+    return buffer;
 }
 
-void DLNAMediaItem::setResource(const QString &path, const QHostAddress &localAddress, quint16 port)
+void DLNAMediaItem::setResource(const QString &path, const QString &pathHash, const QString &mimeName, const QString &baseUrl)
 {
-    static QMimeDatabase database;
-    QString mimeName = database.mimeTypeForFile(path).name();
     protocolInfo = QString("http-get:*:%1:%2").arg(mimeName, dlnaExtMap.value(mimeName, "*"));
-    QString pathHash(QCryptographicHash::hash(path.toUtf8(),QCryptographicHash::Md5).toHex());
     QString suffix = path.mid(path.lastIndexOf('.') + 1);
-    url = QString("http://%1:%2/media/%3.%4").arg(localAddress.toString(), QString::number(port), pathHash, suffix);
+    url = QString("%1/media/%2.%3").arg(baseUrl, pathHash, suffix);
 }
 
 quint32 DLNAMediaItem::getMask(const QString &filter)
@@ -1,9 +1,7 @@
 #ifndef DLNAMEDIAITEM_H
 #define DLNAMEDIAITEM_H
 #include <QString>
-#include <QHostAddress>
 
-class QXmlStreamWriter;
 struct DLNAMediaItem
 {
     enum ClassType
@@ -15,12 +13,14 @@ struct DLNAMediaItem
     QString parentID;
     QString title;
     int childSize = 0;
-    qint64 fileSize = 0;
+    qint64 fileSize = -1;  // -1: unknown, the size attribute is left out
 
     QString protocolInfo;
     QString url;
-    void toDidl(QXmlStreamWriter &writer, quint32 mask) const;
-    void setResource(const QString &path, const QHostAddress &localAddress, quint16 port);
+    // <item> or <container> element, the dc/upnp prefixes are declared by the enclosing DIDL-Lite element
+    QByteArray toDidl(quint32 mask) const;
+    // baseUrl: http://<local address>:<port>
+    void setResource(const QString &path, const QString &pathHash, const QString &mimeName, const QString &baseUrl);
 
     static quint32 getMask(const QString &filter);
 };
@@ -1,8 +1,10 @@
 #include "dlnamediaserver.h"
 #include <QSysInfo>
 #include "dlnamediaitem.h"
+#include "dlnasearchcriteria.h"
 #include "Common/threadtask.h"
 #include "Common/logger.h"
+#include "Common/metrics.h"
 #include "globalobjects.h"
 #include "Play/Playlist/playlist.h"
 
@@ -26,6 +28,7 @@ void DLNAMediaServer::onAction(UPnPAction &action, stefanfrings::HttpRequest &re
     using Func = void(DLNAMediaServer::*)(UPnPAction &, stefanfrings::HttpRequest &, stefanfrings::HttpResponse &);
     static QMap<QString, Func> actionTable = {
         {"Browse", &DLNAMediaServer::onBrowse},
+        {"Search", &DLNAMediaServer::onSearch},
         {"GetSystemUpdateID", &DLNAMediaServer::onGetSystemUpdateID},
         {"GetSortCapabilities", &DLNAMediaServer::onGetSortCapabilities},
         {"GetSearchCapabilities", &DLNAMediaServer::onGetSearchCapabilities},
@@ -36,12 +39,14 @@ void DLNAMediaServer::onAction(UPnPAction &action, stefanfrings::HttpRequest &re
     auto actionFunc = actionTable.value(action.desc.name, nullptr);
     if(!actionFunc)
     {
+        Metrics::instance()->add("kikoplay_dlna_actions_total", 1, {"unknown", "invalid"});
         response.setStatus(stefanfrings::HttpResponse::BadRequest);
         return;
     }
     response.setHeader("Content-Type", "text/xml; charset=\"utf-8\"");
     response.setHeader("Server", this->server);
     (this->*actionFunc)(action, request, response);
+    Metrics::instance()->add("kikoplay_dlna_actions_total", 1, {action.desc.name, QString::number(action.errCode)});
     Logger::logger()->log(Logger::LANServer, QString("[DLNA][%1]OnAction: %2, status: %3").arg(request.getPeerAddress().toString(), action.desc.name, QString::number(action.errCode)));
 }
 
@@ -70,6 +75,8 @@ void DLNAMediaServer::initContentDirectoryService()
     UPnPStateVariable &svArgUpdateID = contentDirectory.addStateVariable("A_ARG_TYPE_UpdateID", "ui4");
     UPnPStateVariable &svArgResult = contentDirectory.addStateVariable("A_ARG_TYPE_Result", "string");
     UPnPStateVariable &svSearchCapabilities = contentDirectory.addStateVariable("SearchCapabilities", "string");
+    svSearchCapabilities.value = "dc:title,upnp:class";
+    UPnPStateVariable &svArgSearchCriteria = contentDirectory.addStateVariable("A_ARG_TYPE_SearchCriteria", "string");
     UPnPStateVariable &svFilter = contentDirectory.addStateVariable("A_ARG_TYPE_Filter", "string");
 
     UPnPActionDesc &adBrowse = contentDirectory.addActionDesc("Browse");
@@ -84,6 +91,18 @@ void DLNAMediaServer::initContentDirectoryService()
     adBrowse.addArgDesc("TotalMatches", svArgCount, UPnPArgDesc::OUT);
     adBrowse.addArgDesc("UpdateID", svArgUpdateID, UPnPArgDesc::OUT);
 
+    UPnPActionDesc &adSearch = contentDirectory.addActionDesc("Search");
+    adSearch.addArgDesc("ContainerID", svArgObjID, UPnPArgDesc::IN);
+    adSearch.addArgDesc("SearchCriteria", svArgSearchCriteria, UPnPArgDesc::IN);
+    adSearch.addArgDesc("Filter", svFilter, UPnPArgDesc::IN);
+    adSearch.addArgDesc("StartingIndex", svArgIndex, UPnPArgDesc::IN);
+    adSearch.addArgDesc("RequestedCount", svArgCount, UPnPArgDesc::IN);
+    adSearch.addArgDesc("SortCriteria", svArgSortCriteria, UPnPArgDesc::IN);
+    adSearch.addArgDesc("Result", svArgResult, UPnPArgDesc::OUT);
+    adSearch.addArgDesc("NumberReturned", svArgCount, UPnPArgDesc::OUT);
+    adSearch.addArgDesc("TotalMatches", svArgCount, UPnPArgDesc::OUT);
+    adSearch.addArgDesc("UpdateID", svArgUpdateID, UPnPArgDesc::OUT);
+
     UPnPActionDesc &adGetSortCaps = contentDirectory.addActionDesc("GetSortCapabilities");
     adGetSortCaps.addArgDesc("SortCaps", svSortCapabilities, UPnPArgDesc::OUT);
 
@@ -156,6 +175,51 @@ void DLNAMediaServer::onBrowse(UPnPAction &action, stefanfrings::HttpRequest &re
         action.errCode = 402;
         action.errDesc = "Invalid args";
     }
+    writeActionResponse(action, response);
+}
+
+void DLNAMediaServer::onSearch(UPnPAction &action, stefanfrings::HttpRequest &request, stefanfrings::HttpResponse &response)
+{
+    QString containerId = action.argMap["ContainerID"]->val;
+    int startIndex = action.argMap["StartingIndex"]->val.toInt();
+    int requestCount = action.argMap["RequestedCount"]->val.toInt();
+    DLNASearchCriteria criteria;
+    if(containerId.isEmpty() || startIndex < 0 || requestCount < 0)
+    {
+        action.errCode = 402;
+        action.errDesc = "Invalid args";
+    }
+    else if(!criteria.parse(action.argMap["SearchCriteria"]->val))
+    {
+        action.errCode = 708;
+        action.errDesc = "Unsupported or invalid search criteria";
+    }
+    else
+    {
+        QSharedPointer<const PlayListSnapshot> snapshot = mediaIndex.snapshot();
+        const PlayListSnapshot::Node *container = snapshot->node(containerId);
+        if(!container || !container->isCollection)
+        {
+            action.errCode = 710;
+            action.errDesc = "No such container";
+        }
+        else
+        {
+            const QVector<const PlayListSnapshot::Node *> matches = mediaIndex.search(*snapshot, container, criteria);
+            QString filter = action.argMap["Filter"]->val;
+            const int returned = writePage(action, *snapshot, matches, startIndex, requestCount, baseUrl(response), DLNAMediaItem::getMask(filter));
+            // the number of all matches, whatever the page
+            action.setArg("TotalMatches", QString::number(matches.size()));
+            Logger::logger()->log(Logger::LANServer, QString("[DLNA][%1]Search: %2, criteria: %3, matches: %4, returned: %5")
+                                  .arg(request.getPeerAddress().toString(), snapshot->fullPath(container), action.argMap["SearchCriteria"]->val,
+                                       QString::number(matches.size()), QString::number(returned)));
+        }
+    }
+    writeActionResponse(action, response);
+}
+
+void DLNAMediaServer::writeActionResponse(UPnPAction &action, stefanfrings::HttpResponse &response)
+{
     QByteArray resposeBuffer;
     if(action.errCode != 0)
     {
@@ -212,17 +276,22 @@ void DLNAMediaServer::onGetCurrentConnectionInfo(UPnPAction &action, stefanfring
     setDefaultActionResponse(action, response);
 }
 
-void DLNAMediaServer::writeDIDL(QByteArray &buffer, const QVector<DLNAMediaItem> &mediaItems, quint32 mask)
+void DLNAMediaServer::writeDIDL(QByteArray &buffer, const QVector<QByteArray> &fragments)
 {
-    QXmlStreamWriter writer(&buffer);
-    writer.writeStartElement("DIDL-Lite");
-    writer.writeDefaultNamespace("urn:schemas-upnp-org:metadata-1-0/DIDL-Lite/");
-    writer.writeNamespace("http://purl.org/dc/elements/1.1/", "dc");
-    writer.writeNamespace("urn:schemas-upnp-org:metadata-1-0/upnp/", "upnp");
-    writer.writeNamespace("urn:schemas-dlna-org:metadata-1-0/", "dlna");
-    for(const DLNAMediaItem &item : mediaItems)
-        item.toDidl(writer, mask);
-    writer.writeEndElement();
+    // the fragments come from the index, so the envelope is written by hand
+    buffer.append("<DIDL-Lite xmlns=\"urn:schemas-upnp-org:metadata-1-0/DIDL-Lite/\" "
+                  "xmlns:dc=\"http://purl.org/dc/elements/1.1/\" "
+                  "xmlns:upnp=\"urn:schemas-upnp-org:metadata-1-0/upnp/\" "
+                  "xmlns:dlna=\"urn:schemas-dlna-org:metadata-1-0/\">");
+    for(const QByteArray &fragment : fragments)
+        buffer.append(fragment);
+    buffer.append("</DIDL-Lite>");
+}
+
+QString DLNAMediaServer::baseUrl(stefanfrings::HttpResponse &response) const
+{
+    quint16 port = GlobalObjects::appSetting->value("Server/Port", 8000).toUInt();
+    return QString("http://%1:%2").arg(response.getLocalAddress().toString(), QString::number(port));
 }
 
 void DLNAMediaServer::onBrowseMeta(UPnPAction &action, stefanfrings::HttpRequest &request, stefanfrings::HttpResponse &response)
@@ -234,52 +303,26 @@ void DLNAMediaServer::onBrowseMeta(UPnPAction &action, stefanfrings::HttpRequest
         action.errDesc = "Invalid args";
         return;
     }
-    DLNAMediaItem mediaItem;
-    QString filePath;
-    bool pathErr = false;
-    QMetaObject::invokeMethod(GlobalObjects::playlist, [&]()->bool{
-        const PlayListItem *item = GlobalObjects::playlist->getPathItem(objId);
-        if(!item) return true;
-        mediaItem.title = item->parent? item->title : "Root";
-        mediaItem.objID = objId;
-        mediaItem.type = item->children? DLNAMediaItem::Container : DLNAMediaItem::Item;
-        mediaItem.childSize = item->children? item->children->size() : 0;
-        mediaItem.parentID = "-1";
-        if(objId != "0")
-        {
-            int sepPos = objId.lastIndexOf('_');
-            assert(sepPos != -1);
-            mediaItem.parentID = objId.mid(0, sepPos);
-        }
-        filePath = mediaItem.type == DLNAMediaItem::Item? item->path : "";
-        return false;
-    },Qt::BlockingQueuedConnection, &pathErr);
-    if(pathErr)
+    QSharedPointer<const PlayListSnapshot> snapshot = mediaIndex.snapshot();
+    const PlayListSnapshot::Node *node = snapshot->node(objId);
+    if(!node)
     {
         action.errCode = 800;
         action.errDesc = "Internal error";
         return;
     }
-    if(mediaItem.type == DLNAMediaItem::Item)
-    {
-        quint16 port = GlobalObjects::appSetting->value("Server/Port", 8000).toUInt();
-        mediaItem.setResource(filePath, response.getLocalAddress(), port);
-        QFileInfo info(filePath);
-        mediaItem.fileSize = info.size();
-    }
     QByteArray result;
     QString filter = action.argMap["Filter"]->val;
-    writeDIDL(result, {mediaItem}, DLNAMediaItem::getMask(filter));
+    writeDIDL(result, {mediaIndex.didlFragment(*snapshot, node, baseUrl(response), DLNAMediaItem::getMask(filter))});
     action.setArg("Result", result);
     action.setArg("NumberReturned", "1");
     action.setArg("TotalMatches", "1");
     action.setArg("UpdateID", "1");
-    Logger::logger()->log(Logger::LANServer, QString("[DLNA][%1]BrowseMeta: %2, filter: %3").arg(request.getPeerAddress().toString(), mediaItem.title, filter));
+    Logger::logger()->log(Logger::LANServer, QString("[DLNA][%1]BrowseMeta: %2, filter: %3").arg(request.getPeerAddress().toString(), node->title, filter));
 }
 
 void DLNAMediaServer::onBrowseDirectChildren(UPnPAction &action, stefanfrings::HttpRequest &request, stefanfrings::HttpResponse &response)
 {
-    Q_UNUSED(request);
     QString objId = action.argMap["ObjectID"]->val;
     if(objId.isEmpty())
     {
@@ -287,76 +330,53 @@ void DLNAMediaServer::onBrowseDirectChildren(UPnPAction &action, stefanfrings::H
         action.errDesc = "Invalid args";
         return;
     }
-    QVector<DLNAMediaItem> mediaItems;
-    QVector<QString> filePaths;
-    bool pathErr = false;
     int startIndex = action.argMap["StartingIndex"]->val.toInt();
     int requestCount = action.argMap["RequestedCount"]->val.toInt();
-    int totalMatches = 0;
     if(startIndex < 0 || requestCount < 0)
     {
         action.errCode = 402;
         action.errDesc = "Invalid args";
         return;
     }
-    QString fullPath;
-    QMetaObject::invokeMethod(GlobalObjects::playlist, [&]()->bool{
-        const PlayListItem *item = GlobalObjects::playlist->getPathItem(objId);
-        if(!item || !item->children) return true;
-        QStringList pathStack;
-        const PlayListItem *tmpItem = item;
-        while(tmpItem)
-        {
-            pathStack.push_front(tmpItem->title);
-            tmpItem = tmpItem->parent;
-        }
-        fullPath = pathStack.join('/');
-        if(objId == "0") fullPath = "/";
-        const QVector<PlayListItem *> &children = *item->children;
-        totalMatches = children.size();
-        if (children.size() == 0 || startIndex >= children.size()) return false;
-        totalMatches = children.size() - startIndex;
-        int endIndex = requestCount == 0? children.size() : startIndex + requestCount;
-        endIndex = qMin(endIndex, children.size());
-        mediaItems.reserve(endIndex - startIndex);
-        filePaths.reserve(endIndex - startIndex);
-        for(int i = startIndex; i < endIndex; ++i)
-        {
-            mediaItems.append(DLNAMediaItem());
-            DLNAMediaItem &curItem = mediaItems.back();
-            curItem.title = children[i]->title;
-            curItem.objID = objId + "_" + QString::number(i);
-            curItem.type = children[i]->children? DLNAMediaItem::Container : DLNAMediaItem::Item;
-            curItem.parentID = objId;
-            filePaths.append(curItem.type == DLNAMediaItem::Item? children[i]->path : "");
-        }
-        return false;
-    },Qt::BlockingQueuedConnection, &pathErr);
-    if(pathErr)
+    QSharedPointer<const PlayListSnapshot> snapshot = mediaIndex.snapshot();
+    const PlayListSnapshot::Node *node = snapshot->node(objId);
+    if(!node || !node->isCollection)
     {
         action.errCode = 800;
         action.errDesc = "Internal error";
         return;
     }
-    quint16 port = GlobalObjects::appSetting->value("Server/Port", 8000).toUInt();
-    for(int i = 0; i < mediaItems.size(); ++i)
+    QVector<const PlayListSnapshot::Node *> children;
+    children.reserve(node->children.size());
+    for(int i = 0; i < node->children.size(); ++i)
+        children.append(snapshot->child(node, i));
+    QString filter = action.argMap["Filter"]->val;
+    const int returned = writePage(action, *snapshot, children, startIndex, requestCount, baseUrl(response), DLNAMediaItem::getMask(filter));
+    // browsing has always counted the children from the start index on
+    action.setArg("TotalMatches", QString::number(startIndex < children.size()? children.size() - startIndex : children.size()));
+    Logger::logger()->log(Logger::LANServer, QString("[DLNA][%1]BrowseDirectChildren: %2, filter: %3, start: %4, requset count: %5, returned: %6")
+                          .arg(request.getPeerAddress().toString(), snapshot->fullPath(node), filter, QString::number(startIndex), QString::number(requestCount), QString::number(returned)));
+}
+
+int DLNAMediaServer::writePage(UPnPAction &action, const PlayListSnapshot &snapshot, const QVector<const PlayListSnapshot::Node *> &nodes,
+                               int startIndex, int requestCount, const QString &baseUrl, quint32 mask)
+{
+    const int count = nodes.size();
+    QVector<QByteArray> fragments;
+    if(count > 0 && startIndex < count)
     {
-        if(mediaItems[i].type == DLNAMediaItem::Item)
-        {
-            mediaItems[i].setResource(filePaths[i], response.getLocalAddress(), port);
-            QFileInfo info(filePaths[i]);
-            mediaItems[i].fileSize = info.size();
-        }
+        int endIndex = requestCount == 0? count : startIndex + requestCount;
+        endIndex = qMin(endIndex, count);
+        fragments.reserve(endIndex - startIndex);
+        for(int i = startIndex; i < endIndex; ++i)
+            fragments.append(mediaIndex.didlFragment(snapshot, nodes[i], baseUrl, mask));
     }
     QByteArray result;
-    QString filter = action.argMap["Filter"]->val;
-    writeDIDL(result, mediaItems, DLNAMediaItem::getMask(filter));
+    writeDIDL(result, fragments);
     action.setArg("Result", result);
-    action.setArg("NumberReturned", QString::number(mediaItems.size()));
-    action.setArg("TotalMatches", QString::number(totalMatches));
+    action.setArg("NumberReturned", QString::number(fragments.size()));
     action.setArg("UpdateID", "1");
-    Logger::logger()->log(Logger::LANServer, QString("[DLNA][%1]BrowseDirectChildren: %2, filter: %3, start: %4, requset count: %5")
-                          .arg(request.getPeerAddress().toString(), fullPath, filter, QString::number(startIndex), QString::number(requestCount)));
+    return fragments.size();
 }
 
 void DLNAMediaServer::setDefaultActionResponse(UPnPAction &action, stefanfrings::HttpResponse &response)
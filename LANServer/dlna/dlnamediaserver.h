@@ -2,11 +2,13 @@
 #define DLNAMEDIASERVER_H
 
 #include "upnpdevice.h"
-struct DLNAMediaItem;
+#include "dlnamediaindex.h"
 class DLNAMediaServer : public UPnPDevice
 {
 public:
     DLNAMediaServer();
+    // starts indexing the playlist before the first request
+    void refreshIndex() { mediaIndex.snapshot(); }
 
     // UPnPDevice interface
 protected:
@@ -16,6 +18,7 @@ private:
     void initConnectionManagerService();
 
     void onBrowse(UPnPAction &action, stefanfrings::HttpRequest& request, stefanfrings::HttpResponse& response);
+    void onSearch(UPnPAction &action, stefanfrings::HttpRequest& request, stefanfrings::HttpResponse& response);
     void onGetSystemUpdateID(UPnPAction &action, stefanfrings::HttpRequest& request, stefanfrings::HttpResponse& response);
     void onGetSortCapabilities(UPnPAction &action, stefanfrings::HttpRequest& request, stefanfrings::HttpResponse& response);
     void onGetSearchCapabilities(UPnPAction &action, stefanfrings::HttpRequest& request, stefanfrings::HttpResponse& response);
@@ -24,9 +27,15 @@ private:
     void onGetProtocolInfo(UPnPAction &action, stefanfrings::HttpRequest& request, stefanfrings::HttpResponse& response);
     void onGetCurrentConnectionInfo(UPnPAction &action, stefanfrings::HttpRequest& request, stefanfrings::HttpResponse& response);
 private:
-    void writeDIDL(QByteArray &buffer,  const QVector<DLNAMediaItem> &mediaItems, quint32 mask);
+    DLNAMediaIndex mediaIndex;
+
+    void writeDIDL(QByteArray &buffer, const QVector<QByteArray> &fragments);
+    QString baseUrl(stefanfrings::HttpResponse& response) const;
     void onBrowseMeta(UPnPAction &action, stefanfrings::HttpRequest& request, stefanfrings::HttpResponse& response);
     void onBrowseDirectChildren(UPnPAction &action, stefanfrings::HttpRequest& request, stefanfrings::HttpResponse& response);
+    int writePage(UPnPAction &action, const PlayListSnapshot &snapshot, const QVector<const PlayListSnapshot::Node *> &nodes,
+                  int startIndex, int requestCount, const QString &baseUrl, quint32 mask);
+    void writeActionResponse(UPnPAction &action, stefanfrings::HttpResponse& response);
     void setDefaultActionResponse(UPnPAction &action, stefanfrings::HttpResponse& response);
 };
 
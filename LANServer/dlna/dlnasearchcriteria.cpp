@@ -0,0 +1,196 @@
+#include "dlnasearchcriteria.h"
+
+bool DLNASearchCriteria::parse(const QString &criteria)
+{
+    exprs.clear();
+    tokens.clear();
+    pos = 0;
+    depth = 0;
+    terms = 0;
+    root = -1;
+    const QString trimmed = criteria.trimmed();
+    if(trimmed.isEmpty() || trimmed == "*")
+    {
+        exprs.append({Expr::All, QString(), QString(), QString()});
+        root = 0;
+        return true;
+    }
+    if(!tokenize(trimmed)) return false;
+    root = parseOr();
+    // trailing tokens are a syntax error too
+    if(root < 0 || pos != tokens.size())
+    {
+        root = -1;
+        return false;
+    }
+    return true;
+}
+
+bool DLNASearchCriteria::match(const QString &title, const QString &upnpClass) const
+{
+    return root >= 0 && eval(root, title, upnpClass);
+}
+
+bool DLNASearchCriteria::tokenize(const QString &criteria)
+{
+    // quoted values keep their quote as the first char, so they can't be confused with keywords
+    const QString opChars("=!<>");
+    int i = 0;
+    while(i < criteria.size())
+    {
+        const QChar c = criteria[i];
+        if(c.isSpace())
+        {
+            ++i;
+        }
+        else if(c == '(' || c == ')')
+        {
+            tokens.append(QString(c));
+            ++i;
+        }
+        else if(c == '"')
+        {
+            QString value("\"");
+            ++i;
+            bool closed = false;
+            while(i < criteria.size())
+            {
+                const QChar vc = criteria[i++];
+                if(vc == '\\' && i < criteria.size())
+                {
+                    value.append(criteria[i++]);
+                }
+                else if(vc == '"')
+                {
+                    closed = true;
+                    break;
+                }
+                else
+                {
+                    value.append(vc);
+                }
+            }
+            if(!closed) return false;
+            tokens.append(value);
+        }
+        else if(opChars.contains(c))
+        {
+            int start = i;
+            while(i < criteria.size() && opChars.contains(criteria[i])) ++i;
+            tokens.append(criteria.mid(start, i - start));
+        }
+        else
+        {
+            int start = i;
+            while(i < criteria.size() && !criteria[i].isSpace() && criteria[i] != '(' && criteria[i] != ')' &&
+                  criteria[i] != '"' && !opChars.contains(criteria[i])) ++i;
+            tokens.append(criteria.mid(start, i - start));
+        }
+    }
+    return !tokens.isEmpty();
+}
+
+int DLNASearchCriteria::parseOr()
+{
+    int left = parseAnd();
+    while(left >= 0 && pos < tokens.size() && tokens[pos].compare("or", Qt::CaseInsensitive) == 0)
+    {
+        ++pos;
+        int right = parseAnd();
+        if(right < 0) return -1;
+        exprs.append({Expr::Or, QString(), QString(), QString(), left, right});
+        left = exprs.size() - 1;
+    }
+    return left;
+}
+
+int DLNASearchCriteria::parseAnd()
+{
+    int left = parsePrimary();
+    while(left >= 0 && pos < tokens.size() && tokens[pos].compare("and", Qt::CaseInsensitive) == 0)
+    {
+        ++pos;
+        int right = parsePrimary();
+        if(right < 0) return -1;
+        exprs.append({Expr::And, QString(), QString(), QString(), left, right});
+        left = exprs.size() - 1;
+    }
+    return left;
+}
+
+int DLNASearchCriteria::parsePrimary()
+{
+    static const QStringList binOps{"=", "!=", "<", "<=", ">", ">=", "contains", "doesnotcontain", "derivedfrom"};
+    if(pos >= tokens.size()) return -1;
+    if(tokens[pos] == "(")
+    {
+        // each level recurses, too deep criteria are rejected like invalid ones
+        if(depth >= maxDepth) return -1;
+        ++pos;
+        ++depth;
+        int expr = parseOr();
+        --depth;
+        if(expr < 0 || pos >= tokens.size() || tokens[pos] != ")") return -1;
+        ++pos;
+        return expr;
+    }
+    // property op value
+    if(pos + 3 > tokens.size()) return -1;
+    // and/or chains are evaluated recursively, one level per term
+    if(++terms > maxTerms) return -1;
+    const QString property = tokens[pos];
+    const QString op = tokens[pos + 1].toLower();
+    const QString value = tokens[pos + 2];
+    if(property.startsWith('"')) return -1;
+    if(op == "exists")
+    {
+        const QString boolVal = value.toLower();
+        if(boolVal != "true" && boolVal != "false") return -1;
+        exprs.append({Expr::Relation, property, op, boolVal});
+    }
+    else
+    {
+        if(!binOps.contains(op) || !value.startsWith('"')) return -1;
+        exprs.append({Expr::Relation, property, op, value.mid(1)});
+    }
+    pos += 3;
+    return exprs.size() - 1;
+}
+
+bool DLNASearchCriteria::eval(int index, const QString &title, const QString &upnpClass) const
+{
+    const Expr &expr = exprs[index];
+    switch (expr.type)
+    {
+    case Expr::All:
+        return true;
+    case Expr::And:
+        return eval(expr.left, title, upnpClass) && eval(expr.right, title, upnpClass);
+    case Expr::Or:
+        return eval(expr.left, title, upnpClass) || eval(expr.right, title, upnpClass);
+    case Expr::Relation:
+        break;
+    }
+    const QString *propVal = nullptr;
+    if(expr.property == "dc:title") propVal = &title;
+    else if(expr.property == "upnp:class") propVal = &upnpClass;
+    if(expr.op == "exists") return (propVal != nullptr) == (expr.value == "true");
+    if(!propVal) return false;
+
+    const int cmp = propVal->compare(expr.value, Qt::CaseInsensitive);
+    if(expr.op == "=") return cmp == 0;
+    if(expr.op == "!=") return cmp != 0;
+    if(expr.op == "<") return cmp < 0;
+    if(expr.op == "<=") return cmp <= 0;
+    if(expr.op == ">") return cmp > 0;
+    if(expr.op == ">=") return cmp >= 0;
+    if(expr.op == "contains") return propVal->contains(expr.value, Qt::CaseInsensitive);
+    if(expr.op == "doesnotcontain") return !propVal->contains(expr.value, Qt::CaseInsensitive);
+    if(expr.op == "derivedfrom")
+    {
+        // object.item derives object.item.videoItem, but not object.itemX
+        return propVal->startsWith(expr.value, Qt::CaseInsensitive) &&
+               (propVal->size() == expr.value.size() || propVal->at(expr.value.size()) == '.');
+    }
+    return false;
+}
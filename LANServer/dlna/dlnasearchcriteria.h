@@ -0,0 +1,49 @@
+#ifndef DLNASEARCHCRITERIA_H
+#define DLNASEARCHCRITERIA_H
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/*
+ * SearchCriteria of the ContentDirectory Search action, e.g.
+ *   upnp:class derivedfrom "object.item.videoItem" and dc:title contains "tokyo"
+ * Supported properties are dc:title and upnp:class, with the operators
+ * =, !=, <, <=, >, >=, contains, doesNotContain, derivedfrom and exists, joined by and/or and parentheses.
+ * "*" matches everything. String comparisons are case-insensitive.
+ * Parentheses nest at most maxDepth levels, at most maxTerms relations are joined.
+ */
+class DLNASearchCriteria
+{
+public:
+    bool parse(const QString &criteria);
+    bool match(const QString &title, const QString &upnpClass) const;
+
+private:
+    struct Expr
+    {
+        enum Type
+        {
+            All, And, Or, Relation
+        };
+        Type type;
+        QString property;
+        QString op;
+        QString value;
+        int left = -1, right = -1;
+    };
+    QVector<Expr> exprs;
+    int root = -1;
+
+    static const int maxDepth = 32;
+    static const int maxTerms = 128;
+    QStringList tokens;
+    int pos = 0, depth = 0, terms = 0;
+
+    bool tokenize(const QString &criteria);
+    int parseOr();
+    int parseAnd();
+    int parsePrimary();
+    bool eval(int index, const QString &title, const QString &upnpClass) const;
+};
+
+#endif // DLNASEARCHCRITERIA_H
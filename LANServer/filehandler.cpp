@@ -1,6 +1,8 @@
 #include "filehandler.h"
 #include "globalobjects.h"
 #include "Play/Playlist/playlist.h"
+#include <QRegularExpression>
+#include <QDateTime>
 
 FileHandler::FileHandler(QObject *parent) : stefanfrings::HttpRequestHandler(parent)
 {
@@ -42,6 +44,7 @@ void FileHandler::service(stefanfrings::HttpRequest &request, stefanfrings::Http
            return;
         }
         if(path.trimmed().isEmpty()) path = "index.html";
+        if(assetCache.service(request, response, QString(path))) return;
         QString absolutePath = root.absoluteFilePath(path);
         QFileInfo(absolutePath).isDir() ? processDirectory(request, response, absolutePath) :
                                           processFile(request, response, absolutePath);
@@ -89,66 +92,95 @@ void FileHandler::processDirectory(stefanfrings::HttpRequest &request, stefanfri
 
 void FileHandler::processFile(stefanfrings::HttpRequest &request, stefanfrings::HttpResponse &response, const QString &path)
 {
-    QFile file(path);
-    if(!file.exists())
+    QFileInfo fileInfo(path);
+    if(!fileInfo.exists())
     {
         response.setStatus(stefanfrings::HttpResponse::NotFound);
         return;
     }
-    if (!file.open(QIODevice::ReadOnly))
+    if(!fileInfo.isReadable())
     {
         response.setStatus(stefanfrings::HttpResponse::InternalServerError);
         return;
     }
-    qint64 fileSize = file.size();
-    QByteArray rangeHeader = request.getHeader("Range");
-
-    bool rangeValid = false;
-    qint64 from = 0, to = fileSize - 1;
+    // the content is sent by the I/O thread of the connection, directly from the file
+    const qint64 fileSize = fileInfo.size();
+    const QByteArray rangeHeader = request.getHeader("Range");
+    const QByteArray mimeType = database.mimeTypeForFile(path).name().toUtf8();
 
+    QVector<QPair<qint64, qint64>> ranges;
     if (!rangeHeader.isEmpty() && rangeHeader.startsWith("bytes="))
     {
         // Skiping 'bytes=' - first 6 chars and spliting ranges by comma
-        QList<QByteArray> rangeList = rangeHeader.mid(6).split(',');
-        // Taking only first range, as multiple ranges require multipart
-        // reply support
-        rangeValid = getRange(QString(rangeList.at(0)), fileSize, from, to);
-        //emit message(QString("range request: %1-%2/%3, length=%4, %5").
-        //             arg(from).arg(to).arg(fileSize).arg(to-from+1).arg(rangeValid));
-        if(from >= fileSize)
+        const QList<QByteArray> rangeList = rangeHeader.mid(6).split(',');
+        for(const QByteArray &rangeStr : rangeList)
+        {
+            qint64 from, to;
+            if(getRange(QString(rangeStr), fileSize, from, to)) ranges.append({from, to});
+            if(ranges.size() >= maxRanges) break;
+        }
+        if(ranges.isEmpty())
         {
             response.setStatus(stefanfrings::HttpResponse::RequestedRangeNotSatisfiable);
+            response.setHeader("Content-Range", QByteArray("bytes */") + QByteArray::number(fileSize));
             return;
         }
     }
-    response.setHeader("Content-Type",  database.mimeTypeForFile(path).name().toUtf8());
     response.setHeader("Accept-Ranges", "bytes");
-    if(rangeValid)
+    Logger::logger()->log(Logger::LANServer, QString("[%1]Media%3: %2").arg(request.getPeerAddress().toString(), path, ranges.isEmpty()?"":"(Range)"));
+
+    if(ranges.size() > 1)
     {
+        // multipart/byteranges, the parts are written between the file ranges
+        const QByteArray boundary = QByteArray::number(QDateTime::currentMSecsSinceEpoch(), 16) + "_kiko_byteranges";
+        QVector<QByteArray> partHeads;
+        const QByteArray ending = "\r\n--" + boundary + "--\r\n";
+        qint64 contentLength = ending.size();
+        for(const auto &range : ranges)
+        {
+            QByteArray head = "\r\n--" + boundary + "\r\nContent-Type: " + mimeType +
+                    "\r\nContent-Range: bytes " + QByteArray::number(range.first) + '-' + QByteArray::number(range.second) +
+                    '/' + QByteArray::number(fileSize) + "\r\n\r\n";
+            contentLength += head.size() + range.second - range.first + 1;
+            partHeads.append(head);
+        }
         response.setStatus(stefanfrings::HttpResponse::PartialContent);
-        QString rangeStr = QString("%1-%2/%3").arg(QString::number(from), QString::number(to), QString::number(fileSize));
-        response.setHeader("Content-Range", QByteArray("bytes ") + rangeStr.toLatin1());
+        response.setHeader("Content-Type", "multipart/byteranges; boundary=" + boundary);
+        response.setHeader("Content-Length", QByteArray::number(contentLength));
+        for(int i = 0; i < ranges.size() && response.isConnected(); ++i)
+        {
+            response.write(partHeads[i]);
+            if(!response.writeFile(path, ranges[i].first, ranges[i].second - ranges[i].first + 1)) return;
+        }
+        response.write(ending, true);
+        return;
     }
-    Logger::logger()->log(Logger::LANServer, QString("[%1]Media%3: %2").arg(request.getPeerAddress().toString(), path, rangeValid?"(Range)":""));
 
-    file.seek(from);
-    // Return the file content, do not store in cache
-    while (!file.atEnd() && !file.error() && file.pos() <= to && response.isConnected())
+    qint64 from = 0, to = fileSize - 1;
+    response.setHeader("Content-Type", mimeType);
+    if(!ranges.isEmpty())
     {
-        qint64 blockSize = qMin<qint64>(65536, to - file.pos() + 1);
-        response.write(file.read(blockSize), file.atEnd());
+        from = ranges.first().first;
+        to = ranges.first().second;
+        response.setStatus(stefanfrings::HttpResponse::PartialContent);
+        QString rangeStr = QString("%1-%2/%3").arg(QString::number(from), QString::number(to), QString::number(fileSize));
+        response.setHeader("Content-Range", QByteArray("bytes ") + rangeStr.toLatin1());
     }
+    response.setHeader("Content-Length", QByteArray::number(to - from + 1));
+    response.writeFile(path, from, to - from + 1, true);
 }
 
 bool FileHandler::getRange(const QString &range, qint64 fileSize, qint64 &from, qint64 &to)
 {
-    static QRegExp regExp("^(\\d*)-(\\d*)$");
+    // workers run in parallel, QRegularExpression is safe to share
+    static const QRegularExpression regExp("^(\\d*)-(\\d*)$");
 
     from = 0, to = fileSize - 1;
-    if (regExp.indexIn(range.trimmed()) == -1) return false;
+    QRegularExpressionMatch match = regExp.match(range.trimmed());
+    if (!match.hasMatch()) return false;
 
-    QString fromStr = regExp.cap(1);
-    QString toStr = regExp.cap(2);
+    QString fromStr = match.captured(1);
+    QString toStr = match.captured(2);
 
     if (fromStr.isEmpty() && toStr.isEmpty()) return false;
 
@@ -164,10 +196,10 @@ bool FileHandler::getRange(const QString &range, qint64 fileSize, qint64 &from,
         to = fileSize - 1;
         if(from < 0) from = 0;
     }
-    else if(toStr.isEmpty())
+    else if(toStr.isEmpty() || to >= fileSize)
     {
         to = fileSize - 1;
     }
-    if(from > to) return false;
+    if(from > to || from >= fileSize) return false;
     return true;
 }
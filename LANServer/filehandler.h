@@ -2,6 +2,7 @@
 #define FILEHANDLER_H
 
 #include "httpserver/httprequesthandler.h"
+#include "staticassetcache.h"
 #include <QString>
 #include <QHash>
 #include <QDir>
@@ -14,10 +15,12 @@ class FileHandler : public stefanfrings::HttpRequestHandler
 public:
     FileHandler(QObject* parent = nullptr);
     void service(stefanfrings::HttpRequest& request, stefanfrings::HttpResponse& response);
-    void setRoot(const QString &path) {root.setPath(path);}
+    void setRoot(const QString &path) {root.setPath(path); assetCache.setRoot(path);}
 private:
     QDir root;
     QMimeDatabase database;
+    StaticAssetCache assetCache;
+    static const int maxRanges = 16;
 
     void processDirectory(stefanfrings::HttpRequest& request, stefanfrings::HttpResponse& response, const QString &path);
     void processFile(stefanfrings::HttpRequest& request, stefanfrings::HttpResponse& response, const QString &path);
@@ -0,0 +1,600 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#include "httpconnection.h"
+#include "httpconnectionmanager.h"
+#include "httpresponse.h"
+#include "Common/metrics.h"
+#ifndef QT_NO_SSL
+    #include <QSslSocket>
+#endif
+#ifdef Q_OS_LINUX
+    #include <sys/sendfile.h>
+    #include <errno.h>
+#endif
+
+using namespace stefanfrings;
+
+HttpConnection::HttpConnection(HttpConnectionManager* manager, const QSettings *settings, const QSslConfiguration* sslConfiguration)
+    : QObject(), connected(false), drainScheduled(false)
+{
+    Q_ASSERT(manager!=nullptr);
+    Q_ASSERT(settings!=nullptr);
+    this->manager=manager;
+    this->settings=settings;
+    this->sslConfiguration=sslConfiguration;
+    socket=nullptr;
+    readTimer=nullptr;
+    currentRequest=nullptr;
+    inService=false;
+    upgradeChecked=false;
+    responseFinished=false;
+    closeAfterResponse=false;
+    pumpScheduled=false;
+    queuedBytes=0;
+    socketBuffered=0;
+    unreportedBytes=0;
+}
+
+
+HttpConnection::~HttpConnection()
+{
+    delete currentRequest;
+    reportSentBytes();
+    manager->connectionClosed(this);
+#ifdef QT_DEBUG
+    Logger::logger()->log(Logger::LANServer, "HttpConnection (%p): destroyed", static_cast<void*>(this));
+#endif
+}
+
+
+void HttpConnection::createSocket()
+{
+    // If SSL is supported and configured, then create an instance of QSslSocket
+    #ifndef QT_NO_SSL
+        if (sslConfiguration)
+        {
+            QSslSocket* sslSocket=new QSslSocket(this);
+            sslSocket->setSslConfiguration(*sslConfiguration);
+            socket=sslSocket;
+#ifdef QT_DEBUG
+            Logger::logger()->log(Logger::LANServer, "HttpConnection (%p): SSL is enabled", static_cast<void*>(this));
+#endif
+            return;
+        }
+    #endif
+    // else create an instance of QTcpSocket
+    socket=new QTcpSocket(this);
+}
+
+
+bool HttpConnection::start(tSocketDescriptor socketDescriptor)
+{
+#ifdef QT_DEBUG
+    Logger::logger()->log(Logger::LANServer, "HttpConnection (%p): handle new connection", static_cast<void*>(this));
+#endif
+    createSocket();
+    if (!socket->setSocketDescriptor(socketDescriptor))
+    {
+        Logger::logger()->log(Logger::LANServer, "HttpConnection (%p): cannot initialize socket: %s",
+                  static_cast<void*>(this),qPrintable(socket->errorString()));
+        return false;
+    }
+    localAddress=socket->localAddress();
+    clientName=socket->peerAddress().toString();
+    connected=true;
+
+    connect(socket, &QTcpSocket::readyRead, this, &HttpConnection::read);
+    connect(socket, &QTcpSocket::disconnected, this, &HttpConnection::disconnected);
+    connect(socket, &QTcpSocket::bytesWritten, this, &HttpConnection::bytesWritten);
+
+    #ifndef QT_NO_SSL
+        // Switch on encryption, if SSL is configured
+        if (sslConfiguration)
+        {
+#ifdef QT_DEBUG
+            Logger::logger()->log(Logger::LANServer, "HttpConnection (%p): Starting encryption", static_cast<void*>(this));
+#endif
+            (static_cast<QSslSocket*>(socket))->startServerEncryption();
+        }
+    #endif
+
+    // Start timer for read timeout
+    readTimer=new QTimer(this);
+    readTimer->setSingleShot(true);
+    connect(readTimer, &QTimer::timeout, this, &HttpConnection::readTimeout);
+    readTimer->start(settings->value("readTimeout",10000).toInt());
+    return true;
+}
+
+
+void HttpConnection::readTimeout()
+{
+#ifdef QT_DEBUG
+    Logger::logger()->log(Logger::LANServer, "HttpConnection (%p): read timeout occured",static_cast<void*>(this));
+#endif
+
+    //Commented out because QWebView cannot handle this.
+    //socket->write("HTTP/1.1 408 request timeout\r\nConnection: close\r\n\r\n408 request timeout\r\n");
+
+    socket->disconnectFromHost();
+    delete currentRequest;
+    currentRequest=nullptr;
+}
+
+
+void HttpConnection::disconnected()
+{
+#ifdef QT_DEBUG
+    Logger::logger()->log(Logger::LANServer, "HttpConnection (%p): disconnected", static_cast<void*>(this));
+#endif
+    readTimer->stop();
+    setClosed();
+    sendQueue.clear();
+    // while a worker is still writing the response, finishRequest() deletes the connection
+    if (!inService)
+    {
+        deleteLater();
+    }
+}
+
+
+void HttpConnection::abort()
+{
+    setClosed();
+    sendQueue.clear();
+    if (socket)
+    {
+        socket->abort();
+    }
+}
+
+
+void HttpConnection::setClosed()
+{
+    QMutexLocker locker(&outputMutex);
+    connected=false;
+    outputQueue.clear();
+    queuedBytes=0;
+    socketBuffered=0;
+    outputDrained.wakeAll();
+}
+
+
+void HttpConnection::read()
+{
+    // The first line of a new connection may ask for another protocol, e.g. WebSocket.
+    // Such connections are passed to the request handler before any HTTP processing.
+    if (!upgradeChecked)
+    {
+        if (!socket->canReadLine() && socket->bytesAvailable()<upgradeLineLimit)
+        {
+            return;
+        }
+        upgradeChecked=true;
+        if (!sslConfiguration && manager->getRequestHandler()->acceptsUpgrade(socket->peek(upgradeLineLimit)))
+        {
+            upgrade();
+            return;
+        }
+    }
+    // Pipelined requests wait in the socket buffer until the current response is sent
+    while (!inService && !responseFinished && socket->bytesAvailable())
+    {
+        #ifdef SUPERVERBOSE
+            Logger::logger()->log(Logger::LANServer, "HttpConnection (%p): read input",static_cast<void*>(this));
+        #endif
+
+        // Create new HttpRequest object if necessary
+        if (!currentRequest)
+        {
+            currentRequest=new HttpRequest(settings);
+        }
+
+        // Collect data for the request object
+        while (socket->bytesAvailable() && currentRequest->getStatus()!=HttpRequest::complete && currentRequest->getStatus()!=HttpRequest::abort)
+        {
+            currentRequest->readFromSocket(socket);
+            if (currentRequest->getStatus()==HttpRequest::waitForBody)
+            {
+                // Restart timer for read timeout, otherwise it would
+                // expire during large file uploads.
+                readTimer->start(settings->value("readTimeout",10000).toInt());
+            }
+        }
+
+        // If the request is aborted, return error message and close the connection
+        if (currentRequest->getStatus()==HttpRequest::abort)
+        {
+            socket->write("HTTP/1.1 413 entity too large\r\nConnection: close\r\n\r\n413 Entity too large\r\n");
+            socket->disconnectFromHost();
+            delete currentRequest;
+            currentRequest=nullptr;
+            return;
+        }
+
+        // If the request is complete, pass it to a worker
+        if (currentRequest->getStatus()==HttpRequest::complete)
+        {
+            readTimer->stop();
+#ifdef QT_DEBUG
+            Logger::logger()->log(Logger::LANServer, "HttpConnection (%p): received request",static_cast<void*>(this));
+#endif
+            HttpRequest* request=currentRequest;
+            currentRequest=nullptr;
+            inService=true;
+            if (!manager->schedule(this, request))
+            {
+                inService=false;
+                delete request;
+                Logger::logger()->log(Logger::LANServer, "HttpConnection: Too many queued requests");
+                socket->write("HTTP/1.1 503 too many requests\r\nConnection: close\r\n\r\nToo many requests\r\n");
+                socket->disconnectFromHost();
+                return;
+            }
+        }
+    }
+}
+
+
+void HttpConnection::upgrade()
+{
+#ifdef QT_DEBUG
+    Logger::logger()->log(Logger::LANServer, "HttpConnection (%p): protocol upgrade", static_cast<void*>(this));
+#endif
+    readTimer->stop();
+    disconnect(socket, nullptr, this, nullptr);
+    QTcpSocket* upgradedSocket=socket;
+    socket=nullptr;
+    upgradedSocket->setParent(nullptr);
+    setClosed();
+    manager->getRequestHandler()->upgrade(upgradedSocket);
+    deleteLater();
+}
+
+
+void HttpConnection::process(HttpRequest *request, HttpRequestHandler *requestHandler)
+{
+    // Copy the Connection:close header to the response
+    HttpResponse response(this);
+    bool closeConnection=QString::compare(request->getHeader("Connection"),"close",Qt::CaseInsensitive)==0;
+    if (closeConnection)
+    {
+        response.setHeader("Connection","close");
+    }
+
+    // In case of HTTP 1.0 protocol add the Connection:close header.
+    // This ensures that the HttpResponse does not activate chunked mode, which is not spported by HTTP 1.0.
+    else
+    {
+        bool http1_0=QString::compare(request->getVersion(),"HTTP/1.0",Qt::CaseInsensitive)==0;
+        if (http1_0)
+        {
+            closeConnection=true;
+            response.setHeader("Connection","close");
+        }
+    }
+
+    // Call the request mapper
+    try
+    {
+        requestHandler->service(*request, response);
+    }
+    catch (...)
+    {
+        Logger::logger()->log(Logger::LANServer, "HttpConnection (%p): An uncatched exception occured in the request handler",
+                            static_cast<void*>(this));
+    }
+
+    // Finalize sending the response if not already done
+    if (!response.hasSentLastPart())
+    {
+        response.write(QByteArray(),true);
+    }
+#ifdef QT_DEBUG
+    Logger::logger()->log(Logger::LANServer, "HttpConnection (%p): finished request",static_cast<void*>(this));
+#endif
+
+    // Find out whether the connection must be closed
+    if (!closeConnection)
+    {
+        // Maybe the request handler or mapper added a Connection:close header in the meantime
+        bool closeResponse=QString::compare(response.getHeaders().value("Connection"),"close",Qt::CaseInsensitive)==0;
+        if (closeResponse==true)
+        {
+            closeConnection=true;
+        }
+        else
+        {
+            // If we have no Content-Length header and did not use chunked mode, then we have to close the
+            // connection to tell the HTTP client that the end of the response has been reached.
+            bool hasContentLength=response.getHeaders().contains("Content-Length");
+            if (!hasContentLength)
+            {
+                bool hasChunkedMode=QString::compare(response.getHeaders().value("Transfer-Encoding"),"chunked",Qt::CaseInsensitive)==0;
+                if (!hasChunkedMode)
+                {
+                    closeConnection=true;
+                }
+            }
+        }
+    }
+    delete request;
+    QMetaObject::invokeMethod(this, "finishRequest", Qt::QueuedConnection, Q_ARG(bool, closeConnection));
+}
+
+
+void HttpConnection::finishRequest(bool closeConnection)
+{
+    inService=false;
+    if (!connected)
+    {
+        deleteLater();
+        return;
+    }
+    // the output queue may still hold file ranges, the response is complete when they are sent
+    responseFinished=true;
+    closeAfterResponse=closeConnection;
+    drain();
+}
+
+
+void HttpConnection::completeResponse()
+{
+    responseFinished=false;
+    reportSentBytes();
+    // Close the connection or prepare for the next request on the same connection.
+    if (closeAfterResponse)
+    {
+        // pending output is still sent before the connection is closed
+        socket->disconnectFromHost();
+    }
+    else
+    {
+        // Start timer for next request
+        readTimer->start(settings->value("readTimeout",10000).toInt());
+        read();
+    }
+}
+
+
+bool HttpConnection::send(const QByteArray &data)
+{
+    OutputItem item;
+    item.data=data;
+    return enqueue(item);
+}
+
+
+bool HttpConnection::sendFile(const QString &path, qint64 offset, qint64 length)
+{
+    QSharedPointer<QFile> file(new QFile(path));
+    if (!file->open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+    OutputItem item;
+    item.file=file;
+    item.offset=offset;
+    item.length=length;
+    return enqueue(item);
+}
+
+
+bool HttpConnection::enqueue(const OutputItem &item)
+{
+    QMutexLocker locker(&outputMutex);
+    while (connected && queuedBytes+socketBuffered>highWaterMark)
+    {
+        outputDrained.wait(&outputMutex);
+    }
+    if (!connected)
+    {
+        return false;
+    }
+    outputQueue.append(item);
+    queuedBytes+=item.data.size();
+    locker.unlock();
+    if (!drainScheduled.exchange(true))
+    {
+        QMetaObject::invokeMethod(this, "drain", Qt::QueuedConnection);
+    }
+    return true;
+}
+
+
+void HttpConnection::drain()
+{
+    drainScheduled=false;
+    {
+        QMutexLocker locker(&outputMutex);
+        sendQueue.append(outputQueue);
+        outputQueue.clear();
+        queuedBytes=0;
+    }
+    pump();
+}
+
+
+void HttpConnection::pump()
+{
+    pumpScheduled=false;
+    qint64 budget=fileSendBudget;
+    while (connected && !sendQueue.isEmpty())
+    {
+        OutputItem& item=sendQueue.first();
+        if (!item.file)
+        {
+            if (socket->write(item.data)==-1)
+            {
+                socket->abort();
+                return;
+            }
+            sendQueue.removeFirst();
+            continue;
+        }
+        if (item.length>0 && !sendFileChunk(item, budget))
+        {
+            Logger::logger()->log(Logger::LANServer, "HttpConnection (%p): cannot send file %s",
+                                static_cast<void*>(this), qPrintable(item.file->fileName()));
+            socket->abort();
+            return;
+        }
+        if (item.length>0)
+        {
+            // go on when the socket buffer drains, or in the next turn of the event loop when the budget is used up
+            if (budget<=0 && !pumpScheduled)
+            {
+                pumpScheduled=true;
+                QMetaObject::invokeMethod(this, "pump", Qt::QueuedConnection);
+            }
+            break;
+        }
+        sendQueue.removeFirst();
+    }
+    if (!connected)
+    {
+        return;
+    }
+    updateSocketBuffered();
+    if (sendQueue.isEmpty() && responseFinished)
+    {
+        completeResponse();
+    }
+}
+
+
+bool HttpConnection::sendFileChunk(OutputItem &item, qint64 &budget)
+{
+    // a single small mapped chunk is enough to be notified by bytesWritten() when the kernel buffer drains
+    bool notifyOnly=false;
+#ifdef Q_OS_LINUX
+    if (!sslConfiguration && !item.mapOnly)
+    {
+        // data in the socket buffer has to go out before the file
+        if (socket->bytesToWrite()>0)
+        {
+            return true;
+        }
+        while (item.length>0 && budget>0)
+        {
+            off_t offset=item.offset;
+            const ssize_t sent=::sendfile(socket->socketDescriptor(), item.file->handle(), &offset,
+                                          size_t(qMin(item.length, qMin(budget, sendfileChunkSize))));
+            if (sent>0)
+            {
+                unreportedBytes+=sent;
+                item.offset+=sent;
+                item.length-=sent;
+                budget-=sent;
+            }
+            else if (sent<0 && errno==EINTR)
+            {
+                continue;
+            }
+            else if (sent<0 && (errno==EAGAIN || errno==EWOULDBLOCK))
+            {
+                notifyOnly=true;
+                break;
+            }
+            else if (sent==0)
+            {
+                // the file is shorter than announced
+                return false;
+            }
+            else
+            {
+                // sendfile is not supported for this file, e.g. on some network file systems
+                item.mapOnly=true;
+                break;
+            }
+        }
+        if (!notifyOnly && !item.mapOnly)
+        {
+            return true;
+        }
+    }
+#endif
+    while (item.length>0 && budget>0 && socket->bytesToWrite()<socketBufferLimit)
+    {
+        const qint64 chunkSize=qMin(item.length, notifyOnly? 64*1024 : mapChunkSize);
+        qint64 written=-1;
+        uchar* data=item.file->map(item.offset, chunkSize);
+        if (data)
+        {
+            written=socket->write(reinterpret_cast<const char*>(data), chunkSize);
+            item.file->unmap(data);
+        }
+        else if (item.file->seek(item.offset))
+        {
+            const QByteArray buffer(item.file->read(chunkSize));
+            if (buffer.isEmpty())
+            {
+                return false;
+            }
+            written=socket->write(buffer);
+        }
+        if (written<=0)
+        {
+            return false;
+        }
+        item.offset+=written;
+        item.length-=written;
+        budget-=written;
+        if (notifyOnly)
+        {
+            break;
+        }
+    }
+    return true;
+}
+
+
+void HttpConnection::updateSocketBuffered()
+{
+    QMutexLocker locker(&outputMutex);
+    socketBuffered=socket->bytesToWrite();
+    if (queuedBytes+socketBuffered<=lowWaterMark)
+    {
+        outputDrained.wakeAll();
+    }
+}
+
+
+void HttpConnection::bytesWritten(qint64 bytes)
+{
+    unreportedBytes+=bytes;
+    if (unreportedBytes>=sentBytesReportSize)
+    {
+        reportSentBytes();
+    }
+    updateSocketBuffered();
+    if (!sendQueue.isEmpty() && !pumpScheduled)
+    {
+        pump();
+    }
+}
+
+
+void HttpConnection::reportSentBytes()
+{
+    if (unreportedBytes>0)
+    {
+        Metrics::instance()->add("kikoplay_http_sent_bytes_total", unreportedBytes, {clientName});
+        unreportedBytes=0;
+    }
+}
+
+
+bool HttpConnection::isConnected() const
+{
+    return connected;
+}
+
+
+QHostAddress HttpConnection::getLocalAddress() const
+{
+    return localAddress;
+}
@@ -0,0 +1,277 @@
+/**
+  @file
+  @author Stefan Frings
+*/
+
+#ifndef HTTPCONNECTION_H
+#define HTTPCONNECTION_H
+
+#ifndef QT_NO_SSL
+   #include <QSslConfiguration>
+#endif
+#include <QTcpSocket>
+#include <QSettings>
+#include <QTimer>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QHostAddress>
+#include <QFile>
+#include <QSharedPointer>
+#include <atomic>
+#include "httpglobal.h"
+#include "httprequest.h"
+#include "httprequesthandler.h"
+
+namespace stefanfrings {
+
+/** Alias type definition, for compatibility to different Qt versions */
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    typedef qintptr tSocketDescriptor;
+#else
+    typedef int tSocketDescriptor;
+#endif
+
+/** Alias for QSslConfiguration if OpenSSL is not supported */
+#ifdef QT_NO_SSL
+  #define QSslConfiguration QObject
+#endif
+
+class HttpConnectionManager;
+
+/**
+  A single client connection. It lives in one of the I/O threads of the HttpConnectionManager,
+  which multiplex many connections each, and owns no thread by itself.
+  <p>
+  Incoming requests are parsed in the I/O thread. A complete request is passed to the worker pool
+  of the manager, where HttpRequestHandler::service() runs. Since HTTP clients can send multiple
+  requests before waiting for the response, further requests stay in the socket buffer until the
+  current response is finished.
+  <p>
+  The response is written through send() from the worker thread. The data is handed over to the
+  I/O thread, and send() blocks while more than highWaterMark bytes are waiting to be sent, so a
+  slow client throttles the handler instead of filling memory.
+  <p>
+  File content queued with sendFile() is streamed by the I/O thread after the handler returns:
+  with sendfile() on Linux for plain TCP, otherwise from memory mapped windows of the file,
+  in both cases only as fast as the socket send buffer drains.
+  <p>
+  Example for the required configuration settings:
+  <code><pre>
+  readTimeout=60000
+  maxRequestSize=16000
+  maxMultiPartSize=1000000
+  </pre></code>
+  <p>
+  The readTimeout value defines the maximum time to wait for a complete HTTP request.
+  <p>
+  MaxRequestSize is the maximum size of a HTTP request. In case of
+  multipart/form-data requests (also known as file-upload), the maximum
+  size of the body must not exceed maxMultiPartSize.
+*/
+class DECLSPEC HttpConnection : public QObject {
+    Q_OBJECT
+    Q_DISABLE_COPY(HttpConnection)
+
+public:
+
+    /**
+      Constructor.
+      @param manager The manager that dispatches requests of this connection
+      @param settings Configuration settings of the HTTP webserver
+      @param sslConfiguration SSL (HTTPS) will be used if not NULL
+    */
+    HttpConnection(HttpConnectionManager* manager, const QSettings* settings,
+                   const QSslConfiguration* sslConfiguration=nullptr);
+
+    /** Destructor */
+    virtual ~HttpConnection();
+
+    /**
+      Start processing an accepted connection, must be called in the I/O thread.
+      @param socketDescriptor references the accepted connection.
+    */
+    bool start(const tSocketDescriptor socketDescriptor);
+
+    /**
+      Service a request, called in a worker thread.
+      The request is deleted afterwards.
+    */
+    void process(HttpRequest* request, HttpRequestHandler* requestHandler);
+
+    /**
+      Queue data for sending, thread-safe.
+      Blocks while the output queue is above the high water mark.
+      @return false if the connection has been closed
+    */
+    bool send(const QByteArray& data);
+
+    /**
+      Queue a range of a file for sending, thread-safe.
+      @return false if the file cannot be opened or the connection has been closed
+    */
+    bool sendFile(const QString& path, qint64 offset, qint64 length);
+
+    /** Whether the client is still connected, thread-safe */
+    bool isConnected() const;
+
+    /** Local address of the connection, thread-safe */
+    QHostAddress getLocalAddress() const;
+
+public slots:
+
+    /** Close the connection immediately, wakes up a blocked send() */
+    void abort();
+
+private:
+
+    /** Output queue size above which send() blocks */
+    static const qint64 highWaterMark=512*1024;
+
+    /** Output queue size below which a blocked send() continues */
+    static const qint64 lowWaterMark=128*1024;
+
+    /** File bytes sent in one turn of the event loop, other connections of the thread go on after that */
+    static const qint64 fileSendBudget=4*1024*1024;
+
+    /** Longest first line that is passed to HttpRequestHandler::acceptsUpgrade() */
+    static const qint64 upgradeLineLimit=256;
+
+    /** Largest single sendfile() call */
+    static const qint64 sendfileChunkSize=1024*1024;
+
+    /** Size of a mapped file window */
+    static const qint64 mapChunkSize=256*1024;
+
+    /** File data is only mapped into the socket buffer while it holds less than this */
+    static const qint64 socketBufferLimit=512*1024;
+
+    /** Sent bytes are passed to the metrics after each response and every time this much has been sent */
+    static const qint64 sentBytesReportSize=4*1024*1024;
+
+    /** An item of the output queue, either data or a range of a file */
+    struct OutputItem
+    {
+        QByteArray data;
+        QSharedPointer<QFile> file;
+        qint64 offset=0;
+        qint64 length=0;
+        bool mapOnly=false;
+    };
+
+    /** The manager of this connection */
+    HttpConnectionManager* manager;
+
+    /** Configuration settings */
+    const QSettings* settings;
+
+    /** Configuration for SSL */
+    const QSslConfiguration* sslConfiguration;
+
+    /** TCP socket of the connection  */
+    QTcpSocket* socket;
+
+    /** Time for read timeout detection */
+    QTimer* readTimer;
+
+    /** Storage for the current incoming HTTP request */
+    HttpRequest* currentRequest;
+
+    /** Local address, cached for worker threads */
+    QHostAddress localAddress;
+
+    /** Peer address, the client label of the metrics */
+    QString clientName;
+
+    /** Bytes sent and not yet passed to the metrics, used in the I/O thread */
+    qint64 unreportedBytes;
+
+    /** A request of this connection is processed by a worker */
+    bool inService;
+
+    /** The first line has been checked for a protocol upgrade */
+    bool upgradeChecked;
+
+    /** The worker has finished the response, the output queue is still being sent */
+    bool responseFinished;
+
+    /** Close the connection after the current response is sent */
+    bool closeAfterResponse;
+
+    /** Output taken over by the I/O thread, not yet passed to the socket completely */
+    QList<OutputItem> sendQueue;
+
+    /** Connection state, read by worker threads */
+    std::atomic<bool> connected;
+
+    /** A drain() call is queued to the I/O thread */
+    std::atomic<bool> drainScheduled;
+
+    /** A pump() call is queued to the I/O thread */
+    bool pumpScheduled;
+
+    /** Guards outputQueue, queuedBytes and socketBuffered */
+    mutable QMutex outputMutex;
+
+    /** Wakes up send() when the output queue becomes small enough */
+    QWaitCondition outputDrained;
+
+    /** Output from send() and sendFile(), not yet taken over by the I/O thread */
+    QList<OutputItem> outputQueue;
+
+    /** Data bytes in outputQueue */
+    qint64 queuedBytes;
+
+    /** Bytes in the write buffer of the socket */
+    qint64 socketBuffered;
+
+    /**  Create SSL or TCP socket */
+    void createSocket();
+
+    /** Mark the connection as closed and wake up the worker */
+    void setClosed();
+
+    /** Enqueue an output item and schedule drain() */
+    bool enqueue(const OutputItem& item);
+
+    /** Pass part of a file range to the socket, false on errors */
+    bool sendFileChunk(OutputItem& item, qint64& budget);
+
+    /** Refresh socketBuffered and wake up the worker if the output became small enough */
+    void updateSocketBuffered();
+
+    /** The response is sent completely: close or wait for the next request */
+    void completeResponse();
+
+    /** Pass unreportedBytes to the metrics */
+    void reportSentBytes();
+
+    /** Pass the socket to the request handler and delete this connection */
+    void upgrade();
+
+private slots:
+
+    /** Received from the socket when a read-timeout occured */
+    void readTimeout();
+
+    /** Received from the socket when incoming data can be read */
+    void read();
+
+    /** Received from the socket when a connection has been closed */
+    void disconnected();
+
+    /** Received from the socket when data has been written to the network */
+    void bytesWritten(qint64 bytes);
+
+    /** Take over queued output */
+    void drain();
+
+    /** Pass output to the socket as far as the send buffer allows */
+    void pump();
+
+    /** Queued by the worker after the response is complete */
+    void finishRequest(bool closeConnection);
+};
+
+} // end of namespace
+
+#endif // HTTPCONNECTION_H
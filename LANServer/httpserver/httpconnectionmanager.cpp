@@ -0,0 +1,247 @@
+#ifndef QT_NO_SSL
+    #include <QSslSocket>
+    #include <QSslKey>
+    #include <QSslCertificate>
+    #include <QSslConfiguration>
+#endif
+#include <QDir>
+#include <QRunnable>
+#include "httpconnectionmanager.h"
+#include "Common/metrics.h"
+
+using namespace stefanfrings;
+
+namespace
+{
+    class HttpRequestTask : public QRunnable
+    {
+    public:
+        HttpRequestTask(HttpConnection* connection, HttpRequest* request, HttpRequestHandler* requestHandler, std::atomic<int>& queuedRequests)
+            : connection(connection), request(request), requestHandler(requestHandler), queuedRequests(queuedRequests) {}
+
+        void run() override
+        {
+            Metrics::instance()->add("kikoplay_http_busy_workers", 1);
+            connection->process(request, requestHandler);
+            Metrics::instance()->add("kikoplay_http_busy_workers", -1);
+            Metrics::instance()->add("kikoplay_http_pending_requests", -1);
+            --queuedRequests;
+        }
+
+    private:
+        HttpConnection* connection;
+        HttpRequest* request;
+        HttpRequestHandler* requestHandler;
+        std::atomic<int>& queuedRequests;
+    };
+}
+
+HttpConnectionManager::HttpConnectionManager(const QSettings *settings, HttpRequestHandler *requestHandler)
+    : QObject(), queuedRequests(0)
+{
+    Q_ASSERT(settings!=nullptr);
+    this->settings=settings;
+    this->requestHandler=requestHandler;
+    this->sslConfiguration=nullptr;
+    loadSslConfig();
+
+    maxConnections=settings->value("maxConnections",1000).toInt();
+    maxQueuedRequests=settings->value("maxQueuedRequests",256).toInt();
+    workerPool.setMaxThreadCount(settings->value("maxThreads",32).toInt());
+    workerPool.setExpiryTimeout(settings->value("cleanupInterval",60000).toInt());
+
+    int ioThreadCount=settings->value("ioThreads",qBound(1,QThread::idealThreadCount()/2,4)).toInt();
+    for (int i=0; i<qMax(1,ioThreadCount); ++i)
+    {
+        QThread* thread=new QThread();
+        thread->setObjectName(QStringLiteral("HttpIoThread"));
+        thread->start();
+        ioThreads.append(thread);
+    }
+    nextIoThread=0;
+    Metrics::instance()->add("kikoplay_http_io_threads", ioThreads.size());
+}
+
+
+HttpConnectionManager::~HttpConnectionManager()
+{
+    // closing the connections wakes up workers blocked in HttpConnection::send()
+    {
+        QMutexLocker locker(&mutex);
+        foreach(HttpConnection* connection, connections)
+        {
+            QMetaObject::invokeMethod(connection, "abort", Qt::QueuedConnection);
+        }
+    }
+    workerPool.waitForDone();
+    foreach(QThread* thread, ioThreads)
+    {
+        thread->quit();
+        thread->wait();
+    }
+    // connections that were not started or not deleted by their thread
+    const QSet<HttpConnection*> remaining=connections;
+    qDeleteAll(remaining);
+    Metrics::instance()->add("kikoplay_http_io_threads", -ioThreads.size());
+    qDeleteAll(ioThreads);
+    delete sslConfiguration;
+#ifdef QT_DEBUG
+    Logger::logger()->log(Logger::LANServer, "HttpConnectionManager (%p): destroyed", this);
+#endif
+}
+
+
+bool HttpConnectionManager::handleConnection(tSocketDescriptor socketDescriptor)
+{
+    QMutexLocker locker(&mutex);
+    if (connections.size()>=maxConnections)
+    {
+        Metrics::instance()->add("kikoplay_http_rejected_total", 1, {"connections"});
+        return false;
+    }
+    HttpConnection* connection=new HttpConnection(this,settings,sslConfiguration);
+    connections.insert(connection);
+    Metrics::instance()->add("kikoplay_http_connections", 1);
+    connection->moveToThread(ioThreads[nextIoThread]);
+    nextIoThread=(nextIoThread+1)%ioThreads.size();
+    // The descriptor is passed via event queue because the connection lives in another thread
+    QMetaObject::invokeMethod(connection, [connection, socketDescriptor](){
+        if (!connection->start(socketDescriptor))
+        {
+            delete connection;
+        }
+    }, Qt::QueuedConnection);
+    return true;
+}
+
+
+bool HttpConnectionManager::schedule(HttpConnection *connection, HttpRequest *request)
+{
+    if (queuedRequests.fetch_add(1)>=maxQueuedRequests)
+    {
+        --queuedRequests;
+        Metrics::instance()->add("kikoplay_http_rejected_total", 1, {"requests"});
+        return false;
+    }
+    Metrics::instance()->add("kikoplay_http_pending_requests", 1);
+    workerPool.start(new HttpRequestTask(connection,request,requestHandler,queuedRequests));
+    return true;
+}
+
+
+void HttpConnectionManager::connectionClosed(HttpConnection *connection)
+{
+    QMutexLocker locker(&mutex);
+    if (connections.remove(connection))
+    {
+        Metrics::instance()->add("kikoplay_http_connections", -1);
+    }
+}
+
+
+void HttpConnectionManager::loadSslConfig()
+{
+    // If certificate and key files are configured, then load them
+    QString sslKeyFileName=settings->value("sslKeyFile","").toString();
+    QString sslCertFileName=settings->value("sslCertFile","").toString();
+    QString caCertFileName=settings->value("caCertFile","").toString();
+    bool verifyPeer=settings->value("verifyPeer","false").toBool();
+
+    if (!sslKeyFileName.isEmpty() && !sslCertFileName.isEmpty())
+    {
+        #ifdef QT_NO_SSL
+            qWarning("HttpConnectionManager: SSL is not supported");
+        #else
+            // Convert relative fileNames to absolute, based on the directory of the config file.
+            QFileInfo configFile(settings->fileName());
+            #ifdef Q_OS_WIN32
+                if (QDir::isRelativePath(sslKeyFileName) && settings->format()!=QSettings::NativeFormat)
+            #else
+                if (QDir::isRelativePath(sslKeyFileName))
+            #endif
+            {
+                sslKeyFileName=QFileInfo(configFile.absolutePath(),sslKeyFileName).absoluteFilePath();
+            }
+
+            #ifdef Q_OS_WIN32
+                if (QDir::isRelativePath(sslCertFileName) && settings->format()!=QSettings::NativeFormat)
+            #else
+                if (QDir::isRelativePath(sslCertFileName))
+            #endif
+            {
+                sslCertFileName=QFileInfo(configFile.absolutePath(),sslCertFileName).absoluteFilePath();
+            }
+
+            // Load the SSL certificate
+            QFile certFile(sslCertFileName);
+            if (!certFile.open(QIODevice::ReadOnly))
+            {
+                Logger::logger()->log(Logger::LANServer, "HttpConnectionManager: cannot open sslCertFile %s", qPrintable(sslCertFileName));
+                return;
+            }
+            QSslCertificate certificate(&certFile, QSsl::Pem);
+            certFile.close();
+
+            // Load the key file
+            QFile keyFile(sslKeyFileName);
+            if (!keyFile.open(QIODevice::ReadOnly))
+            {
+                Logger::logger()->log(Logger::LANServer, "HttpConnectionManager: cannot open sslKeyFile %s", qPrintable(sslKeyFileName));
+                return;
+            }
+            QSslKey sslKey(&keyFile, QSsl::Rsa, QSsl::Pem);
+            keyFile.close();
+
+            // Create the SSL configuration
+            sslConfiguration=new QSslConfiguration();
+            sslConfiguration->setProtocol(QSsl::AnyProtocol);
+            sslConfiguration->setLocalCertificate(certificate);
+            sslConfiguration->setPrivateKey(sslKey);
+
+            // We can optionally use a CA certificate to validate the HTTP clients
+            if (!caCertFileName.isEmpty())
+            {
+                #if QT_VERSION < QT_VERSION_CHECK(5, 15, 0)
+                    Logger::logger()->log(Logger::LANServer, "HttpConnectionManager: Using a caCertFile requires Qt 5.15 or newer");
+                #else
+
+                    // Convert relative fileName to absolute, based on the directory of the config file.
+                    #ifdef Q_OS_WIN32
+                        if (QDir::isRelativePath(caCertFileName) && settings->format()!=QSettings::NativeFormat)
+                    #else
+                        if (QDir::isRelativePath(caCertFileName))
+                    #endif
+                    {
+                        caCertFileName=QFileInfo(configFile.absolutePath(),caCertFileName).absoluteFilePath();
+                    }
+
+                    // Load the CA cert file
+                    QFile caCertFile(caCertFileName);
+                    if (!caCertFile.open(QIODevice::ReadOnly))
+                    {
+                        Logger::logger()->log(Logger::LANServer, "HttpConnectionManager: cannot open caCertFile %s", qPrintable(caCertFileName));
+                        return;
+                    }
+                    QSslCertificate caCertificate(&caCertFile, QSsl::Pem);
+                    caCertFile.close();
+
+                    // Configure SSL
+                    sslConfiguration->addCaCertificate(caCertificate);
+                #endif
+            }
+
+            // Enable or disable verification of the HTTP client
+            if (verifyPeer)
+            {
+                sslConfiguration->setPeerVerifyMode(QSslSocket::VerifyPeer);
+            }
+            else
+            {
+                sslConfiguration->setPeerVerifyMode(QSslSocket::VerifyNone);
+            }
+#ifdef QT_DEBUG
+            Logger::logger()->log(Logger::LANServer, "HttpConnectionManager: SSL settings loaded");
+#endif
+         #endif
+    }
+}
@@ -0,0 +1,134 @@
+#ifndef HTTPCONNECTIONMANAGER_H
+#define HTTPCONNECTIONMANAGER_H
+
+#include <QList>
+#include <QSet>
+#include <QObject>
+#include <QMutex>
+#include <QThread>
+#include <QThreadPool>
+#include <atomic>
+#include "httpglobal.h"
+#include "httpconnection.h"
+
+namespace stefanfrings {
+
+/**
+  Event driven connection core. Connections are spread over a few I/O threads, each one
+  multiplexing its sockets with the event dispatcher of the thread (epoll/select/IOCP),
+  so idle keep-alive connections do not occupy a thread. Requests are serviced by a bounded
+  pool of worker threads, because HttpRequestHandler::service() is allowed to block.
+  <p>
+  Example for the required configuration settings:
+  <code><pre>
+  readTimeout=60000
+  maxRequestSize=16000
+  maxMultiPartSize=1000000
+  ioThreads=2
+  maxThreads=32
+  maxQueuedRequests=256
+  maxConnections=1000
+  cleanupInterval=60000
+  </pre></code>
+  <p>
+  The readTimeout value defines the maximum time to wait for a complete HTTP request.
+  <p>
+  MaxRequestSize is the maximum size of a HTTP request. In case of
+  multipart/form-data requests (also known as file-upload), the maximum
+  size of the body must not exceed maxMultiPartSize.
+  <p>
+  ioThreads is the number of threads handling socket I/O, maxThreads the number of
+  worker threads running request handlers. Requests wait in a queue when all workers are busy,
+  beyond maxQueuedRequests they are answered with 503, and so are connections beyond maxConnections.
+  Idle worker threads are stopped after cleanupInterval.
+  <p>
+  Additional settings for SSL (HTTPS):
+  <code><pre>
+  sslKeyFile=ssl/server.key
+  sslCertFile=ssl/server.crt
+  ;caCertFile=ssl/ca.crt
+  verifyPeer=false
+  </pre></code>
+  For SSL support, you need at least a pair of OpenSSL x509 certificate and an RSA key,
+  both files in PEM format. To enable verification of the peer (the calling web browser),
+  you can either use the central certificate store of the operating system, or provide
+  a CA certificate file in PEM format. The certificates of the peers must have been
+  derived from the CA certificate.
+  <p>
+  Please note that a listener with SSL can only handle HTTPS protocol. To support both
+  HTTP and HTTPS simultaneously, you need to start <b>two</b> listeners on different ports
+  one with SLL and one without SSL (usually on public ports 80 and 443, or locally on 8080 and 8443).
+*/
+
+class DECLSPEC HttpConnectionManager : public QObject {
+    Q_OBJECT
+    Q_DISABLE_COPY(HttpConnectionManager)
+public:
+
+    /**
+      Constructor.
+      @param settings Configuration settings for the HTTP server. Must not be 0.
+      @param requestHandler The handler that will process each received HTTP request.
+    */
+    HttpConnectionManager(const QSettings* settings, HttpRequestHandler *requestHandler);
+
+    /** Destructor, closes all connections and waits for running requests */
+    virtual ~HttpConnectionManager();
+
+    /**
+      Take over an accepted connection.
+      @return false if the connection limit is reached
+    */
+    bool handleConnection(tSocketDescriptor socketDescriptor);
+
+    /**
+      Queue a complete request of the connection to the worker pool.
+      @return false if the request queue is full
+    */
+    bool schedule(HttpConnection* connection, HttpRequest* request);
+
+    /** Called by the connection when it is destroyed */
+    void connectionClosed(HttpConnection* connection);
+
+    /** The request handler, also asked for protocol upgrades of new connections */
+    HttpRequestHandler* getRequestHandler() const { return requestHandler; }
+
+private:
+
+    /** Settings for this manager */
+    const QSettings* settings;
+
+    /** Will be passed to the workers */
+    HttpRequestHandler* requestHandler;
+
+    /** Threads multiplexing the sockets */
+    QList<QThread*> ioThreads;
+
+    /** Round robin index for new connections */
+    int nextIoThread;
+
+    /** Threads running request handlers */
+    QThreadPool workerPool;
+
+    /** Open connections */
+    QSet<HttpConnection*> connections;
+
+    /** Guards connections */
+    QMutex mutex;
+
+    /** Requests queued or running in the worker pool */
+    std::atomic<int> queuedRequests;
+
+    /** Limits */
+    int maxConnections, maxQueuedRequests;
+
+    /** The SSL configuration (certificate, key and other settings) */
+    QSslConfiguration* sslConfiguration;
+
+    /** Load SSL configuration */
+    void loadSslConfig();
+};
+
+} // end of namespace
+
+#endif // HTTPCONNECTIONMANAGER_H
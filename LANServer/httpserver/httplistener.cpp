@@ -4,8 +4,8 @@
 */
 
 #include "httplistener.h"
-#include "httpconnectionhandler.h"
-#include "httpconnectionhandlerpool.h"
+#include "httpconnection.h"
+#include "httpconnectionmanager.h"
 #include <QCoreApplication>
 #include "Common/logger.h"
 
@@ -16,7 +16,7 @@ HttpListener::HttpListener(const QSettings* settings, HttpRequestHandler* reques
 {
     Q_ASSERT(settings!=nullptr);
     Q_ASSERT(requestHandler!=nullptr);
-    pool=nullptr;
+    manager=nullptr;
     this->settings=settings;
     this->requestHandler=requestHandler;
     // Reqister type of socketDescriptor for signal/slot handling
@@ -36,9 +36,9 @@ HttpListener::~HttpListener()
 bool HttpListener::listen()
 {
     if (isListening()) return true;
-    if (!pool)
+    if (!manager)
     {
-        pool=new HttpConnectionHandlerPool(settings,requestHandler);
+        manager=new HttpConnectionManager(settings,requestHandler);
     }
     QString host = settings->value("host").toString();
     quint16 port = settings->value("port").toUInt() & 0xFFFF;
@@ -51,9 +51,9 @@ bool HttpListener::listen()
 void HttpListener::close() {
     QTcpServer::close();
     Logger::logger()->log(Logger::LANServer, "HttpListener: closed");
-    if (pool) {
-        delete pool;
-        pool=nullptr;
+    if (manager) {
+        delete manager;
+        manager=nullptr;
     }
 }
 
@@ -62,19 +62,8 @@ void HttpListener::incomingConnection(tSocketDescriptor socketDescriptor) {
    Logger::logger()->log(Logger::LANServer, "HttpListener: New connection");
 #endif
 
-    HttpConnectionHandler* freeHandler=nullptr;
-    if (pool)
-    {
-        freeHandler=pool->getConnectionHandler();
-    }
-
-    // Let the handler process the new connection.
-    if (freeHandler)
-    {
-        // The descriptor is passed via event queue because the handler lives in another thread
-        QMetaObject::invokeMethod(freeHandler, "handleConnection", Qt::QueuedConnection, Q_ARG(tSocketDescriptor, socketDescriptor));
-    }
-    else
+    // Let the manager process the new connection.
+    if (!manager || !manager->handleConnection(socketDescriptor))
     {
         // Reject the connection
         Logger::logger()->log(Logger::LANServer, "HttpListener: Too many incoming connections");
@@ -10,8 +10,8 @@
 #include <QSettings>
 #include <QBasicTimer>
 #include "httpglobal.h"
-#include "httpconnectionhandler.h"
-#include "httpconnectionhandlerpool.h"
+#include "httpconnection.h"
+#include "httpconnectionmanager.h"
 #include "httprequesthandler.h"
 
 namespace stefanfrings {
@@ -29,9 +29,11 @@ namespace stefanfrings {
   maxRequestSize=16000
   maxMultiPartSize=1000000
 
-  minThreads=1
-  maxThreads=10
-  cleanupInterval=1000
+  ioThreads=2
+  maxThreads=32
+  maxQueuedRequests=256
+  maxConnections=1000
+  cleanupInterval=60000
 
   ;sslKeyFile=ssl/server.key
   ;sslCertFile=ssl/server.crt
@@ -47,11 +49,9 @@ namespace stefanfrings {
   multipart/form-data requests (also known as file-upload), the maximum
   size of the body must not exceed maxMultiPartSize.
   <p>
-  After server start, the size of the thread pool is always 0. Threads
-  are started on demand when requests come in. The cleanup timer reduces
-  the number of idle threads slowly by closing one thread in each interval.
-  But the configured minimum number of threads are kept running.
-  @see HttpConnectionHandlerPool for description of the optional ssl settings
+  Connections are multiplexed by a few I/O threads, request handlers run in a
+  pool of at most maxThreads worker threads.
+  @see HttpConnectionManager for description of the thread settings and the optional ssl settings
 */
 
 class DECLSPEC HttpListener : public QTcpServer {
@@ -61,7 +61,7 @@ public:
 
     /**
       Constructor.
-      Creates a connection pool and starts listening on the configured host and port.
+      Creates a connection manager and starts listening on the configured host and port.
       @param settings Configuration settings, usually stored in an INI file. Must not be 0.
       Settings are read from the current group, so the caller must have called settings->beginGroup().
       Because the group must not change during runtime, it is recommended to provide a
@@ -84,7 +84,7 @@ public:
 
     /**
      Closes the listener, waits until all pending requests are processed,
-     then closes the connection pool.
+     then closes the connection manager.
     */
     Q_INVOKABLE void close();
 
@@ -101,18 +101,8 @@ private:
     /** Point to the reuqest handler which processes all HTTP requests */
     HttpRequestHandler* requestHandler;
 
-    /** Pool of connection handlers */
-    HttpConnectionHandlerPool* pool;
-
-signals:
-
-    /**
-      Sent to the connection handler to process a new incoming connection.
-      @param socketDescriptor references the accepted connection.
-    */
-
-    void handleConnection(tSocketDescriptor socketDescriptor);
-
+    /** Connection I/O threads and request workers */
+    HttpConnectionManager* manager;
 };
 
 } // end of namespace
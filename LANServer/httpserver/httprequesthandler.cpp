@@ -4,6 +4,7 @@
 */
 
 #include "httprequesthandler.h"
+#include <QTcpSocket>
 
 using namespace stefanfrings;
 
@@ -21,3 +22,14 @@ void HttpRequestHandler::service(HttpRequest& request, HttpResponse& response)
     response.setStatus(501,"not implemented");
     response.write("501 not implemented",true);
 }
+
+bool HttpRequestHandler::acceptsUpgrade(const QByteArray& head)
+{
+    Q_UNUSED(head)
+    return false;
+}
+
+void HttpRequestHandler::upgrade(QTcpSocket* socket)
+{
+    delete socket;
+}
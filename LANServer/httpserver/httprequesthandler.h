@@ -10,6 +10,8 @@
 #include "httprequest.h"
 #include "httpresponse.h"
 
+class QTcpSocket;
+
 namespace stefanfrings {
 
 /**
@@ -46,6 +48,23 @@ public:
     */
     virtual void service(HttpRequest& request, HttpResponse& response);
 
+    /**
+      Whether a new connection should be taken over by upgrade() instead of being
+      processed as HTTP, e.g. for WebSocket. Called in an I/O thread.
+      The default implementation returns false.
+      @param head The first line of the connection, as far as it has been received
+      @warning This method must be thread safe
+    */
+    virtual bool acceptsUpgrade(const QByteArray& head);
+
+    /**
+      Take over the socket of a connection accepted by acceptsUpgrade().
+      The request is still unread. The socket has no parent and lives in the I/O thread
+      that calls this method, so it has to be moved to the thread of its new owner here.
+      The default implementation deletes the socket.
+    */
+    virtual void upgrade(QTcpSocket* socket);
+
 };
 
 } // end of namespace
@@ -4,12 +4,13 @@
 */
 
 #include "httpresponse.h"
+#include "httpconnection.h"
 
 using namespace stefanfrings;
 
-HttpResponse::HttpResponse(QTcpSocket *socket)
+HttpResponse::HttpResponse(HttpConnection *connection)
 {
-    this->socket=socket;
+    this->connection=connection;
     statusCode=200;
     statusText="OK";
     sentHeaders=false;
@@ -69,31 +70,37 @@ void HttpResponse::writeHeaders()
     }
     buffer.append("\r\n");
     writeToSocket(buffer);
-    socket->flush();
     sentHeaders=true;
 }
 
 bool HttpResponse::writeToSocket(QByteArray data)
 {
-    int remaining=data.size();
-    char* ptr=data.data();
-    while (socket->isOpen() && remaining>0)
+    return connection->send(data);
+}
+
+void HttpResponse::beginBody(qint64 lastPartSize)
+{
+    // If the whole response is generated with a single call to write(), then we know the total
+    // size of the response and therefore can set the Content-Length header automatically.
+    if (lastPartSize>=0)
     {
-        // If the output buffer has become large, then wait until it has been sent.
-        if (socket->bytesToWrite()>16384)
-        {
-            socket->waitForBytesWritten(-1);
-        }
+       // Automatically set the Content-Length header
+       headers.insert("Content-Length",QByteArray::number(lastPartSize));
+    }
 
-        qint64 written=socket->write(ptr,remaining);
-        if (written==-1)
+    // else if we will not close the connection at the end and the size is unknown, then we must use the chunked mode.
+    else if (!headers.contains("Content-Length"))
+    {
+        QByteArray connectionValue=headers.value("Connection",headers.value("connection"));
+        bool connectionClose=QString::compare(connectionValue,"close",Qt::CaseInsensitive)==0;
+        if (!connectionClose)
         {
-          return false;
+            headers.insert("Transfer-Encoding","chunked");
+            chunkedMode=true;
         }
-        ptr+=written;
-        remaining-=written;
     }
-    return true;
+
+    writeHeaders();
 }
 
 void HttpResponse::write(QByteArray data, bool lastPart)
@@ -103,27 +110,7 @@ void HttpResponse::write(QByteArray data, bool lastPart)
     // Send HTTP headers, if not already done (that happens only on the first call to write())
     if (sentHeaders==false)
     {
-        // If the whole response is generated with a single call to write(), then we know the total
-        // size of the response and therefore can set the Content-Length header automatically.
-        if (lastPart)
-        {
-           // Automatically set the Content-Length header
-           headers.insert("Content-Length",QByteArray::number(data.size()));
-        }
-
-        // else if we will not close the connection at the end, them we must use the chunked mode.
-        else
-        {
-            QByteArray connectionValue=headers.value("Connection",headers.value("connection"));
-            bool connectionClose=QString::compare(connectionValue,"close",Qt::CaseInsensitive)==0;
-            if (!connectionClose)
-            {
-                headers.insert("Transfer-Encoding","chunked");
-                chunkedMode=true;
-            }
-        }
-
-        writeHeaders();
+        beginBody(lastPart? data.size() : -1);
     }
 
     // Send data
@@ -133,11 +120,12 @@ void HttpResponse::write(QByteArray data, bool lastPart)
         {
             if (data.size()>0)
             {
-                QByteArray size=QByteArray::number(data.size(),16);
-                writeToSocket(size);
-                writeToSocket("\r\n");
-                writeToSocket(data);
-                writeToSocket("\r\n");
+                QByteArray chunk=QByteArray::number(data.size(),16);
+                chunk.reserve(chunk.size()+data.size()+4);
+                chunk.append("\r\n");
+                chunk.append(data);
+                chunk.append("\r\n");
+                writeToSocket(chunk);
             }
         }
         else
@@ -153,12 +141,44 @@ void HttpResponse::write(QByteArray data, bool lastPart)
         {
             writeToSocket("0\r\n\r\n");
         }
-        socket->flush();
         sentLastPart=true;
     }
 }
 
 
+bool HttpResponse::writeFile(const QString& path, qint64 offset, qint64 length, bool lastPart)
+{
+    Q_ASSERT(sentLastPart==false);
+    if (sentHeaders==false)
+    {
+        beginBody(lastPart && !headers.contains("Content-Length")? length : -1);
+    }
+    bool ok=true;
+    if (length>0)
+    {
+        if (chunkedMode)
+        {
+            QByteArray chunkHead=QByteArray::number(length,16);
+            chunkHead.append("\r\n");
+            ok=writeToSocket(chunkHead) && connection->sendFile(path,offset,length) && writeToSocket("\r\n");
+        }
+        else
+        {
+            ok=connection->sendFile(path,offset,length);
+        }
+    }
+    if (lastPart)
+    {
+        if (chunkedMode)
+        {
+            writeToSocket("0\r\n\r\n");
+        }
+        sentLastPart=true;
+    }
+    return ok;
+}
+
+
 bool HttpResponse::hasSentLastPart() const
 {
     return sentLastPart;
@@ -191,16 +211,15 @@ void HttpResponse::redirect(const QByteArray& url)
 
 void HttpResponse::flush()
 {
-    socket->flush();
 }
 
 
 bool HttpResponse::isConnected() const
 {
-    return socket->isOpen();
+    return connection->isConnected();
 }
 
 QHostAddress HttpResponse::getLocalAddress() const
 {
-    return socket->localAddress();
+    return connection->getLocalAddress();
 }
@@ -8,13 +8,14 @@
 
 #include <QMap>
 #include <QString>
-#include <QTcpSocket>
 #include <QHostAddress>
 #include "httpglobal.h"
 #include "httpcookie.h"
 
 namespace stefanfrings {
 
+class HttpConnection;
+
 /**
   This object represents a HTTP response, used to return something to the web client.
   <p>
@@ -40,9 +41,9 @@ public:
 
     /**
       Constructor.
-      @param socket used to write the response
+      @param connection used to write the response
     */
-    HttpResponse(QTcpSocket *socket);
+    HttpResponse(HttpConnection *connection);
 
     enum
     {
@@ -128,6 +129,20 @@ public:
     */
     void write(const QByteArray data, const bool lastPart=false);
 
+    /**
+      Write a range of a file as body data.
+      <p>
+      The file is sent by the I/O thread of the connection, without copying it
+      through the worker thread. A Content-Length header should be set before,
+      otherwise chunked mode is selected like in write().
+      @param path Path of the file
+      @param offset Start of the range
+      @param length Size of the range
+      @param lastPart Indicates that this is the last part of the body
+      @return false if the file cannot be opened or the connection has been closed
+    */
+    bool writeFile(const QString& path, const qint64 offset, const qint64 length, const bool lastPart=false);
+
     /**
       Indicates whether the body has been sent completely (write() has been called with lastPart=true).
     */
@@ -148,8 +163,8 @@ public:
 
     /**
      * Flush the output buffer (of the underlying socket).
-     * You normally don't need to call this method because flush is
-     * automatically called after HttpRequestHandler::service() returns.
+     * Output is passed to the I/O thread as soon as it is written,
+     * so this method is kept for compatibility only.
      */
     void flush();
 
@@ -166,8 +181,8 @@ private:
     /** Request headers */
     QMap<QByteArray,QByteArray> headers;
 
-    /** Socket for writing output */
-    QTcpSocket* socket;
+    /** Connection for writing output */
+    HttpConnection* connection;
 
     /** HTTP status code*/
     int statusCode;
@@ -187,7 +202,7 @@ private:
     /** Cookies */
     QMap<QByteArray,HttpCookie> cookies;
 
-    /** Write raw data to the socket. This method blocks until all bytes have been passed to the TCP buffer */
+    /** Write raw data to the connection. This method blocks while the output queue of the connection is full */
     bool writeToSocket(QByteArray data);
 
     /**
@@ -197,6 +212,12 @@ private:
     */
     void writeHeaders();
 
+    /**
+      Select Content-Length or chunked mode and write the headers, on the first part of the body.
+      @param lastPartSize size of the whole body if it is written at once, otherwise -1
+    */
+    void beginBody(const qint64 lastPartSize);
+
 };
 
 } // end of namespace
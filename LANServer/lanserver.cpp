@@ -7,6 +7,7 @@
 #include "dlna/upnp.h"
 #include "dlna/dlnamediaserver.h"
 #include "router.h"
+#include "pushservice.h"
 
 LANServer::LANServer(QObject *parent) : QObject(parent)
 {
@@ -15,14 +16,17 @@ LANServer::LANServer(QObject *parent) : QObject(parent)
     httpThread->start(QThread::NormalPriority);
 
     serverSettings = new QSettings("KikoPlayProject", "KikoPlay");
-    serverSettings->setValue("minThreads","4");
-    serverSettings->setValue("maxThreads","100");
+    serverSettings->setValue("ioThreads","2");
+    serverSettings->setValue("maxThreads","32");
+    serverSettings->setValue("maxQueuedRequests","256");
+    serverSettings->setValue("maxConnections","1000");
     serverSettings->setValue("cleanupInterval","60000");
     serverSettings->setValue("readTimeout","60000");
     serverSettings->setValue("maxRequestSize","16000");
     serverSettings->setValue("maxMultiPartSize","10000000");
 
     router = new Router;
+    pushService = new PushService(this);
     listener = new stefanfrings::HttpListener(serverSettings, router);
     listener->moveToThread(httpThread);
     upnp = new UPnP;
@@ -72,6 +76,7 @@ void LANServer::stopServer()
 void LANServer::startDLNA()
 {
     if(!isStart()) return;
+    dlnaMediaServer->refreshIndex();
     QMetaObject::invokeMethod(upnp, [this](){
         upnp->start();
         upnp->addDevice(dlnaMediaServer);
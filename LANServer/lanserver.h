@@ -5,6 +5,7 @@
 class Router;
 class UPnP;
 class DLNAMediaServer;
+class PushService;
 class QSettings;
 namespace stefanfrings
 {
@@ -23,10 +24,12 @@ public:
     bool isStart() const;
     bool isDLNAStart() const;
     UPnP *getUPnP() const {return upnp;}
+    PushService *getPushService() const {return pushService;}
 private:
     Router *router;
     UPnP *upnp;
     DLNAMediaServer *dlnaMediaServer;
+    PushService *pushService;
     stefanfrings::HttpListener *listener;
     QSettings* serverSettings;
 
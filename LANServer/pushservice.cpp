@@ -0,0 +1,228 @@
+#include "pushservice.h"
+#include "globalobjects.h"
+#include "Common/logger.h"
+#include "Common/eventbus.h"
+#include "Play/Playlist/playlist.h"
+#include "Play/Danmu/Manager/pool.h"
+#include "Play/Danmu/danmupool.h"
+#include "Play/Video/mpvplayer.h"
+#include "Play/playcontext.h"
+#include <QTcpSocket>
+#include <QWebSocket>
+#include <QWebSocketServer>
+#include <QJsonDocument>
+
+PushService::PushService(QObject *parent) : QObject(parent), lastPushedPosition(-1)
+{
+    // comments may be added by the workers of the http server
+    qRegisterMetaType<QVector<QSharedPointer<DanmuComment> > >("QVector<QSharedPointer<DanmuComment> >");
+    qRegisterMetaType<QList<QSharedPointer<DanmuComment> > >("QList<QSharedPointer<DanmuComment> >");
+    server = new QWebSocketServer(QStringLiteral("KikoPlay"), QWebSocketServer::NonSecureMode, this);
+    QObject::connect(server, &QWebSocketServer::newConnection, this, &PushService::onNewConnection);
+    flushTimer.setSingleShot(true);
+    flushTimer.setInterval(flushInterval);
+    QObject::connect(&flushTimer, &QTimer::timeout, this, [this](){
+        for(Client &client : clients)
+        {
+            flush(client);
+        }
+    });
+}
+
+PushService::~PushService()
+{
+    watchSources(false);
+    for(QWebSocket *socket : clients.keys())
+    {
+        socket->disconnect(this);
+        socket->abort();
+    }
+}
+
+bool PushService::isPushRequest(const QByteArray &head)
+{
+    return head.startsWith("GET /api/ws ") || head.startsWith("GET /api/ws?");
+}
+
+void PushService::addSocket(QTcpSocket *socket)
+{
+    // the handshake is still unread, QWebSocketServer answers it
+    socket->moveToThread(thread());
+    QMetaObject::invokeMethod(this, [this, socket](){
+        server->handleConnection(socket);
+    }, Qt::QueuedConnection);
+}
+
+void PushService::onNewConnection()
+{
+    while(server->hasPendingConnections())
+    {
+        QWebSocket *socket = server->nextPendingConnection();
+        if(clients.size() >= maxClients)
+        {
+            socket->close(QWebSocketProtocol::CloseCodePolicyViolated, QStringLiteral("too many clients"));
+            socket->deleteLater();
+            continue;
+        }
+        Logger::logger()->log(Logger::LANServer, QString("[%1]Push connected").arg(socket->peerAddress().toString()));
+        if(clients.isEmpty()) watchSources(true);
+        Client &client = clients[socket];
+        client.socket = socket;
+        client.danmuPool = GlobalObjects::danmuPool->getPool()->id();
+        QObject::connect(socket, &QWebSocket::disconnected, this, [this, socket](){
+            Logger::logger()->log(Logger::LANServer, QString("[%1]Push disconnected").arg(socket->peerAddress().toString()));
+            clients.remove(socket);
+            socket->deleteLater();
+            if(clients.isEmpty()) watchSources(false);
+        });
+        QObject::connect(socket, &QWebSocket::bytesWritten, this, [this, socket](qint64 bytes){
+            auto iter = clients.find(socket);
+            if(iter == clients.end()) return;
+            // frame headers are counted here too
+            iter->unwritten = qMax<qint64>(0, iter->unwritten - bytes);
+            if(iter->unwritten < maxUnwritten) scheduleFlush();
+        });
+        publishState();
+    }
+}
+
+void PushService::watchSources(bool on)
+{
+    if(!on)
+    {
+        // the player only posts events while someone listens
+        qDeleteAll(listeners);
+        listeners.clear();
+        for(const QMetaObject::Connection &conn : sourceConnections)
+        {
+            QObject::disconnect(conn);
+        }
+        sourceConnections.clear();
+        QObject::disconnect(poolConnection);
+        return;
+    }
+    for(int event : {EventBus::EVENT_PLAYER_STATE_CHANGED, EventBus::EVENT_PLAYER_FILE_CHANGED})
+    {
+        listeners.append(new EventListener(EventBus::getEventBus(), event, [this](const EventParam *){
+            publishState();
+        }, this));
+    }
+    sourceConnections << QObject::connect(GlobalObjects::mpvplayer, &MPVPlayer::positionChanged, this, [this](int time){
+        if(lastPushedPosition >= 0 && qAbs(time - lastPushedPosition) < positionInterval) return;
+        lastPushedPosition = time;
+        publish("pos", {{"type", "pos"}, {"time", time}});
+    });
+    sourceConnections << QObject::connect(GlobalObjects::mpvplayer, &MPVPlayer::positionJumped, this, [this](int time){
+        lastPushedPosition = time;
+        publish("pos", {{"type", "pos"}, {"time", time}});
+    });
+    sourceConnections << QObject::connect(GlobalObjects::danmuPool, &DanmuPool::poolIdChanged, this, [this](){
+        watchPool(GlobalObjects::danmuPool->getPool());
+        publishState();
+    });
+    sourceConnections << QObject::connect(GlobalObjects::danmuPool, &DanmuPool::danmuLaunched, this, [this](const QList<QSharedPointer<DanmuComment> > &comments){
+        publishDanmu(GlobalObjects::danmuPool->getPool()->id(), Pool::exportJson(comments.toVector()));
+    });
+    auto onPlaylistChanged = [this](){
+        publish("playlist", {{"type", "playlist"}});
+    };
+    PlayList *playlist = GlobalObjects::playlist;
+    sourceConnections << QObject::connect(playlist, &PlayList::rowsInserted, this, onPlaylistChanged);
+    sourceConnections << QObject::connect(playlist, &PlayList::rowsRemoved, this, onPlaylistChanged);
+    sourceConnections << QObject::connect(playlist, &PlayList::rowsMoved, this, onPlaylistChanged);
+    sourceConnections << QObject::connect(playlist, &PlayList::dataChanged, this, onPlaylistChanged);
+    sourceConnections << QObject::connect(playlist, &PlayList::layoutChanged, this, onPlaylistChanged);
+    sourceConnections << QObject::connect(playlist, &PlayList::modelReset, this, onPlaylistChanged);
+    watchPool(GlobalObjects::danmuPool->getPool());
+}
+
+void PushService::watchPool(Pool *pool)
+{
+    QObject::disconnect(poolConnection);
+    const QString pid = pool->id();
+    poolConnection = QObject::connect(pool, &Pool::commentsAdded, this, [this, pid](const QVector<QSharedPointer<DanmuComment> > &comments){
+        publishDanmu(pid, Pool::exportJson(comments));
+    });
+}
+
+void PushService::publish(const QString &type, const QJsonObject &msg)
+{
+    for(Client &client : clients)
+    {
+        // a pending message of the same type is replaced, it keeps its position in the queue
+        if(!client.latest.contains(type)) client.order.append(type);
+        client.latest[type] = msg;
+    }
+    scheduleFlush();
+}
+
+void PushService::publishDanmu(const QString &pid, const QJsonArray &danmu)
+{
+    if(danmu.isEmpty()) return;
+    for(Client &client : clients)
+    {
+        if(client.danmuPool != pid)
+        {
+            // comments of the previous pool are dropped, the state message tells the client about the new one
+            client.danmuPool = pid;
+            client.danmu = QJsonArray();
+            client.danmuReset = false;
+        }
+        if(client.danmuReset) continue;
+        for(const QJsonValue &comment : danmu)
+        {
+            client.danmu.append(comment);
+        }
+        if(client.danmu.size() > maxPendingDanmu)
+        {
+            // the client has to fetch the pool again
+            client.danmu = QJsonArray();
+            client.danmuReset = true;
+        }
+    }
+    scheduleFlush();
+}
+
+void PushService::publishState()
+{
+    const PlayListItem *item = GlobalObjects::playlist->getCurrentItem();
+    publish("state", {
+        {"type", "state"},
+        {"state", (int)GlobalObjects::mpvplayer->getState()},
+        {"file", GlobalObjects::mpvplayer->getCurrentFile()},
+        {"title", item? item->title : QString()},
+        {"duration", PlayContext::context()->duration},
+        {"playtime", PlayContext::context()->playtime},
+        {"pool", GlobalObjects::danmuPool->getPool()->id()}
+    });
+}
+
+void PushService::scheduleFlush()
+{
+    if(!flushTimer.isActive()) flushTimer.start();
+}
+
+void PushService::flush(Client &client)
+{
+    // a slow client keeps its coalesced queue until the socket has written enough
+    if(client.unwritten >= maxUnwritten) return;
+    auto send = [&client](const QJsonObject &msg){
+        client.unwritten += client.socket->sendTextMessage(QString::fromUtf8(QJsonDocument(msg).toJson(QJsonDocument::Compact)));
+    };
+    for(const QString &type : client.order)
+    {
+        send(client.latest[type]);
+    }
+    client.order.clear();
+    client.latest.clear();
+    if(client.danmuReset)
+    {
+        send({{"type", "danmu"}, {"pool", client.danmuPool}, {"reset", true}});
+    }
+    else if(!client.danmu.isEmpty())
+    {
+        send({{"type", "danmu"}, {"pool", client.danmuPool}, {"data", client.danmu}});
+    }
+    client.danmu = QJsonArray();
+    client.danmuReset = false;
+}
@@ -0,0 +1,72 @@
+#ifndef PUSHSERVICE_H
+#define PUSHSERVICE_H
+
+#include <QObject>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QTimer>
+#include "Play/Danmu/common.h"
+class QTcpSocket;
+class QWebSocket;
+class QWebSocketServer;
+class EventListener;
+class Pool;
+/*
+ * WebSocket channel of the LAN server (/api/ws), upgraded from connections of the http server.
+ * Pushes compact JSON messages:
+ *   {"type":"state", ...}     player state, file and pool
+ *   {"type":"pos","time":ms}  position ticks
+ *   {"type":"danmu","pool":pid,"data":[...]}  new comments of the current pool, in the format of /api/danmu/v3/
+ *   {"type":"playlist"}       the playlist changed, /api/playlist answers with a new ETag
+ * Messages wait in a queue per client and are flushed every flushInterval.
+ * State messages replace the pending one of the same type, so a slow client only gets the latest state,
+ * and its danmu queue is replaced by a reset message beyond maxPendingDanmu.
+ */
+class PushService : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PushService(QObject *parent = nullptr);
+    ~PushService();
+
+    static bool isPushRequest(const QByteArray &head);
+    // called in the I/O thread of the http server, the socket has no parent
+    void addSocket(QTcpSocket *socket);
+
+private:
+    struct Client
+    {
+        QWebSocket *socket = nullptr;
+        QStringList order;
+        QHash<QString, QJsonObject> latest;
+        QJsonArray danmu;
+        QString danmuPool;
+        bool danmuReset = false;
+        qint64 unwritten = 0;
+    };
+    static const int maxClients = 64;
+    static const int flushInterval = 200;  // ms
+    static const int positionInterval = 1000;  // ms
+    static const int maxPendingDanmu = 2000;
+    static const qint64 maxUnwritten = 256 * 1024;
+
+    QWebSocketServer *server;
+    QHash<QWebSocket *, Client> clients;
+    QList<EventListener *> listeners;
+    QList<QMetaObject::Connection> sourceConnections;
+    QMetaObject::Connection poolConnection;
+    QTimer flushTimer;
+    int lastPushedPosition;
+
+    void onNewConnection();
+    void watchSources(bool on);
+    void watchPool(Pool *pool);
+    void publish(const QString &type, const QJsonObject &msg);
+    void publishDanmu(const QString &pid, const QJsonArray &danmu);
+    void publishState();
+    void scheduleFlush();
+    void flush(Client &client);
+};
+
+#endif // PUSHSERVICE_H
@@ -0,0 +1,145 @@
+#include "responsecache.h"
+#include "globalobjects.h"
+#include "Common/network.h"
+#include "Common/metrics.h"
+#include "Play/Danmu/Manager/pool.h"
+#include "Play/Danmu/blocker.h"
+#include "httpserver/httprequest.h"
+#include "httpserver/httpresponse.h"
+#include <QCryptographicHash>
+#include <algorithm>
+
+ResponseCache::ResponseCache(QObject *parent) : QObject(parent), blockVersion(0), useCounter(0)
+{
+    // block rules change the blockBy flag of comments in every pool
+    auto onRuleChanged = [this](){
+        QMutexLocker locker(&lock);
+        ++blockVersion;
+    };
+    QObject::connect(GlobalObjects::blocker, &Blocker::dataChanged, this, onRuleChanged, Qt::DirectConnection);
+    QObject::connect(GlobalObjects::blocker, &Blocker::rowsInserted, this, onRuleChanged, Qt::DirectConnection);
+    QObject::connect(GlobalObjects::blocker, &Blocker::rowsRemoved, this, onRuleChanged, Qt::DirectConnection);
+    QObject::connect(GlobalObjects::blocker, &Blocker::modelReset, this, onRuleChanged, Qt::DirectConnection);
+}
+
+quint64 ResponseCache::poolVersion(Pool *pool)
+{
+    QMutexLocker locker(&lock);
+    watchPool(pool);
+    // both counters only grow, so the sum changes whenever one of them does
+    return pool->version() + blockVersion;
+}
+
+bool ResponseCache::get(const QString &key, quint64 version, Entry &entry)
+{
+    // danmu/<pool id> -> danmu
+    const QString cacheName = key.section('/', 0, 0);
+    QMutexLocker locker(&lock);
+    auto iter = entries.find(key);
+    if(iter == entries.end() || iter->version != version)
+    {
+        Metrics::instance()->add("kikoplay_response_cache_requests_total", 1, {cacheName, "miss"});
+        return false;
+    }
+    iter->lastUse = ++useCounter;
+    entry = *iter;
+    Metrics::instance()->add("kikoplay_response_cache_requests_total", 1, {cacheName, "hit"});
+    return true;
+}
+
+ResponseCache::Entry ResponseCache::put(const QString &key, quint64 version, const QByteArray &data)
+{
+    Entry entry;
+    Network::gzipCompress(data, entry.body);
+    entry.etag = '"' + QCryptographicHash::hash(entry.body, QCryptographicHash::Md5).toHex() + '"';
+    entry.version = version;
+    QMutexLocker locker(&lock);
+    // a slower request must not replace a newer body
+    auto cur = entries.find(key);
+    if(cur != entries.end() && cur->version > version) return entry;
+    if(cur == entries.end() && entries.size() >= maxEntries)
+    {
+        auto lru = entries.begin();
+        for(auto iter = entries.begin(); iter != entries.end(); ++iter)
+        {
+            if(iter->lastUse < lru->lastUse) lru = iter;
+        }
+        entries.erase(lru);
+    }
+    entry.lastUse = ++useCounter;
+    entries.insert(key, entry);
+    return entry;
+}
+
+QSharedPointer<const ResponseCache::CommentList> ResponseCache::timeline(Pool *pool)
+{
+    // blocked comments are filtered when a window is read, so only changes of the pool count here
+    const quint64 version = pool->version();
+    {
+        QMutexLocker locker(&lock);
+        watchPool(pool);
+        auto iter = timelines.find(pool->id());
+        if(iter != timelines.end() && iter->first == version)
+        {
+            Metrics::instance()->add("kikoplay_response_cache_requests_total", 1, {"timeline", "hit"});
+            return iter->second;
+        }
+    }
+    Metrics::instance()->add("kikoplay_response_cache_requests_total", 1, {"timeline", "miss"});
+    // the pool is only kept sorted while it is played
+    QSharedPointer<CommentList> list(new CommentList(pool->comments()));
+    std::stable_sort(list->begin(), list->end(), [](const QSharedPointer<DanmuComment> &dm1, const QSharedPointer<DanmuComment> &dm2){
+        return dm1->time < dm2->time;
+    });
+    QMutexLocker locker(&lock);
+    auto iter = timelines.find(pool->id());
+    if(iter != timelines.end() && iter->first > version) return list;
+    if(iter == timelines.end() && timelines.size() >= maxEntries) timelines.clear();
+    timelines.insert(pool->id(), {version, list});
+    return list;
+}
+
+void ResponseCache::write(stefanfrings::HttpRequest &request, stefanfrings::HttpResponse &response, const Entry &entry)
+{
+    response.setHeader("ETag", entry.etag);
+    response.setHeader("Cache-Control", "no-cache");
+    const QByteArray ifNoneMatch = request.getHeader("If-None-Match");
+    if(!ifNoneMatch.isEmpty())
+    {
+        for(QByteArray tag : ifNoneMatch.split(','))
+        {
+            tag = tag.trimmed();
+            if(tag.startsWith("W/")) tag = tag.mid(2);
+            if(tag == entry.etag || tag == "*")
+            {
+                response.setStatus(304, "Not Modified");
+                response.write(QByteArray(), true);
+                return;
+            }
+        }
+    }
+    response.setHeader("Content-Type", "application/json");
+    response.setHeader("Content-Encoding", "gzip");
+    response.write(entry.body, true);
+}
+
+void ResponseCache::watchPool(Pool *pool)
+{
+    const QString pid = pool->id();
+    if(watchedPools.contains(pid)) return;
+    watchedPools.insert(pid);
+    // drop the entries of a destroyed pool
+    QObject::connect(pool, &QObject::destroyed, this, [this, pid](){
+        invalidatePool(pid);
+        QMutexLocker locker(&lock);
+        watchedPools.remove(pid);
+    }, Qt::DirectConnection);
+}
+
+void ResponseCache::invalidatePool(const QString &pid)
+{
+    QMutexLocker locker(&lock);
+    entries.remove("danmu/" + pid);
+    entries.remove("danmufull/" + pid);
+    timelines.remove(pid);
+}
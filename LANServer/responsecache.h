@@ -0,0 +1,61 @@
+#ifndef RESPONSECACHE_H
+#define RESPONSECACHE_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QVector>
+class Pool;
+struct DanmuComment;
+namespace stefanfrings
+{
+class HttpRequest;
+class HttpResponse;
+}
+/*
+ * Gzipped API responses, keyed by (endpoint, version).
+ * Pool versions combine Pool::version with a count of block rule changes,
+ * the playlist version is the version of its snapshot.
+ * Entries carry a strong ETag, so clients revalidate with If-None-Match and get 304.
+ * Time-sorted copies of the pools (timeline) are kept for Pool::version alone.
+ * Thread-safe, used by the workers of the http server.
+ */
+class ResponseCache : public QObject
+{
+    Q_OBJECT
+public:
+    struct Entry
+    {
+        QByteArray body;  // gzip
+        QByteArray etag;
+        quint64 version = 0;
+        quint64 lastUse = 0;
+    };
+
+    using CommentList = QVector<QSharedPointer<DanmuComment> >;
+
+    explicit ResponseCache(QObject *parent = nullptr);
+
+    quint64 poolVersion(Pool *pool);
+    bool get(const QString &key, quint64 version, Entry &entry);
+    Entry put(const QString &key, quint64 version, const QByteArray &data);
+    QSharedPointer<const CommentList> timeline(Pool *pool);
+
+    static void write(stefanfrings::HttpRequest &request, stefanfrings::HttpResponse &response, const Entry &entry);
+
+private:
+    static const int maxEntries = 32;
+
+    QMutex lock;
+    QHash<QString, Entry> entries;
+    QHash<QString, QPair<quint64, QSharedPointer<const CommentList>>> timelines;
+    QSet<QString> watchedPools;
+    quint64 blockVersion, useCounter;
+
+    void watchPool(Pool *pool);
+    void invalidatePool(const QString &pid);
+};
+
+#endif // RESPONSECACHE_H
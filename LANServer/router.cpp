@@ -4,7 +4,10 @@
 #include "globalobjects.h"
 #include "lanserver.h"
 #include "dlna/upnp.h"
+#include "pushservice.h"
+#include "Common/metrics.h"
 #include <QCoreApplication>
+#include <QElapsedTimer>
 
 Router::Router(QObject *parent) : stefanfrings::HttpRequestHandler(parent)
 {
@@ -33,17 +36,42 @@ Router::Router(QObject *parent) : stefanfrings::HttpRequestHandler(parent)
 
 void Router::service(stefanfrings::HttpRequest &request, stefanfrings::HttpResponse &response)
 {
+    QElapsedTimer timer;
+    timer.start();
     QByteArray path = request.getPath();
+    QString route;
     if(path.startsWith("/api/"))
     {
+        route = APIHandler::routeName(path);
         apiHandler->service(request, response);
     }
     else if(path.startsWith("/upnp/"))
     {
+        route = "upnp";
         GlobalObjects::lanServer->getUPnP()->handleHttpRequest(request, response);
     }
+    else if(path == "/metrics")
+    {
+        route = "metrics";
+        response.setHeader("Content-Type", "text/plain; version=0.0.4; charset=utf-8");
+        response.setHeader("Cache-Control", "no-store");
+        response.write(Metrics::instance()->exposition(), true);
+    }
     else
     {
+        route = path.startsWith("/media/")? "media" : path.startsWith("/sub/")? "subtitle" : "static";
         fileHandler->service(request, response);
     }
+    Metrics::instance()->add("kikoplay_http_requests_total", 1, {route, QString::number(response.getStatusCode())});
+    Metrics::instance()->observe("kikoplay_http_request_duration_seconds", timer.nsecsElapsed() / 1e9, {route});
+}
+
+bool Router::acceptsUpgrade(const QByteArray &head)
+{
+    return PushService::isPushRequest(head);
+}
+
+void Router::upgrade(QTcpSocket *socket)
+{
+    GlobalObjects::lanServer->getPushService()->addSocket(socket);
 }
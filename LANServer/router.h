@@ -11,6 +11,8 @@ class Router : public stefanfrings::HttpRequestHandler
 public:
     Router(QObject* parent = nullptr);
     void service(stefanfrings::HttpRequest& request, stefanfrings::HttpResponse& response);
+    bool acceptsUpgrade(const QByteArray &head);
+    void upgrade(QTcpSocket *socket);
 private:
     FileHandler *fileHandler;
     APIHandler *apiHandler;
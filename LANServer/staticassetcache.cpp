@@ -0,0 +1,228 @@
+#include "staticassetcache.h"
+#include "Common/network.h"
+#include "httpserver/httprequest.h"
+#include "httpserver/httpresponse.h"
+#include <QDirIterator>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <QRegularExpression>
+
+void StaticAssetCache::setRoot(const QString &path)
+{
+    {
+        QWriteLocker locker(&lock);
+        root.setPath(path);
+        assets.clear();
+        cacheSize = 0;
+    }
+    QDirIterator iter(path, QDir::Files, QDirIterator::Subdirectories);
+    while(iter.hasNext())
+    {
+        const QString filePath = root.relativeFilePath(iter.next());
+        if(filePath.endsWith(".br")) continue;
+        lookup(filePath);
+    }
+}
+
+bool StaticAssetCache::service(stefanfrings::HttpRequest &request, stefanfrings::HttpResponse &response, const QString &path)
+{
+    if(!request.getHeader("Range").isEmpty()) return false;
+    const QString assetPath = QDir::cleanPath(path);
+    if(assetPath.startsWith("..")) return false;
+    QSharedPointer<const Asset> asset = lookup(assetPath);
+    if(!asset) return false;
+
+    const QByteArray acceptEncoding = request.getHeader("Accept-Encoding");
+    const QByteArray *body = &asset->data;
+    QByteArray encoding, etag = asset->hash;
+    if(!asset->brotli.isEmpty() && acceptsEncoding(acceptEncoding, "br"))
+    {
+        body = &asset->brotli;
+        encoding = "br";
+    }
+    else if(!asset->gzip.isEmpty() && acceptsEncoding(acceptEncoding, "gzip"))
+    {
+        body = &asset->gzip;
+        encoding = "gzip";
+    }
+    // each representation has its own strong ETag
+    if(!encoding.isEmpty()) etag += '-' + encoding;
+    etag = '"' + etag + '"';
+
+    response.setHeader("ETag", etag);
+    if(asset->gzip.size() || asset->brotli.size()) response.setHeader("Vary", "Accept-Encoding");
+    const bool versioned = !asset->isHtml && request.getParameter("v") == asset->version;
+    response.setHeader("Cache-Control", versioned? "public, max-age=31536000, immutable" : "no-cache");
+    const QByteArray ifNoneMatch = request.getHeader("If-None-Match");
+    if(!ifNoneMatch.isEmpty())
+    {
+        for(QByteArray tag : ifNoneMatch.split(','))
+        {
+            tag = tag.trimmed();
+            if(tag.startsWith("W/")) tag = tag.mid(2);
+            if(tag == etag || tag == "*")
+            {
+                response.setStatus(304, "Not Modified");
+                response.write(QByteArray(), true);
+                return true;
+            }
+        }
+    }
+    response.setHeader("Content-Type", asset->mimeType);
+    if(!encoding.isEmpty()) response.setHeader("Content-Encoding", encoding);
+    response.write(*body, true);
+    return true;
+}
+
+QSharedPointer<const StaticAssetCache::Asset> StaticAssetCache::lookup(const QString &path)
+{
+    const QFileInfo info(root.absoluteFilePath(path));
+    if(!info.isFile() || !info.isReadable() || info.size() > maxAssetSize) return nullptr;
+    QSharedPointer<const Asset> asset;
+    {
+        QReadLocker locker(&lock);
+        asset = assets.value(path);
+    }
+    if(asset && asset->mtime == info.lastModified().toMSecsSinceEpoch() && asset->size == info.size())
+    {
+        if(!asset->isHtml) return asset;
+        // the page is rewritten when one of the assets it references has changed
+        bool refChanged = false;
+        for(auto iter = asset->refVersions.cbegin(); iter != asset->refVersions.cend(); ++iter)
+        {
+            QSharedPointer<const Asset> ref = lookup(iter.key());
+            if(!ref || ref->version != iter.value())
+            {
+                refChanged = true;
+                break;
+            }
+        }
+        if(!refChanged) return asset;
+        QSharedPointer<Asset> page(new Asset(*asset));
+        rewriteHtml(path, *page);
+        asset = page;
+    }
+    else
+    {
+        asset = load(path, info);
+        if(!asset) return nullptr;
+    }
+    const qint64 cost = asset->source.size() + asset->data.size() + asset->gzip.size() + asset->brotli.size();
+    QWriteLocker locker(&lock);
+    auto old = assets.find(path);
+    if(old != assets.end())
+    {
+        cacheSize -= (*old)->source.size() + (*old)->data.size() + (*old)->gzip.size() + (*old)->brotli.size();
+        assets.erase(old);
+    }
+    // beyond the limit the asset is only used for this request
+    if(cacheSize + cost <= maxCacheSize)
+    {
+        assets.insert(path, asset);
+        cacheSize += cost;
+    }
+    return asset;
+}
+
+QSharedPointer<StaticAssetCache::Asset> StaticAssetCache::load(const QString &path, const QFileInfo &info)
+{
+    QFile file(info.absoluteFilePath());
+    if(!file.open(QIODevice::ReadOnly)) return nullptr;
+    QSharedPointer<Asset> asset(new Asset);
+    asset->mtime = info.lastModified().toMSecsSinceEpoch();
+    asset->size = info.size();
+    asset->mimeType = database.mimeTypeForFile(info).name().toUtf8();
+    asset->isHtml = asset->mimeType == "text/html";
+    if(asset->isHtml)
+    {
+        asset->source = file.readAll();
+        rewriteHtml(path, *asset);
+    }
+    else
+    {
+        asset->data = file.readAll();
+        compress(*asset, info.absoluteFilePath());
+    }
+    return asset;
+}
+
+void StaticAssetCache::rewriteHtml(const QString &path, Asset &asset)
+{
+    // relative src/href values without query or fragment
+    static const QRegularExpression refExp("\\b(?:src|href)=\"([^\"?#:/][^\"?#:]*)\"");
+    const QString dir = QFileInfo(path).path();
+    const QString page = QString::fromUtf8(asset.source);
+    QString result;
+    result.reserve(page.size() + 256);
+    asset.refVersions.clear();
+    int last = 0;
+    QRegularExpressionMatchIterator iter = refExp.globalMatch(page);
+    while(iter.hasNext())
+    {
+        const QRegularExpressionMatch match = iter.next();
+        const QString refPath = QDir::cleanPath(dir + '/' + match.captured(1));
+        // pages are never versioned, they may reference each other
+        if(refPath.startsWith("..") || database.mimeTypeForFile(refPath, QMimeDatabase::MatchExtension).name() == "text/html") continue;
+        QSharedPointer<const Asset> ref = lookup(refPath);
+        if(!ref) continue;
+        result += page.midRef(last, match.capturedEnd(1) - last);
+        result += "?v=" + QString::fromLatin1(ref->version);
+        last = match.capturedEnd(1);
+        asset.refVersions.insert(refPath, ref->version);
+    }
+    result += page.midRef(last);
+    asset.data = result.toUtf8();
+    compress(asset, QString());
+}
+
+void StaticAssetCache::compress(Asset &asset, const QString &filePath)
+{
+    asset.hash = QCryptographicHash::hash(asset.data, QCryptographicHash::Md5).toHex();
+    asset.version = asset.hash.left(8);
+    asset.gzip.clear();
+    asset.brotli.clear();
+    if(asset.data.isEmpty() || !isCompressible(asset.mimeType)) return;
+    // a variant is only kept if it saves at least a tenth
+    const int maxCompressedSize = asset.data.size() - asset.data.size() / 10;
+    if(Network::gzipCompress(asset.data, asset.gzip) != 0 || asset.gzip.size() > maxCompressedSize)
+    {
+        asset.gzip.clear();
+    }
+    // there is no brotli encoder here, a precompressed file can be put next to the asset
+    if(filePath.isEmpty()) return;
+    const QFileInfo brInfo(filePath + ".br");
+    if(!brInfo.isFile() || brInfo.lastModified() < QFileInfo(filePath).lastModified()) return;
+    QFile brFile(brInfo.absoluteFilePath());
+    if(brFile.open(QIODevice::ReadOnly) && brFile.size() <= maxCompressedSize)
+    {
+        asset.brotli = brFile.readAll();
+    }
+}
+
+bool StaticAssetCache::isCompressible(const QByteArray &mimeType)
+{
+    static const QList<QByteArray> compressibleTypes{"javascript", "json", "xml", "svg", "ttf", "otf", "fontobject"};
+    if(mimeType.startsWith("text/")) return true;
+    for(const QByteArray &type : compressibleTypes)
+    {
+        if(mimeType.contains(type)) return true;
+    }
+    return false;
+}
+
+bool StaticAssetCache::acceptsEncoding(const QByteArray &acceptEncoding, const QByteArray &coding)
+{
+    for(const QByteArray &item : acceptEncoding.split(','))
+    {
+        const QList<QByteArray> params = item.split(';');
+        const QByteArray name = params.first().trimmed().toLower();
+        if(name != coding && name != "*") continue;
+        for(int i = 1; i < params.size(); ++i)
+        {
+            const QByteArray param = params[i].trimmed();
+            if(param.startsWith("q=") && param.mid(2).toDouble() <= 0) return false;
+        }
+        return true;
+    }
+    return false;
+}
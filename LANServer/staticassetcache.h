@@ -0,0 +1,60 @@
+#ifndef STATICASSETCACHE_H
+#define STATICASSETCACHE_H
+
+#include <QDir>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QSharedPointer>
+#include <QMimeDatabase>
+namespace stefanfrings
+{
+class HttpRequest;
+class HttpResponse;
+}
+/*
+ * In-memory copy of the web root, loaded when the root is set.
+ * Each asset keeps its gzip variant, and the brotli variant when a precompressed "<file>.br" lies next to it.
+ * Files are checked against their mtime and size on every request and reloaded when they change.
+ * Html pages are rewritten to reference the assets they load with "?v=<version>":
+ * those urls are cached by the browser for a year, everything else is revalidated with the ETag.
+ * Thread-safe, used by the workers of the http server.
+ */
+class StaticAssetCache
+{
+public:
+    StaticAssetCache() {}
+
+    void setRoot(const QString &path);
+    // false if the file has to be served from disk: missing, too large or a range request
+    bool service(stefanfrings::HttpRequest &request, stefanfrings::HttpResponse &response, const QString &path);
+
+private:
+    struct Asset
+    {
+        QByteArray source;  // html only, before rewriting
+        QByteArray data, gzip, brotli;
+        QByteArray hash, version;
+        QByteArray mimeType;
+        bool isHtml = false;
+        qint64 mtime = 0, size = 0;
+        QHash<QString, QByteArray> refVersions;  // html only, versions written into the page
+    };
+    static const qint64 maxAssetSize = 4 * 1024 * 1024;
+    static const qint64 maxCacheSize = 64 * 1024 * 1024;
+
+    QDir root;
+    QMimeDatabase database;
+    QReadWriteLock lock;
+    QHash<QString, QSharedPointer<const Asset>> assets;
+    qint64 cacheSize = 0;
+
+    QSharedPointer<const Asset> lookup(const QString &path);
+    QSharedPointer<Asset> load(const QString &path, const QFileInfo &info);
+    void rewriteHtml(const QString &path, Asset &asset);
+    void compress(Asset &asset, const QString &filePath);
+
+    static bool isCompressible(const QByteArray &mimeType);
+    static bool acceptsEncoding(const QByteArray &acceptEncoding, const QByteArray &coding);
+};
+
+#endif // STATICASSETCACHE_H
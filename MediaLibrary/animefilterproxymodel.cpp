@@ -1,23 +1,61 @@
 #include "animefilterproxymodel.h"
 #include "animemodel.h"
 #include "labelmodel.h"
+#include "animeworker.h"
+#include <QTimer>
 
-AnimeFilterProxyModel::AnimeFilterProxyModel(AnimeModel *srcModel, QObject *parent):QSortFilterProxyModel(parent),filterType(0), orderType(O_AddTime), ascending(false)
+AnimeFilterProxyModel::AnimeFilterProxyModel(AnimeModel *srcModel, QObject *parent):QSortFilterProxyModel(parent),filterType(0), orderType(O_AddTime), ascending(false),
+    tagMatchesRevision(0), tagMatchesValid(false), searchActive(false)
 {
     QObject::connect(srcModel, &AnimeModel::animeCountInfo,this, &AnimeFilterProxyModel::refreshAnimeCount);
+    searchTimer = new QTimer(this);
+    searchTimer->setSingleShot(true);
+    searchTimer->setInterval(searchDelay);
+    QObject::connect(searchTimer, &QTimer::timeout, this, [this](){
+        applyFilter(4, pendingSearch);
+    });
 }
 
 void AnimeFilterProxyModel::setFilter(int type, const QString &str)
+{
+    // without a full-text index "All" searches the titles of the loaded animes
+    if(type == 4 && !AnimeWorker::instance()->hasSearchIndex()) type = 0;
+    searchTimer->stop();
+    // the filter follows every keystroke, a full-text query only runs once the text stays unchanged
+    if(type == 4 && !str.trimmed().isEmpty())
+    {
+        pendingSearch = str;
+        searchTimer->start();
+        return;
+    }
+    applyFilter(type, str);
+}
+
+void AnimeFilterProxyModel::applyFilter(int type, const QString &str)
 {
     filterType=type;
-    setFilterRegExp(str);
+    const bool wasSearchActive = searchActive;
+    searchActive = type == 4 && !str.trimmed().isEmpty();
+    searchRanks.clear();
+    if(searchActive)
+    {
+        // every hit, hits on pages not fetched yet are loaded by name
+        const QStringList names = AnimeWorker::instance()->searchAnimes(str, -1);
+        for(int i = 0; i < names.size(); ++i)
+            searchRanks.insert(names[i], i);
+        static_cast<AnimeModel *>(sourceModel())->fetchAnimes(names);
+    }
     setFilterCaseSensitivity(Qt::CaseInsensitive);
+    setFilterRegExp(str);
+    // the ranks decide the order while searching
+    if(searchActive || wasSearchActive) invalidate();
     static_cast<AnimeModel *>(sourceModel())->showStatisMessage();
 }
 
 void AnimeFilterProxyModel::setTags(SelectedLabelInfo &&selectedLabels)
 {
     filterLabels = selectedLabels;
+    tagMatchesValid = false;
     invalidateFilter();
     static_cast<AnimeModel *>(sourceModel())->showStatisMessage();
 }
@@ -61,56 +99,11 @@ bool AnimeFilterProxyModel::filterAcceptsRow(int source_row, const QModelIndex &
      QString animeTime(anime->airDate().left(7));
      if(!filterLabels.timeTags.isEmpty() && !filterLabels.timeTags.contains(animeTime))return false;
 
-     if(!filterLabels.epPathTags.isEmpty())
-     {
-         bool contains = false;
-         for(const QString &tag : filterLabels.epPathTags)
-         {
-             auto iter = LabelModel::instance()->epTags().lowerBound(tag);
-             while(iter != LabelModel::instance()->epTags().end() && iter.key().startsWith(tag))
-             {
-                 if(iter.key()==tag || iter.key().startsWith(tag+'/'))
-                 {
-                     if(iter.value().contains(anime->name()))
-                     {
-                         contains = true;
-                         break;
-                     }
-                 }
-                 ++iter;
-             }
-             if(contains) break;
-         }
-         if(!contains) return false;
-     }
-
-     if(!filterLabels.customPrefixTags.isEmpty())
+     if(!filterLabels.epPathTags.isEmpty() || !filterLabels.customPrefixTags.isEmpty() || !filterLabels.customTags.isEmpty())
      {
-         bool contains = false;
-         for(const QString &tag : filterLabels.customPrefixTags)
-         {
-             auto iter = LabelModel::instance()->customTags().lowerBound(tag);
-             while(iter != LabelModel::instance()->customTags().end() && iter.key().startsWith(tag))
-             {
-                 if(iter.key()==tag || iter.key().startsWith(tag+'/'))
-                 {
-                     if(iter.value().contains(anime->name()))
-                     {
-                         contains = true;
-                         break;
-                     }
-                 }
-				 ++iter;
-             }
-             if(contains) break;
-         }
-         if(!contains) return false;
-     }
-
-     for(const QString &tag : filterLabels.customTags)
-     {
-         if(!LabelModel::instance()->customTags()[tag].contains(anime->name()))
-             return false;
+         if(!tagMatchesValid || tagMatchesRevision != LabelModel::instance()->tagBitsRevision()) updateTagMatches();
+         const int ordinal = LabelModel::instance()->animeOrdinal(anime->name());
+         if(ordinal < 0 || ordinal >= tagMatches.size() || !tagMatches.testBit(ordinal)) return false;
      }
 
      switch (filterType)
@@ -137,15 +130,52 @@ bool AnimeFilterProxyModel::filterAcceptsRow(int source_row, const QModelIndex &
          }
          return false;
      }
+     case 4://all, full-text index
+         return !searchActive || searchRanks.contains(anime->name());
      }
      return true;
 }
 
+void AnimeFilterProxyModel::updateTagMatches() const
+{
+    // tags of a category are or-ed, categories and exact custom tags are and-ed
+    LabelModel *labelModel = LabelModel::instance();
+    bool first = true;
+    auto intersect = [&](const QBitArray &bits){
+        if(first) tagMatches = bits;
+        else tagMatches &= bits;
+        first = false;
+    };
+    if(!filterLabels.epPathTags.isEmpty())
+    {
+        QBitArray bits;
+        for(const QString &tag : filterLabels.epPathTags)
+            bits |= labelModel->epTagBits(tag);
+        intersect(bits);
+    }
+    if(!filterLabels.customPrefixTags.isEmpty())
+    {
+        QBitArray bits;
+        for(const QString &tag : filterLabels.customPrefixTags)
+            bits |= labelModel->customTagBits(tag, true);
+        intersect(bits);
+    }
+    for(const QString &tag : filterLabels.customTags)
+        intersect(labelModel->customTagBits(tag, false));
+    tagMatchesRevision = labelModel->tagBitsRevision();
+    tagMatchesValid = true;
+}
+
 bool AnimeFilterProxyModel::lessThan(const QModelIndex &source_left, const QModelIndex &source_right) const
 {
     AnimeModel *model = static_cast<AnimeModel *>(sourceModel());
     Anime *animeL = model->getAnime(source_left), *animeR = model->getAnime(source_right);
     static QCollator comparer;
+    if(searchActive)
+    {
+        const int rankL = searchRanks.value(animeL->name(), searchRanks.size()), rankR = searchRanks.value(animeR->name(), searchRanks.size());
+        if(rankL != rankR) return rankL < rankR;
+    }
     switch (orderType)
     {
     case O_AddTime:
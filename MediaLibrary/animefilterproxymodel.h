@@ -4,6 +4,7 @@
 #include <QSortFilterProxyModel>
 #include "labelmodel.h"
 class AnimeModel;
+class QTimer;
 class AnimeFilterProxyModel : public QSortFilterProxyModel
 {
     Q_OBJECT
@@ -27,6 +28,18 @@ private:
     OrderType orderType;
     bool ascending;
     SelectedLabelInfo filterLabels;
+    // full-text search: anime -> rank, results are shown best match first
+    QHash<QString, int> searchRanks;
+    bool searchActive;
+    static const int searchDelay = 300;  // ms
+    QTimer *searchTimer;
+    QString pendingSearch;
+    void applyFilter(int type, const QString &str);
+    // animes (by LabelModel ordinal) matching the selected file and custom tags
+    mutable QBitArray tagMatches;
+    mutable quint64 tagMatchesRevision;
+    mutable bool tagMatchesValid;
+    void updateTagMatches() const;
     void refreshAnimeCount(int cur, int total);
     // QSortFilterProxyModel interface
 protected:
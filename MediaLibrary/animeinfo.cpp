@@ -12,10 +12,14 @@ LRUCache<Anime *, QSharedPointer<QPixmap>> coverCache{"PreviewCover", 128, true}
 const QPixmap &Anime::cover(bool onlyCache)
 {
     static QPixmap emptyCover;
-    if(_coverData.isEmpty()) return emptyCover;
+    if(coverLoaded && _coverData.isEmpty()) return emptyCover;
     QSharedPointer<QPixmap> cover = coverCache.get(this);
     if(cover) return *cover;
     if(onlyCache) return emptyCover;
+    // loaded and decoded in the background, AnimeWorker::coverLoaded is emitted when it is ready
+    if(AnimeWorker::instance()->requestCover(this)) return emptyCover;
+    AnimeWorker::instance()->loadCover(this);
+    if(_coverData.isEmpty()) return emptyCover;
     QBuffer bufferImage(&_coverData);
     bufferImage.open(QIODevice::ReadOnly);
     QImageReader reader(&bufferImage);
@@ -29,6 +33,7 @@ const QPixmap &Anime::rawCover()
 {
     QSharedPointer<QPixmap> cover = rawCoverCache.get(this);
     if(cover) return *cover;
+    AnimeWorker::instance()->loadCover(this);
     QPixmap tmp;
     if(!_coverData.isEmpty())
     {
@@ -39,7 +44,12 @@ const QPixmap &Anime::rawCover()
     return *cover;
 }
 
-Anime::Anime() : _addTime(0), _epCount(0), crtImagesLoaded(false), epLoaded(false)
+void Anime::setPreviewCover(const QImage &preview)
+{
+    coverCache.put(this, QSharedPointer<QPixmap>::create(QPixmap::fromImage(preview)));
+}
+
+Anime::Anime() : _addTime(0), _epCount(0), crtImagesLoaded(false), epLoaded(false), coverLoaded(true)
 {
 
 }
@@ -69,6 +79,7 @@ void Anime::setCover(const QByteArray &data, bool updateDB, const QString &cover
     if(updateDB)
         AnimeWorker::instance()->updateCoverImage(_name, data, coverURL);
     _coverData = data;
+    coverLoaded = true;
     coverCache.remove(this);
     rawCoverCache.remove(this);
     if(coverURL != emptyCoverURL) _coverURL = coverURL;
@@ -132,6 +143,7 @@ void Anime::assign(const Anime *anime)
     _airDate = anime->_airDate;
     _coverURL = anime->_coverURL;
     _coverData = anime->_coverData;
+    coverLoaded = anime->coverLoaded;
     _scriptId = anime->_scriptId;
     _scriptData = anime->_scriptData;
     _epCount = anime->_epCount;
@@ -151,6 +151,7 @@ class Anime
     int _epCount;
     bool crtImagesLoaded;
     bool epLoaded;
+    bool coverLoaded;  // library pages are fetched without the Cover blob
 
 public:
     const QString &name() const {return _name;}
@@ -202,6 +203,7 @@ public:
 
 private:
     void assign(const Anime *anime);
+    void setPreviewCover(const QImage &preview);
     void setStaffs(const QString &staffStrs);
     QString staffToStr() const;
     static QString staffListToStr(const QVector<QPair<QString,QString>> &staffs);
@@ -13,6 +13,12 @@ AnimeModel::AnimeModel(QObject *parent):QAbstractItemModel(parent),
     limitCount = qMax(limitCount, 8);
     QObject::connect(AnimeWorker::instance(), &AnimeWorker::animeAdded, this, &AnimeModel::addAnime);
     QObject::connect(AnimeWorker::instance(), &AnimeWorker::animeRemoved, this, &AnimeModel::removeAnime);
+    QObject::connect(AnimeWorker::instance(), &AnimeWorker::coverLoaded, this, [this](Anime *anime){
+        const int row = animes.indexOf(anime);
+        if(row < 0) return;
+        QModelIndex index(createIndex(row, 0));
+        emit dataChanged(index, index);
+    });
     QObject::connect(AnimeWorker::instance(), &AnimeWorker::animeUpdated, this, [](Anime *anime){
         if (EventBus::getEventBus()->hasListener(EventBus::EVENT_LIBRARY_ANIME_UPDATED))
         {
@@ -31,14 +37,17 @@ void AnimeModel::init()
         totalCount += AnimeWorker::instance()->animeCount();
         QSharedPointer<QVector<Anime *>> animes = QSharedPointer<QVector<Anime *>>::create();
         animes->reserve(limitCount);
-        AnimeWorker::instance()->fetchAnimes(animes.get(), 0, limitCount);
+        const int fetched = AnimeWorker::instance()->fetchAnimes(animes.get(), 0, limitCount);
         ThreadTask task(this->thread());
-        task.RunOnce([animes, this](){
-            beginInsertRows(QModelIndex(), 0, animes->count()-1);
-            this->animes.append(*animes);
-            endInsertRows();
-            currentOffset+=animes->count();
-            hasMoreAnimes = animes->count() >= limitCount;
+        task.RunOnce([animes, fetched, this](){
+            if(!animes->isEmpty())
+            {
+                beginInsertRows(QModelIndex(), this->animes.count(), this->animes.count()+animes->count()-1);
+                this->animes.append(*animes);
+                endInsertRows();
+            }
+            currentOffset+=fetched;
+            hasMoreAnimes = fetched >= limitCount;
             showStatisMessage();
             Notifier::getNotifier()->showMessage(Notifier::LIBRARY_NOTIFY, tr("Down"), NM_HIDE);
         });
@@ -136,16 +145,28 @@ void AnimeModel::fetchMore(const QModelIndex &)
     QVector<Anime *> moreAnimes;
     hasMoreAnimes=false;
     Notifier::getNotifier()->showMessage(Notifier::LIBRARY_NOTIFY, tr("Fetching..."), NM_PROCESS | NM_DARKNESS_BACK);
-    AnimeWorker::instance()->fetchAnimes(&moreAnimes, currentOffset, limitCount);
-	hasMoreAnimes = moreAnimes.count() >= limitCount;
+    const int fetched = AnimeWorker::instance()->fetchAnimes(&moreAnimes, currentOffset, limitCount);
+	hasMoreAnimes = fetched >= limitCount;
+    currentOffset += fetched;
     if(moreAnimes.count() > 0)
     {
         beginInsertRows(QModelIndex(),animes.count(),animes.count()+moreAnimes.count()-1);
         animes.append(moreAnimes);
         endInsertRows();
-        currentOffset += moreAnimes.count();
         showStatisMessage();
     }
     Notifier::getNotifier()->showMessage(Notifier::LIBRARY_NOTIFY, tr("Down"), NM_HIDE);
 }
 
+void AnimeModel::fetchAnimes(const QStringList &names)
+{
+    if(!inited) return;
+    QVector<Anime *> hitAnimes;
+    AnimeWorker::instance()->fetchAnimes(&hitAnimes, names);
+    if(hitAnimes.isEmpty()) return;
+    // the pages that hold them later skip them, the offset stays a row count of the fetched pages
+    beginInsertRows(QModelIndex(),animes.count(),animes.count()+hitAnimes.count()-1);
+    animes.append(hitAnimes);
+    endInsertRows();
+}
+
@@ -15,6 +15,8 @@ public:
     void setActive(bool isActive);
     void deleteAnime(const QModelIndex &index);
     Anime *getAnime(const QModelIndex &index);
+    // adds the named animes that are not fetched yet, independent of paging
+    void fetchAnimes(const QStringList &names);
     void showStatisMessage();
 signals:
     void animeCountInfo(int cur, int total);
@@ -1,17 +1,120 @@
 #include "animeworker.h"
 #include "tagnode.h"
+#include "animeitemdelegate.h"
 #include "globalobjects.h"
 #include "Common/threadtask.h"
 #include "Common/lrucache.h"
+#include "Common/logger.h"
 
 #include <QSqlQuery>
 #include <QSqlRecord>
 #include <QSqlError>
 #include <QPainter>
+#include <QBuffer>
+#include <QImageReader>
+#include <QTimer>
+#include <QtConcurrent>
 
 namespace
 {
 LRUCache<QString, QSharedPointer<Anime>> singleAnimeCache{"SingleAnime", 128, true, true};
+const int characterBatchSize = 500;  // below the host parameter limit of sqlite
+// Cover is left out, covers are loaded on first display
+const char *pageColumns = "Anime, Desc, AddTime, AirDate, EpCount, URL, ScriptId, ScriptData, Staff, CoverURL";
+
+QString placeholders(int count)
+{
+    QStringList marks;
+    marks.reserve(count);
+    for(int i = 0; i < count; ++i) marks << "?";
+    return marks.join(',');
+}
+
+QImage decodePreviewCover(const QByteArray &data, const QSize &size)
+{
+    QBuffer bufferImage;
+    bufferImage.setData(data);
+    bufferImage.open(QIODevice::ReadOnly);
+    QImageReader reader(&bufferImage);
+    // jpeg is decoded at a reduced scale directly
+    reader.setScaledSize(size);
+    return reader.read();
+}
+
+bool isCJKScript(QChar::Script script)
+{
+    return script == QChar::Script_Han || script == QChar::Script_Hiragana || script == QChar::Script_Katakana ||
+           script == QChar::Script_Hangul || script == QChar::Script_Bopomofo;
+}
+
+// lower case runs of letters and digits, CJK text has no spaces between words and forms runs of its own
+QVector<QPair<QString, bool>> searchRuns(const QString &text)
+{
+    QVector<QPair<QString, bool>> runs;
+    QString run;
+    bool runCJK = false;
+    for(const QChar c : text)
+    {
+        const bool word = c.isLetterOrNumber();
+        const bool cjk = word && isCJKScript(c.script());
+        if(!run.isEmpty() && (!word || cjk != runCJK))
+        {
+            runs.append({run.toLower(), runCJK});
+            run.clear();
+        }
+        if(!word) continue;
+        run.append(c);
+        runCJK = cjk;
+    }
+    if(!run.isEmpty()) runs.append({run.toLower(), runCJK});
+    return runs;
+}
+
+// CJK runs are indexed as overlapping bigrams plus the last character, so every character starts a token
+QString searchIndexText(const QString &text)
+{
+    QStringList tokens;
+    for(const auto &run : searchRuns(text))
+    {
+        if(!run.second)
+        {
+            tokens.append(run.first);
+            continue;
+        }
+        for(int i = 0; i + 1 < run.first.size(); ++i)
+            tokens.append(run.first.mid(i, 2));
+        tokens.append(run.first.right(1));
+    }
+    return tokens.join(' ');
+}
+
+// words match as prefix, a CJK run as the phrase of its bigrams
+QString searchMatchExpr(const QString &text)
+{
+    QStringList terms;
+    for(const auto &run : searchRuns(text))
+    {
+        if(!run.second || run.first.size() == 1)
+        {
+            terms.append(QString("\"%1\"*").arg(run.first));
+            continue;
+        }
+        QStringList bigrams;
+        for(int i = 0; i + 1 < run.first.size(); ++i)
+            bigrams.append(run.first.mid(i, 2));
+        terms.append(QString("\"%1\"").arg(bigrams.join(' ')));
+    }
+    return terms.join(' ');
+}
+
+QByteArray encodeCoverThumb(const QImage &thumb)
+{
+    QByteArray data;
+    QBuffer bufferImage(&data);
+    bufferImage.open(QIODevice::WriteOnly);
+    thumb.save(&bufferImage, thumb.hasAlphaChannel()? "PNG" : "JPG", 90);
+    return data;
+}
 }
 
 void AnimeWorker::deleteAnime(Anime *anime)
@@ -19,16 +122,26 @@ void AnimeWorker::deleteAnime(Anime *anime)
     ThreadTask task(GlobalObjects::workThread);
     task.Run([=](){
         QSqlDatabase db=GlobalObjects::getDB(GlobalObjects::Bangumi_DB);
-        db.transaction();
         QSqlQuery query(db);
+        // the images of the anime are deleted by the foreign key, their files afterwards
+        QStringList imageHashes;
+        query.prepare("select Hash from image where Anime=? and Hash is not null");
+        query.bindValue(0,anime->_name);
+        query.exec();
+        while(query.next())
+            imageHashes.append(query.value(0).toString());
+        db.transaction();
         query.prepare("delete from anime where Anime=?");
         query.bindValue(0,anime->_name);
         query.exec();
         query.prepare("delete from alias where Anime=?");
         query.bindValue(0,anime->_name);
         query.exec();
+        markSearchDirty(anime->_name);
         animesMap.remove(anime->_name);
         db.commit();
+        for(const QString &hash : imageHashes)
+            releaseImage(hash);
         removeAlias(anime->_name);
         delete anime;
         return 0;
@@ -121,7 +234,7 @@ QSharedPointer<Anime> AnimeWorker::getSingleAnime(const QString &name)
     return nullptr;
 }
 
-AnimeWorker::AnimeWorker(QObject *parent):QObject(parent)
+AnimeWorker::AnimeWorker(QObject *parent):QObject(parent), imageStore(GlobalObjects::dataPath + "images/")
 {
     qRegisterMetaType<EpInfo>("EpInfo");
     qRegisterMetaType<AnimeImage>("AnimeImage");
@@ -129,10 +242,54 @@ AnimeWorker::AnimeWorker(QObject *parent):QObject(parent)
     qRegisterMetaType<TagNode::TagType>("TagNode::TagType");
     qRegisterMetaType<AnimeLite>("AnimeLite");
     aliasLoaded = false;
+    coverFlushScheduled = false;
+    searchIndexReady = false;
+    searchFlushScheduled = false;
+    thumbPool.setMaxThreadCount(qBound(1, QThread::idealThreadCount() / 2, 4));
+    ThreadTask task(GlobalObjects::workThread);
+    task.RunOnce([this](){
+        // bangumi.db files created by older versions have no cover_thumb table
+        QSqlQuery query(GlobalObjects::getDB(GlobalObjects::Bangumi_DB));
+        query.exec("CREATE TABLE IF NOT EXISTS \"cover_thumb\" (\"Anime\" TEXT NOT NULL, \"Width\" INTEGER, \"Height\" INTEGER, \"CoverSize\" INTEGER, \"Thumb\" BLOB, "
+                   "PRIMARY KEY (\"Anime\" ASC), CONSTRAINT \"Anime\" FOREIGN KEY (\"Anime\") REFERENCES \"anime\" (\"Anime\") ON DELETE CASCADE ON UPDATE CASCADE)");
+        // captures are moved from the Data column to the image store, bangumi.db files of older versions have no Hash column
+        query.exec("PRAGMA table_info(image)");
+        bool hasHash = false;
+        while(query.next())
+            hasHash = hasHash || query.value(1).toString() == "Hash";
+        if(!hasHash) query.exec("ALTER TABLE image ADD COLUMN \"Hash\" TEXT");
+        query.exec("CREATE INDEX IF NOT EXISTS \"Hash_Index\" ON \"image\" (\"Hash\" ASC)");
+        query.exec("select 1 from image where Data is not null limit 1");
+        if(query.first())
+        {
+            QTimer::singleShot(0, [this](){
+                migrateImageData(0);
+            });
+        }
+        // the full-text index needs fts5, without it searching falls back to the filters of loaded animes
+        query.exec("select name from sqlite_master where type='table' and name='anime_search'");
+        const bool indexExists = query.first();
+        if(!indexExists && !query.exec("CREATE VIRTUAL TABLE anime_search USING fts5(Anime UNINDEXED, Title, Content, tokenize='unicode61')"))
+        {
+            Logger::logger()->log(Logger::APP, QString("[AnimeWorker]Full-text index unavailable: %1").arg(query.lastError().text()));
+            return;
+        }
+        searchIndexReady = true;
+        // a new index or one left incomplete, e.g. by a crash while building it, is rebuilt
+        if(indexExists)
+        {
+            query.exec("select (select count(*) from anime_search) = (select count(*) from anime)");
+            if(query.first() && query.value(0).toBool()) return;
+        }
+        query.exec("select Anime from anime");
+        while(query.next())
+            markSearchDirty(query.value(0).toString());
+    });
 }
 
 AnimeWorker::~AnimeWorker()
 {
+    thumbPool.waitForDone();
     qDeleteAll(animesMap);
 }
 
@@ -141,58 +298,248 @@ int AnimeWorker::fetchAnimes(QVector<Anime *> *animes, int offset, int limit)
     ThreadTask task(GlobalObjects::workThread);
     return task.Run([=](){
         QSqlQuery query(GlobalObjects::getDB(GlobalObjects::Bangumi_DB));
-        query.exec(QString("select * from anime order by AddTime desc limit %1 offset %2").arg(limit).arg(offset));
-        int animeNo=query.record().indexOf("Anime"),
-            descNo=query.record().indexOf("Desc"),
-            timeNo=query.record().indexOf("AddTime"),
-            airDateNo=query.record().indexOf("AirDate"),
-            epCountNo=query.record().indexOf("EpCount"),
-            urlNo=query.record().indexOf("URL"),
-            scriptIdNo=query.record().indexOf("ScriptId"),
-            scriptDataNo=query.record().indexOf("ScriptData"),
-            staffNo=query.record().indexOf("Staff"),
-            coverURLNo=query.record().indexOf("CoverURL"),
-            coverNo=query.record().indexOf("Cover");
-        QSqlQuery crtQuery(GlobalObjects::getDB(GlobalObjects::Bangumi_DB));
-        crtQuery.prepare("select Name, Actor, Link, ImageURL from character where Anime=?");
-        int count=0;
-        while (query.next())
+        query.exec(QString("select %1 from anime order by AddTime desc limit %2 offset %3").arg(pageColumns).arg(limit).arg(offset));
+        return readAnimes(query, animes);
+    }).toInt();
+}
+
+int AnimeWorker::fetchAnimes(QVector<Anime *> *animes, const QStringList &names)
+{
+    ThreadTask task(GlobalObjects::workThread);
+    return task.Run([=](){
+        const int loadedCount = animes->size();
+        QStringList unloaded;
+        for(const QString &name : names)
         {
-            Anime *anime=new Anime;
-            anime->_name=query.value(animeNo).toString();
-            anime->_desc=query.value(descNo).toString();
-            anime->_airDate=query.value(airDateNo).toString();
-            anime->_addTime=query.value(timeNo).toLongLong();
-            anime->_epCount=query.value(epCountNo).toInt();
-            anime->_url=query.value(urlNo).toString();
-            anime->_scriptId=query.value(scriptIdNo).toString();
-            anime->_scriptData=query.value(scriptDataNo).toString();
-            anime->setStaffs(query.value(staffNo).toString());
-            anime->_coverURL=query.value(coverURLNo).toString();
-			anime->_coverData = query.value(coverNo).toByteArray();
-            //anime->_cover.loadFromData(query.value(coverNo).toByteArray());
+            if(!animesMap.contains(name)) unloaded.append(name);
+        }
+        QSqlQuery query(GlobalObjects::getDB(GlobalObjects::Bangumi_DB));
+        for(int i = 0; i < unloaded.size(); i += characterBatchSize)
+        {
+            const int batchCount = qMin(characterBatchSize, unloaded.size() - i);
+            query.prepare(QString("select %1 from anime where Anime in (%2)").arg(pageColumns).arg(placeholders(batchCount)));
+            for(int j = 0; j < batchCount; ++j)
+                query.bindValue(j, unloaded[i + j]);
+            query.exec();
+            readAnimes(query, animes);
+        }
+        return animes->size() - loadedCount;
+    }).toInt();
+}
 
-            crtQuery.bindValue(0,anime->_name);
-            crtQuery.exec();
-            int nameNo=crtQuery.record().indexOf("Name"),
-                actorNo=crtQuery.record().indexOf("Actor"),
-                linkNo=crtQuery.record().indexOf("Link"),
-                imageURLNo=crtQuery.record().indexOf("ImageURL");
-            while (crtQuery.next())
+int AnimeWorker::readAnimes(QSqlQuery &query, QVector<Anime *> *animes)
+{
+    int animeNo=query.record().indexOf("Anime"),
+        descNo=query.record().indexOf("Desc"),
+        timeNo=query.record().indexOf("AddTime"),
+        airDateNo=query.record().indexOf("AirDate"),
+        epCountNo=query.record().indexOf("EpCount"),
+        urlNo=query.record().indexOf("URL"),
+        scriptIdNo=query.record().indexOf("ScriptId"),
+        scriptDataNo=query.record().indexOf("ScriptData"),
+        staffNo=query.record().indexOf("Staff"),
+        coverURLNo=query.record().indexOf("CoverURL");
+    int rows = 0;
+    QVector<Anime *> pageAnimes;
+    QHash<QString, Anime *> nameAnimes;
+    while (query.next())
+    {
+        ++rows;
+        // animes loaded by a search are already in the model when their page comes
+        const QString name = query.value(animeNo).toString();
+        if(animesMap.contains(name)) continue;
+        Anime *anime=new Anime;
+        anime->_name=name;
+        anime->_desc=query.value(descNo).toString();
+        anime->_airDate=query.value(airDateNo).toString();
+        anime->_addTime=query.value(timeNo).toLongLong();
+        anime->_epCount=query.value(epCountNo).toInt();
+        anime->_url=query.value(urlNo).toString();
+        anime->_scriptId=query.value(scriptIdNo).toString();
+        anime->_scriptData=query.value(scriptDataNo).toString();
+        anime->setStaffs(query.value(staffNo).toString());
+        anime->_coverURL=query.value(coverURLNo).toString();
+        anime->coverLoaded = false;
+        pageAnimes.append(anime);
+        nameAnimes.insert(anime->_name, anime);
+    }
+    // characters of the whole page, one query per batch instead of one per anime
+    QSqlQuery crtQuery(GlobalObjects::getDB(GlobalObjects::Bangumi_DB));
+    for(int i = 0; i < pageAnimes.size(); i += characterBatchSize)
+    {
+        const int batchCount = qMin(characterBatchSize, pageAnimes.size() - i);
+        crtQuery.prepare(QString("select Anime, Name, Actor, Link, ImageURL from character where Anime in (%1) order by rowid").arg(placeholders(batchCount)));
+        for(int j = 0; j < batchCount; ++j)
+            crtQuery.bindValue(j, pageAnimes[i + j]->_name);
+        crtQuery.exec();
+        int crtAnimeNo=crtQuery.record().indexOf("Anime"),
+            nameNo=crtQuery.record().indexOf("Name"),
+            actorNo=crtQuery.record().indexOf("Actor"),
+            linkNo=crtQuery.record().indexOf("Link"),
+            imageURLNo=crtQuery.record().indexOf("ImageURL");
+        while (crtQuery.next())
+        {
+            Anime *anime = nameAnimes.value(crtQuery.value(crtAnimeNo).toString(), nullptr);
+            if(!anime) continue;
+            Character crt;
+            crt.name=crtQuery.value(nameNo).toString();
+            crt.actor=crtQuery.value(actorNo).toString();
+            crt.link=crtQuery.value(linkNo).toString();
+            crt.imgURL=crtQuery.value(imageURLNo).toString();
+            anime->characters.append(crt);
+        }
+    }
+    for(Anime *anime : pageAnimes)
+    {
+        animes->append(anime);
+        animesMap.insert(anime->_name,anime);
+    }
+    return rows;
+}
+
+bool AnimeWorker::requestCover(Anime *anime)
+{
+    if(animesMap.value(anime->_name, nullptr) != anime) return false;
+    if(pendingCovers.contains(anime)) return true;
+    pendingCovers.insert(anime);
+    // requests of one paint are loaded together
+    if(coverFlushScheduled) return true;
+    coverFlushScheduled = true;
+    QTimer::singleShot(0, [this](){
+        flushCoverRequests();
+    });
+    return true;
+}
+
+void AnimeWorker::loadCover(Anime *anime)
+{
+    if(anime->coverLoaded) return;
+    const QString animeName = anime->_name;
+    ThreadTask task(GlobalObjects::workThread);
+    anime->_coverData = task.Run([animeName](){
+        QSqlQuery query(GlobalObjects::getDB(GlobalObjects::Bangumi_DB));
+        query.prepare("select Cover from anime where Anime=?");
+        query.bindValue(0, animeName);
+        query.exec();
+        return query.first()? query.value(0) : QVariant();
+    }).toByteArray();
+    anime->coverLoaded = true;
+}
+
+void AnimeWorker::flushCoverRequests()
+{
+    coverFlushScheduled = false;
+    QVector<Anime *> requests;
+    QStringList names;
+    QVector<QByteArray> loadedCovers;
+    for(Anime *anime : pendingCovers)
+    {
+        requests.append(anime);
+        names.append(anime->_name);
+        // covers set by scripts are not in the db yet
+        loadedCovers.append(anime->coverLoaded? anime->_coverData : QByteArray());
+    }
+    pendingCovers.clear();
+    QThread *uiThread = QThread::currentThread();
+    const QSize thumbSize(AnimeItemDelegate::CoverWidth, AnimeItemDelegate::CoverHeight);
+    ThreadTask task(GlobalObjects::workThread);
+    task.RunOnce([=](){
+        // stored thumbs are used as long as the cover and the grid size are unchanged
+        QHash<QString, QByteArray> thumbs, covers;
+        QStringList missed;
+        QSqlQuery query(GlobalObjects::getDB(GlobalObjects::Bangumi_DB));
+        for(int i = 0; i < names.size(); i += coverBatchSize)
+        {
+            const int batchCount = qMin(int(coverBatchSize), names.size() - i);
+            query.prepare(QString("select t.Anime, t.Thumb from cover_thumb t join anime a on a.Anime=t.Anime "
+                                  "where t.Anime in (%1) and t.Width=? and t.Height=? and t.CoverSize=length(a.Cover)").arg(placeholders(batchCount)));
+            for(int j = 0; j < batchCount; ++j)
+                query.bindValue(j, names[i + j]);
+            query.bindValue(batchCount, thumbSize.width());
+            query.bindValue(batchCount + 1, thumbSize.height());
+            query.exec();
+            while(query.next())
+                thumbs.insert(query.value(0).toString(), query.value(1).toByteArray());
+        }
+        for(int i = 0; i < names.size(); ++i)
+        {
+            if(!thumbs.contains(names[i]) && loadedCovers[i].isEmpty()) missed.append(names[i]);
+        }
+        for(int i = 0; i < missed.size(); i += coverBatchSize)
+        {
+            const int batchCount = qMin(int(coverBatchSize), missed.size() - i);
+            query.prepare(QString("select Anime, Cover from anime where Anime in (%1)").arg(placeholders(batchCount)));
+            for(int j = 0; j < batchCount; ++j)
+                query.bindValue(j, missed[i + j]);
+            query.exec();
+            while(query.next())
+                covers.insert(query.value(0).toString(), query.value(1).toByteArray());
+        }
+        // decoding runs on the pool, a chunk is shown as soon as it is ready
+        for(int i = 0; i < requests.size(); i += thumbChunkSize)
+        {
+            const int chunkEnd = qMin(i + int(thumbChunkSize), requests.size());
+            QVector<QPair<QString, QByteArray>> chunkThumbs, chunkCovers;
+            for(int j = i; j < chunkEnd; ++j)
             {
-                Character crt;
-                crt.name=crtQuery.value(nameNo).toString();
-                crt.actor=crtQuery.value(actorNo).toString();
-                crt.link=crtQuery.value(linkNo).toString();
-                crt.imgURL=crtQuery.value(imageURLNo).toString();
-                anime->characters.append(crt);
+                if(thumbs.contains(names[j]))
+                    chunkThumbs.append({names[j], thumbs.value(names[j])});
+                else
+                    chunkCovers.append({names[j], loadedCovers[j].isEmpty()? covers.value(names[j]) : loadedCovers[j]});
             }
-            animes->append(anime);
-            animesMap.insert(anime->_name,anime);
-            count++;
+            const QVector<Anime *> chunkRequests(requests.mid(i, chunkEnd - i));
+            QtConcurrent::run(&thumbPool, [=](){
+                QHash<QString, QImage> previews;
+                for(const auto &thumb : chunkThumbs)
+                    previews.insert(thumb.first, QImage::fromData(thumb.second));
+                QVector<QByteArray> newThumbs;
+                for(const auto &cover : chunkCovers)
+                {
+                    const QImage preview = cover.second.isEmpty()? QImage() : decodePreviewCover(cover.second, thumbSize);
+                    previews.insert(cover.first, preview);
+                    newThumbs.append(preview.isNull()? QByteArray() : encodeCoverThumb(preview));
+                }
+                if(!chunkCovers.isEmpty())
+                {
+                    ThreadTask storeTask(GlobalObjects::workThread);
+                    storeTask.RunOnce([=](){
+                        storeCoverThumbs(chunkCovers, newThumbs, thumbSize);
+                    });
+                }
+                ThreadTask uiTask(uiThread);
+                uiTask.RunOnce([=](){
+                    for(Anime *anime : chunkRequests)
+                    {
+                        // the anime may have been removed or renamed in the meantime
+                        if(!previews.contains(anime->_name) || animesMap.value(anime->_name, nullptr) != anime) continue;
+                        anime->setPreviewCover(previews.value(anime->_name));
+                        emit coverLoaded(anime);
+                    }
+                });
+            });
         }
-        return count;
-    }).toInt();
+    });
+}
+
+void AnimeWorker::storeCoverThumbs(const QVector<QPair<QString, QByteArray>> &covers, const QVector<QByteArray> &thumbs, const QSize &thumbSize)
+{
+    QSqlDatabase db = GlobalObjects::getDB(GlobalObjects::Bangumi_DB);
+    db.transaction();
+    QSqlQuery query(db);
+    // a thumb is only stored for the cover it was made from, the cover may have changed during decoding
+    query.prepare("insert or replace into cover_thumb(Anime,Width,Height,CoverSize,Thumb) "
+                  "select Anime,?,?,length(Cover),? from anime where Anime=? and length(Cover)=?");
+    for(int i = 0; i < covers.size(); ++i)
+    {
+        if(thumbs[i].isEmpty()) continue;
+        query.bindValue(0, thumbSize.width());
+        query.bindValue(1, thumbSize.height());
+        query.bindValue(2, thumbs[i]);
+        query.bindValue(3, covers[i].first);
+        query.bindValue(4, covers[i].second.size());
+        query.exec();
+    }
+    db.commit();
 }
 
 int AnimeWorker::animeCount()
@@ -294,6 +641,7 @@ void AnimeWorker::addAnime(const MatchResult &match)
         query.bindValue(2,anime->_scriptId);
         query.bindValue(3,anime->_scriptData);
         query.exec();
+        markSearchDirty(anime->_name);
         if(!anime->_scriptId.isEmpty()) emit addScriptTag(anime->_scriptId);
         addEp(matchAnimeName, match.ep);
         animesMap.insert(matchAnimeName,anime);
@@ -315,6 +663,7 @@ void AnimeWorker::addAnime(const QString &name)
             query.bindValue(0,anime->_name);
             query.bindValue(1,anime->_addTime);
             query.exec();
+            markSearchDirty(name);
             animesMap.insert(name,anime);
             emit animeAdded(anime);
         }
@@ -359,6 +708,7 @@ const QString AnimeWorker::addAnime(Anime *srcAnime, Anime *newAnime)
         if(srcAnime->_name!=newAnime->_name)
         {
             addAlias(newAnime->_name, srcAnime->_name);
+            markSearchDirty(srcAnime->_name);
             retAnimeName = newAnime->_name;
             emit renameEpTag(srcAnime->_name, newAnime->_name);
             Anime *animeInMap = animesMap.value(newAnime->_name, nullptr);
@@ -443,6 +793,7 @@ void AnimeWorker::addEp(const QString &animeName, const EpInfo &ep)
     query.bindValue(3,(int)ep.type);
     query.bindValue(4,ep.localFile);
     query.exec();
+    markSearchDirty(animeName);
     Anime *anime = animesMap.value(animeName, nullptr);
     if(anime) anime->addEp(ep);
     emit epAdded(animeName, ep);
@@ -454,6 +805,7 @@ void AnimeWorker::removeEp(const QString &animeName, const QString &path)
     query.prepare("delete from episode where LocalFile=?");
     query.bindValue(0,path);
     query.exec();
+    markSearchDirty(animeName);
     Anime *anime = animesMap.value(animeName, nullptr);
     if(anime) anime->removeEp(path);
     emit epRemoved(animeName, path);
@@ -507,6 +859,7 @@ void AnimeWorker::updateEpInfo(const QString &animeName, const QString &path, co
         query.bindValue(2,(int)nEp.type);
         query.bindValue(3,path);
         query.exec();
+        markSearchDirty(animeName);
         Anime *anime = animesMap.value(animeName, nullptr);
         if(anime) anime->updateEpInfo(path, nEp);
         emit epUpdated(animeName, path);
@@ -527,6 +880,7 @@ void AnimeWorker::updateEpPath(const QString &animeName, const QString &path, co
         query.bindValue(0,nPath);
         query.bindValue(1,path);
         query.exec();
+        markSearchDirty(animeName);
         Anime *anime = animesMap.value(animeName, nullptr);
         if(anime) anime->updateEpPath(path, nPath);
         emit epUpdated(animeName, path);
@@ -578,6 +932,7 @@ std::function<void (QSqlQuery *)> AnimeWorker::updateStaffInfo(const QString &an
         query->bindValue(0, staffStr);
         query->bindValue(1, animeName);
         query->exec();
+        markSearchDirty(animeName);
     };
 }
 
@@ -588,6 +943,7 @@ std::function<void (QSqlQuery *)> AnimeWorker::updateDescription(const QString &
         query->bindValue(0, desc);
         query->bindValue(1, animeName);
         query->exec();
+        markSearchDirty(animeName);
     };
 }
 
@@ -625,6 +981,9 @@ void AnimeWorker::updateCoverImage(const QString &animeName, const QByteArray &i
             query.bindValue(1,animeName);
         }
         query.exec();
+        query.prepare("delete from cover_thumb where Anime=?");
+        query.bindValue(0,animeName);
+        query.exec();
     });
 }
 
@@ -652,6 +1011,7 @@ void AnimeWorker::addCharacter(const QString &animeName, const Character &crt)
         query.bindValue(2, crt.actor);
         query.bindValue(3, crt.link);
         query.exec();
+        markSearchDirty(animeName);
     });
 }
 
@@ -667,6 +1027,7 @@ void AnimeWorker::modifyCharacter(const QString &animeName, const QString &srcCr
         query.bindValue(3, animeName);
         query.bindValue(4, srcCrtName);
         query.exec();
+        markSearchDirty(animeName);
     });
 }
 
@@ -679,6 +1040,7 @@ void AnimeWorker::removeCharacter(const QString &animeName, const QString &crtNa
         query.bindValue(0,animeName);
         query.bindValue(1,crtName);
         query.exec();
+        markSearchDirty(animeName);
     });
 }
 
@@ -704,14 +1066,17 @@ void AnimeWorker::saveCapture(const QString &animeName, const QString &info, con
         QString matchAnimeName = alias.isEmpty()?animeName:alias;
 
         qint64 timeId = QDateTime::currentDateTime().toMSecsSinceEpoch();
+        // the image goes to the image store, the db only keeps it if the file cannot be written
+        const QString hash = imageStore.put(imgBytes);
         QSqlQuery query(GlobalObjects::getDB(GlobalObjects::Bangumi_DB));
-        query.prepare("insert into image(Anime,Type,TimeId,Info,Thumb,Data) values(?,?,?,?,?,?)");
+        query.prepare("insert into image(Anime,Type,TimeId,Info,Thumb,Data,Hash) values(?,?,?,?,?,?,?)");
         query.bindValue(0,matchAnimeName);
         query.bindValue(1,AnimeImage::CAPTURE);
         query.bindValue(2,timeId);
         query.bindValue(3,info);
         query.bindValue(4,thumbBytes);
-        query.bindValue(5,imgBytes);
+        query.bindValue(5,hash.isEmpty()? QVariant(imgBytes) : QVariant(QVariant::ByteArray));
+        query.bindValue(6,hash.isEmpty()? QVariant(QVariant::String) : QVariant(hash));
         query.exec();
 
         AnimeImage aImage;
@@ -766,7 +1131,7 @@ void AnimeWorker::saveSnippet(const QString &animeName, const QString &info, qin
 const QPixmap AnimeWorker::getAnimeImageData(const QString &animeName, AnimeImage::ImageType type, qint64 timeId)
 {
     QSqlQuery query(GlobalObjects::getDB(GlobalObjects::Bangumi_DB));
-    query.prepare("select Data from image where Anime=? and Type=? and TimeId=?");
+    query.prepare("select Hash, Data from image where Anime=? and Type=? and TimeId=?");
     query.bindValue(0,animeName);
     query.bindValue(1,type);
     query.bindValue(2,timeId);
@@ -774,7 +1139,11 @@ const QPixmap AnimeWorker::getAnimeImageData(const QString &animeName, AnimeImag
     QPixmap image;
     if(query.first())
     {
-        image.loadFromData(query.value(0).toByteArray());
+        const QString hash = query.value(0).toString();
+        if(!hash.isEmpty())
+            image = imageStore.load(hash);
+        else
+            image.loadFromData(query.value(1).toByteArray());
     }
     return image;
 }
@@ -784,11 +1153,69 @@ void AnimeWorker::deleteAnimeImage(const QString &animeName, AnimeImage::ImageTy
     ThreadTask task(GlobalObjects::workThread);
     task.RunOnce([=](){
         QSqlQuery query(GlobalObjects::getDB(GlobalObjects::Bangumi_DB));
+        query.prepare("select Hash from image where Anime=? and Type=? and TimeId=?");
+        query.bindValue(0,animeName);
+        query.bindValue(1,type);
+        query.bindValue(2,timeId);
+        query.exec();
+        const QString hash = query.first()? query.value(0).toString() : QString();
         query.prepare("delete from image where Anime=? and Type=? and TimeId=?");
         query.bindValue(0,animeName);
         query.bindValue(1,type);
         query.bindValue(2,timeId);
         query.exec();
+        releaseImage(hash);
+    });
+}
+
+void AnimeWorker::releaseImage(const QString &hash)
+{
+    if(hash.isEmpty()) return;
+    // equal images share a file
+    QSqlQuery query(GlobalObjects::getDB(GlobalObjects::Bangumi_DB));
+    query.prepare("select 1 from image where Hash=? limit 1");
+    query.bindValue(0,hash);
+    query.exec();
+    if(!query.first()) imageStore.remove(hash);
+}
+
+void AnimeWorker::migrateImageData(int migrated)
+{
+    QSqlDatabase db = GlobalObjects::getDB(GlobalObjects::Bangumi_DB);
+    QSqlQuery query(db);
+    query.exec(QString("select rowid, Data from image where Data is not null limit %1").arg(imageMigrateBatchSize));
+    QVector<QPair<qint64, QString>> moved;
+    while(query.next())
+    {
+        const QByteArray data = query.value(1).toByteArray();
+        const QString hash = imageStore.put(data);
+        if(hash.isEmpty() && !data.isEmpty())
+        {
+            // tried again at the next start
+            Logger::logger()->log(Logger::APP, "[AnimeWorker]Moving captures to the image store failed");
+            return;
+        }
+        moved.append({query.value(0).toLongLong(), hash});
+    }
+    if(moved.isEmpty())
+    {
+        // the space of the moved images is only returned to the file system by vacuum
+        Logger::logger()->log(Logger::APP, QString("[AnimeWorker]Moved %1 capture(s) to the image store").arg(migrated));
+        if(migrated > 0) query.exec("VACUUM");
+        return;
+    }
+    db.transaction();
+    query.prepare("update image set Hash=?, Data=null where rowid=?");
+    for(const auto &image : moved)
+    {
+        query.bindValue(0, image.second.isEmpty()? QVariant(QVariant::String) : QVariant(image.second));
+        query.bindValue(1, image.first);
+        query.exec();
+    }
+    db.commit();
+    // one batch at a time, other tasks of the work thread run in between
+    QTimer::singleShot(0, [this, migrated, moved](){
+        migrateImageData(migrated + moved.size());
     });
 }
 
@@ -978,7 +1405,11 @@ bool AnimeWorker::updateAnimeInfo(Anime *anime)
     db.transaction();
 
     QSqlQuery query(db);
-    query.prepare("update anime set Desc=?,AirDate=?,EpCount=?,URL=?,ScriptId=?,ScriptData=?,Staff=?,CoverURL=?,Cover=? where Anime=?");
+    // a cover that has not been loaded is kept as it is
+    if(anime->coverLoaded)
+        query.prepare("update anime set Desc=?,AirDate=?,EpCount=?,URL=?,ScriptId=?,ScriptData=?,Staff=?,CoverURL=?,Cover=? where Anime=?");
+    else
+        query.prepare("update anime set Desc=?,AirDate=?,EpCount=?,URL=?,ScriptId=?,ScriptData=?,Staff=?,CoverURL=? where Anime=?");
     query.bindValue(0,anime->_desc);
     query.bindValue(1,anime->_airDate);
     query.bindValue(2,anime->_epCount);
@@ -987,10 +1418,18 @@ bool AnimeWorker::updateAnimeInfo(Anime *anime)
     query.bindValue(5,anime->_scriptData);
     query.bindValue(6,anime->staffToStr());
     query.bindValue(7,anime->_coverURL);
-    query.bindValue(8,anime->_coverData);
-    query.bindValue(9,anime->_name);
+    int pos = 8;
+    if(anime->coverLoaded) query.bindValue(pos++,anime->_coverData);
+    query.bindValue(pos,anime->_name);
     query.exec();
 
+    if(anime->coverLoaded)
+    {
+        query.prepare("delete from cover_thumb where Anime=?");
+        query.bindValue(0,anime->_name);
+        query.exec();
+    }
+
     query.prepare("delete from character where Anime=?");
     query.bindValue(0,anime->_name);
     query.exec();
@@ -1013,6 +1452,7 @@ bool AnimeWorker::updateAnimeInfo(Anime *anime)
         query.bindValue(5, bytes);
         query.exec();
     }
+    markSearchDirty(anime->_name);
     return db.commit();
 }
 
@@ -1032,11 +1472,13 @@ bool AnimeWorker::addAlias(const QString &name, const QString &alias)
     query.prepare("insert into alias(Alias,Anime) values(?,?)");
     query.bindValue(0,alias);
     query.bindValue(1,name);
+    markSearchDirty(name);
     return query.exec();
 }
 
 void AnimeWorker::removeAlias(const QString &name, const QString &alias, bool updateDB)
 {
+    if(updateDB) markSearchDirty(name);
     if(alias.isEmpty())
     {
         animeAlias.remove(name);
@@ -1069,6 +1511,109 @@ const QStringList AnimeWorker::getAlias(const QString &animeName)
     return animeAlias.values(animeName);
 }
 
+QStringList AnimeWorker::searchAnimes(const QString &text, int limit)
+{
+    const QString matchExpr = searchMatchExpr(text);
+    if(matchExpr.isEmpty() || !searchIndexReady) return QStringList();
+    ThreadTask task(GlobalObjects::workThread);
+    return task.Run([=](){
+        // edits not flushed yet are found after the next flush, typing must not wait for a large backlog
+        QStringList names;
+        QSqlQuery query(GlobalObjects::getDB(GlobalObjects::Bangumi_DB));
+        // a title match weighs more than a match in the description, staff, characters or episodes
+        query.prepare("select Anime from anime_search where anime_search match ? order by bm25(anime_search, 0.0, 10.0, 1.0) limit ?");
+        query.bindValue(0, matchExpr);
+        query.bindValue(1, limit);
+        query.exec();
+        while(query.next())
+            names.append(query.value(0).toString());
+        return names;
+    }).toStringList();
+}
+
+void AnimeWorker::markSearchDirty(const QString &animeName)
+{
+    ThreadTask task(GlobalObjects::workThread);
+    task.RunOnce([=](){
+        if(!searchIndexReady) return;
+        searchDirty.insert(animeName);
+        if(searchFlushScheduled) return;
+        searchFlushScheduled = true;
+        // edits come in bursts, e.g. the episodes of a matched folder
+        QTimer::singleShot(searchFlushDelay, [this](){
+            flushSearchIndex();
+        });
+    });
+}
+
+void AnimeWorker::flushSearchIndex()
+{
+    loadAlias();
+    QSqlDatabase db = GlobalObjects::getDB(GlobalObjects::Bangumi_DB);
+    QSqlQuery query(db);
+    if(!searchDirty.isEmpty())
+    {
+        QStringList names;
+        for(auto iter = searchDirty.begin(); iter != searchDirty.end() && names.size() < searchBatchSize;)
+        {
+            names.append(*iter);
+            iter = searchDirty.erase(iter);
+        }
+        const QString marks(placeholders(names.size()));
+        auto bindNames = [&](){
+            for(int i = 0; i < names.size(); ++i)
+                query.bindValue(i, names[i]);
+        };
+        QHash<QString, QStringList> contents;
+        QSet<QString> existing;
+        query.prepare(QString("select Anime, Desc, Staff from anime where Anime in (%1)").arg(marks));
+        bindNames();
+        query.exec();
+        while(query.next())
+        {
+            existing.insert(query.value(0).toString());
+            contents[query.value(0).toString()] << query.value(1).toString() << query.value(2).toString();
+        }
+        query.prepare(QString("select Anime, Name, Actor from character where Anime in (%1)").arg(marks));
+        bindNames();
+        query.exec();
+        while(query.next())
+            contents[query.value(0).toString()] << query.value(1).toString() << query.value(2).toString();
+        query.prepare(QString("select Anime, Name, LocalFile from episode where Anime in (%1)").arg(marks));
+        bindNames();
+        query.exec();
+        while(query.next())
+            contents[query.value(0).toString()] << query.value(1).toString() << query.value(2).toString();
+
+        db.transaction();
+        query.prepare(QString("delete from anime_search where Anime in (%1)").arg(marks));
+        bindNames();
+        query.exec();
+        query.prepare("insert into anime_search(Anime,Title,Content) values(?,?,?)");
+        for(const QString &name : names)
+        {
+            // removed animes are only deleted from the index
+            if(!existing.contains(name)) continue;
+            QStringList titles(animeAlias.values(name));
+            titles.prepend(name);
+            query.bindValue(0, name);
+            query.bindValue(1, searchIndexText(titles.join(' ')));
+            query.bindValue(2, searchIndexText(contents.value(name).join(' ')));
+            query.exec();
+        }
+        db.commit();
+        if(!searchDirty.isEmpty())
+        {
+            // a large backlog, e.g. building the index, does not block the work thread
+            QTimer::singleShot(0, [this](){
+                flushSearchIndex();
+            });
+            return;
+        }
+    }
+    searchFlushScheduled = false;
+}
+
 bool AnimeWorker::checkAnimeExist(const QString &name)
 {
     QSqlQuery query(GlobalObjects::getDB(GlobalObjects::Bangumi_DB));
@@ -1107,6 +1652,7 @@ bool AnimeWorker::checkEpExist(const QString &animeName, const EpInfo &ep)
             query.bindValue(2,(int)ep.type);
             query.bindValue(3,ep.localFile);
             query.exec();
+            markSearchDirty(animeName);
             Anime *anime = animesMap.value(animeName, nullptr);
             if(anime) anime->addEp(ep);
             emit epUpdated(animeName, ep.localFile);
@@ -1,6 +1,8 @@
 #ifndef ANIMEWORKER_H
 #define ANIMEWORKER_H
 #include "animeinfo.h"
+#include "imagestore.h"
+#include <QThreadPool>
 
 class QSqlQuery;
 class AnimeWorker : public QObject
@@ -17,8 +19,14 @@ public:
         static AnimeWorker worker;
         return &worker;
     }
+    // returns the rows read, animes already loaded are skipped and not added again
     int fetchAnimes(QVector<Anime *> *animes, int offset, int limit);
+    // loads the named animes that are not loaded yet, e.g. search hits beyond the fetched pages
+    int fetchAnimes(QVector<Anime *> *animes, const QStringList &names);
     int animeCount();
+    // queues a library anime for background cover loading, false for animes that are not part of the library
+    bool requestCover(Anime *anime);
+    void loadCover(Anime *anime);
     void loadCrImages(Anime *anime);
     bool loadEpInfo(Anime *anime);
 
@@ -68,8 +76,33 @@ public:
     void removeAlias(const QString &name, const QString &alias = "", bool updateDB=false);
     const QStringList getAlias(const QString &animeName);
 
+    // names of the animes matching text in the full-text index, best match first, a negative limit returns all matches
+    QStringList searchAnimes(const QString &text, int limit = 200);
+    bool hasSearchIndex() const {return searchIndexReady;}
+
 private:
+    static const int coverBatchSize = 32;
+    static const int thumbChunkSize = 8;  // covers decoded by one pool task
     QMap<QString,Anime *> animesMap;
+    QSet<Anime *> pendingCovers;
+    int readAnimes(QSqlQuery &query, QVector<Anime *> *animes);
+    bool coverFlushScheduled;
+    QThreadPool thumbPool;
+    void flushCoverRequests();
+    void storeCoverThumbs(const QVector<QPair<QString, QByteArray>> &covers, const QVector<QByteArray> &thumbs, const QSize &thumbSize);
+
+    static const int searchBatchSize = 200;
+    static const int searchFlushDelay = 500;  // ms
+    std::atomic<bool> searchIndexReady;
+    QSet<QString> searchDirty;  // only used in the work thread
+    bool searchFlushScheduled;
+    void markSearchDirty(const QString &animeName);
+    void flushSearchIndex();
+
+    static const int imageMigrateBatchSize = 32;
+    ImageStore imageStore;
+    void releaseImage(const QString &hash);
+    void migrateImageData(int migrated);
 
     QMultiMap<QString, QString> animeAlias;
     QMap<QString, QString> aliasAnime;
@@ -83,6 +116,7 @@ private:
     bool updateAnimeInfo(Anime *anime);
 
 signals:
+    void coverLoaded(Anime *anime);
     void animeAdded(Anime *anime);
     void animeUpdated(Anime *anime);
     void animeRemoved(Anime *anime);
@@ -0,0 +1,52 @@
+#include "imagestore.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+ImageStore::ImageStore(const QString &rootPath) : root(rootPath)
+{
+}
+
+QString ImageStore::put(const QByteArray &data) const
+{
+    if(data.isEmpty()) return QString();
+    const QString hash(QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex());
+    const QString path = filePath(hash);
+    // the same image is already stored
+    if(QFileInfo(path).size() == data.size()) return hash;
+    if(!QDir().mkpath(QFileInfo(path).path())) return QString();
+    QSaveFile file(path);
+    if(!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) return QString();
+    return hash;
+}
+
+QPixmap ImageStore::load(const QString &hash) const
+{
+    QPixmap image;
+    QFile file(filePath(hash));
+    if(hash.isEmpty() || !file.open(QIODevice::ReadOnly)) return image;
+    uchar *data = file.map(0, file.size());
+    if(data)
+    {
+        image.loadFromData(data, uint(file.size()));
+        file.unmap(data);
+    }
+    else
+    {
+        image.loadFromData(file.readAll());
+    }
+    return image;
+}
+
+void ImageStore::remove(const QString &hash) const
+{
+    if(hash.isEmpty()) return;
+    QFile::remove(filePath(hash));
+}
+
+QString ImageStore::filePath(const QString &hash) const
+{
+    return root + hash.left(2) + '/' + hash;
+}
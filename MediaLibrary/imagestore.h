@@ -0,0 +1,28 @@
+#ifndef IMAGESTORE_H
+#define IMAGESTORE_H
+#include <QByteArray>
+#include <QPixmap>
+#include <QString>
+
+/*
+ * Content-addressed files for the full size capture images, so they stay out of bangumi.db.
+ * A file is named by the sha1 of its content and sharded by the first two hex digits: <root>/ab/abcdef...
+ * Equal images share one file, the image table refers to it by hash.
+ */
+class ImageStore
+{
+public:
+    explicit ImageStore(const QString &rootPath);
+
+    // returns the hash of data, empty if it could not be written
+    QString put(const QByteArray &data) const;
+    // the file is memory mapped while decoding
+    QPixmap load(const QString &hash) const;
+    void remove(const QString &hash) const;
+
+private:
+    QString root;
+    QString filePath(const QString &hash) const;
+};
+
+#endif // IMAGESTORE_H
@@ -11,12 +11,14 @@
 LabelModel::LabelModel(QObject *parent) : QAbstractItemModel(parent), root(nullptr)
 {
     QObject::connect(AnimeWorker::instance(), &AnimeWorker::renameEpTag, this, [=](const QString &oldAnimeName, const QString &newAnimeName){
-        for(auto &animes : epPathAnimes)
+        for(auto iter = epPathAnimes.begin(); iter != epPathAnimes.end(); ++iter)
         {
-            if(animes.contains(oldAnimeName))
+            if(iter->contains(oldAnimeName))
             {
-                animes.remove(oldAnimeName);
-                animes.insert(newAnimeName);
+                iter->remove(oldAnimeName);
+                iter->insert(newAnimeName);
+                setTagBit(epPathBits, iter.key(), oldAnimeName, false);
+                setTagBit(epPathBits, iter.key(), newAnimeName, true);
             }
         }
     });
@@ -51,6 +53,7 @@ LabelModel::LabelModel(QObject *parent) : QAbstractItemModel(parent), root(nullp
         if(filePath.isEmpty() || !root) return;
         if(epPathAnimes.contains(filePath) && epPathAnimes[filePath].contains(animeName)) return;
         epPathAnimes[filePath].insert(animeName);
+        setTagBit(epPathBits, filePath, animeName, true);
         insertNodeIndex(root->subNodes->value(C_FILE), filePath, 1, TagNode::TAG_FILE);
     });
 }
@@ -69,6 +72,8 @@ void LabelModel::loadLabels()
     addAnimeInfoTag();
     addEpPathTag();
     addCustomTag();
+    buildTagBits(epPathAnimes, epPathBits);
+    buildTagBits(tagAnimes, customBits);
     loadedPromise.set_value(true);
     loaded = true;
 }
@@ -107,6 +112,16 @@ void LabelModel::selectedLabelList(const QModelIndexList &indexes,  SelectedLabe
     }
 }
 
+QBitArray LabelModel::epTagBits(const QString &pathTag) const
+{
+    return collectTagBits(epPathAnimes, epPathBits, pathTag, true);
+}
+
+QBitArray LabelModel::customTagBits(const QString &tag, bool withSubTags) const
+{
+    return collectTagBits(tagAnimes, customBits, tag, withSubTags);
+}
+
 void LabelModel::setBrushColor(LabelModel::BrushType type, const QColor &color)
 {
     beginResetModel();
@@ -127,12 +142,14 @@ void LabelModel::addTag(const QString &animeName, const QString &tag, TagNode::T
     {
         if(epPathAnimes.contains(tag) && epPathAnimes[tag].contains(animeName))  return;
         else epPathAnimes[tag].insert(animeName);
+        setTagBit(epPathBits, tag, animeName, true);
     }
 
     if(type == TagNode::TAG_CUSTOM)
     {
         if(tagAnimes.contains(tag) && tagAnimes[tag].contains(animeName)) return;
         else tagAnimes[tag].insert(animeName);
+        setTagBit(customBits, tag, animeName, true);
     }
     insertNodeIndex(cateNode[type], tag, 1, type, type==TagNode::TAG_TIME?'-':'/');
 }
@@ -145,6 +162,7 @@ int LabelModel::addCustomTags(const QString &animeName, const QStringList &tagLi
     {
         if(tagAnimes.contains(tag) && tagAnimes[tag].contains(animeName)) continue;
         tagAnimes[tag].insert(animeName);
+        setTagBit(customBits, tag, animeName, true);
         insertNodeIndex(root->subNodes->value(C_CUSTOM), tag, 1, TagNode::TAG_CUSTOM);
         ++validCount;
     }
@@ -166,6 +184,7 @@ void LabelModel::removeTag(const QString &animeName, const QString &tag, TagNode
         if(epPathAnimes.contains(tag) && epPathAnimes[tag].contains(animeName))
         {
             epPathAnimes[tag].remove(animeName);
+            setTagBit(epPathBits, tag, animeName, false);
         }
         else return;
     }
@@ -175,6 +194,7 @@ void LabelModel::removeTag(const QString &animeName, const QString &tag, TagNode
         if(tagAnimes.contains(tag) && tagAnimes[tag].contains(animeName))
         {
             tagAnimes[tag].remove(animeName);
+            setTagBit(customBits, tag, animeName, false);
             AnimeWorker::instance()->deleteTag(tag, animeName);
         }
         else return;
@@ -234,6 +254,8 @@ void LabelModel::removeTag(const QModelIndex &index)
     for(const QString &tag : nodePaths)
     {
         tagAnimes.remove(tag);
+        customBits.remove(tag);
+        ++bitsRevision;
         emit tagRemoved(tag);
     }
     TagNode *parent = node->parent;
@@ -427,6 +449,61 @@ void LabelModel::addCustomTag()
     }
 }
 
+int LabelModel::addAnimeOrdinal(const QString &animeName)
+{
+    // ordinals are never reused, the bit of a removed anime is cleared from all tags anyway
+    auto iter = animeOrdinals.constFind(animeName);
+    if(iter != animeOrdinals.cend()) return iter.value();
+    const int ordinal = animeOrdinals.size();
+    animeOrdinals.insert(animeName, ordinal);
+    return ordinal;
+}
+
+void LabelModel::setTagBit(QHash<QString, QBitArray> &tagBits, const QString &tag, const QString &animeName, bool on)
+{
+    const int ordinal = on? addAnimeOrdinal(animeName) : animeOrdinal(animeName);
+    if(ordinal < 0) return;
+    QBitArray &bits = tagBits[tag];
+    if(ordinal >= bits.size())
+    {
+        if(!on) return;
+        bits.resize(qMax(ordinal + 1, animeOrdinals.size()));
+    }
+    bits.setBit(ordinal, on);
+    ++bitsRevision;
+}
+
+void LabelModel::buildTagBits(const QMap<QString, QSet<QString>> &tagMap, QHash<QString, QBitArray> &tagBits)
+{
+    tagBits.clear();
+    for(auto iter = tagMap.cbegin(); iter != tagMap.cend(); ++iter)
+    {
+        for(const QString &animeName : iter.value())
+            addAnimeOrdinal(animeName);
+    }
+    for(auto iter = tagMap.cbegin(); iter != tagMap.cend(); ++iter)
+    {
+        QBitArray bits(animeOrdinals.size());
+        for(const QString &animeName : iter.value())
+            bits.setBit(animeOrdinals.value(animeName));
+        tagBits.insert(iter.key(), bits);
+    }
+    ++bitsRevision;
+}
+
+QBitArray LabelModel::collectTagBits(const QMap<QString, QSet<QString>> &tagMap, const QHash<QString, QBitArray> &tagBits, const QString &tag, bool withSubTags) const
+{
+    if(!withSubTags) return tagBits.value(tag);
+    // the sub tags of a tag follow it in the sorted tag map
+    QBitArray bits;
+    for(auto iter = tagMap.lowerBound(tag); iter != tagMap.cend() && iter.key().startsWith(tag); ++iter)
+    {
+        if(iter.key().size() == tag.size() || iter.key().at(tag.size()) == '/')
+            bits |= tagBits.value(iter.key());
+    }
+    return bits;
+}
+
 TagNode *LabelModel::insertNode(TagNode *parent, const QString &strPath, int count, TagNode::TagType type, char split)
 {
     auto titles(strPath.splitRef(split, QString::SkipEmptyParts));
@@ -36,6 +36,12 @@ public:
 
     const QMap<QString, QSet<QString>> &epTags() const {return epPathAnimes;}
     const QMap<QString, QSet<QString>> &customTags() const {return tagAnimes;}
+    // tag bitsets are indexed by anime ordinal, -1 for animes without file or custom tags
+    int animeOrdinal(const QString &animeName) const {return animeOrdinals.value(animeName, -1);}
+    QBitArray epTagBits(const QString &pathTag) const;
+    QBitArray customTagBits(const QString &tag, bool withSubTags) const;
+    // changes whenever the animes of a file or custom tag change
+    quint64 tagBitsRevision() const {return bitsRevision;}
 
     void setBrushColor(BrushType type, const QColor &color);
 public:
@@ -61,6 +67,9 @@ signals:
 private:
     TagNode *root;
     QMap<QString, QSet<QString>> tagAnimes, epPathAnimes;
+    QHash<QString, int> animeOrdinals;
+    QHash<QString, QBitArray> customBits, epPathBits;
+    quint64 bitsRevision = 0;
     enum CategoryTag
     {
         C_SCRIPT, C_TIME, C_FILE, C_CUSTOM
@@ -74,6 +83,11 @@ private:
     void addEpPathTag();
     void addCustomTag();
 
+    int addAnimeOrdinal(const QString &animeName);
+    void setTagBit(QHash<QString, QBitArray> &tagBits, const QString &tag, const QString &animeName, bool on);
+    void buildTagBits(const QMap<QString, QSet<QString>> &tagMap, QHash<QString, QBitArray> &tagBits);
+    QBitArray collectTagBits(const QMap<QString, QSet<QString>> &tagMap, const QHash<QString, QBitArray> &tagBits, const QString &tag, bool withSubTags) const;
+
     TagNode *insertNode(TagNode *parent, const QString &strPath, int count, TagNode::TagType type, char split = '/');
     TagNode *insertNodeIndex(TagNode *parent, const QString &strPath, int count, TagNode::TagType type, char split = '/');
     void removeNodeIndex(TagNode *parent, const QString &strPath, bool removeAll = false, char split = '/');
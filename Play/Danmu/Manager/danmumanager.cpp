@@ -14,12 +14,18 @@
 #include "../blocker.h"
 #include "../danmuprovider.h"
 #include "globalobjects.h"
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#endif
 
 DanmuManager *PoolStateLock::manager=nullptr;
 DanmuManager::DanmuManager(QObject *parent) : QObject(parent),countInited(false)
 {
     poolCache.reset(new LRUCache<QString, Pool *>("DanmuPool", [](Pool *p){return !p->used && p->clean();}));
     PoolStateLock::manager=this;
+    // comment.db files created by older versions have no file_hash table
+    QSqlQuery query(GlobalObjects::getDB(GlobalObjects::Comment_DB));
+    query.exec("CREATE TABLE IF NOT EXISTS \"file_hash\" (\"Path\" TEXT NOT NULL, \"Size\" INTEGER, \"MTime\" INTEGER, \"MD5\" TEXT, PRIMARY KEY (\"Path\" ASC))");
     loadAllPool();
 }
 
@@ -295,11 +301,63 @@ void DanmuManager::removeMatch(const QString &fileName)
 
 QString DanmuManager::getFileHash(const QString &fileName)
 {
+    const QFileInfo fileInfo(fileName);
+    if(!fileInfo.isFile()) return hashFile(fileName);
+    QString fileHash(lookupFileHash(fileInfo));
+    if(!fileHash.isEmpty()) return fileHash;
+    fileHash = hashFile(fileName);
+    if(!fileHash.isEmpty()) saveFileHash(fileInfo, fileHash);
+    return fileHash;
+}
+
+QString DanmuManager::lookupFileHash(const QFileInfo &fileInfo)
+{
+    bool dbError = false;
+    QSqlDatabase db = GlobalObjects::getDB(GlobalObjects::Comment_DB, &dbError);
+    if(dbError) return QString();
+    QSqlQuery query(db);
+    query.prepare("select MD5 from file_hash where Path=? and Size=? and MTime=?");
+    query.bindValue(0, fileInfo.absoluteFilePath());
+    query.bindValue(1, fileInfo.size());
+    query.bindValue(2, fileInfo.lastModified().toMSecsSinceEpoch());
+    query.exec();
+    return query.first()? query.value(0).toString() : QString();
+}
+
+void DanmuManager::saveFileHash(const QFileInfo &fileInfo, const QString &fileHash)
+{
+    bool dbError = false;
+    QSqlDatabase db = GlobalObjects::getDB(GlobalObjects::Comment_DB, &dbError);
+    if(dbError) return;
+    QSqlQuery query(db);
+    query.prepare("insert or replace into file_hash(Path,Size,MTime,MD5) values(?,?,?,?)");
+    query.bindValue(0, fileInfo.absoluteFilePath());
+    query.bindValue(1, fileInfo.size());
+    query.bindValue(2, fileInfo.lastModified().toMSecsSinceEpoch());
+    query.bindValue(3, fileHash);
+    query.exec();
+}
+
+QString DanmuManager::hashFile(const QString &fileName)
+{
+    const qint64 hashSize = 16*1024*1024, chunkSize = 1024*1024;
     QFile mediaFile(fileName);
     bool ret=mediaFile.open(QIODevice::ReadOnly);
     if(!ret) return QString();
-    QByteArray file16MB = mediaFile.read(16*1024*1024);
-    return QCryptographicHash::hash(file16MB,QCryptographicHash::Md5).toHex();
+#ifdef Q_OS_LINUX
+    // larger read-ahead for the single sequential pass
+    posix_fadvise(mediaFile.handle(), 0, hashSize, POSIX_FADV_SEQUENTIAL);
+#endif
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    QByteArray chunk(chunkSize, Qt::Uninitialized);
+    for(qint64 remain = hashSize; remain > 0; )
+    {
+        const qint64 len = mediaFile.read(chunk.data(), qMin(remain, chunkSize));
+        if(len <= 0) break;
+        hash.addData(chunk.constData(), int(len));
+        remain -= len;
+    }
+    return hash.result().toHex();
 }
 
 void DanmuManager::localSearch(const QString &keyword, QList<AnimeLite> &results)
@@ -331,9 +389,9 @@ void DanmuManager::localSearch(const QString &keyword, QList<AnimeLite> &results
     }
 }
 
-void DanmuManager::localMatch(const QString &path, MatchResult &result)
+void DanmuManager::localMatch(const QString &path, MatchResult &result, const QString &fileHash)
 {
-    QString hashStr(getFileHash(path));
+    QString hashStr(fileHash.isEmpty()? getFileHash(path) : fileHash);
     do
     {
         if(hashStr.isEmpty()) break;
@@ -397,6 +455,22 @@ QString DanmuManager::createPool(const QString &path, const MatchResult &match)
     return createPool(match.name, match.ep.type, match.ep.index, match.ep.name, getFileHash(path));
 }
 
+QStringList DanmuManager::createPools(const QVector<MatchResult> &matches, const QStringList &fileHashes)
+{
+    Q_ASSERT(matches.size()==fileHashes.size());
+    QSqlDatabase db = GlobalObjects::getDB(GlobalObjects::Comment_DB);
+    // one transaction for the batch instead of one per insert
+    db.transaction();
+    QStringList poolIds;
+    for(int i = 0; i < matches.size(); ++i)
+    {
+        const MatchResult &match = matches[i];
+        poolIds << createPool(match.name, match.ep.type, match.ep.index, match.ep.name, fileHashes[i]);
+    }
+    db.commit();
+    return poolIds;
+}
+
 QString DanmuManager::renamePool(const QString &pid, const QString &nAnimeTitle, EpType nType, double nIndex,  const QString &nEpTitle)
 {
     Pool *pool=getPool(pid,false);
@@ -7,6 +7,7 @@
 #include "nodeinfo.h"
 #include "MediaLibrary/animeinfo.h"
 class Pool;
+class QFileInfo;
 class DanmuManager : public QObject
 {
     Q_OBJECT
@@ -28,11 +29,16 @@ public:
     QStringList getMatchedFile16Md5(const QString &pid);
     QString createPool(const QString &animeTitle, EpType epType, double epIndex, const QString &epName="", const QString &fileHash="");
     QString createPool(const QString &path, const MatchResult &match);
+    QStringList createPools(const QVector<MatchResult> &matches, const QStringList &fileHashes);
     QString renamePool(const QString &pid, const QString &nAnimeTitle, EpType nType, double nIndex, const QString &nEpTitle);
     QString getFileHash(const QString &fileName);
+    // md5 of the first 16MB, cached in file_hash by (path, size, mtime), not available to threads without a db connection
+    QString lookupFileHash(const QFileInfo &fileInfo);
+    void saveFileHash(const QFileInfo &fileInfo, const QString &fileHash);
+    static QString hashFile(const QString &fileName);
 public:
     void localSearch(const QString &keyword,  QList<AnimeLite> &results);
-    void localMatch(const QString &path, MatchResult &result);
+    void localMatch(const QString &path, MatchResult &result, const QString &fileHash = QString());
     QString updateMatch(const QString &fileName, const MatchResult &newMatchInfo);
     void removeMatch(const QString &fileName);
 private:
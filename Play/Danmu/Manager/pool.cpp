@@ -16,7 +16,7 @@ namespace
 }
 
 Pool::Pool(const QString &id, const QString &animeTitle, const QString &epTitle, EpType type, double index, QObject *parent):
-     QObject(parent),pid(id),anime(animeTitle),ep(epTitle),epType(type), epIndex(index), used(false),isLoaded(false)
+     QObject(parent),pid(id),anime(animeTitle),ep(epTitle),epType(type), epIndex(index), used(false),isLoaded(false),modCounter(0)
 {
 
 }
@@ -51,6 +51,7 @@ bool Pool::load()
         GlobalObjects::danmuManager->loadPool(this);
         GlobalObjects::blocker->checkDanmu(commentList.begin(), commentList.end());
         isLoaded=true;
+        markModified();
         return true;
     }
     GlobalObjects::blocker->checkDanmu(commentList.begin(), commentList.end());
@@ -64,6 +65,7 @@ bool Pool::clean()
     QVector<QSharedPointer<DanmuComment> > emptyList;
     commentList.swap(emptyList);
     isLoaded=false;
+    markModified();
     return true;
 }
 
@@ -101,11 +103,13 @@ int Pool::update(int sourceId, QVector<QSharedPointer<DanmuComment> > *incList)
     GlobalObjects::blocker->checkDanmu(tList.begin(), tList.end());
     if(incList!=nullptr) *incList=spList;
     if(!pid.isEmpty()) GlobalObjects::danmuManager->saveSource(pid,nullptr,spList);
+    if(tList.count()>0) markModified();
     if(tList.count()>0 && used)
     {
         std::sort(commentList.begin(),commentList.end(),DanmuSPCompare);
         emit poolChanged(true);
     }
+    if(!spList.isEmpty()) emit commentsAdded(spList);
     return tList.count();
 }
 
@@ -166,11 +170,13 @@ int Pool::addSource(const DanmuSource &sourceInfo, QVector<DanmuComment *> &danm
         tmpList.append(sp);
     }
     if(!pid.isEmpty() && save)GlobalObjects::danmuManager->saveSource(pid,containSource?nullptr:source,tmpList);
+    markModified();
     if(reset && used)
     {
         std::sort(commentList.begin(),commentList.end(),DanmuSPCompare);
         emit poolChanged(true);
     }
+    if(!tmpList.isEmpty()) emit commentsAdded(tmpList);
     return source->id;
 }
 
@@ -188,6 +194,7 @@ bool Pool::deleteSource(int sourceId, bool applyDB)
             ++iter;
     }
     if(!pid.isEmpty() && applyDB) GlobalObjects::danmuManager->deleteSource(pid,sourceId);
+    markModified();
     if(used)
     {
         emit poolChanged(true);
@@ -204,6 +211,7 @@ bool Pool::deleteDanmu(int pos)
         sourcesTable[commentList.at(pos)->source].count--;
         if(!pid.isEmpty())GlobalObjects::danmuManager->deleteDanmu(pid, commentList.at(pos));
         commentList.removeAt(pos);
+        markModified();
         return true;
     }
     return false;
@@ -222,6 +230,7 @@ bool Pool::setTimeline(int sourceId, const QVector<QPair<int, int>> &timelineInf
         if (cur->source == sourceId) setDelay(cur);
     }
     if(!pid.isEmpty()) GlobalObjects::danmuManager->updateSourceTimeline(pid,srcInfo);
+    markModified();
     if(used)
     {
         std::sort(commentList.begin(),commentList.end(),DanmuSPCompare);
@@ -244,6 +253,7 @@ bool Pool::setDelay(int sourceId, int delay)
         if (cur->source == sourceId) setDelay(cur);
     }
     if(!pid.isEmpty()) GlobalObjects::danmuManager->updateSourceDelay(pid,srcInfo);
+    markModified();
     if(used)
     {
         std::sort(commentList.begin(),commentList.end(),DanmuSPCompare);
@@ -255,13 +265,18 @@ bool Pool::setDelay(int sourceId, int delay)
 void Pool::setUsed(bool on)
 {
     used=on;
-    if(used) std::sort(commentList.begin(),commentList.end(),DanmuSPCompare);
+    if(used)
+    {
+        std::sort(commentList.begin(),commentList.end(),DanmuSPCompare);
+        markModified();
+    }
 }
 
 void Pool::setSourceVisibility(int srcId, bool show)
 {
     if(!sourcesTable.contains(srcId)) return;
     sourcesTable[srcId].show=show;
+    markModified();
 }
 
 void Pool::exportPool(const QString &fileName, bool useTimeline, bool applyBlockRule, const QList<int> &ids)
@@ -477,6 +492,13 @@ void Pool::addSourceJson(const QJsonArray &array)
     addSource(srcInfo,emptyList);
 }
 
+void Pool::markModified()
+{
+    // versions are drawn from one sequence, a pool created again under the same id never repeats an old one
+    static std::atomic<quint64> modSequence(0);
+    modCounter.store(++modSequence, std::memory_order_release);
+}
+
 void Pool::setDelay(DanmuComment *danmu)
 {
     auto srcInfo=&sourcesTable[danmu->source];
@@ -2,6 +2,7 @@
 #define POOL_H
 
 #include <QObject>
+#include <atomic>
 #include "../common.h"
 #include "MediaLibrary/animeinfo.h"
 
@@ -14,6 +15,8 @@ public:
     inline const QMap<int,DanmuSource> &sources(){return sourcesTable;}
     inline const QString &id() const {return pid;}
     inline bool isUsed() const {return used;}
+    // grows on every change of comments or sources, whether the pool is used or not
+    inline quint64 version() const {return modCounter.load(std::memory_order_acquire);}
     inline const QString &animeTitle() const {return anime;}
     inline const QString &epTitle() const {return ep;}
     EpInfo toEp() const { EpInfo ep; ep.name = this->ep; ep.type = epType; ep.index = epIndex; return ep; }
@@ -64,9 +67,11 @@ private:
     bool isLoaded;
     QVector<QSharedPointer<DanmuComment> > commentList;
     QMap<int,DanmuSource> sourcesTable;
+    std::atomic<quint64> modCounter;
 
     bool load();
     bool clean();
+    void markModified();
     void setDelay(DanmuComment *danmu);
     QSet<QString> getDanmuHashSet(int sourceId=-1);
     void addSourceJson(const QJsonArray &array);
@@ -74,6 +79,7 @@ private:
     friend class DanmuManager;
 signals:
     void poolChanged(bool reset);
+    void commentsAdded(const QVector<QSharedPointer<DanmuComment> > &comments);
 };
 
 #endif // POOL_H
@@ -145,7 +145,7 @@ void DanmuPool::launch(const QList<QSharedPointer<DanmuComment> > userComments)
     } else {
         recyclePrepareList(prepareList);
     }
-
+    emit danmuLaunched(userComments);
 }
 
 bool DanmuPool::addLocalDanmuFile(const QString &fileName)
@@ -74,6 +74,7 @@ signals:
     void statisInfoChange();
     void eventAnalyzeFinished(const QVector<DanmuEvent> &);
     void poolIdChanged();
+    void danmuLaunched(const QList<QSharedPointer<DanmuComment> > &comments);
 public slots:
     void mediaTimeElapsed(int newTime);
     void mediaTimeJumped(int newTime);
@@ -0,0 +1,253 @@
+#include "folderscanner.h"
+#include "globalobjects.h"
+#include "Play/Video/mpvplayer.h"
+#include <QtConcurrent>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <algorithm>
+
+namespace
+{
+    const quint32 stateMagic = 0x4B465332;  // KFS2
+
+    // listings only keep video files, they are valid for the formats they were filtered with
+    QString formatsKey()
+    {
+        QStringList formats(GlobalObjects::mpvplayer->videoFileFormats);
+        std::sort(formats.begin(), formats.end());
+        return formats.join(' ');
+    }
+}
+
+FolderScanner::FolderScanner(QObject *parent) : QObject(parent), statesLoaded(false), statesChanged(false)
+{
+    // listing is I/O bound, a few threads are enough to hide the latency of a network drive
+    pool.setMaxThreadCount(4);
+}
+
+FolderScanner::~FolderScanner()
+{
+    pool.waitForDone();
+}
+
+void FolderScanner::scan(const QStringList &roots, Callback callback)
+{
+    QtConcurrent::run(&pool, [this, roots, callback](){
+        QSharedPointer<const Result> result = walk(roots);
+        QMetaObject::invokeMethod(this, [result, callback](){
+            callback(result);
+        }, Qt::QueuedConnection);
+    });
+}
+
+bool FolderScanner::isVideoFile(const QString &fileName)
+{
+    static const QSet<QString> suffixes = [](){
+        QSet<QString> suffixSet;
+        for(const QString &format : GlobalObjects::mpvplayer->videoFileFormats)
+        {
+            suffixSet.insert(format.mid(2));  // *.mkv
+        }
+        return suffixSet;
+    }();
+    const int suffixPos = fileName.lastIndexOf('.');
+    return suffixPos >= 0 && suffixes.contains(fileName.mid(suffixPos + 1).toLower());
+}
+
+QString FolderScanner::filePath(const QString &dirPath, const QString &name)
+{
+    return dirPath.endsWith('/')? dirPath + name : dirPath + '/' + name;
+}
+
+QSharedPointer<FolderScanner::Result> FolderScanner::walk(const QStringList &roots)
+{
+    loadStates();
+    QSharedPointer<Result> result(new Result);
+    QStringList rootPaths;
+    for(const QString &root : roots)
+    {
+        rootPaths.append(QDir(root).path());
+    }
+    std::sort(rootPaths.begin(), rootPaths.end());
+    QVector<int> level;
+    for(const QString &root : rootPaths)
+    {
+        const bool nested = std::any_of(result->dirs.cbegin(), result->dirs.cend(), [&root](const Dir &dir){
+            return root == dir.path || root.startsWith(filePath(dir.path, ""));
+        });
+        if(nested) continue;
+        Dir dir;
+        dir.path = root;
+        dir.name = QDir(root).dirName();
+        result->pathIndex.insert(root, result->dirs.size());
+        level.append(result->dirs.size());
+        result->dirs.append(dir);
+    }
+    // breadth first, the directories of a level are listed in parallel
+    for(int depth = 0; depth < maxDepth && !level.isEmpty(); ++depth)
+    {
+        QVector<QFuture<DirState>> listings;
+        listings.reserve(level.size());
+        for(int index : level)
+        {
+            const QString path = result->dirs[index].path;
+            listings.append(QtConcurrent::run(&pool, [this, path](){
+                return list(path);
+            }));
+        }
+        QVector<int> nextLevel;
+        for(int i = 0; i < level.size(); ++i)
+        {
+            // waiting runs the listing in this thread if it has not been started yet
+            const DirState state = listings[i].result();
+            const QString dirPath = result->dirs[level[i]].path;
+            result->dirs[level[i]].exists = state.exists;
+            for(const auto &item : state.entries)
+            {
+                Entry entry;
+                entry.name = item.first;
+                if(item.second)
+                {
+                    const QString subPath = filePath(dirPath, item.first);
+                    if(result->pathIndex.contains(subPath)) continue;
+                    Dir subDir;
+                    subDir.path = subPath;
+                    subDir.name = item.first;
+                    entry.subDir = result->dirs.size();
+                    result->pathIndex.insert(subPath, entry.subDir);
+                    result->dirs.append(subDir);
+                    nextLevel.append(entry.subDir);
+                }
+                result->dirs[level[i]].entries.append(entry);
+            }
+        }
+        level.swap(nextLevel);
+    }
+    // sub directories are always behind their parent
+    for(int i = result->dirs.size() - 1; i >= 0; --i)
+    {
+        Dir &dir = result->dirs[i];
+        for(const Entry &entry : dir.entries)
+        {
+            if(entry.subDir < 0 || result->dirs[entry.subDir].hasVideo)
+            {
+                dir.hasVideo = true;
+                break;
+            }
+        }
+    }
+    saveStates();
+    return result;
+}
+
+FolderScanner::DirState FolderScanner::list(const QString &path)
+{
+    const QFileInfo dirInfo(path);
+    if(!dirInfo.isDir())
+    {
+        QMutexLocker locker(&stateLock);
+        if(dirStates.remove(path) > 0) statesChanged = true;
+        DirState state;
+        state.exists = false;
+        return state;
+    }
+    const qint64 mtime = dirInfo.lastModified().toMSecsSinceEpoch();
+    {
+        QMutexLocker locker(&stateLock);
+        auto iter = dirStates.constFind(path);
+        if(iter != dirStates.cend() && iter->mtime == mtime) return iter.value();
+    }
+    DirState state;
+    state.mtime = mtime;
+    QSet<QString> downloading;
+    QDirIterator iter(path, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+    while(iter.hasNext())
+    {
+        iter.next();
+        const QFileInfo fileInfo = iter.fileInfo();
+        const QString fileName = fileInfo.fileName();
+        if(fileInfo.isDir())
+            state.entries.append({fileName, true});
+        else if(isVideoFile(fileName))
+            state.entries.append({fileName, false});
+        else if(fileName.endsWith(".aria2"))
+            downloading.insert(fileName.chopped(6));
+    }
+    if(!downloading.isEmpty())
+    {
+        state.entries.erase(std::remove_if(state.entries.begin(), state.entries.end(), [&downloading](const QPair<QString, bool> &entry){
+            return !entry.second && downloading.contains(entry.first);
+        }), state.entries.end());
+    }
+    // same order as QDir::entryInfoList
+    std::sort(state.entries.begin(), state.entries.end(), [](const QPair<QString, bool> &e1, const QPair<QString, bool> &e2){
+        return e1.first.compare(e2.first, Qt::CaseInsensitive) < 0;
+    });
+    // the mtime of a directory changed just now may not cover all changes yet
+    if(QDateTime::currentMSecsSinceEpoch() - mtime > stableTime)
+    {
+        QMutexLocker locker(&stateLock);
+        if(dirStates.size() >= maxDirStates) dirStates.clear();
+        dirStates.insert(path, state);
+        statesChanged = true;
+    }
+    return state;
+}
+
+void FolderScanner::loadStates()
+{
+    QMutexLocker saveLocker(&saveLock);
+    if(statesLoaded) return;
+    statesLoaded = true;
+    QFile stateFile(GlobalObjects::dataPath + "folderstate.dat");
+    if(!stateFile.open(QFile::ReadOnly)) return;
+    QDataStream ds(&stateFile);
+    quint32 magic = 0, count = 0;
+    QString formats;
+    ds >> magic;
+    if(ds.status() != QDataStream::Ok || magic != stateMagic) return;
+    ds >> formats >> count;
+    if(ds.status() != QDataStream::Ok || formats != formatsKey()) return;
+    QHash<QString, DirState> states;
+    states.reserve(int(qMin(count, quint32(maxDirStates))));
+    for(quint32 i = 0; i < count && ds.status() == QDataStream::Ok; ++i)
+    {
+        QString path;
+        DirState state;
+        ds >> path >> state.mtime >> state.entries;
+        states.insert(path, state);
+    }
+    if(ds.status() != QDataStream::Ok) return;
+    QMutexLocker locker(&stateLock);
+    // states listed before loading are newer
+    for(auto iter = states.cbegin(); iter != states.cend(); ++iter)
+    {
+        if(!dirStates.contains(iter.key())) dirStates.insert(iter.key(), iter.value());
+    }
+}
+
+void FolderScanner::saveStates()
+{
+    QMutexLocker saveLocker(&saveLock);
+    QHash<QString, DirState> states;
+    {
+        QMutexLocker locker(&stateLock);
+        if(!statesChanged) return;
+        states = dirStates;
+        statesChanged = false;
+    }
+    QSaveFile stateFile(GlobalObjects::dataPath + "folderstate.dat");
+    if(!stateFile.open(QFile::WriteOnly)) return;
+    QDataStream ds(&stateFile);
+    ds << stateMagic << formatsKey() << quint32(states.size());
+    for(auto iter = states.cbegin(); iter != states.cend(); ++iter)
+    {
+        ds << iter.key() << iter->mtime << iter->entries;
+    }
+    stateFile.commit();
+}
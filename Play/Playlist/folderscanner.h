@@ -0,0 +1,73 @@
+#ifndef FOLDERSCANNER_H
+#define FOLDERSCANNER_H
+#include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QVector>
+#include <functional>
+
+/*
+ * Scans local folders for PlayList::addFolder/refreshFolder on a thread pool.
+ * The directories of each level are listed in parallel and video files are matched by suffix through a hash set.
+ * Listings are cached per directory together with its mtime and persisted in folderstate.dat,
+ * an unchanged directory costs a single stat instead of a listing. The file is dropped when the video formats change.
+ * Files still being downloaded by aria2 (with a .aria2 control file beside them) are left out.
+ */
+class FolderScanner : public QObject
+{
+    Q_OBJECT
+public:
+    struct Entry
+    {
+        QString name;
+        int subDir = -1;  // index in Result, -1: video file
+    };
+    struct Dir
+    {
+        QString path, name;
+        QVector<Entry> entries;  // video files and sub directories, sorted by name
+        bool exists = true;
+        bool hasVideo = false;   // the subtree contains video files
+    };
+    struct Result
+    {
+        QVector<Dir> dirs;
+        QHash<QString, int> pathIndex;  // scanned directories, path -> index in dirs
+    };
+    using Callback = std::function<void(QSharedPointer<const Result>)>;
+
+    explicit FolderScanner(QObject *parent = nullptr);
+    ~FolderScanner();
+
+    // roots nested in other roots are served by the outer walk, callback runs in the thread of the scanner
+    void scan(const QStringList &roots, Callback callback);
+
+    static bool isVideoFile(const QString &fileName);
+    static QString filePath(const QString &dirPath, const QString &name);
+
+private:
+    static const int maxDepth = 64;
+    static const int maxDirStates = 200000;
+    static const qint64 stableTime = 2000;  // ms, a directory modified within this time is not cached
+
+    struct DirState
+    {
+        qint64 mtime = 0;
+        QVector<QPair<QString, bool>> entries;  // name, isDir
+        bool exists = true;
+    };
+
+    QThreadPool pool;
+    QMutex stateLock, saveLock;
+    QHash<QString, DirState> dirStates;
+    bool statesLoaded, statesChanged;
+
+    QSharedPointer<Result> walk(const QStringList &roots);
+    DirState list(const QString &path);
+    void loadStates();
+    void saveStates();
+};
+
+#endif // FOLDERSCANNER_H
@@ -0,0 +1,176 @@
+#include "folderwatcher.h"
+#include "Common/logger.h"
+#include <QtConcurrent>
+#include <QDateTime>
+#include <QDir>
+#include <QFileSystemWatcher>
+#include <QFutureWatcher>
+#include <algorithm>
+
+FolderWatcher::FolderWatcher(QObject *parent) : QObject(parent), watcher(new QFileSystemWatcher(this))
+{
+    debounceTimer.setSingleShot(true);
+    QObject::connect(&debounceTimer, &QTimer::timeout, this, &FolderWatcher::flush);
+    QObject::connect(watcher, &QFileSystemWatcher::directoryChanged, this, &FolderWatcher::onDirectoryChanged);
+}
+
+void FolderWatcher::setRoots(const QStringList &rootPaths)
+{
+    QSet<QString> newRoots;
+    for(const QString &path : rootPaths)
+    {
+        if(newRoots.size() >= maxRoots) break;
+        newRoots.insert(QDir(path).path());
+    }
+    if(newRoots == roots) return;
+    QStringList removed, added;
+    for(const QString &path : roots)
+    {
+        if(!newRoots.contains(path) && !hotDirs.contains(path)) removed << path;
+    }
+    for(const QString &path : newRoots)
+    {
+        if(!roots.contains(path) && !hotDirs.contains(path)) added << path;
+    }
+    roots.swap(newRoots);
+    // hot directories only matter below a root
+    for(auto iter = hotDirs.begin(); iter != hotDirs.end();)
+    {
+        const QString &path = iter.key();
+        const bool underRoot = std::any_of(roots.cbegin(), roots.cend(), [&path](const QString &root){
+            return path.startsWith(FolderScanner::filePath(root, ""));
+        });
+        if(underRoot || roots.contains(path))
+        {
+            ++iter;
+            continue;
+        }
+        removed << path;
+        iter = hotDirs.erase(iter);
+    }
+    if(!removed.isEmpty())
+    {
+        watcher->removePaths(removed);
+        for(const QString &path : removed) subDirs.remove(path);
+    }
+    if(added.isEmpty()) return;
+    const QStringList failed = watcher->addPaths(added);
+    if(!failed.isEmpty())
+    {
+        Logger::logger()->log(Logger::APP, QString("[FolderWatcher]Cannot watch %1 folder(s), e.g. %2").arg(failed.size()).arg(failed.first()));
+    }
+    // sub directories of new roots are the baseline for hot directories, listed in the background
+    QFutureWatcher<QHash<QString, QSet<QString>>> *baselineWatcher = new QFutureWatcher<QHash<QString, QSet<QString>>>(this);
+    QObject::connect(baselineWatcher, &QFutureWatcherBase::finished, this, [this, baselineWatcher](){
+        const QHash<QString, QSet<QString>> baseline = baselineWatcher->result();
+        for(auto iter = baseline.cbegin(); iter != baseline.cend(); ++iter)
+        {
+            if(roots.contains(iter.key()) && !subDirs.contains(iter.key())) subDirs.insert(iter.key(), iter.value());
+        }
+        baselineWatcher->deleteLater();
+    });
+    baselineWatcher->setFuture(QtConcurrent::run([added](){
+        QHash<QString, QSet<QString>> baseline;
+        for(const QString &path : added)
+        {
+            const QStringList names = QDir(path).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+            baseline.insert(path, QSet<QString>(names.begin(), names.end()));
+        }
+        return baseline;
+    }));
+}
+
+void FolderWatcher::updateSubDirs(const FolderScanner::Result &result)
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QVector<int> freshDirs;
+    const QStringList watched = watcher->directories();
+    for(const QString &path : watched)
+    {
+        const int index = result.pathIndex.value(path, -1);
+        if(index < 0 || !result.dirs[index].exists) continue;
+        QSet<QString> names;
+        auto known = subDirs.constFind(path);
+        for(const FolderScanner::Entry &entry : result.dirs[index].entries)
+        {
+            if(entry.subDir < 0) continue;
+            names.insert(entry.name);
+            if(known != subDirs.cend() && !known->contains(entry.name)) freshDirs << entry.subDir;
+        }
+        subDirs.insert(path, names);
+    }
+    // everything below a new directory is new too, e.g. the folders of a multi-file torrent
+    int added = 0;
+    while(!freshDirs.isEmpty() && added < maxHotDirs)
+    {
+        const FolderScanner::Dir &dir = result.dirs[freshDirs.takeLast()];
+        addHotDir(dir.path, now);
+        ++added;
+        QSet<QString> names;
+        for(const FolderScanner::Entry &entry : dir.entries)
+        {
+            if(entry.subDir < 0) continue;
+            names.insert(entry.name);
+            freshDirs << entry.subDir;
+        }
+        subDirs.insert(dir.path, names);
+    }
+}
+
+void FolderWatcher::onDirectoryChanged(const QString &path)
+{
+    pendingDirs.insert(path);
+    if(hotDirs.contains(path)) hotDirs[path] = QDateTime::currentMSecsSinceEpoch();
+    if(!pendingTimer.isValid()) pendingTimer.start();
+    // a storm of events is reported every maxDelay at the latest
+    debounceTimer.start(int(qBound<qint64>(0, maxDelay - pendingTimer.elapsed(), debounceTime)));
+}
+
+void FolderWatcher::flush()
+{
+    pendingTimer.invalidate();
+    removeExpiredHotDirs(QDateTime::currentMSecsSinceEpoch());
+    const QStringList dirs(pendingDirs.values());
+    pendingDirs.clear();
+    if(!dirs.isEmpty()) emit foldersChanged(dirs);
+}
+
+void FolderWatcher::addHotDir(const QString &path, qint64 now)
+{
+    if(hotDirs.contains(path) || roots.contains(path))
+    {
+        if(hotDirs.contains(path)) hotDirs[path] = now;
+        return;
+    }
+    if(hotDirs.size() >= maxHotDirs)
+    {
+        auto oldest = std::min_element(hotDirs.begin(), hotDirs.end());
+        unwatch(oldest.key());
+        hotDirs.erase(oldest);
+    }
+    if(watcher->addPath(path)) hotDirs.insert(path, now);
+}
+
+void FolderWatcher::removeExpiredHotDirs(qint64 now)
+{
+    for(auto iter = hotDirs.begin(); iter != hotDirs.end();)
+    {
+        if(now - iter.value() > hotTime)
+        {
+            unwatch(iter.key());
+            iter = hotDirs.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+}
+
+void FolderWatcher::unwatch(const QString &hotDir)
+{
+    // a hot directory may have become a root
+    if(roots.contains(hotDir)) return;
+    watcher->removePath(hotDir);
+    subDirs.remove(hotDir);
+}
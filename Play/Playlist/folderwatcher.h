@@ -0,0 +1,52 @@
+#ifndef FOLDERWATCHER_H
+#define FOLDERWATCHER_H
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
+#include "folderscanner.h"
+class QFileSystemWatcher;
+
+/*
+ * Watches the folders of playlist collections for new and removed files.
+ * A watch covers a single directory and watches per user are limited (inotify on Linux), so only the root folders
+ * of collections are watched, plus hot directories: sub directories that appeared recently, e.g. created by a download.
+ * Events are collected until none came for debounceTime (at most maxDelay), then reported by foldersChanged.
+ */
+class FolderWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FolderWatcher(QObject *parent = nullptr);
+
+    void setRoots(const QStringList &rootPaths);
+    // sub directories of watched directories that were not seen before become hot
+    void updateSubDirs(const FolderScanner::Result &result);
+
+signals:
+    void foldersChanged(const QStringList &dirs);
+
+private:
+    static const int debounceTime = 1500;  // ms
+    static const int maxDelay = 10000;  // ms
+    static const int maxRoots = 512;
+    static const int maxHotDirs = 128;
+    static const qint64 hotTime = 6 * 3600 * 1000;  // ms
+
+    QFileSystemWatcher *watcher;
+    QSet<QString> roots;
+    QHash<QString, qint64> hotDirs;  // path -> last change
+    QHash<QString, QSet<QString>> subDirs;  // watched directory -> names of its sub directories
+    QSet<QString> pendingDirs;
+    QTimer debounceTimer;
+    QElapsedTimer pendingTimer;
+
+    void onDirectoryChanged(const QString &path);
+    void flush();
+    void addHotDir(const QString &path, qint64 now);
+    void removeExpiredHotDirs(qint64 now);
+    void unwatch(const QString &hotDir);
+};
+
+#endif // FOLDERWATCHER_H
@@ -7,6 +7,8 @@
 #include <QCoreApplication>
 #include <QDir>
 #include <QCollator>
+#include <QFileInfo>
+#include <QtConcurrent>
 
 #include "playlistprivate.h"
 #include "webdav/qwebdav.h"
@@ -24,28 +26,30 @@
 namespace
 {
     static QCollator comparer;
-    struct
+    const int parallelSortSize = 4096;
+    // sort keys are compared bytewise, preparing them costs one collation per item instead of one per comparison
+    void prepareSortKeys(const QVector<PlayListItem *> &items)
     {
-        inline bool operator()(const PlayListItem *item1,const PlayListItem *item2) const
-        {
-            return comparer.compare(item1->title,item2->title)>=0?false:true;
-        }
-    } titleCompareAscending;
-    struct
+        for (PlayListItem *item : items)
+            item->titleSortKey(comparer);
+    }
+    void sortChildren(PlayListItem *parent, bool ascendingOrder)
     {
-        inline bool operator()(const PlayListItem *item1,const PlayListItem *item2) const
-        {
-            return comparer.compare(item2->title,item1->title)>=0?false:true;
-        }
-    } titleCompareDescending;
+        // keys are ready, comparing them is safe on any thread
+        std::sort(parent->children->begin(), parent->children->end(), [ascendingOrder](PlayListItem *item1, PlayListItem *item2){
+            const int ret = item1->titleSortKey(comparer).compare(item2->titleSortKey(comparer));
+            return ascendingOrder? ret < 0 : ret > 0;
+        });
+    }
 }
 
-PlayList::PlayList(QObject *parent) : QAbstractItemModel(parent), d_ptr(new PlayListPrivate(this))
+PlayList::PlayList(QObject *parent) : QAbstractItemModel(parent), d_ptr(new PlayListPrivate(this)), folderWatcher(nullptr)
 {
     Q_D(PlayList);
     comparer.setNumericMode(true);
     d->loadRecentlist();
     d->loadPlaylist();
+    d->publishSnapshot();
     qRegisterMetaType<QList<PlayListItem *> >("QList<PlayListItem *>");
     matchWorker = new MatchWorker();
     matchWorker->moveToThread(GlobalObjects::workThread);
@@ -53,7 +57,7 @@ PlayList::PlayList(QObject *parent) : QAbstractItemModel(parent), d_ptr(new Play
     QObject::connect(matchWorker, &MatchWorker::matchDown, this, [this](const QList<PlayListItem *> &matchedItems){
         Q_D(PlayList);
         d->playListChanged = true;
-        d->needRefresh = true;
+        d->markChanged();
         for(auto currentItem : matchedItems)
         {
             QModelIndex nIndex = createIndex(currentItem->parent->children->indexOf(currentItem), 0, currentItem);
@@ -65,6 +69,39 @@ PlayList::PlayList(QObject *parent) : QAbstractItemModel(parent), d_ptr(new Play
         emit matchStatusChanged(false);
     });
 
+    folderScanner = new FolderScanner(this);
+    if (GlobalObjects::appSetting->value("List/WatchFolders", true).toBool())
+    {
+        folderWatcher = new FolderWatcher(this);
+        QObject::connect(folderWatcher, &FolderWatcher::foldersChanged, this, [this](const QStringList &dirs){
+            Q_D(PlayList);
+            const QStringList folders = d->collectionFolders(dirs);
+            if (folders.isEmpty()) return;
+            folderScanner->scan(folders, [this](QSharedPointer<const FolderScanner::Result> result){
+                Q_D(PlayList);
+                QVector<PlayListItem *> nItems;
+                const int removed = d->removeMissing(d->root, *result);
+                const int added = d->applyRefresh(d->root, *result, nItems);
+                folderWatcher->updateSubDirs(*result);
+                if (added == 0 && removed == 0) return;
+                d->addMediaPathHash(nItems);
+                d->playListChanged=true;
+                d->markChanged();
+                d->incModifyCounter();
+                d->savePlaylist();
+                Notifier::getNotifier()->showMessage(Notifier::LIST_NOTIFY, tr("Folder changed, add %1 item(s), remove %2 item(s)").arg(added).arg(removed), NM_HIDE);
+                if (d->autoMatch && added > 0)
+                {
+                    emit matchStatusChanged(true);
+                    QMetaObject::invokeMethod(matchWorker, [this, nItems](){
+                        matchWorker->match(nItems);
+                    },Qt::QueuedConnection);
+                }
+            });
+        });
+        folderWatcher->setRoots(d->watchRoots());
+    }
+
     webdavWorker = new WebDAVWorker();
     webdavWorker->moveToThread(GlobalObjects::workThread);
     QObject::connect(GlobalObjects::workThread, &QThread::finished, webdavWorker, &QObject::deleteLater);
@@ -138,6 +175,7 @@ PlayList::~PlayList()
 {
     Q_D(PlayList);
     d->savePlaylist();
+    d->exportPlaylist();
     d->saveRecentlist();
     delete d;
 }
@@ -287,7 +325,7 @@ int PlayList::addItems(QStringList &items, QModelIndex parent)
 	endInsertRows();
     d->addMediaPathHash(matchItems);
     d->playListChanged=true;
-    d->needRefresh = true;
+    d->markChanged();
     d->incModifyCounter();
     notifier->showMessage(Notifier::LIST_NOTIFY, tr("Add %1 item(s)").arg(tmpItems.size()),NM_HIDE);
     if(d->autoMatch && matchItems.count()>0)
@@ -300,68 +338,53 @@ int PlayList::addItems(QStringList &items, QModelIndex parent)
     return tmpItems.size();
 }
 
-int PlayList::addFolder(QString folderStr, QModelIndex parent, const QString &name)
+void PlayList::addFolder(QString folderStr, QModelIndex parent, const QString &name, std::function<void(int)> done)
 {
-    Q_D(PlayList);
-    int insertPosition(0);
-    PlayListItem *parentItem = parent.isValid() ? static_cast<PlayListItem*>(parent.internalPointer()) : d->root;
-	if (parentItem->children)
-    {
-        insertPosition = parentItem->children->size();
-    }
-	else
-	{
-        insertPosition = parentItem->parent->children->indexOf(parentItem) + 1;
-		parentItem = parentItem->parent;
-		parent = this->parent(parent);
-	}
-	
-    PlayListItem folderRootCollection;
-    int itemCount=0;
-    d->addSubFolder(folderStr, &folderRootCollection,itemCount);
-    QVector<PlayListItem *> matchItems;
-    if (folderRootCollection.children->count())
-	{
-        PlayListItem *folderRoot(folderRootCollection.children->first());
-        if (!name.isEmpty())
+    // the parent may be removed during the scan, the folder goes to the root then
+    const QPersistentModelIndex parentIndex(parent);
+    folderScanner->scan({folderStr}, [this, parentIndex, name, done](QSharedPointer<const FolderScanner::Result> result){
+        Q_D(PlayList);
+        QModelIndex parent(parentIndex);
+        int insertPosition(0);
+        PlayListItem *parentItem = parent.isValid() ? static_cast<PlayListItem*>(parent.internalPointer()) : d->root;
+        if (parentItem->children)
         {
-            folderRoot->title = name;
+            insertPosition = parentItem->children->size();
+        }
+        else
+        {
+            insertPosition = parentItem->parent->children->indexOf(parentItem) + 1;
+            parentItem = parentItem->parent;
+            parent = this->parent(parent);
         }
-        beginInsertRows(parent, insertPosition, insertPosition);
-        folderRoot->moveTo(parentItem, insertPosition);
-		endInsertRows();
-        d->playListChanged=true;
-        d->needRefresh = true;
-        d->incModifyCounter();
 
-        QVector<PlayListItem *> items({folderRoot});
-        while(!items.empty())
+        QVector<PlayListItem *> matchItems;
+        PlayListItem *folderRoot = result->dirs.isEmpty()? nullptr : d->buildFolderItem(*result, 0, matchItems);
+        if (folderRoot)
         {
-            PlayListItem *currentItem=items.takeFirst();
-            if(currentItem->children)
-            {
-                for(PlayListItem *child:*currentItem->children)
-                {
-                    items.push_back(child);
-                }
-            }
-            else if(currentItem->poolID.isEmpty())
+            if (!name.isEmpty())
             {
-                matchItems<<currentItem;
+                folderRoot->title = name;
             }
+            beginInsertRows(parent, insertPosition, insertPosition);
+            folderRoot->moveTo(parentItem, insertPosition);
+            endInsertRows();
+            d->playListChanged=true;
+            d->markChanged();
+            d->incModifyCounter();
         }
-    }
-    d->addMediaPathHash(matchItems);
-    Notifier *notifier = Notifier::getNotifier();
-    notifier->showMessage(Notifier::LIST_NOTIFY, tr("Add %1 item(s)").arg(itemCount),NotifyMessageFlag::NM_HIDE);
-    if(d->autoMatch && matchItems.count()>0)
-    {
-        emit matchStatusChanged(true);
-        QMetaObject::invokeMethod(matchWorker, [this, matchItems](){
-            matchWorker->match(matchItems);
-        },Qt::QueuedConnection);
-    }
-    return itemCount;
+        d->addMediaPathHash(matchItems);
+        Notifier *notifier = Notifier::getNotifier();
+        notifier->showMessage(Notifier::LIST_NOTIFY, tr("Add %1 item(s)").arg(matchItems.size()),NotifyMessageFlag::NM_HIDE);
+        if(d->autoMatch && matchItems.count()>0)
+        {
+            emit matchStatusChanged(true);
+            QMetaObject::invokeMethod(matchWorker, [this, matchItems](){
+                matchWorker->match(matchItems);
+            },Qt::QueuedConnection);
+        }
+        if(done) done(matchItems.size());
+    });
 }
 
 int PlayList::addURL(const QStringList &urls, QModelIndex parent, bool decodeTitle)
@@ -414,7 +437,7 @@ int PlayList::addURL(const QStringList &urls, QModelIndex parent, bool decodeTit
     }
     endInsertRows();
     d->playListChanged=true;
-    d->needRefresh = true;
+    d->markChanged();
     d->incModifyCounter();
     Notifier *notifier = Notifier::getNotifier();
     notifier->showMessage(Notifier::LIST_NOTIFY, tr("Add %1 URL item(s)").arg(insertCount), NM_HIDE);
@@ -444,7 +467,7 @@ void PlayList::deleteItems(const QModelIndexList &deleteIndexes)
     }
     Q_D(PlayList);
     d->playListChanged=true;
-    d->needRefresh = true;
+    d->markChanged();
     d->incModifyCounter();
 }
 
@@ -491,7 +514,7 @@ int PlayList::deleteInvalidItems(const QModelIndexList &indexes)
     }
     Q_D(PlayList);
     d->playListChanged=true;
-    d->needRefresh = true;
+    d->markChanged();
     d->incModifyCounter();
     return invalidItems.size();
 }
@@ -511,7 +534,7 @@ void PlayList::clear()
     d->pathHashLock.unlock();
     d->fileItems.clear();
     d->playListChanged=true;
-    d->needRefresh = true;
+    d->markChanged();
 }
 
 void PlayList::sortItems(const QModelIndex &parent, bool ascendingOrder)
@@ -523,37 +546,45 @@ void PlayList::sortItems(const QModelIndex &parent, bool ascendingOrder)
         QList<QPersistentModelIndex> persistentIndexList;
         persistentIndexList.append(QPersistentModelIndex(parent));
         emit layoutAboutToBeChanged(persistentIndexList);
-        if(ascendingOrder)
-            std::sort(parentItem->children->begin(),parentItem->children->end(),titleCompareAscending);
-        else
-            std::sort(parentItem->children->begin(),parentItem->children->end(),titleCompareDescending);
+        prepareSortKeys(*parentItem->children);
+        sortChildren(parentItem, ascendingOrder);
         emit layoutChanged(persistentIndexList);
     }
     d->playListChanged=true;
-    d->needRefresh = true;
+    d->markChanged();
     d->incModifyCounter();
 }
 
 void PlayList::sortAllItems(bool ascendingOrder)
 {
     Q_D(PlayList);
-    QList<PlayListItem *> items;
-    items.push_back(d->root);
+    QVector<PlayListItem *> collections;
+    collections.push_back(d->root);
+    int itemCount = 0;
     emit layoutAboutToBeChanged();
-    while(!items.empty())
+    for(int i = 0; i < collections.size(); ++i)
     {
-        PlayListItem *currentItem=items.front();
-        items.pop_front();
-        if(ascendingOrder)
-            std::sort(currentItem->children->begin(),currentItem->children->end(),titleCompareAscending);
-        else
-            std::sort(currentItem->children->begin(),currentItem->children->end(),titleCompareDescending);
-        for(PlayListItem *child:*currentItem->children)
+        const QVector<PlayListItem *> &children = *collections[i]->children;
+        prepareSortKeys(children);
+        itemCount += children.size();
+        for(PlayListItem *child : children)
             if(child->children)
-                items.push_back(child);
+                collections.push_back(child);
+    }
+    // collections are independent, large trees are sorted in parallel
+    if(itemCount >= parallelSortSize && collections.size() > 1)
+    {
+        QtConcurrent::blockingMap(collections, [ascendingOrder](PlayListItem *collection){
+            sortChildren(collection, ascendingOrder);
+        });
+    }
+    else
+    {
+        for(PlayListItem *collection : collections)
+            sortChildren(collection, ascendingOrder);
     }
     d->playListChanged=true;
-    d->needRefresh = true;
+    d->markChanged();
     emit layoutChanged();
 }
 
@@ -579,7 +610,7 @@ QModelIndex PlayList::addCollection(QModelIndex parent, const QString &title)
     newCollection->addTime = QDateTime::currentDateTime().toSecsSinceEpoch();
 	endInsertRows();
     d->playListChanged=true;
-    d->needRefresh = true;
+    d->markChanged();
     d->incModifyCounter();
     return this->index(insertPosition,0,parent);
 }
@@ -619,38 +650,57 @@ QModelIndex PlayList::getCollection(QModelIndex parent, const QStringList &path)
     if (listChanged)
     {
         d->playListChanged=true;
-        d->needRefresh = true;
+        d->markChanged();
         d->incModifyCounter();
     }
     return parent;
 }
 
-int PlayList::refreshFolder(const QModelIndex &index)
+void PlayList::refreshFolder(const QModelIndex &index)
 {
-    Q_D(PlayList);
-    if(!index.isValid())return 0;
+    if(!index.isValid())return;
     PlayListItem *item = static_cast<PlayListItem*>(index.internalPointer());
-    if(!item->children) return 0;
-    QVector<PlayListItem *> nItems;
-    int c = d->refreshFolder(item, nItems);
-    d->addMediaPathHash(nItems);
-    Notifier *notifier = Notifier::getNotifier();
-    notifier->showMessage(Notifier::LIST_NOTIFY, tr("Add %1 item(s)").arg(c),NotifyMessageFlag::NM_HIDE);
-    if(c>0)
-    {
-        d->playListChanged=true;
-        d->needRefresh = true;
-        d->incModifyCounter();
-        if(d->autoMatch)
+    if(!item->children) return;
+    // folders of nested collections are scanned in the same walk
+    QStringList roots;
+    QVector<PlayListItem *> collections({item});
+    while(!collections.isEmpty())
+    {
+        PlayListItem *collection = collections.takeLast();
+        if(collection->isWebDAVCollection()) continue;
+        if(!collection->path.isEmpty()) roots << collection->path;
+        for(PlayListItem *child : *collection->children)
         {
-            emit matchStatusChanged(true);
-            QMetaObject::invokeMethod(matchWorker, [this, nItems](){
-                matchWorker->match(nItems);
-            },Qt::QueuedConnection);
+            if(child->children) collections << child;
         }
-        d->savePlaylist();
     }
-    return c;
+    if(roots.isEmpty()) return;
+    const QPersistentModelIndex folderIndex(index);
+    folderScanner->scan(roots, [this, folderIndex](QSharedPointer<const FolderScanner::Result> result){
+        Q_D(PlayList);
+        // the collection has been removed during the scan
+        if(!folderIndex.isValid()) return;
+        PlayListItem *item = static_cast<PlayListItem*>(folderIndex.internalPointer());
+        QVector<PlayListItem *> nItems;
+        int c = d->applyRefresh(item, *result, nItems);
+        d->addMediaPathHash(nItems);
+        Notifier *notifier = Notifier::getNotifier();
+        notifier->showMessage(Notifier::LIST_NOTIFY, tr("Add %1 item(s)").arg(c),NotifyMessageFlag::NM_HIDE);
+        if(c>0)
+        {
+            d->playListChanged=true;
+            d->markChanged();
+            d->incModifyCounter();
+            if(d->autoMatch)
+            {
+                emit matchStatusChanged(true);
+                QMetaObject::invokeMethod(matchWorker, [this, nItems](){
+                    matchWorker->match(nItems);
+                },Qt::QueuedConnection);
+            }
+            d->savePlaylist();
+        }
+    });
 }
 
 QModelIndex PlayList::addItem(QModelIndex parent, PlayListItem *item)
@@ -687,7 +737,7 @@ QModelIndex PlayList::addItem(QModelIndex parent, PlayListItem *item)
 
     d->addMediaPathHash({item});
     d->playListChanged=true;
-    d->needRefresh = true;
+    d->markChanged();
     return createIndex(parentItem->children->indexOf(item), 0, item);
 }
 
@@ -702,7 +752,7 @@ QModelIndex PlayList::addWebDAVCollection(QModelIndex parent, const QString &tit
     item->path = url;
     Q_D(PlayList);
     d->playListChanged=true;
-    d->needRefresh = true;
+    d->markChanged();
     d->incModifyCounter();
     return collectionIndex;
 }
@@ -746,6 +796,7 @@ void PlayList::cutItems(const QModelIndexList &cutIndexes)
         endRemoveRows();
     }
     d->playListChanged=true;
+    d->markChanged();
 }
 
 void PlayList::pasteItems(QModelIndex parent)
@@ -770,7 +821,7 @@ void PlayList::pasteItems(QModelIndex parent)
     }
     endInsertRows();
     d->playListChanged=true;
-    d->needRefresh = true;
+    d->markChanged();
     d->itemsClipboard.clear();
 }
 
@@ -788,7 +839,7 @@ void PlayList::moveUpDown(QModelIndex index, bool up)
     endMoveRows();
     Q_D(PlayList);
     d->playListChanged=true;
-    d->needRefresh = true;
+    d->markChanged();
     d->incModifyCounter();
 }
 
@@ -808,6 +859,7 @@ void PlayList::switchBgmCollection(const QModelIndex &index)
         d->bgmCollectionItems.remove(item->title);
     }
     d->playListChanged=true;
+    d->markChanged();
     emit dataChanged(index, index);
 }
 
@@ -819,7 +871,7 @@ void PlayList::setMarker(const QModelIndex &index, PlayListItem::Marker marker)
     if(item->marker==marker) return;
     item->marker = marker;
     d->playListChanged=true;
-    d->needRefresh = true;
+    d->markChanged();
     d->incModifyCounter();
     emit dataChanged(index, index);
 }
@@ -854,7 +906,7 @@ void PlayList::autoMoveToBgmCollection(const QModelIndex &index)
     currentItem->moveTo(bgmCollectionItem);
     endInsertRows();
     d->playListChanged = true;
-    d->needRefresh = true;
+    d->markChanged();
 }
 
 QModelIndex PlayList::index(int row, int column, const QModelIndex &parent) const
@@ -1067,7 +1119,7 @@ bool PlayList::dropMimeData(const QMimeData *data, Qt::DropAction action, int ro
 		endInsertRows();
 	}
     d->playListChanged=true;
-    d->needRefresh = true;
+    d->markChanged();
     return true;
 }
 
@@ -1085,7 +1137,7 @@ bool PlayList::setData(const QModelIndex &index, const QVariant &value, int)
         }
         item->title=val;
         d->playListChanged=true;
-        d->needRefresh = true;
+        d->markChanged();
         d->incModifyCounter();
         return true;
     }
@@ -1281,7 +1333,7 @@ void PlayList::matchIndex(QModelIndex &index, const MatchResult &match)
     item->title=match.ep.toString();
     item->poolID=GlobalObjects::danmuManager->updateMatch(item->path,match);
     d->playListChanged = true;
-    d->needRefresh = true;
+    d->markChanged();
     Notifier *notifier = Notifier::getNotifier();
     notifier->showMessage(Notifier::LIST_NOTIFY, tr("Success: %1").arg(item->title),NotifyMessageFlag::NM_HIDE);
     emit dataChanged(index, index);
@@ -1346,7 +1398,7 @@ void PlayList::removeMatch(const QModelIndexList &matchIndexes)
             }
             if (currentItem == d->currentItem) emit currentMatchChanged(currentItem->poolID);
             d->playListChanged = true;
-            d->needRefresh = true;
+            d->markChanged();
             QModelIndex nIndex = createIndex(currentItem->parent->children->indexOf(currentItem), 0, currentItem);
             emit dataChanged(nIndex, nIndex);
         }
@@ -1431,7 +1483,7 @@ void PlayList::setCurrentPlayTime()
         }
     }
     d->playListChanged=true;
-    d->needRefresh=true;
+    d->markChanged();
     d->incModifyCounter();
 }
 
@@ -1447,7 +1499,7 @@ void PlayList::addCurrentSub(const QString &subFile)
     if(currentItem->trackInfo->subFiles.contains(subFile)) return;
     currentItem->trackInfo->subFiles.append(subFile);
     d->playListChanged=true;
-    d->needRefresh=true;
+    d->markChanged();
     d->incModifyCounter();
 }
 
@@ -1464,7 +1516,7 @@ void PlayList::clearCurrentSub()
         currentItem->trackInfo = nullptr;
     }
     d->playListChanged=true;
-    d->needRefresh=true;
+    d->markChanged();
     d->incModifyCounter();
 }
 
@@ -1480,7 +1532,7 @@ void PlayList::setCurrentSubDelay(int delay)
     }
     currentItem->trackInfo->subDelay = delay;
     d->playListChanged=true;
-    d->needRefresh=true;
+    d->markChanged();
     d->incModifyCounter();
 }
 
@@ -1497,7 +1549,7 @@ void PlayList::setCurrentSubIndex(int index)
     }
     currentItem->trackInfo->subIndex = index;
     d->playListChanged=true;
-    d->needRefresh=true;
+    d->markChanged();
     d->incModifyCounter();
 }
 
@@ -1513,7 +1565,7 @@ void PlayList::addCurrentAudio(const QString &audioFile)
     if(currentItem->trackInfo->audioFiles.contains(audioFile)) return;
     currentItem->trackInfo->audioFiles.append(audioFile);
     d->playListChanged=true;
-    d->needRefresh=true;
+    d->markChanged();
     d->incModifyCounter();
 }
 
@@ -1530,7 +1582,7 @@ void PlayList::clearCurrentAudio()
         currentItem->trackInfo = nullptr;
     }
     d->playListChanged=true;
-    d->needRefresh=true;
+    d->markChanged();
     d->incModifyCounter();
 }
 
@@ -1547,7 +1599,7 @@ void PlayList::setCurrentAudioIndex(int index)
     }
     currentItem->trackInfo->audioIndex = index;
     d->playListChanged=true;
-    d->needRefresh=true;
+    d->markChanged();
     d->incModifyCounter();
 }
 
@@ -1598,6 +1650,7 @@ QModelIndex PlayList::mergeItems(const QModelIndexList &mergeIndexes)
     }
 	endInsertRows();
     d->playListChanged=true;
+    d->markChanged();
     return collectionIndex;
 }
 
@@ -1641,16 +1694,11 @@ void PlayList::exportDanmuItems(const QModelIndexList &exportIndexes)
     notifier->showMessage(Notifier::LIST_NOTIFY, tr("Export Down"),NotifyMessageFlag::NM_HIDE);
 }
 
-void PlayList::dumpJsonPlaylist(QJsonDocument &jsonDoc)
+QSharedPointer<const PlayListSnapshot> PlayList::snapshot()
 {
     Q_D(PlayList);
-    if(!d->needRefresh) return;
-    QJsonDocument newDoc;
-    QJsonArray rootArray;
-    d->dumpItem(rootArray, d->root);
-    newDoc.setArray(rootArray);
-    jsonDoc.swap(newDoc);
-    d->needRefresh=false;
+    QMutexLocker locker(&d->snapshotLock);
+    return d->snapshot;
 }
 
 QString PlayList::getPathByHash(const QString &hash)
@@ -1662,33 +1710,6 @@ QString PlayList::getPathByHash(const QString &hash)
     return path;
 }
 
-const PlayListItem *PlayList::getPathItem(const QString &pathId)
-{
-    Q_D(PlayList);
-    if(pathId == "0")
-    {
-        return d->root;
-    }
-    else
-    {
-        QStringList itemPosList = pathId.split("_");
-        if(itemPosList.size() < 2 || itemPosList[0] != '0') return nullptr;
-        itemPosList.pop_front();
-        PlayListItem *item = d->root;
-        for(const QString &sPos : itemPosList)
-        {
-            if(sPos.isEmpty()) return nullptr;
-            bool ok = true;
-            int pos = sPos.toInt(&ok);
-            if(!ok) return nullptr;
-            if(!item->children || item->children->size() <= pos) return nullptr;
-            item = (*item->children)[pos];
-        }
-        return item;
-    }
-    return nullptr;
-}
-
 void PlayList::updatePlayTime(const QString &path, int time, PlayListItem::PlayState state)
 {
     Q_D(PlayList);
@@ -1701,7 +1722,7 @@ void PlayList::updatePlayTime(const QString &path, int time, PlayListItem::PlayS
         QModelIndex cIndex = createIndex(item->parent->children->indexOf(item), 0, item);
         emit dataChanged(cIndex, cIndex);
         d->playListChanged=true;
-        d->needRefresh=true;
+        d->markChanged();
         if(!item->animeTitle.isEmpty())
         {
             if(state==PlayListItem::PlayState::FINISH)
@@ -1743,7 +1764,7 @@ void PlayList::renameItemPoolId(const QString &opid, const QString &npid)
                 emit currentMatchChanged(item->poolID);
             }
             d->playListChanged=true;
-            d->needRefresh=true;
+            d->markChanged();
             d->incModifyCounter();
             match.ep.localFile = item->path;
             AnimeWorker::instance()->addAnime(match);
@@ -1759,32 +1780,82 @@ void MatchWorker::match(const QVector<PlayListItem *> &items)
     notifier->showMessage(Notifier::LIST_NOTIFY, tr("Match Start"),NotifyMessageFlag::NM_PROCESS|NotifyMessageFlag::NM_SHOWCANCEL);
     bool cancel = false;
     auto conn = QObject::connect(notifier, &Notifier::cancelTrigger, [&](int nType){ if(nType & Notifier::LIST_NOTIFY) cancel=true;});
+    // stage 1: files without a cached hash are read in hashPool while earlier items are matched
+    struct MatchTask
+    {
+        PlayListItem *item;
+        QFileInfo fileInfo;
+        QString fileHash;
+        QFuture<QString> hashFuture;
+    };
+    QVector<MatchTask> tasks;
     for (auto currentItem: items)
     {
-        if (cancel) break;
         if (currentItem->hasPool()) continue;
         if (currentItem->type == PlayListItem::ItemType::WEB_URL) continue;
-        if (!QFile::exists(currentItem->path)) continue;
         if (filterItem(currentItem))
         {
             Logger::logger()->log(Logger::APP, tr("Skip Match: %1").arg(currentItem->title));
             continue;
         }
+        MatchTask task{currentItem, QFileInfo(currentItem->path), QString(), QFuture<QString>()};
+        if (!task.fileInfo.isFile()) continue;
+        task.fileHash = GlobalObjects::danmuManager->lookupFileHash(task.fileInfo);
+        if (task.fileHash.isEmpty())
+        {
+            const QString path = currentItem->path;
+            task.hashFuture = QtConcurrent::run(&hashPool, [path](){
+                return DanmuManager::hashFile(path);
+            });
+        }
+        tasks.append(task);
+    }
+    // stage 3: pools of matched items are created in batches, one transaction each
+    QVector<PlayListItem *> batchItems;
+    QVector<MatchResult> batchMatches;
+    QStringList batchHashes;
+    auto commit = [&](){
+        if (batchItems.isEmpty()) return;
+        const QStringList poolIds = GlobalObjects::danmuManager->createPools(batchMatches, batchHashes);
+        for (int i = 0; i < batchItems.size(); ++i)
+        {
+            PlayListItem *currentItem = batchItems[i];
+            currentItem->animeTitle=batchMatches[i].name;
+            currentItem->title=batchMatches[i].ep.toString();
+            currentItem->poolID=poolIds[i];
+            matchedItems<<currentItem;
+            AnimeWorker::instance()->addAnime(batchMatches[i]);
+        }
+        batchItems.clear();
+        batchMatches.clear();
+        batchHashes.clear();
+    };
+    // stage 2: local and script matching run here, scripts and db connections belong to this thread
+    for (MatchTask &task : tasks)
+    {
+        if (cancel) break;
+        if (task.fileHash.isEmpty())
+        {
+            task.fileHash = task.hashFuture.result();
+            if (!task.fileHash.isEmpty()) GlobalObjects::danmuManager->saveFileHash(task.fileInfo, task.fileHash);
+        }
+        PlayListItem *currentItem = task.item;
         MatchResult match;
-        GlobalObjects::danmuManager->localMatch(currentItem->path, match);
+        GlobalObjects::danmuManager->localMatch(currentItem->path, match, task.fileHash);
         if(!match.success) GlobalObjects::animeProvider->match(GlobalObjects::animeProvider->defaultMatchScript(), currentItem->path, match);
         if(!match.success)
         {
             notifier->showMessage(Notifier::LIST_NOTIFY, tr("Failed: %1").arg(currentItem->title),NotifyMessageFlag::NM_PROCESS|NotifyMessageFlag::NM_SHOWCANCEL);
             continue;
         }
-        currentItem->animeTitle=match.name;
-        currentItem->title=match.ep.toString();
-        currentItem->poolID=GlobalObjects::danmuManager->createPool(currentItem->path, match);
-        matchedItems<<currentItem;
-        notifier->showMessage(Notifier::LIST_NOTIFY, tr("Success: %1").arg(currentItem->title),NotifyMessageFlag::NM_PROCESS|NotifyMessageFlag::NM_SHOWCANCEL);
-        AnimeWorker::instance()->addAnime(match);
-    }
+        batchItems.append(currentItem);
+        batchMatches.append(match);
+        batchHashes.append(task.fileHash);
+        notifier->showMessage(Notifier::LIST_NOTIFY, tr("Success: %1").arg(match.ep.toString()),NotifyMessageFlag::NM_PROCESS|NotifyMessageFlag::NM_SHOWCANCEL);
+        if (batchItems.size() >= commitBatchSize) commit();
+    }
+    commit();
+    if (cancel) hashPool.clear();
     QObject::disconnect(conn);
     emit matchDown(matchedItems);
     notifier->showMessage(Notifier::LIST_NOTIFY, tr("Match Done"),NotifyMessageFlag::NM_HIDE);
@@ -3,24 +3,33 @@
 
 #include <QAbstractItemModel>
 #include <QSortFilterProxyModel>
+#include <QThreadPool>
+#include <functional>
 #include "playlistitem.h"
+#include "playlistsnapshot.h"
 #include "MediaLibrary/animeinfo.h"
 #include "webdav/qwebdavitem.h"
 
 class PlayListPrivate;
 class QWebdav;
+class FolderScanner;
+class FolderWatcher;
 class QWebdavDirParser;
 class MatchWorker : public QObject
 {
     Q_OBJECT
 public:
-    explicit MatchWorker(QObject *parent = nullptr):QObject(parent) { updateFilterRules(); }
+    explicit MatchWorker(QObject *parent = nullptr):QObject(parent) { hashPool.setMaxThreadCount(maxHashThreads); updateFilterRules(); }
     void match(const QVector<PlayListItem *> &items);
     void match(const QVector<PlayListItem *> &items, const QString &animeTitle, const QList<EpInfo> &eps);
     void updateFilterRules();
 signals:
     void matchDown(const QList<PlayListItem *> &matchedItems);
 private:
+    // files are hashed ahead of matching, a few reads at a time
+    static const int maxHashThreads = 2;
+    static const int commitBatchSize = 16;
+    QThreadPool hashPool;
     QVector<QRegExp> filterRules;
     bool filterItem(PlayListItem *item);
 };
@@ -85,11 +94,12 @@ signals:
     void matchStatusChanged(bool on);
 public slots :
     int addItems(QStringList &items, QModelIndex parent);
-    int addFolder(QString folderStr, QModelIndex parent, const QString &name = "");
+    // the folder is scanned in the background, done gets the number of added items once they are in the list
+    void addFolder(QString folderStr, QModelIndex parent, const QString &name = "", std::function<void(int)> done = nullptr);
     int addURL(const QStringList &urls, QModelIndex parent, bool decodeTitle = false);
     QModelIndex addCollection(QModelIndex parent, const QString &title);
     QModelIndex getCollection(QModelIndex parent, const QStringList &path);
-    int refreshFolder(const QModelIndex &index);
+    void refreshFolder(const QModelIndex &index);
     QModelIndex addItem(QModelIndex parent, PlayListItem *item);
     QModelIndex addWebDAVCollection(QModelIndex parent, const QString &title, const QString &url, const QString &user, const QString &password);
     void refreshWebDAVCollection(const QModelIndex &index);
@@ -136,9 +146,8 @@ public slots :
     void exportDanmuItems(const QModelIndexList &exportIndexes);
 
     
-    void dumpJsonPlaylist(QJsonDocument &jsonDoc);
+    QSharedPointer<const PlayListSnapshot> snapshot();
     QString getPathByHash(const QString &hash);
-    const PlayListItem *getPathItem(const QString &pathId);
     void updatePlayTime(const QString &path, int time, PlayListItem::PlayState state);
     void renameItemPoolId(const QString &opid, const QString &npid);
 
@@ -159,6 +168,8 @@ private:
     PlayListPrivate * const d_ptr;
     MatchWorker *matchWorker;
     WebDAVWorker *webdavWorker;
+    FolderScanner *folderScanner;
+    FolderWatcher *folderWatcher;
     Q_DECLARE_PRIVATE(PlayList)
     Q_DISABLE_COPY(PlayList)
 
@@ -2,6 +2,7 @@
 #include "playlist.h"
 #include "Play/Danmu/Manager/danmumanager.h"
 #include "globalobjects.h"
+#include <QCollator>
 
 #define XML_FIELD_TITLE "title"
 #define XML_FIELD_ANIME_TITLE "animeTitle"
@@ -25,7 +26,7 @@ PlayList* PlayListItem::playlist=nullptr;
 
 PlayListItem::PlayListItem(PlayListItem *p, bool leaf, int insertPosition):
     parent(p), children(nullptr), type(LOCAL_FILE), playTimeState(UNPLAY), marker(M_NONE), playTime(0), level(0), isBgmCollection(false), addTime(0),
-    trackInfo(nullptr), webDAVInfo(nullptr)
+    trackInfo(nullptr), webDAVInfo(nullptr), sortKey(nullptr)
 {
     if (!leaf)
     {
@@ -43,7 +44,8 @@ PlayListItem::PlayListItem(PlayListItem *p, bool leaf, int insertPosition):
 }
 PlayListItem::~PlayListItem()
 {
-    playlist->checkCurrentItem(this);
+    // items built outside of a PlayList, e.g. by the benchmarks in tools/, have no list to check
+    if (playlist) playlist->checkCurrentItem(this);
     if (children)
     {
         qDeleteAll(children->begin(),children->end());
@@ -57,6 +59,7 @@ PlayListItem::~PlayListItem()
     {
         delete webDAVInfo;
     }
+    delete sortKey;
 }
 
 PlayListItem *PlayListItem::parseCollection(QXmlStreamReader &reader, PlayListItem *parent)
@@ -187,6 +190,21 @@ bool PlayListItem::hasPool() const
 {
     return !poolID.isEmpty() && GlobalObjects::danmuManager->getPool(poolID, false);
 }
+const QCollatorSortKey &PlayListItem::titleSortKey(const QCollator &collator)
+{
+    if (!sortKey)
+    {
+        sortKey = new QCollatorSortKey(collator.sortKey(title));
+        sortKeyTitle = title;
+    }
+    else if (sortKeyTitle != title)
+    {
+        *sortKey = collator.sortKey(title);
+        sortKeyTitle = title;
+    }
+    return *sortKey;
+}
+
 void PlayListItem::setLevel(int newLevel)
 {
     level = newLevel;
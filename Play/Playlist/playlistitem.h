@@ -3,6 +3,8 @@
 #include <QObject>
 
 class PlayList;
+class QCollator;
+class QCollatorSortKey;
 class QXmlStreamReader;
 class QXmlStreamWriter;
 struct ItemTrackInfo
@@ -23,6 +25,8 @@ struct PlayListItem
 {
     PlayListItem(PlayListItem *p = nullptr, bool leaf = false, int insertPosition = -1);
     ~PlayListItem();
+    // trackInfo, webDAVInfo and sortKey are owned, a copy would delete them twice
+    Q_DISABLE_COPY(PlayListItem)
 
     static PlayListItem *parseCollection(QXmlStreamReader &reader, PlayListItem *parent = nullptr);
     static void writeCollection(QXmlStreamWriter &writer, PlayListItem *item);
@@ -32,6 +36,8 @@ struct PlayListItem
     inline bool isCollection() const { return children; }
     inline bool isWebDAVCollection() const { return children && webDAVInfo; }
     bool hasPool() const;
+    // computed on first use and again after the title has changed, not thread safe
+    const QCollatorSortKey &titleSortKey(const QCollator &collator);
     void setLevel(int newLevel);
     void moveTo(PlayListItem *newParent, int insertPosition = -1);
 
@@ -68,6 +74,9 @@ struct PlayListItem
     QString pathHash;
     ItemTrackInfo *trackInfo;
     WebDAVInfo *webDAVInfo;
+private:
+    QCollatorSortKey *sortKey;
+    QString sortKeyTitle;
 };
 
 #endif // PLAYLISTITEM_H
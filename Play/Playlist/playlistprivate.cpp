@@ -12,8 +12,9 @@
 #include "Play/Danmu/Manager/danmumanager.h"
 #include "Play/Danmu/Manager/pool.h"
 
-PlayListPrivate::PlayListPrivate(PlayList *pl) : root(new PlayListItem), currentItem(nullptr), playListChanged(false),
-    needRefresh(true), loopMode(PlayList::NO_Loop_All), autoMatch(true), modifyCounter(0), saveFinishTimeOnce(true), q_ptr(pl)
+PlayListPrivate::PlayListPrivate(PlayList *pl) : root(new PlayListItem), currentItem(nullptr), playListChanged(false), xmlExportPending(false),
+    loopMode(PlayList::NO_Loop_All), autoMatch(true), modifyCounter(0), saveFinishTimeOnce(true),
+    snapshotVersion(0), publishScheduled(false), q_ptr(pl), store(GlobalObjects::dataPath + "playlist")
 {
     PlayListItem::playlist = pl;
     plPath = GlobalObjects::dataPath + "playlist.xml";
@@ -27,14 +28,57 @@ PlayListPrivate::~PlayListPrivate()
 
 void PlayListPrivate::loadPlaylist()
 {
-    if (QFile::exists(plPath+".tmp") && !QFile::exists(plPath))
+    if (!store.load(root))
     {
-        QFile::rename(plPath+".tmp", plPath);
+        // playlist.xml of older versions is imported once, the binary store is written right away
+        if (store.exists())
+            Logger::logger()->log(Logger::APP, QString("Binary playlist is unreadable, fall back to %1").arg(plPath));
+        if (loadXml(plPath))
+        {
+            playListChanged = true;
+            savePlaylist();
+        }
+    }
+    indexItems(root);
+    for (auto iter = recentList.begin(); iter != recentList.end(); )
+    {
+        const PlayListItem *item = fileItems.value(iter->first, nullptr);
+        if (!item) //not included in playlist
+        {
+            iter = recentList.erase(iter);
+            continue;
+        }
+        iter->second = item->animeTitle.isEmpty()?item->title:QString("%1 %2").arg(item->animeTitle, item->title);
+        iter++;
+    }
+}
+
+void PlayListPrivate::savePlaylist()
+{
+    if(!playListChanged)return;
+    if(store.save(root))
+    {
+        playListChanged = false;
+        xmlExportPending = true;
+    }
+}
+
+void PlayListPrivate::exportPlaylist()
+{
+    // playlist.xml stays readable by older versions and other tools, written once on exit
+    if(xmlExportPending && saveXml(plPath)) xmlExportPending = false;
+}
+
+bool PlayListPrivate::loadXml(const QString &path)
+{
+    if (QFile::exists(path+".tmp") && !QFile::exists(path))
+    {
+        QFile::rename(path+".tmp", path);
         //TODO LOG
     }
-    QFile playlistFile(plPath);
+    QFile playlistFile(path);
     bool ret = playlistFile.open(QIODevice::ReadOnly|QIODevice::Text);
-    if (!ret) return;
+    if (!ret) return false;
     QXmlStreamReader reader(&playlistFile);
     QVector<PlayListItem *> parents;
     QHash<QString,int> nodeNameHash = {
@@ -55,25 +99,12 @@ void PlayListPrivate::loadPlaylist()
             }
             case 1:
             {
-                PlayListItem *collection = PlayListItem::parseCollection(reader, parents.last());
-                if(collection->isBgmCollection)
-                    bgmCollectionItems.insert(collection->title, collection);
-                parents.push_back(collection);
+                parents.push_back(PlayListItem::parseCollection(reader, parents.last()));
                 break;
             }
             case 2:
             {
-                PlayListItem *item = PlayListItem::parseItem(reader, parents.last());
-                fileItems.insert(item->path, item);
-                mediaPathHash.insert(item->pathHash, item->path);
-                for (auto &pair : recentList)
-                {
-                    if (pair.first == item->path)
-                    {
-                        pair.second = item->animeTitle.isEmpty()?item->title:QString("%1 %2").arg(item->animeTitle, item->title);
-                        break;
-                    }
-                }
+                PlayListItem::parseItem(reader, parents.last());
                 break;
             }
             }
@@ -93,37 +124,31 @@ void PlayListPrivate::loadPlaylist()
     {
         Logger::logger()->log(Logger::APP, QString("Playlist File is corrupted: %1").arg(reader.errorString()));
     }
-    for (auto iter = recentList.begin(); iter != recentList.end(); )
-    {
-        if ((*iter).second.isEmpty()) //not included in playlist
-            iter=recentList.erase(iter);
-        else
-            iter++;
-    }
+    return true;
 }
 
-void PlayListPrivate::savePlaylist()
+bool PlayListPrivate::saveXml(const QString &path)
 {
-    if(!playListChanged)return;
-    QFile playlistFile(plPath+".tmp");
+    QFile playlistFile(path+".tmp");
     bool ret=playlistFile.open(QIODevice::WriteOnly|QIODevice::Text);
-    if(!ret) return;
+    if(!ret) return false;
     QXmlStreamWriter writer(&playlistFile);
     writer.setAutoFormatting(true);
     writer.writeStartDocument();
     saveItem(writer, root);
     writer.writeEndDocument();
     playlistFile.flush();
-    ret = QFile::remove(plPath);
-    if(!QFile::exists(plPath) || ret)
+    ret = QFile::remove(path);
+    if(!QFile::exists(path) || ret)
     {
-        ret = playlistFile.rename(plPath);
-        if(ret) playListChanged=false;
+        return playlistFile.rename(path);
     }
+    return false;
 }
 
 void PlayListPrivate::incModifyCounter()
 {
+    markChanged();
     const int maxModifyCount = 5;
     if(++modifyCounter>=maxModifyCount)
     {
@@ -132,6 +157,25 @@ void PlayListPrivate::incModifyCounter()
     }
 }
 
+void PlayListPrivate::markChanged()
+{
+    // changes of one event loop turn are published together
+    if(publishScheduled) return;
+    publishScheduled = true;
+    QMetaObject::invokeMethod(q_ptr, [this](){
+        publishSnapshot();
+    }, Qt::QueuedConnection);
+}
+
+void PlayListPrivate::publishSnapshot()
+{
+    publishScheduled = false;
+    QSharedPointer<const PlayListSnapshot> newSnapshot(new PlayListSnapshot(root, ++snapshotVersion));
+    if(q_ptr->folderWatcher) q_ptr->folderWatcher->setRoots(watchRoots());
+    QMutexLocker locker(&snapshotLock);
+    snapshot.swap(newSnapshot);
+}
+
 void PlayListPrivate::saveItem(QXmlStreamWriter &writer, PlayListItem *item)
 {
     if (item == root)
@@ -159,6 +203,24 @@ void PlayListPrivate::saveItem(QXmlStreamWriter &writer, PlayListItem *item)
     writer.writeEndElement();
 }
 
+void PlayListPrivate::indexItems(PlayListItem *item)
+{
+    for (PlayListItem *child : *item->children)
+    {
+        if (child->children)
+        {
+            if (child->isBgmCollection)
+                bgmCollectionItems.insert(child->title, child);
+            indexItems(child);
+        }
+        else
+        {
+            fileItems.insert(child->path, child);
+            mediaPathHash.insert(child->pathHash, child->path);
+        }
+    }
+}
+
 void PlayListPrivate::loadRecentlist()
 {
     QFile recentlistFile(rectPath);
@@ -285,112 +347,201 @@ PlayListItem *PlayListPrivate::getPrevOrNextItem(bool prev)
     return nullptr;
 }
 
-bool PlayListPrivate::addSubFolder(QString folderStr, PlayListItem *parent, int &itemCount)
+PlayListItem *PlayListPrivate::newFileItem(const QString &dirPath, const QString &fileName, qint64 addTime)
+{
+    const QString path(FolderScanner::filePath(dirPath, fileName));
+    if(fileItems.contains(path)) return nullptr;
+    PlayListItem *newItem = new PlayListItem(nullptr, true);
+    newItem->title = fileName.left(fileName.lastIndexOf('.'));
+    newItem->path = path;
+    newItem->addTime = addTime;
+    newItem->pathHash = QCryptographicHash::hash(newItem->path.toUtf8(),QCryptographicHash::Md5).toHex();
+    fileItems.insert(newItem->path, newItem);
+    return newItem;
+}
+
+PlayListItem *PlayListPrivate::buildFolderItem(const FolderScanner::Result &result, int dirIndex, QVector<PlayListItem *> &nItems)
 {
-    QDir folder(folderStr);
-    bool containsVideoFile = false;
+    const FolderScanner::Dir &dir = result.dirs[dirIndex];
+    if (!dir.hasVideo) return nullptr;
+    const qint64 addTime = QDateTime::currentDateTime().toSecsSinceEpoch();
     PlayListItem *folderCollection = new PlayListItem();
-    folderCollection->title = folder.dirName();
-    folderCollection->path = folderStr;
-    folderCollection->addTime = QDateTime::currentDateTime().toSecsSinceEpoch();
-    for (QFileInfo fileInfo : folder.entryInfoList())
+    folderCollection->title = dir.name;
+    folderCollection->path = dir.path;
+    folderCollection->addTime = addTime;
+    for (const FolderScanner::Entry &entry : dir.entries)
     {
-        QString fileName = fileInfo.fileName();
-        if (fileInfo.isFile())
-        {
-            if (GlobalObjects::mpvplayer->videoFileFormats.contains("*."+fileInfo.suffix().toLower()))
-            {
-                if(!fileItems.contains(fileInfo.filePath()))
-                {
-                    PlayListItem *newItem = new PlayListItem(folderCollection, true);
-                    int suffixPos = fileName.lastIndexOf('.'), pathPos = fileName.lastIndexOf('/') + 1;
-                    newItem->title = fileName.mid(pathPos, suffixPos - pathPos);
-                    newItem->path = fileInfo.filePath();
-                    newItem->addTime = QDateTime::currentDateTime().toSecsSinceEpoch();
-                    newItem->pathHash = QCryptographicHash::hash(newItem->path.toUtf8(),QCryptographicHash::Md5).toHex();
-                    containsVideoFile = true;
-                    itemCount++;
-                    fileItems.insert(newItem->path,newItem);
-                }
-            }
-        }
-        else
-        {
-            if (fileName == "." || fileName == "..")continue;
-            bool ret = addSubFolder(fileInfo.absoluteFilePath(), folderCollection,itemCount);
-            if (ret) containsVideoFile = true;
-        }
+        PlayListItem *child = entry.subDir < 0? newFileItem(dir.path, entry.name, addTime) : buildFolderItem(result, entry.subDir, nItems);
+        if (!child) continue;
+        child->moveTo(folderCollection);
+        if (!child->children) nItems << child;
     }
-    if (containsVideoFile)
-        folderCollection->moveTo(parent);
-    else
+    if (folderCollection->children->isEmpty())
+    {
         delete folderCollection;
-    return containsVideoFile;
+        return nullptr;
+    }
+    return folderCollection;
 }
 
-int PlayListPrivate::refreshFolder(PlayListItem *folderItem, QVector<PlayListItem *> &nItems)
+int PlayListPrivate::applyRefresh(PlayListItem *folderItem, const FolderScanner::Result &result, QVector<PlayListItem *> &nItems)
 {
     int nCount = 0;
     QSet<QString> currentPaths;
     for(PlayListItem *item : *folderItem->children)
     {
-        if(item->children)
+        if(item->children && !item->isWebDAVCollection())
         {
             if(!item->path.isEmpty()) currentPaths<<item->path;
-            nCount += refreshFolder(item, nItems);
+            nCount += applyRefresh(item, result, nItems);
         }
     }
     if(folderItem->path.isEmpty()) return nCount;
+    const int dirIndex = result.pathIndex.value(QDir(folderItem->path).path(), -1);
+    if(dirIndex < 0) return nCount;
 
-    QDir folder(folderItem->path);
-    bool oFolder(folderItem->parent);
-    QModelIndex fIndex;
-    if(oFolder) fIndex = q_ptr->createIndex(folderItem->parent->children->indexOf(folderItem),0,folderItem);
-    for (QFileInfo fileInfo : folder.entryInfoList())
-    {
-        QString fileName(fileInfo.fileName()), filePath(fileInfo.filePath());
-        if (fileInfo.isFile())
+    // new items of the folder are inserted into the model at once
+    const FolderScanner::Dir &dir = result.dirs[dirIndex];
+    const qint64 addTime = QDateTime::currentDateTime().toSecsSinceEpoch();
+    const int itemsBefore = nItems.size();
+    QVector<PlayListItem *> newChildren;
+    for (const FolderScanner::Entry &entry : dir.entries)
+    {
+        PlayListItem *child = nullptr;
+        if (entry.subDir < 0)
         {
-            if (GlobalObjects::mpvplayer->videoFileFormats.contains("*."+fileInfo.suffix().toLower())
-                    && !fileItems.contains(filePath))
-            {
-                if(oFolder) q_ptr->beginInsertRows(fIndex, folderItem->children->size(), folderItem->children->size());
-                PlayListItem *newItem = new PlayListItem(folderItem, true);
-                int suffixPos = fileName.lastIndexOf('.'), pathPos = fileName.lastIndexOf('/') + 1;
-                newItem->title = fileName.mid(pathPos, suffixPos - pathPos);
-                newItem->path = filePath;
-                newItem->addTime = QDateTime::currentDateTime().toSecsSinceEpoch();
-                fileItems.insert(newItem->path,newItem);
-                nItems<<newItem;
-                ++nCount;
-                if(oFolder) q_ptr->endInsertRows();
+            child = newFileItem(dir.path, entry.name, addTime);
+            if (child) nItems << child;
+        }
+        else if (!currentPaths.contains(result.dirs[entry.subDir].path))
+        {
+            child = buildFolderItem(result, entry.subDir, nItems);
+        }
+        if (child) newChildren << child;
+    }
+    if (newChildren.isEmpty()) return nCount;
+    const QModelIndex fIndex = folderItem == root? QModelIndex() : q_ptr->createIndex(folderItem->parent->children->indexOf(folderItem),0,folderItem);
+    q_ptr->beginInsertRows(fIndex, folderItem->children->size(), folderItem->children->size() + newChildren.size() - 1);
+    for (PlayListItem *child : newChildren)
+    {
+        child->moveTo(folderItem);
+    }
+    q_ptr->endInsertRows();
+    return nCount + nItems.size() - itemsBefore;
+}
 
-            }
+int PlayListPrivate::removeMissing(PlayListItem *folderItem, const FolderScanner::Result &result)
+{
+    int nCount = 0;
+    for(PlayListItem *item : *folderItem->children)
+    {
+        if(item->children && !item->isWebDAVCollection()) nCount += removeMissing(item, result);
+    }
+    if(folderItem->path.isEmpty()) return nCount;
+    // nothing is removed while the folder itself is missing, e.g. an unmounted drive
+    const int dirIndex = result.pathIndex.value(QDir(folderItem->path).path(), -1);
+    if(dirIndex < 0 || !result.dirs[dirIndex].exists) return nCount;
+
+    const FolderScanner::Dir &dir = result.dirs[dirIndex];
+    QSet<QString> names;
+    for (const FolderScanner::Entry &entry : dir.entries)
+    {
+        names.insert(entry.name);
+    }
+    auto containsCurrent = [this](PlayListItem *item){
+        for(PlayListItem *cur = currentItem; cur; cur = cur->parent)
+        {
+            if(cur == item) return true;
         }
-        else
+        return false;
+    };
+    QVector<PlayListItem *> missingItems;
+    for(PlayListItem *item : *folderItem->children)
+    {
+        if(item->path.isEmpty() || item->isWebDAVCollection() || item->type == PlayListItem::WEB_URL) continue;
+        // only items of this folder, other items may have been added to the collection by hand
+        const QFileInfo fileInfo(item->path);
+        if(QDir(fileInfo.path()).path() != dir.path) continue;
+        if(names.contains(fileInfo.fileName()) || fileInfo.exists() || containsCurrent(item)) continue;
+        missingItems << item;
+    }
+    if(missingItems.isEmpty()) return nCount;
+    const QModelIndex fIndex = folderItem == root? QModelIndex() : q_ptr->createIndex(folderItem->parent->children->indexOf(folderItem),0,folderItem);
+    for(PlayListItem *item : missingItems)
+    {
+        const int row = folderItem->children->indexOf(item);
+        q_ptr->beginRemoveRows(fIndex, row, row);
+        folderItem->children->removeAt(row);
+        q_ptr->endRemoveRows();
+        QVector<PlayListItem *> items({item});
+        while(!items.isEmpty())
         {
-            if (fileName == "." || fileName == "..")continue;
-            if(!currentPaths.contains(filePath))
-            {
-                PlayListItem *folderCollection = new PlayListItem();
-                folderCollection->title = fileName;
-                folderCollection->path = filePath;
-                folderCollection->addTime = QDateTime::currentDateTime().toSecsSinceEpoch();
-                int c = refreshFolder(folderCollection, nItems);
-                if(c>0)
-                {
-                    if(oFolder) q_ptr->beginInsertRows(fIndex, folderItem->children->size(), folderItem->children->size());
-                    folderCollection->moveTo(folderItem);
-                    if(oFolder) q_ptr->endInsertRows();
-                }
-                else delete folderCollection;
-                nCount += c;
-            }
+            PlayListItem *cur = items.takeLast();
+            if(cur->children) items << *cur->children;
+            else ++nCount;
         }
+        delete item;
     }
     return nCount;
 }
 
+QStringList PlayListPrivate::watchRoots() const
+{
+    QStringList paths;
+    QVector<PlayListItem *> collections({root});
+    while(!collections.isEmpty())
+    {
+        PlayListItem *collection = collections.takeLast();
+        if(collection->isWebDAVCollection()) continue;
+        if(!collection->path.isEmpty()) paths << QDir(collection->path).path();
+        for(PlayListItem *child : *collection->children)
+        {
+            if(child->children) collections << child;
+        }
+    }
+    // folders of nested collections are mostly below another collection folder
+    std::sort(paths.begin(), paths.end());
+    QStringList roots;
+    for(const QString &path : paths)
+    {
+        const bool nested = std::any_of(roots.cbegin(), roots.cend(), [&path](const QString &root){
+            return path == root || path.startsWith(FolderScanner::filePath(root, ""));
+        });
+        if(!nested) roots << path;
+    }
+    return roots;
+}
+
+QStringList PlayListPrivate::collectionFolders(const QStringList &dirs) const
+{
+    QSet<QString> collectionPaths;
+    QVector<PlayListItem *> collections({root});
+    while(!collections.isEmpty())
+    {
+        PlayListItem *collection = collections.takeLast();
+        if(collection->isWebDAVCollection()) continue;
+        if(!collection->path.isEmpty()) collectionPaths << QDir(collection->path).path();
+        for(PlayListItem *child : *collection->children)
+        {
+            if(child->children) collections << child;
+        }
+    }
+    // the closest collection folder covers a directory without its own collection
+    QSet<QString> folders;
+    for(const QString &dir : dirs)
+    {
+        QString path(QDir(dir).path());
+        while(!collectionPaths.contains(path))
+        {
+            const QString parentPath(QFileInfo(path).path());
+            if(parentPath == path) break;
+            path = parentPath;
+        }
+        if(collectionPaths.contains(path)) folders << path;
+    }
+    return folders.values();
+}
+
 QString PlayListPrivate::setCollectionTitle(QList<PlayListItem *> &list)
 {
     int minTitleLen=INT_MAX;
@@ -460,41 +611,6 @@ QString PlayListPrivate::setCollectionTitle(QList<PlayListItem *> &list)
     return matchStr.length() < minLength? defaultTitle : matchStr;
 }
 
-void PlayListPrivate::dumpItem(QJsonArray &array, PlayListItem *item)
-{
-    for(PlayListItem *child:*item->children)
-    {
-        QJsonObject itemObj;
-        itemObj.insert("text",child->title);
-        if(child->marker!=PlayListItem::M_NONE)
-        {
-            itemObj.insert("marker", (int)child->marker);
-        }
-        if(child->children)
-        {
-            QJsonArray childArray;
-            dumpItem(childArray, child);
-            itemObj.insert("nodes",childArray);
-        }
-        else
-        {
-            itemObj.insert("mediaId", child->pathHash);
-            itemObj.insert("danmuPool",child->poolID);
-            itemObj.insert("playTime",child->playTime);
-            itemObj.insert("playTimeState",child->playTimeState);
-            itemObj.insert("animeName", child->animeTitle);
-            itemObj.insert("itemType", child->type);
-            if(child->type == PlayListItem::ItemType::WEB_URL)
-            {
-                itemObj.insert("url", child->path);
-            }
-            static QString nodeColors[3]={"#333","#428bca","#a4a2a2"};
-            itemObj.insert("color",nodeColors[child->playTimeState]);
-        }
-        array.append(itemObj);
-    }
-}
-
 void PlayListPrivate::addMediaPathHash(const QVector<PlayListItem *> newItems)
 {
     pathHashLock.lockForWrite();
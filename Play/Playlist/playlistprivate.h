@@ -1,7 +1,11 @@
 #ifndef PLAYLISTPRIVATE_H
 #define PLAYLISTPRIVATE_H
 #include "playlist.h"
+#include "folderscanner.h"
+#include "folderwatcher.h"
+#include "playliststore.h"
 #include <QXmlStreamWriter>
+#include <QMutex>
 class PlayListPrivate
 {
 public:
@@ -10,7 +14,8 @@ public:
 
     PlayListItem *root;
     PlayListItem *currentItem;
-    bool playListChanged, needRefresh;
+    bool playListChanged;
+    bool xmlExportPending;
     PlayList::LoopMode loopMode;
     bool autoMatch;
     int modifyCounter;
@@ -22,32 +27,48 @@ public:
     QHash<QString, QString> mediaPathHash;
     QReadWriteLock pathHashLock;
 
+    // read by other threads, only the pointer is guarded by snapshotLock
+    QSharedPointer<const PlayListSnapshot> snapshot;
+    QMutex snapshotLock;
+    quint64 snapshotVersion;
+    bool publishScheduled;
+
 public:
     void loadPlaylist();
     void savePlaylist();
+    void exportPlaylist();
     void incModifyCounter();
+    void markChanged();
+    void publishSnapshot();
 
     void loadRecentlist();
     void saveRecentlist();
     void updateRecentlist(PlayListItem *item);
 
     PlayListItem *getPrevOrNextItem(bool prev);
-    bool addSubFolder(QString folderStr, PlayListItem *parent, int &itemCount);
-    int refreshFolder(PlayListItem *folderItem, QVector<PlayListItem *> &nItems);
+    PlayListItem *newFileItem(const QString &dirPath, const QString &fileName, qint64 addTime);
+    PlayListItem *buildFolderItem(const FolderScanner::Result &result, int dirIndex, QVector<PlayListItem *> &nItems);
+    int applyRefresh(PlayListItem *folderItem, const FolderScanner::Result &result, QVector<PlayListItem *> &nItems);
+    int removeMissing(PlayListItem *folderItem, const FolderScanner::Result &result);
+    QStringList watchRoots() const;
+    QStringList collectionFolders(const QStringList &dirs) const;
 
     QString setCollectionTitle(QList<PlayListItem *> &list);
-    void dumpItem(QJsonArray &array, PlayListItem *item);
 
     void addMediaPathHash(const QVector<PlayListItem *> newItems);
 
     void pushEpFinishEvent(PlayListItem *item);
 private:
+    bool loadXml(const QString &path);
+    bool saveXml(const QString &path);
     void saveItem(QXmlStreamWriter &writer,PlayListItem *item);
+    void indexItems(PlayListItem *item);
 private:
     PlayList *const q_ptr;
     Q_DECLARE_PUBLIC(PlayList)
     QString plPath;
     QString rectPath;
+    PlayListStore store;
 };
 
 #endif // PLAYLISTPRIVATE_H
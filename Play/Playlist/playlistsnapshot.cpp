@@ -0,0 +1,109 @@
+#include "playlistsnapshot.h"
+#include <QJsonObject>
+
+PlayListSnapshot::PlayListSnapshot(const PlayListItem *root, quint64 version) : version(version)
+{
+    Node rootNode;
+    rootNode.id = "0";
+    rootNode.title = "Root";
+    rootNode.type = PlayListItem::COLLECTION;
+    rootNode.playTimeState = PlayListItem::UNPLAY;
+    rootNode.marker = PlayListItem::M_NONE;
+    rootNode.playTime = 0;
+    rootNode.addTime = 0;
+    rootNode.isCollection = true;
+    rootNode.parent = -1;
+    nodes.append(rootNode);
+    idIndex.insert(rootNode.id, 0);
+    addChildren(root, 0);
+}
+
+const PlayListSnapshot::Node *PlayListSnapshot::node(const QString &id) const
+{
+    auto iter = idIndex.find(id);
+    return iter == idIndex.end()? nullptr : &nodes[iter.value()];
+}
+
+QString PlayListSnapshot::fullPath(const Node *node) const
+{
+    if(node->parent < 0) return "/";
+    QStringList pathStack;
+    for(const Node *n = node; n->parent >= 0; n = &nodes[n->parent])
+    {
+        pathStack.push_front(n->title);
+    }
+    pathStack.push_front(QString());
+    return pathStack.join('/');
+}
+
+QJsonArray PlayListSnapshot::toJson() const
+{
+    QJsonArray rootArray;
+    dumpNode(rootArray, nodes[0]);
+    return rootArray;
+}
+
+void PlayListSnapshot::addChildren(const PlayListItem *item, int index)
+{
+    if(!item->children) return;
+    nodes[index].children.reserve(item->children->size());
+    int pos = 0;
+    for(const PlayListItem *child : *item->children)
+    {
+        Node node;
+        node.id = nodes[index].id + '_' + QString::number(pos++);
+        node.title = child->title;
+        node.animeTitle = child->animeTitle;
+        node.path = child->path;
+        node.poolID = child->poolID;
+        node.pathHash = child->pathHash;
+        node.type = child->type;
+        node.playTimeState = child->playTimeState;
+        node.marker = child->marker;
+        node.playTime = child->playTime;
+        node.addTime = child->addTime;
+        node.isCollection = child->children;
+        node.parent = index;
+        const int childIndex = nodes.size();
+        idIndex.insert(node.id, childIndex);
+        nodes.append(node);
+        nodes[index].children.append(childIndex);
+        addChildren(child, childIndex);
+    }
+}
+
+void PlayListSnapshot::dumpNode(QJsonArray &array, const Node &node) const
+{
+    for(int childIndex : node.children)
+    {
+        const Node &child = nodes[childIndex];
+        QJsonObject itemObj;
+        itemObj.insert("text",child.title);
+        if(child.marker!=PlayListItem::M_NONE)
+        {
+            itemObj.insert("marker", (int)child.marker);
+        }
+        if(child.isCollection)
+        {
+            QJsonArray childArray;
+            dumpNode(childArray, child);
+            itemObj.insert("nodes",childArray);
+        }
+        else
+        {
+            itemObj.insert("mediaId", child.pathHash);
+            itemObj.insert("danmuPool",child.poolID);
+            itemObj.insert("playTime",child.playTime);
+            itemObj.insert("playTimeState",child.playTimeState);
+            itemObj.insert("animeName", child.animeTitle);
+            itemObj.insert("itemType", child.type);
+            if(child.type == PlayListItem::ItemType::WEB_URL)
+            {
+                itemObj.insert("url", child.path);
+            }
+            static const QString nodeColors[3]={"#333","#428bca","#a4a2a2"};
+            itemObj.insert("color",nodeColors[child.playTimeState]);
+        }
+        array.append(itemObj);
+    }
+}
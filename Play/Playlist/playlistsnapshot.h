@@ -0,0 +1,49 @@
+#ifndef PLAYLISTSNAPSHOT_H
+#define PLAYLISTSNAPSHOT_H
+#include <QVector>
+#include <QHash>
+#include <QJsonArray>
+#include "playlistitem.h"
+
+/*
+ * Immutable copy of the playlist tree for threads other than the main thread (LAN api, DLNA).
+ * Nodes are addressed by object ids like "0_3_5": the root is "0", then the child positions.
+ */
+struct PlayListSnapshot
+{
+    struct Node
+    {
+        QString id;
+        QString title;
+        QString animeTitle;
+        QString path;
+        QString poolID;
+        QString pathHash;
+        PlayListItem::ItemType type;
+        PlayListItem::PlayState playTimeState;
+        PlayListItem::Marker marker;
+        int playTime;
+        qint64 addTime;
+        bool isCollection;
+        int parent;  // -1 for the root
+        QVector<int> children;
+    };
+
+    PlayListSnapshot(const PlayListItem *root, quint64 version);
+
+    const quint64 version;
+    QVector<Node> nodes;  // nodes[0] is the root
+
+    const Node *node(const QString &id) const;
+    const Node *child(const Node *node, int index) const { return &nodes[node->children[index]]; }
+    QString fullPath(const Node *node) const;
+    QJsonArray toJson() const;
+
+private:
+    QHash<QString, int> idIndex;
+
+    void addChildren(const PlayListItem *item, int index);
+    void dumpNode(QJsonArray &array, const Node &node) const;
+};
+
+#endif // PLAYLISTSNAPSHOT_H
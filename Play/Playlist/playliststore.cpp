@@ -0,0 +1,369 @@
+#include "playliststore.h"
+#include "playlistitem.h"
+#include "Common/logger.h"
+#include <QBuffer>
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+#include <QSet>
+#include <functional>
+
+namespace
+{
+    const quint32 snapshotMagic = 0x4B504C53;  // KPLS
+    const quint32 journalMagic = 0x4B504C4A;  // KPLJ
+    const quint32 batchMagic = 0x4B504C42;  // KPLB
+    const quint32 formatVersion = 1;
+    const qint64 snapshotHeaderSize = 5 * sizeof(quint32);
+    const qint64 journalHeaderSize = 2 * sizeof(quint32);
+    const qint64 batchHeaderSize = 2 * sizeof(quint32) + sizeof(quint16);
+    const qint64 minCompactSize = 1024 * 1024;
+
+    enum RecordFlag
+    {
+        R_COLLECTION = 0x1, R_BGM_COLLECTION = 0x2, R_TRACK_INFO = 0x4, R_WEBDAV_INFO = 0x8
+    };
+
+    struct Record
+    {
+        quint32 id = 0, parent = 0, prev = 0;
+        quint8 flags = 0;
+        qint8 type = 0, playTimeState = 0, marker = PlayListItem::M_NONE;
+        qint32 playTime = 0;
+        qint64 addTime = 0;
+        QString title, animeTitle, path, poolID, pathHash;
+        ItemTrackInfo trackInfo;
+        WebDAVInfo webDAVInfo;
+        quint64 hash = 0;
+    };
+
+    quint64 recordHash(const char *data, int len)
+    {
+        const QByteArray record = QByteArray::fromRawData(data, len);
+        return (quint64(qHash(record, 0x9e3779b9)) << 32) | qHash(record, 0x85ebca6b);
+    }
+
+    void writeRecord(QDataStream &ds, const PlayListItem *item, quint32 id, quint32 parent, quint32 prev)
+    {
+        quint8 flags = 0;
+        if (item->children) flags |= R_COLLECTION;
+        if (item->isBgmCollection) flags |= R_BGM_COLLECTION;
+        if (item->trackInfo) flags |= R_TRACK_INFO;
+        if (item->webDAVInfo) flags |= R_WEBDAV_INFO;
+        ds << id << parent << prev << flags << qint8(item->type) << qint8(item->playTimeState) << qint8(item->marker)
+           << qint32(item->playTime) << item->addTime << item->title << item->animeTitle << item->path << item->poolID << item->pathHash;
+        if (item->trackInfo)
+        {
+            const ItemTrackInfo *info = item->trackInfo;
+            ds << qint32(info->subDelay) << qint32(info->subIndex) << qint32(info->audioIndex) << info->subFiles << info->audioFiles;
+        }
+        if (item->webDAVInfo)
+        {
+            ds << item->webDAVInfo->user << item->webDAVInfo->password;
+        }
+    }
+
+    bool readRecord(QDataStream &ds, const QByteArray &data, Record &record)
+    {
+        const qint64 start = ds.device()->pos();
+        ds >> record.id >> record.parent >> record.prev >> record.flags >> record.type >> record.playTimeState >> record.marker
+           >> record.playTime >> record.addTime >> record.title >> record.animeTitle >> record.path >> record.poolID >> record.pathHash;
+        if (record.flags & R_TRACK_INFO)
+        {
+            qint32 subDelay, subIndex, audioIndex;
+            ds >> subDelay >> subIndex >> audioIndex >> record.trackInfo.subFiles >> record.trackInfo.audioFiles;
+            record.trackInfo.subDelay = subDelay;
+            record.trackInfo.subIndex = subIndex;
+            record.trackInfo.audioIndex = audioIndex;
+        }
+        if (record.flags & R_WEBDAV_INFO)
+        {
+            ds >> record.webDAVInfo.user >> record.webDAVInfo.password;
+        }
+        if (ds.status() != QDataStream::Ok || record.id == 0) return false;
+        // the hash of the stored bytes, a record repaired at load differs and is written again by the next save
+        record.hash = recordHash(data.constData() + start, int(ds.device()->pos() - start));
+        return true;
+    }
+
+    PlayListItem *createItem(const Record &record, PlayListItem *parent)
+    {
+        PlayListItem *item = new PlayListItem(parent, !(record.flags & R_COLLECTION));
+        item->type = PlayListItem::ItemType(record.type);
+        item->playTimeState = PlayListItem::PlayState(record.playTimeState);
+        item->marker = PlayListItem::Marker(record.marker);
+        item->playTime = record.playTime;
+        item->isBgmCollection = record.flags & R_BGM_COLLECTION;
+        item->addTime = record.addTime;
+        item->title = record.title;
+        item->animeTitle = record.animeTitle;
+        item->path = record.path;
+        item->poolID = record.poolID;
+        item->pathHash = record.pathHash;
+        if (record.flags & R_TRACK_INFO) item->trackInfo = new ItemTrackInfo(record.trackInfo);
+        if (record.flags & R_WEBDAV_INFO) item->webDAVInfo = new WebDAVInfo(record.webDAVInfo);
+        return item;
+    }
+}
+
+struct PlayListStore::Collected
+{
+    QByteArray records, changes;
+    QBuffer buffer;
+    QDataStream stream;
+    int count = 0, changeCount = 0;
+    QHash<const PlayListItem *, quint32> ids;
+    QHash<quint32, quint64> hashes;
+
+    Collected() : buffer(&records)
+    {
+        buffer.open(QIODevice::WriteOnly);
+        stream.setDevice(&buffer);
+    }
+};
+
+PlayListStore::PlayListStore(const QString &basePath) : snapshotPath(basePath + ".dat"), journalPath(basePath + ".journal"),
+    nextId(1), generation(0), snapshotSize(0), journalSize(0), journalReady(false)
+{
+
+}
+
+bool PlayListStore::exists() const
+{
+    return QFile::exists(snapshotPath);
+}
+
+bool PlayListStore::load(PlayListItem *root)
+{
+    QFile snapshotFile(snapshotPath);
+    if (!snapshotFile.open(QIODevice::ReadOnly)) return false;
+    const QByteArray snapshot = snapshotFile.readAll();
+    QDataStream ds(snapshot);
+    quint32 magic = 0, version = 0, snapshotGeneration = 0, snapshotNextId = 1, count = 0;
+    ds >> magic >> version >> snapshotGeneration >> snapshotNextId >> count;
+    if (ds.status() != QDataStream::Ok || magic != snapshotMagic || version != formatVersion)
+    {
+        Logger::logger()->log(Logger::APP, QString("[PlayListStore]Unknown snapshot format: %1").arg(snapshotPath));
+        return false;
+    }
+    QHash<quint32, Record> records;
+    records.reserve(int(qMin<qint64>(count, snapshot.size() / 32)));
+    for (quint32 i = 0; i < count; ++i)
+    {
+        Record record;
+        if (!readRecord(ds, snapshot, record))
+        {
+            Logger::logger()->log(Logger::APP, QString("[PlayListStore]Snapshot is corrupted at record %1").arg(i));
+            return false;
+        }
+        records.insert(record.id, record);
+    }
+    generation = snapshotGeneration;
+    snapshotSize = snapshot.size();
+
+    // replay the journal, a batch torn by a crash ends it
+    QFile journalFile(journalPath);
+    journalReady = false;
+    journalSize = 0;
+    int batches = 0;
+    if (journalFile.open(QIODevice::ReadOnly))
+    {
+        const QByteArray journal = journalFile.readAll();
+        journalFile.close();
+        QDataStream js(journal);
+        quint32 journalGeneration = 0;
+        js >> magic >> journalGeneration;
+        if (js.status() == QDataStream::Ok && magic == journalMagic && journalGeneration == generation)
+        {
+            journalReady = true;
+            qint64 validEnd = journalHeaderSize;
+            while (!js.atEnd())
+            {
+                quint32 size = 0;
+                quint16 checksum = 0;
+                js >> magic >> size >> checksum;
+                if (js.status() != QDataStream::Ok || magic != batchMagic || size > journal.size() - validEnd - batchHeaderSize) break;
+                const QByteArray payload = QByteArray::fromRawData(journal.constData() + validEnd + batchHeaderSize, int(size));
+                if (qChecksum(payload.constData(), size) != checksum) break;
+                QDataStream ps(payload);
+                QVector<Record> upserts;
+                QVector<quint32> removed;
+                quint32 upsertCount = 0, removeCount = 0;
+                ps >> upsertCount;
+                bool valid = ps.status() == QDataStream::Ok;
+                for (quint32 i = 0; valid && i < upsertCount; ++i)
+                {
+                    Record record;
+                    valid = readRecord(ps, payload, record);
+                    upserts.append(record);
+                }
+                ps >> removeCount;
+                for (quint32 i = 0; valid && i < removeCount; ++i)
+                {
+                    quint32 id = 0;
+                    ps >> id;
+                    removed.append(id);
+                }
+                if (!valid || ps.status() != QDataStream::Ok) break;
+                for (const Record &record : upserts) records.insert(record.id, record);
+                for (quint32 id : removed) records.remove(id);
+                validEnd += batchHeaderSize + size;
+                js.skipRawData(int(size));
+                ++batches;
+            }
+            if (validEnd < journal.size())
+            {
+                Logger::logger()->log(Logger::APP, QString("[PlayListStore]Drop %1 byte(s) of incomplete journal").arg(journal.size() - validEnd));
+                QFile::resize(journalPath, validEnd);
+            }
+            journalSize = validEnd;
+        }
+    }
+
+    // children by parent, a record whose parent is gone is kept at the top level
+    QHash<quint32, QVector<quint32>> childIds;
+    quint32 maxId = 0;
+    for (auto iter = records.cbegin(); iter != records.cend(); ++iter)
+    {
+        quint32 parent = iter->parent;
+        if (parent != 0)
+        {
+            auto parentRecord = records.constFind(parent);
+            if (parentRecord == records.cend() || !(parentRecord->flags & R_COLLECTION)) parent = 0;
+        }
+        childIds[parent].append(iter.key());
+        maxId = qMax(maxId, iter.key());
+    }
+    nextId = qMax(snapshotNextId, maxId + 1);
+
+    QSet<quint32> visited;
+    std::function<void(PlayListItem *, quint32)> build = [&](PlayListItem *parentItem, quint32 parentId){
+        auto children = childIds.constFind(parentId);
+        if (children == childIds.cend()) return;
+        // siblings are chained by prev, the rest of a broken chain keeps the stored order
+        QHash<quint32, quint32> nextSibling;
+        for (quint32 id : *children) nextSibling.insert(records[id].prev, id);
+        QVector<quint32> ordered;
+        ordered.reserve(children->size());
+        for (quint32 id = nextSibling.value(0, 0); id != 0 && !visited.contains(id); id = nextSibling.value(id, 0))
+        {
+            visited.insert(id);
+            ordered.append(id);
+        }
+        for (quint32 id : *children)
+        {
+            if (visited.contains(id)) continue;
+            visited.insert(id);
+            ordered.append(id);
+        }
+        for (quint32 id : ordered)
+        {
+            const Record &record = records[id];
+            PlayListItem *item = createItem(record, parentItem);
+            ids.insert(item, id);
+            hashes.insert(id, record.hash);
+            if (item->children) build(item, id);
+        }
+    };
+    build(root, 0);
+    Logger::logger()->log(Logger::APP, QString("[PlayListStore]Load %1 record(s), replay %2 journal batch(es)").arg(records.size()).arg(batches));
+    return true;
+}
+
+bool PlayListStore::save(const PlayListItem *root)
+{
+    Collected state;
+    state.ids.reserve(ids.size());
+    state.hashes.reserve(hashes.size());
+    collect(root, 0, state);
+    QVector<quint32> removed;
+    for (auto iter = hashes.cbegin(); iter != hashes.cend(); ++iter)
+    {
+        if (!state.hashes.contains(iter.key())) removed.append(iter.key());
+    }
+    if (state.changeCount == 0 && removed.isEmpty() && snapshotSize > 0)
+    {
+        ids.swap(state.ids);
+        return true;
+    }
+    const bool compact = snapshotSize == 0 || journalSize + state.changes.size() > qMax(minCompactSize, snapshotSize / 2);
+    bool ret = !compact && appendJournal(state.changes, state.changeCount, removed);
+    if (!ret) ret = writeSnapshot(state.records, state.count);
+    if (!ret) return false;
+    ids.swap(state.ids);
+    hashes.swap(state.hashes);
+    return true;
+}
+
+void PlayListStore::collect(const PlayListItem *item, quint32 itemId, Collected &state)
+{
+    quint32 prevId = 0;
+    for (const PlayListItem *child : *item->children)
+    {
+        quint32 id = ids.value(child, 0);
+        if (id == 0) id = nextId++;
+        const int start = state.records.size();
+        writeRecord(state.stream, child, id, itemId, prevId);
+        const int len = state.records.size() - start;
+        const quint64 hash = recordHash(state.records.constData() + start, len);
+        if (hashes.value(id, 0) != hash)
+        {
+            state.changes.append(state.records.constData() + start, len);
+            ++state.changeCount;
+        }
+        state.ids.insert(child, id);
+        state.hashes.insert(id, hash);
+        ++state.count;
+        if (child->children) collect(child, id, state);
+        prevId = id;
+    }
+}
+
+bool PlayListStore::writeSnapshot(const QByteArray &records, int count)
+{
+    QSaveFile snapshotFile(snapshotPath);
+    if (!snapshotFile.open(QIODevice::WriteOnly)) return false;
+    QDataStream ds(&snapshotFile);
+    ds << snapshotMagic << formatVersion << generation + 1 << nextId << quint32(count);
+    ds.writeRawData(records.constData(), records.size());
+    if (!snapshotFile.commit()) return false;
+    ++generation;
+    snapshotSize = snapshotHeaderSize + records.size();
+    // the old journal belongs to the previous generation and is ignored from now on
+    QSaveFile journalFile(journalPath);
+    journalReady = false;
+    if (!journalFile.open(QIODevice::WriteOnly)) return true;
+    QDataStream js(&journalFile);
+    js << journalMagic << generation;
+    journalReady = journalFile.commit();
+    journalSize = journalHeaderSize;
+    return true;
+}
+
+bool PlayListStore::appendJournal(const QByteArray &changes, int changeCount, const QVector<quint32> &removed)
+{
+    if (!journalReady) return false;
+    QByteArray payload;
+    {
+        QDataStream ps(&payload, QIODevice::WriteOnly);
+        ps << quint32(changeCount);
+        ps.writeRawData(changes.constData(), changes.size());
+        ps << quint32(removed.size());
+        for (quint32 id : removed) ps << id;
+    }
+    QByteArray batch;
+    {
+        QDataStream bs(&batch, QIODevice::WriteOnly);
+        bs << batchMagic << quint32(payload.size()) << qChecksum(payload.constData(), uint(payload.size()));
+        bs.writeRawData(payload.constData(), payload.size());
+    }
+    QFile journalFile(journalPath);
+    if (!journalFile.open(QIODevice::WriteOnly | QIODevice::Append) || journalFile.write(batch) != batch.size() || !journalFile.flush())
+    {
+        // a partly written batch would hide the following ones, start over with a new snapshot
+        journalReady = false;
+        return false;
+    }
+    journalSize += batch.size();
+    return true;
+}
@@ -0,0 +1,41 @@
+#ifndef PLAYLISTSTORE_H
+#define PLAYLISTSTORE_H
+#include <QHash>
+#include <QString>
+#include <QVector>
+struct PlayListItem;
+
+/*
+ * Binary persistence of the playlist tree: a snapshot (playlist.dat) plus an append-only journal (playlist.journal).
+ * Every node is a record with a stable id that refers to its parent and previous sibling by id,
+ * so inserting or moving a node changes only a few records. save() serializes the tree into memory,
+ * appends the records that differ from the last saved state as one checksummed batch to the journal
+ * and rewrites the snapshot once the journal has grown larger than half of it.
+ * A batch torn by a crash is dropped at load, the journal only applies to the snapshot generation it was started for.
+ */
+class PlayListStore
+{
+public:
+    explicit PlayListStore(const QString &basePath);
+
+    bool exists() const;
+    // builds the children of root, false if there is no readable snapshot
+    bool load(PlayListItem *root);
+    // writes the changes since the last load/save
+    bool save(const PlayListItem *root);
+
+private:
+    QString snapshotPath, journalPath;
+    QHash<const PlayListItem *, quint32> ids;
+    QHash<quint32, quint64> hashes;  // id -> hash of the saved record
+    quint32 nextId, generation;
+    qint64 snapshotSize, journalSize;
+    bool journalReady;
+
+    struct Collected;
+    void collect(const PlayListItem *item, quint32 itemId, Collected &state);
+    bool writeSnapshot(const QByteArray &records, int count);
+    bool appendJournal(const QByteArray &changes, int changeCount, const QVector<quint32> &removed);
+};
+
+#endif // PLAYLISTSTORE_H
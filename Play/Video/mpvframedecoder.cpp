@@ -0,0 +1,114 @@
+#include "mpvframedecoder.h"
+#include <QDir>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <stdexcept>
+#include <mpv/qthelper.hpp>
+
+MPVFrameDecoder::MPVFrameDecoder()
+{
+    mpv = mpv_create();
+    if (!mpv)
+        throw std::runtime_error("could not create mpv context");
+    // the image output writes the decoded frames to vo-image-outdir, nothing is rendered
+    mpv_set_option_string(mpv, "vo", "image");
+    mpv_set_option_string(mpv, "vo-image-format", "png");
+    mpv_set_option_string(mpv, "ao", "null");
+    mpv_set_option_string(mpv, "audio", "no");
+    mpv_set_option_string(mpv, "sid", "no");
+    mpv_set_option_string(mpv, "frames", "1");
+    mpv_set_option_string(mpv, "hr-seek", "yes");
+    mpv_set_option_string(mpv, "idle", "yes");
+    mpv_set_option_string(mpv, "config", "no");
+    mpv_set_option_string(mpv, "load-scripts", "no");
+    mpv_set_option_string(mpv, "ytdl", "no");
+    mpv_set_option_string(mpv, "terminal", "no");
+    if (mpv_initialize(mpv) < 0)
+    {
+        mpv_terminate_destroy(mpv);
+        throw std::runtime_error("could not initialize mpv context");
+    }
+}
+
+MPVFrameDecoder::~MPVFrameDecoder()
+{
+    mpv_terminate_destroy(mpv);
+}
+
+bool MPVFrameDecoder::capture(const QString &filename, double pos, QImage &image, QString &errorInfo, int timeout)
+{
+    QTemporaryDir outDir;
+    if(!outDir.isValid())
+    {
+        errorInfo = QObject::tr("Create Temp Dir Failed");
+        return false;
+    }
+    mpv::qt::set_property(mpv, "vo-image-outdir", outDir.path());
+    mpv::qt::set_property(mpv, "start", QString::number(pos, 'f', 3));
+    // events of a previous capture that timed out may still be queued
+    while(mpv_wait_event(mpv, 0)->event_id != MPV_EVENT_NONE);
+
+    // loadfile returns the playlist entry it creates, only the events of this entry count
+    const QByteArray file(filename.toUtf8());
+    const char *args[] = {"loadfile", file.constData(), "replace", nullptr};
+    mpv_node result;
+    const int ret = mpv_command_ret(mpv, args, &result);
+    if(ret < 0)
+    {
+        errorInfo = QObject::tr("Decode Failed: %1").arg(mpv_error_string(ret));
+        return false;
+    }
+    int64_t entryId = -1;
+    if(result.format == MPV_FORMAT_NODE_MAP)
+    {
+        for(int i = 0; i < result.u.list->num; ++i)
+        {
+            if(qstrcmp(result.u.list->keys[i], "playlist_entry_id") == 0 && result.u.list->values[i].format == MPV_FORMAT_INT64)
+                entryId = result.u.list->values[i].u.int64;
+        }
+    }
+    mpv_free_node_contents(&result);
+
+    QElapsedTimer timer;
+    timer.start();
+    bool finished = false;
+    while(!finished)
+    {
+        const qint64 remaining = timeout - timer.elapsed();
+        if(remaining <= 0) break;
+        mpv_event *event = mpv_wait_event(mpv, remaining / 1000.0);
+        if(event->event_id == MPV_EVENT_START_FILE)
+        {
+            // the id is not returned by older versions of mpv, the first entry started after the drain is ours then
+            if(entryId < 0) entryId = static_cast<mpv_event_start_file *>(event->data)->playlist_entry_id;
+        }
+        else if(event->event_id == MPV_EVENT_END_FILE)
+        {
+            mpv_event_end_file *endFile = static_cast<mpv_event_end_file *>(event->data);
+            if(endFile->playlist_entry_id != entryId) continue;
+            if(endFile->reason == MPV_END_FILE_REASON_ERROR)
+            {
+                errorInfo = QObject::tr("Decode Failed: %1").arg(mpv_error_string(endFile->error));
+                return false;
+            }
+            finished = true;
+        }
+        else if(event->event_id == MPV_EVENT_SHUTDOWN)
+        {
+            break;
+        }
+    }
+    if(!finished)
+    {
+        mpv::qt::command_variant(mpv, "stop");
+        errorInfo = QObject::tr("Decode Timeout");
+        return false;
+    }
+    const QStringList frames = QDir(outDir.path()).entryList(QDir::Files, QDir::Name);
+    if(frames.isEmpty() || !image.load(outDir.filePath(frames.first())))
+    {
+        errorInfo = QObject::tr("No Frame at %1s").arg(pos);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,26 @@
+#ifndef MPVFRAMEDECODER_H
+#define MPVFRAMEDECODER_H
+
+#include <QImage>
+#include <QString>
+#include <mpv/client.h>
+
+/*
+ * Headless libmpv instance that decodes single frames with the image video output.
+ * The instance is kept between captures, so no process is started per frame.
+ * Not thread-safe: one decoder is used by one thread at a time.
+ */
+class MPVFrameDecoder
+{
+public:
+    MPVFrameDecoder();
+    ~MPVFrameDecoder();
+
+    // pos in seconds, blocks until the frame is written or timeout (ms) expires
+    bool capture(const QString &filename, double pos, QImage &image, QString &errorInfo, int timeout = 30000);
+
+private:
+    mpv_handle *mpv;
+};
+
+#endif // MPVFRAMEDECODER_H
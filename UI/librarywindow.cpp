@@ -614,6 +614,11 @@ AnimeFilterBox::AnimeFilterBox(QWidget *parent)
     filterCrt->setCheckable(true);
     filterTypeGroup->addAction(filterCrt);
 
+    QAction *filterAll = menu->addAction(tr("All"));
+    filterAll->setData(QVariant(int(4)));
+    filterAll->setCheckable(true);
+    filterTypeGroup->addAction(filterAll);
+
     connect(filterTypeGroup, &QActionGroup::triggered,[this](QAction *act){
         emit filterChanged(act->data().toInt(),this->text());
     });
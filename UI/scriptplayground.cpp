@@ -5,6 +5,12 @@
 #include <QPushButton>
 #include <QSplitter>
 #include <QGridLayout>
+#include <QCheckBox>
+#include <QFileDialog>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include "Extension/Script/scriptmanager.h"
+#include "globalobjects.h"
 
 namespace
 {
@@ -469,7 +475,12 @@ void CodeEditor::lineNumberAreaPaintEvent(QPaintEvent *event)
 ScriptPlayground::ScriptPlayground(QWidget *parent) :
     CFramelessDialog(tr("Script Playground"), parent, false, true, false), executor(new PlaygroundScript)
 {
+    executor->setMemoryLimit(GlobalObjects::scriptManager->memoryLimit());
     QPushButton *run = new QPushButton(tr("Run"), this);
+    QCheckBox *profileCheck = new QCheckBox(tr("Profile"), this);
+    profileCheck->setToolTip(tr("Profile playground runs and all installed scripts"));
+    QPushButton *profileReport = new QPushButton(tr("Profile Report"), this);
+    QPushButton *saveProfile = new QPushButton(tr("Save Profile"), this);
     CodeEditor *editor = new CodeEditor(this);
     editor->setFont(QFont("Consolas", 12));
 
@@ -488,19 +499,76 @@ ScriptPlayground::ScriptPlayground(QWidget *parent) :
 
     QGridLayout *playgroundGlayout = new QGridLayout(this);
     playgroundGlayout->addWidget(run, 0, 0);
-    playgroundGlayout->addWidget(splitter, 1, 0, 1, 4);
+    playgroundGlayout->addWidget(profileCheck, 0, 1);
+    playgroundGlayout->addWidget(profileReport, 0, 2);
+    playgroundGlayout->addWidget(saveProfile, 0, 3);
+    playgroundGlayout->addWidget(splitter, 1, 0, 1, 5);
     playgroundGlayout->setRowStretch(1, 1);
-    playgroundGlayout->setColumnStretch(3, 1);
+    playgroundGlayout->setColumnStretch(4, 1);
     playgroundGlayout->setContentsMargins(0, 0, 0, 0);
     setSizeSettingKey("DialogSize/ScriptPlayground",QSize(700*logicalDpiX()/96, 400*logicalDpiY()/96));
 
     QObject::connect(run, &QPushButton::clicked, this, [=](){
         run->setEnabled(false);
         outputView->clear();
+        if(profileCheck->isChecked()) executor->setProfilerEnabled(true);
         executor->run(editor->toPlainText());
+        if(profileCheck->isChecked()) outputView->appendPlainText(executor->profileSummary());
         run->setEnabled(true);
     });
 
+    auto profiledScripts = [this](){
+        QList<ScriptBase *> scripts{executor.data()};
+        for(int i = 0; i < ScriptType::UNKNOWN_STYPE; ++i)
+        {
+            for(const auto &s : GlobalObjects::scriptManager->scripts(ScriptType(i)))
+            {
+                if(s->profilerEnabled()) scripts.append(s.get());
+            }
+        }
+        return scripts;
+    };
+    profileCheck->setChecked(GlobalObjects::scriptManager->profilerEnabled());
+    QObject::connect(profileCheck, &QCheckBox::stateChanged, this, [=](int state){
+        executor->setProfilerEnabled(state == Qt::Checked);
+        GlobalObjects::scriptManager->setProfilerEnabled(state == Qt::Checked);
+    });
+    QObject::connect(profileReport, &QPushButton::clicked, this, [=](){
+        for(ScriptBase *s : profiledScripts())
+        {
+            outputView->appendPlainText(QString("[%1]\n%2\n").arg(s->id(), s->profileSummary()));
+        }
+    });
+    QObject::connect(saveProfile, &QPushButton::clicked, this, [=](){
+        QString selectedFilter;
+        QString fileName = QFileDialog::getSaveFileName(this, tr("Save Profile"), "", "JSON (*.json);;Folded Stacks (*.folded)", &selectedFilter);
+        if(fileName.isEmpty()) return;
+        QFile profileFile(fileName);
+        if(!profileFile.open(QFile::WriteOnly)) return;
+        if(selectedFilter.startsWith("JSON"))
+        {
+            QJsonArray profiles;
+            for(ScriptBase *s : profiledScripts())
+            {
+                profiles.append(s->profileData());
+            }
+            profileFile.write(QJsonDocument(profiles).toJson(QJsonDocument::Indented));
+        }
+        else
+        {
+            // prefix every stack with the script id, so all scripts fit in one flamegraph
+            for(ScriptBase *s : profiledScripts())
+            {
+                const QByteArray stackPrefix(s->id().toUtf8() + ";");
+                const QList<QByteArray> stacks(s->profileFoldedStacks().split('\n'));
+                for(const QByteArray &stack : stacks)
+                {
+                    if(!stack.isEmpty()) profileFile.write(stackPrefix + stack + "\n");
+                }
+            }
+        }
+    });
+
     executor->setPrintCallback([=](const QString &content){
         outputView->appendPlainText(content);
         QTextCursor cursor = outputView->textCursor();
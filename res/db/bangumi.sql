@@ -63,9 +63,23 @@ CREATE TABLE "image" (
 "Info"  TEXT,
 "Thumb"  BLOB,
 "Data"  BLOB,
+"Hash"  TEXT,
 PRIMARY KEY ("Anime","TimeId","Type"),
 CONSTRAINT "Anime" FOREIGN KEY ("Anime") REFERENCES "anime" ("Anime") ON DELETE CASCADE ON UPDATE CASCADE
 );
 
 CREATE INDEX "Time_Index"
 ON "image" ("TimeId" ASC);
+
+CREATE INDEX "Hash_Index"
+ON "image" ("Hash" ASC);
+
+CREATE TABLE "cover_thumb" (
+"Anime"  TEXT NOT NULL,
+"Width"  INTEGER,
+"Height"  INTEGER,
+"CoverSize"  INTEGER,
+"Thumb"  BLOB,
+PRIMARY KEY ("Anime" ASC),
+CONSTRAINT "Anime" FOREIGN KEY ("Anime") REFERENCES "anime" ("Anime") ON DELETE CASCADE ON UPDATE CASCADE
+);
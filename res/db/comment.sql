@@ -107,3 +107,11 @@ CONSTRAINT "PoolID" FOREIGN KEY ("PoolID") REFERENCES "pool" ("PoolID") ON DELET
 );
 CREATE UNIQUE INDEX "Match_MD5"
 ON "match" ("MD5" ASC);
+
+CREATE TABLE "file_hash" (
+"Path"  TEXT NOT NULL,
+"Size"  INTEGER,
+"MTime"  INTEGER,
+"MD5"  TEXT,
+PRIMARY KEY ("Path" ASC)
+);
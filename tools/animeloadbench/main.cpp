@@ -0,0 +1,236 @@
+/*
+ * Times the first page of the library (AnimeWorker::fetchAnimes) against the N+1 load it replaced.
+ * For each size a bangumi.db is seeded with animes that have a cover blob and a few characters, then
+ *  - old path: select * from anime, covers included, and one character query per anime
+ *  - new path: AnimeWorker::fetchAnimes, no covers and one character query per batch
+ * Both read the first page of Library/BatchSize animes (1024 by default) on the work thread.
+ *
+ *   animeloadbench [sizes...]    default 1000 5000 10000
+ */
+#include "MediaLibrary/animeworker.h"
+#include "Common/threadtask.h"
+#include "globalobjects.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QVector>
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+    const int pageSize = 1024;
+    const int charactersPerAnime = 8;
+    const int coverSize = 60 * 1024;
+    const int rounds = 5;
+    // the connection names GlobalObjects::getDB picks for the two threads
+    const char *mainConnection = "Bangumi_M";
+    const char *workConnection = "Bangumi_W";
+
+    // fields the old path copied out of each row, Anime keeps its members private to the worker
+    struct OldAnime
+    {
+        QString name, desc, airDate, url, scriptId, scriptData, staff, coverURL;
+        qint64 addTime;
+        int epCount;
+        QByteArray coverData;
+        QVector<Character> characters;
+    };
+
+    bool openDB(const char *name, const QString &file)
+    {
+        QSqlDatabase database = QSqlDatabase::contains(name)? QSqlDatabase::database(name, false) : QSqlDatabase::addDatabase("QSQLITE", name);
+        database.close();
+        database.setDatabaseName(file);
+        if (!database.open()) return false;
+        QSqlQuery query(database);
+        return query.exec("PRAGMA foreign_keys = ON;");
+    }
+
+    bool openWorkDB(const QString &file)
+    {
+        ThreadTask task(GlobalObjects::workThread);
+        return task.Run([file](){
+            return openDB(workConnection, file);
+        }).toBool();
+    }
+
+    // the schema of a new bangumi.db, as GlobalObjects::setDatabase creates it
+    bool createSchema(QSqlDatabase database)
+    {
+        QFile sqlFile(KIKOPLAY_BANGUMI_SQL);
+        if (!sqlFile.open(QFile::ReadOnly)) return false;
+        QSqlQuery query(database);
+        const QStringList sqls = QString(sqlFile.readAll()).split(';', Qt::SkipEmptyParts);
+        for (const QString &sql : sqls)
+        {
+            if (sql.trimmed().isEmpty()) continue;
+            if (!query.exec(sql)) return false;
+        }
+        return true;
+    }
+
+    bool seed(QSqlDatabase database, int count)
+    {
+        if (!createSchema(database)) return false;
+        QByteArray cover(coverSize, Qt::Uninitialized);
+        for (int i = 0; i < cover.size(); ++i) cover[i] = char((i * 2654435761u) >> 24);
+        const QString desc = QString("A description of a few sentences, as the bangumi scripts store it. ").repeated(5);
+        database.transaction();
+        QSqlQuery animeQuery(database), crtQuery(database);
+        animeQuery.prepare("insert into anime(Anime, AddTime, EpCount, AirDate, Desc, URL, ScriptId, ScriptData, Staff, CoverURL, Cover) "
+                           "values(?,?,?,?,?,?,?,?,?,?,?)");
+        crtQuery.prepare("insert into character(Anime, Name, Link, Actor, ImageURL) values(?,?,?,?,?)");
+        for (int i = 0; i < count; ++i)
+        {
+            // names carry the size, the worker keeps every loaded anime by name
+            const QString name = QString("Anime %1-%2").arg(count).arg(i);
+            animeQuery.bindValue(0, name);
+            animeQuery.bindValue(1, 1600000000 + i);
+            animeQuery.bindValue(2, 12 + i % 13);
+            animeQuery.bindValue(3, QString("20%1-%2-01").arg(10 + i % 14).arg(1 + i % 12, 2, 10, QChar('0')));
+            animeQuery.bindValue(4, desc);
+            animeQuery.bindValue(5, QString("https://bgm.tv/subject/%1").arg(i));
+            animeQuery.bindValue(6, "Kikyou.l.Bangumi");
+            animeQuery.bindValue(7, QString::number(i));
+            animeQuery.bindValue(8, "导演:Director;系列构成:Writer;音乐:Composer;动画制作:Studio");
+            animeQuery.bindValue(9, QString("https://lain.bgm.tv/pic/cover/l/%1.jpg").arg(i));
+            animeQuery.bindValue(10, cover);
+            if (!animeQuery.exec()) return false;
+            for (int c = 0; c < charactersPerAnime; ++c)
+            {
+                crtQuery.bindValue(0, name);
+                crtQuery.bindValue(1, QString("Character %1").arg(c));
+                crtQuery.bindValue(2, QString("https://bgm.tv/character/%1").arg(i * charactersPerAnime + c));
+                crtQuery.bindValue(3, QString("Actor %1").arg(c));
+                crtQuery.bindValue(4, QString("https://lain.bgm.tv/pic/crt/m/%1.jpg").arg(i * charactersPerAnime + c));
+                if (!crtQuery.exec()) return false;
+            }
+        }
+        return database.commit();
+    }
+
+    // AnimeWorker::fetchAnimes before the page query left out covers and batched the characters
+    int oldFetch(int offset, int limit)
+    {
+        ThreadTask task(GlobalObjects::workThread);
+        return task.Run([=](){
+            QSqlQuery query(GlobalObjects::getDB(GlobalObjects::Bangumi_DB));
+            query.exec(QString("select * from anime order by AddTime desc limit %1 offset %2").arg(limit).arg(offset));
+            const QSqlRecord record = query.record();
+            const int animeNo = record.indexOf("Anime"), descNo = record.indexOf("Desc"), timeNo = record.indexOf("AddTime"),
+                      airDateNo = record.indexOf("AirDate"), epCountNo = record.indexOf("EpCount"), urlNo = record.indexOf("URL"),
+                      scriptIdNo = record.indexOf("ScriptId"), scriptDataNo = record.indexOf("ScriptData"),
+                      staffNo = record.indexOf("Staff"), coverURLNo = record.indexOf("CoverURL"), coverNo = record.indexOf("Cover");
+            QSqlQuery crtQuery(GlobalObjects::getDB(GlobalObjects::Bangumi_DB));
+            crtQuery.prepare("select Name, Actor, Link, ImageURL from character where Anime=?");
+            QVector<OldAnime> animes;
+            while (query.next())
+            {
+                OldAnime anime;
+                anime.name = query.value(animeNo).toString();
+                anime.desc = query.value(descNo).toString();
+                anime.airDate = query.value(airDateNo).toString();
+                anime.addTime = query.value(timeNo).toLongLong();
+                anime.epCount = query.value(epCountNo).toInt();
+                anime.url = query.value(urlNo).toString();
+                anime.scriptId = query.value(scriptIdNo).toString();
+                anime.scriptData = query.value(scriptDataNo).toString();
+                anime.staff = query.value(staffNo).toString();
+                anime.coverURL = query.value(coverURLNo).toString();
+                anime.coverData = query.value(coverNo).toByteArray();
+                crtQuery.bindValue(0, anime.name);
+                crtQuery.exec();
+                while (crtQuery.next())
+                {
+                    Character crt;
+                    crt.name = crtQuery.value(0).toString();
+                    crt.actor = crtQuery.value(1).toString();
+                    crt.link = crtQuery.value(2).toString();
+                    crt.imgURL = crtQuery.value(3).toString();
+                    anime.characters.append(crt);
+                }
+                animes.append(anime);
+            }
+            return animes.size();
+        }).toInt();
+    }
+
+    double median(QVector<double> times)
+    {
+        std::sort(times.begin(), times.end());
+        return times[times.size() / 2];
+    }
+
+    bool run(int count, const QString &dir)
+    {
+        const QString file = QString("%1/bangumi_%2.db").arg(dir).arg(count);
+        QElapsedTimer timer;
+        std::printf("\n%d animes\n", count);
+
+        timer.start();
+        if (!openDB(mainConnection, file) || !seed(QSqlDatabase::database(mainConnection), count)) return false;
+        std::printf("  seed                %10.1f ms  %8.1f MiB\n", timer.nsecsElapsed() / 1e6, QFile(file).size() / 1048576.0);
+        if (!openWorkDB(file)) return false;
+        const int expected = qMin(count, pageSize);
+
+        // the first round warms the page cache and is not counted
+        QVector<double> oldTimes;
+        for (int r = 0; r <= rounds; ++r)
+        {
+            timer.restart();
+            const int oldCount = oldFetch(0, pageSize);
+            if (r > 0) oldTimes.append(timer.nsecsElapsed() / 1e6);
+            if (oldCount != expected) return false;
+        }
+        std::printf("  old first page      %10.1f ms  (median of %d)\n", median(oldTimes), rounds);
+
+        // the worker keeps every anime it loads, so its path runs once per size
+        QVector<Anime *> animes;
+        timer.restart();
+        const int newCount = AnimeWorker::instance()->fetchAnimes(&animes, 0, pageSize);
+        std::printf("  new first page      %10.1f ms\n", timer.nsecsElapsed() / 1e6);
+        if (newCount != expected || animes.first()->crList().size() != charactersPerAnime) return false;
+        return true;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTemporaryDir dir;
+    if (!dir.isValid()) return 1;
+    // the worker logs through Logger and keeps its image store below the data path
+    GlobalObjects::dataPath = dir.path() + "/";
+
+    QThread::currentThread()->setObjectName(QStringLiteral("mainThread"));
+    GlobalObjects::workThread = new QThread();
+    GlobalObjects::workThread->setObjectName(QStringLiteral("workThread"));
+    GlobalObjects::workThread->start(QThread::NormalPriority);
+
+    // the worker sets up its tables and search index on the first database it sees, an empty one keeps that out of the timing
+    const QString emptyFile = dir.path() + "/bangumi.db";
+    bool ok = openDB(mainConnection, emptyFile) && createSchema(QSqlDatabase::database(mainConnection)) && openWorkDB(emptyFile);
+    if (ok) AnimeWorker::instance();
+
+    QVector<int> sizes;
+    for (int i = 1; i < app.arguments().size(); ++i)
+        sizes.append(app.arguments().at(i).toInt());
+    if (sizes.isEmpty()) sizes = {1000, 5000, 10000};
+    for (int count : sizes)
+    {
+        if (!ok) break;
+        if (count <= 0) continue;
+        ok = run(count, dir.path());
+        if (!ok) std::printf("FAILED at %d animes\n", count);
+    }
+
+    GlobalObjects::workThread->quit();
+    GlobalObjects::workThread->wait();
+    return ok? 0 : 1;
+}
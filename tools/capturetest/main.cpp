@@ -0,0 +1,68 @@
+/*
+ * Captures frames from sample.y4m with MPVFrameDecoder.
+ * The sample has 10 frames at 10 fps, frame i is uniformly gray with luma 16 + 20 * i,
+ * so the captured gray level tells which frame was decoded.
+ *
+ *   capturetest [sample file]
+ */
+#include "Play/Video/mpvframedecoder.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <clocale>
+#include <cstdio>
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool ok, const char *what, const QString &detail = QString())
+    {
+        std::printf("%s: %s%s%s\n", ok? "PASS" : "FAIL", what, detail.isEmpty()? "" : ", ", qPrintable(detail));
+        if(!ok) ++failures;
+    }
+
+    bool isFrame(const QImage &image, int frame)
+    {
+        // limited range luma, scaled to 0-255 by the image output
+        const int expected = frame * 20 * 255 / 219;
+        const QColor center = image.pixelColor(image.width() / 2, image.height() / 2);
+        return qAbs(center.red() - expected) <= 8 && qAbs(center.green() - expected) <= 8 && qAbs(center.blue() - expected) <= 8;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    // libmpv refuses to start with a non-C numeric locale
+    std::setlocale(LC_NUMERIC, "C");
+    const QString sample = app.arguments().size() > 1? app.arguments().at(1) : QString(KIKOPLAY_CAPTURE_SAMPLE);
+
+    MPVFrameDecoder decoder;
+    QImage image;
+    QString errorInfo;
+    QElapsedTimer timer;
+
+    timer.start();
+    bool ok = decoder.capture(sample, 0.5, image, errorInfo);
+    check(ok && image.size() == QSize(64, 48), "capture at 0.5s", ok? QString("%1 ms").arg(timer.elapsed()) : errorInfo);
+    if(ok) check(isFrame(image, 5), "frame 5 at 0.5s");
+
+    // a reused decoder must not mix up the events of the previous load
+    timer.restart();
+    ok = decoder.capture(sample, 0.8, image, errorInfo);
+    check(ok && isFrame(image, 8), "second capture at 0.8s", ok? QString("%1 ms").arg(timer.elapsed()) : errorInfo);
+
+    // a capture that times out leaves its events behind
+    ok = decoder.capture(sample, 0.2, image, errorInfo, 1);
+    std::printf("INFO: capture with 1 ms timeout %s\n", ok? "finished" : qPrintable(errorInfo));
+    ok = decoder.capture(sample, 0.3, image, errorInfo);
+    check(ok && isFrame(image, 3), "capture after a timeout", ok? QString() : errorInfo);
+
+    ok = decoder.capture(sample + ".missing", 0, image, errorInfo, 5000);
+    check(!ok, "missing file fails", errorInfo);
+
+    ok = decoder.capture(sample, 0.1, image, errorInfo);
+    check(ok && isFrame(image, 1), "capture after a failed load", ok? QString() : errorInfo);
+
+    return failures == 0? 0 : 1;
+}
@@ -0,0 +1,176 @@
+/*
+ * Loopback load generator for the LAN server.
+ * Opens a number of keep-alive connections spread over a few threads, each one sends a request as soon as
+ * the previous response is complete, and reports requests/sec and latency percentiles at the end.
+ *
+ *   httpbench --port 8000 --clients 400 --threads 4 --duration 10 --path /api/playstate
+ */
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QMutex>
+#include <QTcpSocket>
+#include <QThread>
+#include <QTimer>
+#include <QVector>
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+    struct Options
+    {
+        QString host;
+        quint16 port;
+        QByteArray path;
+        int clients, threads, duration;
+    };
+
+    struct Stats
+    {
+        QVector<qint64> latencies;  // us
+        qint64 requests = 0, errors = 0, refused = 0, maxOpen = 0;
+    };
+
+    class Client : public QObject
+    {
+    public:
+        Client(const Options &options, Stats &stats, int &openCount, QObject *parent) :
+            QObject(parent), options(options), stats(stats), openCount(openCount), socket(new QTcpSocket(this)), connected(false)
+        {
+            request = "GET " + options.path + " HTTP/1.1\r\nHost: " + options.host.toUtf8() + "\r\nConnection: keep-alive\r\n\r\n";
+            QObject::connect(socket, &QTcpSocket::connected, this, [this](){
+                connected = true;
+                stats.maxOpen = std::max<qint64>(stats.maxOpen, ++this->openCount);
+                send();
+            });
+            QObject::connect(socket, &QTcpSocket::readyRead, this, &Client::onReadyRead);
+            QObject::connect(socket, &QTcpSocket::disconnected, this, [this](){
+                if(connected) --this->openCount;
+                connected = false;
+            });
+            QObject::connect(socket, &QTcpSocket::errorOccurred, this, [this](QAbstractSocket::SocketError error){
+                if(error == QAbstractSocket::ConnectionRefusedError) ++this->stats.refused;
+                else if(error != QAbstractSocket::RemoteHostClosedError) ++this->stats.errors;
+            });
+            socket->connectToHost(options.host, options.port);
+        }
+
+    private:
+        const Options &options;
+        Stats &stats;
+        int &openCount;
+        QTcpSocket *socket;
+        QByteArray request, buffer;
+        QElapsedTimer sentTime;
+        bool connected;
+
+        void send()
+        {
+            buffer.clear();
+            sentTime.start();
+            socket->write(request);
+        }
+
+        void onReadyRead()
+        {
+            buffer.append(socket->readAll());
+            const int headerEnd = buffer.indexOf("\r\n\r\n");
+            if(headerEnd < 0) return;
+            const QByteArray header = buffer.left(headerEnd).toLower();
+            int bodySize = -1;
+            const int lengthPos = header.indexOf("content-length:");
+            if(lengthPos >= 0)
+            {
+                const int lineEnd = header.indexOf("\r\n", lengthPos);
+                bodySize = header.mid(lengthPos + 15, lineEnd < 0? -1 : lineEnd - lengthPos - 15).trimmed().toInt();
+            }
+            if(bodySize < 0)
+            {
+                // chunked bodies end with an empty chunk
+                if(header.contains("transfer-encoding: chunked") && buffer.endsWith("\r\n0\r\n\r\n")) bodySize = buffer.size() - headerEnd - 4;
+                else if(header.contains("transfer-encoding: chunked")) return;
+                else bodySize = 0;
+            }
+            if(buffer.size() < headerEnd + 4 + bodySize) return;
+            if(!header.startsWith("http/1.1 2") && !header.startsWith("http/1.1 304")) ++stats.errors;
+            stats.latencies.append(sentTime.nsecsElapsed() / 1000);
+            ++stats.requests;
+            send();
+        }
+    };
+
+    qint64 percentile(const QVector<qint64> &sorted, double p)
+    {
+        if(sorted.isEmpty()) return 0;
+        const int index = qBound(0, int(sorted.size() * p), sorted.size() - 1);
+        return sorted[index];
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Loopback load generator for the KikoPlay LAN server");
+    parser.addHelpOption();
+    parser.addOption({"host", "Server address", "host", "127.0.0.1"});
+    parser.addOption({"port", "Server port", "port", "8000"});
+    parser.addOption({"path", "Request path", "path", "/api/playstate"});
+    parser.addOption({"clients", "Concurrent keep-alive connections", "n", "200"});
+    parser.addOption({"threads", "Client threads", "n", "4"});
+    parser.addOption({"duration", "Seconds to run", "s", "10"});
+    parser.process(app);
+
+    Options options;
+    options.host = parser.value("host");
+    options.port = parser.value("port").toUShort();
+    options.path = parser.value("path").toUtf8();
+    options.clients = qMax(1, parser.value("clients").toInt());
+    options.threads = qBound(1, parser.value("threads").toInt(), options.clients);
+    options.duration = qMax(1, parser.value("duration").toInt());
+
+    QMutex lock;
+    Stats total;
+    QVector<QThread *> threads;
+    QElapsedTimer elapsed;
+    elapsed.start();
+    for(int t = 0; t < options.threads; ++t)
+    {
+        const int count = options.clients / options.threads + (t < options.clients % options.threads? 1 : 0);
+        threads.append(QThread::create([&options, &lock, &total, count](){
+            Stats stats;
+            int openCount = 0;
+            QEventLoop loop;
+            QObject owner;
+            for(int i = 0; i < count; ++i)
+                new Client(options, stats, openCount, &owner);
+            QTimer::singleShot(options.duration * 1000, &loop, &QEventLoop::quit);
+            loop.exec();
+            QMutexLocker locker(&lock);
+            total.latencies += stats.latencies;
+            total.requests += stats.requests;
+            total.errors += stats.errors;
+            total.refused += stats.refused;
+            total.maxOpen += stats.maxOpen;
+        }));
+        threads.last()->start();
+    }
+    for(QThread *thread : threads)
+    {
+        thread->wait();
+        delete thread;
+    }
+    const double seconds = elapsed.elapsed() / 1000.0;
+
+    std::sort(total.latencies.begin(), total.latencies.end());
+    std::printf("clients %d, threads %d, %.1f s, %s:%u%s\n", options.clients, options.threads, seconds,
+                qPrintable(options.host), options.port, options.path.constData());
+    std::printf("connected %lld, refused %lld, errors %lld\n", total.maxOpen, total.refused, total.errors);
+    std::printf("requests %lld, %.0f req/s\n", total.requests, total.requests / seconds);
+    std::printf("latency p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+                percentile(total.latencies, 0.5) / 1000.0, percentile(total.latencies, 0.9) / 1000.0,
+                percentile(total.latencies, 0.99) / 1000.0, (total.latencies.isEmpty()? 0 : total.latencies.last()) / 1000.0);
+    return 0;
+}
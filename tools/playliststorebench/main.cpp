@@ -0,0 +1,240 @@
+/*
+ * Times the binary playlist store (PlayListStore) against the XML format it replaced.
+ * For each size a tree of anime collections with 40 episodes each is built, then
+ *  - xml save/load: the layout of PlayListPrivate::saveXml/loadXml
+ *  - snapshot write/load: the first save of a store and loading it back
+ *  - journal append: a save after a few items changed, averaged over 100 saves
+ *  - journal replay: loading the snapshot together with those 100 batches
+ *  - compaction: a save after every item changed, which rewrites the snapshot
+ *
+ *   playliststorebench [sizes...]    default 10000 50000 100000
+ */
+#include "Play/Playlist/playlistitem.h"
+#include "Play/Playlist/playliststore.h"
+#include "globalobjects.h"
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include <cstdio>
+#include <functional>
+
+namespace
+{
+    const int episodesPerCollection = 40;
+    const int journalSaves = 100;
+    const int changesPerSave = 5;
+
+    PlayListItem *buildTree(int count)
+    {
+        PlayListItem *root = new PlayListItem;
+        PlayListItem *collection = nullptr;
+        for (int i = 0; i < count; ++i)
+        {
+            const int anime = i / episodesPerCollection, ep = i % episodesPerCollection + 1;
+            if (ep == 1)
+            {
+                collection = new PlayListItem(root);
+                collection->title = QString("Anime %1").arg(anime);
+            }
+            PlayListItem *item = new PlayListItem(collection, true);
+            item->title = QString("Anime %1 - %2 [1080p]").arg(anime).arg(ep, 2, 10, QChar('0'));
+            item->animeTitle = QString("Anime %1").arg(anime);
+            item->path = QString("/media/anime/Anime %1/[Group] Anime %1 - %2 [1080p].mkv").arg(anime).arg(ep, 2, 10, QChar('0'));
+            item->pathHash = QCryptographicHash::hash(item->path.toUtf8(), QCryptographicHash::Md5).toHex();
+            item->addTime = 1600000000 + i;
+            item->playTime = i % 1440;
+            item->playTimeState = PlayListItem::PlayState(i % 3);
+        }
+        return root;
+    }
+
+    void forEachLeaf(PlayListItem *item, const std::function<void(PlayListItem *)> &func)
+    {
+        for (PlayListItem *child : *item->children)
+        {
+            if (child->children) forEachLeaf(child, func);
+            else func(child);
+        }
+    }
+
+    int countLeaves(PlayListItem *root)
+    {
+        int count = 0;
+        forEachLeaf(root, [&count](PlayListItem *){ ++count; });
+        return count;
+    }
+
+    void writeXml(QXmlStreamWriter &writer, PlayListItem *item, bool isRoot)
+    {
+        if (isRoot)
+        {
+            writer.writeStartElement("playlist");
+        }
+        else
+        {
+            writer.writeStartElement("collection");
+            PlayListItem::writeCollection(writer, item);
+        }
+        for (PlayListItem *child : *item->children)
+        {
+            if (child->children)
+            {
+                writeXml(writer, child, false);
+            }
+            else
+            {
+                writer.writeStartElement("item");
+                PlayListItem::writeItem(writer, child);
+                writer.writeEndElement();
+            }
+        }
+        writer.writeEndElement();
+    }
+
+    bool saveXml(const QString &path, PlayListItem *root)
+    {
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) return false;
+        QXmlStreamWriter writer(&file);
+        writer.setAutoFormatting(true);
+        writer.writeStartDocument();
+        writeXml(writer, root, true);
+        writer.writeEndDocument();
+        return file.flush();
+    }
+
+    PlayListItem *loadXml(const QString &path)
+    {
+        PlayListItem *root = new PlayListItem;
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) return root;
+        QXmlStreamReader reader(&file);
+        QVector<PlayListItem *> parents;
+        while (!reader.atEnd())
+        {
+            if (reader.isStartElement())
+            {
+                if (reader.name() == QLatin1String("playlist")) parents.push_back(root);
+                else if (reader.name() == QLatin1String("collection")) parents.push_back(PlayListItem::parseCollection(reader, parents.last()));
+                else if (reader.name() == QLatin1String("item")) PlayListItem::parseItem(reader, parents.last());
+            }
+            if (reader.isEndElement())
+            {
+                if (reader.name() == QLatin1String("playlist")) break;
+                if (reader.name() == QLatin1String("collection")) parents.pop_back();
+            }
+            reader.readNext();
+        }
+        return root;
+    }
+
+    double ms(QElapsedTimer &timer)
+    {
+        return timer.nsecsElapsed() / 1e6;
+    }
+
+    bool run(int count, const QString &dir)
+    {
+        const QString base = QString("%1/playlist_%2").arg(dir).arg(count);
+        QElapsedTimer timer;
+        std::printf("\n%d items\n", count);
+
+        timer.start();
+        PlayListItem *root = buildTree(count);
+        std::printf("  build tree          %10.1f ms\n", ms(timer));
+
+        timer.restart();
+        if (!saveXml(base + ".xml", root)) return false;
+        std::printf("  xml save            %10.1f ms  %8.1f KiB\n", ms(timer), QFile(base + ".xml").size() / 1024.0);
+        timer.restart();
+        PlayListItem *xmlRoot = loadXml(base + ".xml");
+        std::printf("  xml load            %10.1f ms\n", ms(timer));
+        const bool xmlOk = countLeaves(xmlRoot) == count;
+        delete xmlRoot;
+        if (!xmlOk) return false;
+
+        PlayListStore store(base);
+        timer.restart();
+        if (!store.save(root)) return false;
+        std::printf("  snapshot write      %10.1f ms  %8.1f KiB\n", ms(timer), QFile(base + ".dat").size() / 1024.0);
+        {
+            PlayListStore loader(base);
+            PlayListItem *loaded = new PlayListItem;
+            timer.restart();
+            const bool ok = loader.load(loaded);
+            std::printf("  snapshot load       %10.1f ms\n", ms(timer));
+            const bool countOk = ok && countLeaves(loaded) == count;
+            delete loaded;
+            if (!countOk) return false;
+        }
+
+        // a few items change between saves, as after playing an episode
+        QVector<PlayListItem *> leaves;
+        forEachLeaf(root, [&leaves](PlayListItem *item){ leaves.append(item); });
+        double appendTotal = 0;
+        for (int s = 0; s < journalSaves; ++s)
+        {
+            for (int c = 0; c < changesPerSave; ++c)
+            {
+                PlayListItem *item = leaves[(s * 7919 + c * 104729) % leaves.size()];
+                item->playTime += 1;
+                item->playTimeState = PlayListItem::UNFINISH;
+            }
+            timer.restart();
+            if (!store.save(root)) return false;
+            appendTotal += ms(timer);
+        }
+        std::printf("  journal append      %10.2f ms  (average of %d saves, %d changes each)  %8.1f KiB\n",
+                    appendTotal / journalSaves, journalSaves, changesPerSave, QFile(base + ".journal").size() / 1024.0);
+        {
+            PlayListStore loader(base);
+            PlayListItem *loaded = new PlayListItem;
+            timer.restart();
+            const bool ok = loader.load(loaded);
+            std::printf("  journal replay      %10.1f ms  (snapshot + %d batches)\n", ms(timer), journalSaves);
+            int playTimeSum = 0, expectedSum = 0;
+            forEachLeaf(loaded, [&playTimeSum](PlayListItem *item){ playTimeSum += item->playTime; });
+            for (PlayListItem *item : leaves) expectedSum += item->playTime;
+            const bool replayOk = ok && countLeaves(loaded) == count && playTimeSum == expectedSum;
+            delete loaded;
+            if (!replayOk) return false;
+        }
+
+        // every record differs, the journal would outgrow the snapshot
+        for (PlayListItem *item : leaves) item->playTime += 1;
+        timer.restart();
+        if (!store.save(root)) return false;
+        std::printf("  compaction          %10.1f ms  journal %8.1f KiB after\n", ms(timer), QFile(base + ".journal").size() / 1024.0);
+
+        delete root;
+        return true;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTemporaryDir dir;
+    if (!dir.isValid()) return 1;
+    // PlayListStore logs through Logger, which writes below the data path
+    GlobalObjects::dataPath = dir.path() + "/";
+
+    QVector<int> sizes;
+    for (int i = 1; i < app.arguments().size(); ++i)
+        sizes.append(app.arguments().at(i).toInt());
+    if (sizes.isEmpty()) sizes = {10000, 50000, 100000};
+    for (int count : sizes)
+    {
+        if (count <= 0) continue;
+        if (!run(count, dir.path()))
+        {
+            std::printf("FAILED at %d items\n", count);
+            return 1;
+        }
+    }
+    return 0;
+}